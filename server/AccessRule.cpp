@@ -0,0 +1,286 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <ctime>
+#include <fstream>
+#include <algorithm>
+#include "AccessRule.h"
+#include "Util/SHA1.h"
+#include "Util/File.h"
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Common/config.h"
+#include "Common/Parser.h"
+#include "Network/sockutil.h"
+
+using namespace toolkit;
+
+namespace Hook {
+#define HOOK_FIELD "hook."
+//本地访问控制规则文件，文件不存在则不启用本地规则
+const string kAccessRuleFile = HOOK_FIELD"access_rule_file";
+onceToken token_access_rule([](){
+    mINI::Instance()[kAccessRuleFile] = exeDir() + "access_rule.json";
+},nullptr);
+}//namespace Hook
+
+static AccessRuleEngine::Ptr s_current;
+
+static string hmac_sha1_hex(const string &key, const string &msg) {
+    static const int kBlockSize = 64;
+    string realKey = key.size() > kBlockSize ? SHA1::encode_bin(key) : key;
+    realKey.resize(kBlockSize, '\0');
+    string ipad(kBlockSize, '\0'), opad(kBlockSize, '\0');
+    for (int i = 0; i < kBlockSize; ++i) {
+        ipad[i] = realKey[i] ^ 0x36;
+        opad[i] = realKey[i] ^ 0x5c;
+    }
+    auto digest = SHA1::encode_bin(opad + SHA1::encode_bin(ipad + msg));
+    static const char *s_hex = "0123456789abcdef";
+    string ret;
+    ret.reserve(digest.size() * 2);
+    for (auto ch : digest) {
+        ret.push_back(s_hex[((uint8_t) ch) >> 4]);
+        ret.push_back(s_hex[((uint8_t) ch) & 0x0F]);
+    }
+    return ret;
+}
+
+//常量时间比较签名(hex不区分大小写)，耗时与第一个不同字符的位置无关，防止通过计时逐字节猜测签名
+static bool sign_equal(const string &sign, const string &token) {
+    if (sign.size() != token.size()) {
+        return false;
+    }
+    uint8_t diff = 0;
+    for (size_t i = 0; i < sign.size(); ++i) {
+        uint8_t a = sign[i], b = token[i];
+        //hex字母统一为小写，非字母字符不受影响
+        a |= (uint8_t) (((a - 'A') < 26u) << 5);
+        b |= (uint8_t) (((b - 'A') < 26u) << 5);
+        diff |= a ^ b;
+    }
+    return diff == 0;
+}
+
+//解析 a.b.c.d/len 格式，解析失败返回false
+static bool parse_cidr(const string &cidr, uint32_t &ip, int &prefixLen) {
+    auto pos = cidr.find('/');
+    auto ipStr = cidr.substr(0, pos);
+    prefixLen = pos == string::npos ? 32 : atoi(cidr.substr(pos + 1).data());
+    struct in_addr addr;
+    if (inet_pton(AF_INET, ipStr.data(), &addr) != 1 || prefixLen < 0 || prefixLen > 32) {
+        return false;
+    }
+    ip = ntohl(addr.s_addr);
+    return true;
+}
+
+void AccessRuleEngine::CidrTrie::insert(uint32_t ip, int prefixLen, int ruleIndex) {
+    int node = 0;
+    for (int i = 0; i < prefixLen; ++i) {
+        int bit = (ip >> (31 - i)) & 0x01;
+        if (_nodes[node]._child[bit] == -1) {
+            _nodes[node]._child[bit] = _nodes.size();
+            _nodes.emplace_back();
+        }
+        node = _nodes[node]._child[bit];
+    }
+    _nodes[node]._rules.emplace_back(ruleIndex);
+}
+
+void AccessRuleEngine::CidrTrie::lookup(uint32_t ip, vector<bool> &flags) const {
+    int node = 0;
+    for (int i = 0; node != -1; ++i) {
+        for (auto index : _nodes[node]._rules) {
+            flags[index] = true;
+        }
+        if (i == 32) {
+            break;
+        }
+        node = _nodes[node]._child[(ip >> (31 - i)) & 0x01];
+    }
+}
+
+AccessRuleEngine::Ptr AccessRuleEngine::compile(const Json::Value &rules) {
+    Ptr ret(new AccessRuleEngine);
+    if (!rules.isArray()) {
+        return ret;
+    }
+    unordered_map<string, vector<int> > appOnlyRules;
+    for (Json::Value::ArrayIndex i = 0; i < rules.size(); ++i) {
+        auto &cfg = rules[i];
+        int index = ret->_rules.size();
+        Rule rule;
+        auto type = cfg.get("type", "all").asString();
+        rule._play = type != "publish";
+        rule._publish = type != "play";
+        rule._vhost = cfg.get("vhost", "").asString();
+        rule._streamPrefix = cfg.get("stream_prefix", "").asString();
+
+        auto action = cfg.get("action", "allow").asString();
+        if (action == "deny") {
+            rule._action = Rule::Action_Deny;
+        } else if (action == "token") {
+            rule._action = Rule::Action_Token;
+            rule._tokenKey = cfg.get("token_key", "").asString();
+            if (rule._tokenKey.empty()) {
+                //空密钥的签名任何人都能计算出来，忽略该规则
+                ErrorL << "第" << i << "条访问控制规则action为token但未设置token_key，已忽略该规则";
+                continue;
+            }
+            rule._tokenParam = cfg.get("token_param", "token").asString();
+            rule._expireParam = cfg.get("expire_param", "expire").asString();
+        } else {
+            rule._action = Rule::Action_Allow;
+        }
+
+        auto &cidrs = cfg["cidr"];
+        if (cidrs.isArray() && cidrs.size()) {
+            rule._anyIp = false;
+            for (Json::Value::ArrayIndex j = 0; j < cidrs.size(); ++j) {
+                uint32_t ip;
+                int prefixLen;
+                if (!parse_cidr(cidrs[j].asString(), ip, prefixLen)) {
+                    WarnL << "无效的cidr:" << cidrs[j].asString();
+                    continue;
+                }
+                ret->_trie.insert(ip, prefixLen, index);
+            }
+        }
+
+        auto app = cfg.get("app", "").asString();
+        if (app.empty()) {
+            ret->_anyAppRules.emplace_back(index);
+        } else {
+            appOnlyRules[app].emplace_back(index);
+        }
+        ret->_rules.emplace_back(std::move(rule));
+    }
+
+    //每个app的候选规则合并不限app的规则，保持规则原有顺序
+    for (auto &pr : appOnlyRules) {
+        auto &merged = ret->_appRules[pr.first];
+        std::merge(pr.second.begin(), pr.second.end(),
+                   ret->_anyAppRules.begin(), ret->_anyAppRules.end(),
+                   std::back_inserter(merged));
+    }
+    return ret;
+}
+
+AccessRuleEngine::Ptr AccessRuleEngine::loadFile(const string &path) {
+    std::ifstream file(path);
+    if (!file) {
+        return compile(Json::nullValue);
+    }
+    try {
+        Json::Value rules;
+        file >> rules;
+        auto ret = compile(rules);
+        InfoL << "加载本地访问控制规则" << ret->size() << "条:" << path;
+        return ret;
+    } catch (std::exception &ex) {
+        WarnL << "解析本地访问控制规则失败:" << path << " " << ex.what();
+        return compile(Json::nullValue);
+    }
+}
+
+AccessRuleEngine::Ptr AccessRuleEngine::current() {
+    return std::atomic_load(&s_current);
+}
+
+void AccessRuleEngine::reload() {
+    GET_CONFIG(string, ruleFile, Hook::kAccessRuleFile);
+    std::atomic_store(&s_current, loadFile(ruleFile));
+}
+
+const vector<int> &AccessRuleEngine::candidates(const string &app) const {
+    auto it = _appRules.find(app);
+    if (it == _appRules.end()) {
+        return _anyAppRules;
+    }
+    return it->second;
+}
+
+AccessRuleEngine::Result AccessRuleEngine::match(bool isPlayer, const MediaInfo &args, const string &peerIp, string &reason) const {
+    auto &ruleIndexes = candidates(args._app);
+    if (ruleIndexes.empty()) {
+        return Rule_NoMatch;
+    }
+
+    vector<bool> ipMatched(_rules.size(), false);
+    struct in_addr addr;
+    if (inet_pton(AF_INET, peerIp.data(), &addr) == 1) {
+        _trie.lookup(ntohl(addr.s_addr), ipMatched);
+    }
+
+    for (auto index : ruleIndexes) {
+        auto &rule = _rules[index];
+        if (!(isPlayer ? rule._play : rule._publish)) {
+            continue;
+        }
+        if (!rule._vhost.empty() && rule._vhost != args._vhost) {
+            continue;
+        }
+        if (!rule._anyIp && !ipMatched[index]) {
+            continue;
+        }
+        if (args._streamid.compare(0, rule._streamPrefix.size(), rule._streamPrefix) != 0) {
+            continue;
+        }
+        return apply(rule, args, reason);
+    }
+    return Rule_NoMatch;
+}
+
+AccessRuleEngine::Result AccessRuleEngine::apply(const Rule &rule, const MediaInfo &args, string &reason) const {
+    switch (rule._action) {
+        case Rule::Action_Allow:
+            return Rule_Allow;
+        case Rule::Action_Deny:
+            reason = "denied by access rule";
+            return Rule_Deny;
+        default:
+            break;
+    }
+
+    auto params = Parser::parseArgs(args._param_strs);
+    auto &token = params[rule._tokenParam];
+    auto &expire = params[rule._expireParam];
+    if (token.empty() || expire.empty()) {
+        reason = "access token required";
+        return Rule_Deny;
+    }
+    if (strtoull(expire.data(), nullptr, 10) < (uint64_t) time(NULL)) {
+        reason = "access token expired";
+        return Rule_Deny;
+    }
+    auto sign = hmac_sha1_hex(rule._tokenKey, args._app + "/" + args._streamid + "/" + expire);
+    if (!sign_equal(sign, token)) {
+        reason = "access token mismatch";
+        return Rule_Deny;
+    }
+    return Rule_Allow;
+}
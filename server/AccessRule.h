@@ -0,0 +1,152 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ZLMEDIAKIT_ACCESSRULE_H
+#define ZLMEDIAKIT_ACCESSRULE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include "jsoncpp/json.h"
+#include "Common/MediaSource.h"
+
+using namespace std;
+using namespace mediakit;
+
+/**
+ * 本地访问控制规则，用于在进程内直接完成大部分播放/推流鉴权，避免每次都请求http hook
+ * 规则从json文件加载，按照数组顺序匹配，第一个匹配的规则生效，未命中任何规则时回退到http hook
+ * 规则格式如下:
+ * [
+ *   {
+ *     "type" : "play",                 //play、publish或all，默认all
+ *     "vhost" : "",                    //为空匹配所有vhost
+ *     "app" : "live",                  //为空匹配所有app
+ *     "stream_prefix" : "cam",         //stream前缀，为空匹配所有stream
+ *     "cidr" : ["10.0.0.0/8"],         //客户端ip范围，为空匹配所有ip
+ *     "action" : "allow",              //allow、deny或token
+ *     "token_key" : "secret",          //action为token时的hmac密钥，不能为空，否则忽略该规则
+ *     "token_param" : "token",         //url参数中携带签名的参数名，默认token
+ *     "expire_param" : "expire"        //url参数中携带过期时间(unix秒)的参数名，默认expire
+ *   }
+ * ]
+ * token签名算法为: hex(hmac_sha1(token_key, app + "/" + stream + "/" + expire))
+ */
+class AccessRuleEngine {
+public:
+    typedef std::shared_ptr<AccessRuleEngine> Ptr;
+
+    typedef enum {
+        //未命中任何规则，需要回退到http hook
+        Rule_NoMatch = 0,
+        //允许访问
+        Rule_Allow,
+        //拒绝访问
+        Rule_Deny,
+    } Result;
+
+    /**
+     * 从json文件加载规则并编译，文件不存在时返回空规则
+     */
+    static Ptr loadFile(const string &path);
+
+    /**
+     * 从json数组编译规则
+     */
+    static Ptr compile(const Json::Value &rules);
+
+    /**
+     * 当前生效的规则，可能为空
+     */
+    static Ptr current();
+
+    /**
+     * 重新加载配置中指定的规则文件
+     */
+    static void reload();
+
+    /**
+     * 匹配规则
+     * @param isPlayer 是否为播放，否则为推流
+     * @param args 媒体信息，包括url参数
+     * @param peerIp 客户端ip
+     * @param reason 拒绝原因
+     */
+    Result match(bool isPlayer, const MediaInfo &args, const string &peerIp, string &reason) const;
+
+    size_t size() const { return _rules.size(); }
+
+private:
+    class Rule {
+    public:
+        typedef enum {
+            Action_Allow = 0,
+            Action_Deny,
+            Action_Token,
+        } Action;
+        bool _play = true;
+        bool _publish = true;
+        bool _anyIp = true;
+        string _vhost;
+        string _streamPrefix;
+        Action _action = Action_Allow;
+        string _tokenKey;
+        string _tokenParam;
+        string _expireParam;
+    };
+
+    /**
+     * ip前缀树，每个节点记录以该节点为前缀的规则序号
+     */
+    class CidrTrie {
+    public:
+        void insert(uint32_t ip, int prefixLen, int ruleIndex);
+        //把包含该ip的规则序号标记到flags中
+        void lookup(uint32_t ip, vector<bool> &flags) const;
+    private:
+        class Node {
+        public:
+            int _child[2] = {-1, -1};
+            vector<int> _rules;
+        };
+        vector<Node> _nodes = vector<Node>(1);
+    };
+
+    AccessRuleEngine() {}
+    Result apply(const Rule &rule, const MediaInfo &args, string &reason) const;
+    const vector<int> &candidates(const string &app) const;
+
+private:
+    vector<Rule> _rules;
+    CidrTrie _trie;
+    //按app索引的候选规则(已合并不限app的规则，按序号排序)
+    unordered_map<string, vector<int> > _appRules;
+    //不限app的规则
+    vector<int> _anyAppRules;
+};
+
+#endif //ZLMEDIAKIT_ACCESSRULE_H
@@ -24,6 +24,8 @@
  * SOFTWARE.
  */
 #include <tuple>
+#include <deque>
+#include <cstdint>
 #include <signal.h>
 #include <functional>
 #include <sstream>
@@ -42,12 +44,17 @@
 
 #include "Common/config.h"
 #include "Common/MediaSource.h"
+#include "Common/PacketArena.h"
+#include "MediaFile/RecordRetention.h"
 #include "Http/HttpRequester.h"
 #include "Http/HttpSession.h"
 #include "Network/TcpServer.h"
 #include "Player/PlayerProxy.h"
 #include "Kf/DbUtil.h"
 #include "Kf/Globals.h"
+#include "Kf/ChannelCatalog.h"
+#include "RtpProxy/RtpSelector.h"
+#include "RtpProxy/TsUdpReceiver.h"
 #include "Util/MD5.h"
 #include "WebApi.h"
 #include <stdio.h>
@@ -114,10 +121,13 @@ typedef enum {
 #define API_FIELD "api."
 const string kApiDebug = API_FIELD"apiDebug";
 const string kSecret = API_FIELD"secret";
+//批量保存通道时，每秒最多(重新)拉流的通道数，0为不限制
+const string kReconcileRestartPerSecond = API_FIELD"reconcileRestartPerSecond";
 
 static onceToken token([]() {
     mINI::Instance()[kApiDebug] = "1";
     mINI::Instance()[kSecret] = "035c73f7-bb6b-4889-a715-d9eb2d1925cc";
+    mINI::Instance()[kReconcileRestartPerSecond] = 20;
 });
 }//namespace API
 
@@ -352,6 +362,12 @@ bool directoryMp4RecordExists(const std::string &directory) {
 static unordered_map<string ,PlayerProxy::Ptr> s_proxyMap;
 static recursive_mutex s_proxyMapMtx;
 
+#if defined(ENABLE_RTPPROXY)
+//mpeg-ts over udp收流器，key为vhost/app/stream
+static unordered_map<string ,TsUdpReceiver::Ptr> s_tsReceiverMap;
+static recursive_mutex s_tsReceiverMapMtx;
+#endif//defined(ENABLE_RTPPROXY)
+
 #if !defined(_WIN32)
 static unordered_map<string, FFmpegSource::Ptr> s_ffmpegMap;
 static recursive_mutex s_ffmpegMapMtx;
@@ -434,19 +450,13 @@ void processProxyCfg(const Json::Value &proxyData, const bool initialize = false
     bool realOnDemand = vRecordMp4 ? false : vOnDemand;
 
 
-    InfoL << "\n========================================================================\n"
-          << "========== " << (initialize ? "[初始化]" : "[按需重拉]") << "应用频道代理规则 : " << vName << " ==========\n"
-          << "========================================================================\n"
-          << "active        :  " << vActive << "\n"
-          << "url        :  " << vUrl << "\n"
-          << "vhost        :  " << vHost << "\n"
-          << "app        :  " << vApp << "\n"
-          << "stream     :  " << vStream << "\n"
-          << "enable_hls :  " << vEnableHls << "\n"
-          << "record_mp4 :  " << vRecordMp4 << "\n"
-          << "ffmpeg_cmd :  " << vFFmpegCmd << "\n"
-          << "ffmpeg_cmd :  " << vFFmpegCmd << "\n"
-          << "on_demand  :  " << vOnDemand << "\n\n";
+    InfoL << (initialize ? "[初始化]" : "[按需重拉]") << "应用频道代理规则:" << vName
+          << " " << vHost << "/" << vApp << "/" << vStream
+          << " url:" << vUrl
+          << " enable_hls:" << vEnableHls
+          << " record_mp4:" << vRecordMp4
+          << " on_demand:" << vOnDemand
+          << " ffmpeg_cmd:" << vFFmpegCmd;
 
 
 
@@ -539,6 +549,135 @@ void processProxyCfg(const Json::Value &proxyData, const bool initialize = false
 
 
 }
+//停止通道对应的拉流代理、FFmpeg以及定时快照
+static void stopProxyCfg(const string &proxyKey) {
+    {
+        lock_guard<recursive_mutex> lck(m_s_proxyMapMtx);
+        m_s_proxyMap.erase(proxyKey);
+    }
+    {
+        lock_guard<recursive_mutex> lck(m_s_ffmpegMapMtx);
+        m_s_ffmpegMap.erase(proxyKey);
+    }
+    lock_guard<decltype(m_s_snapshotTimerMtx)> lck(m_s_snapshotTimerMtx);
+    snapshotInfoMap.erase(proxyKey);
+}
+
+//通道是否正在拉流
+static bool isProxyRunning(const string &proxyKey) {
+    {
+        lock_guard<recursive_mutex> lck(m_s_proxyMapMtx);
+        if (m_s_proxyMap.find(proxyKey) != m_s_proxyMap.end()) {
+            return true;
+        }
+    }
+    lock_guard<recursive_mutex> lck(m_s_ffmpegMapMtx);
+    return m_s_ffmpegMap.find(proxyKey) != m_s_ffmpegMap.end();
+}
+
+//除名称外的字段变化都需要重新拉流
+static bool isStreamCfgChanged(const Json::Value &original, const Json::Value &channel) {
+    for (auto &key : channel.getMemberNames()) {
+        if (key != "name" && original[key] != channel[key]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static recursive_mutex s_restartMtx;
+static deque<Json::Value> s_restartQueue;
+static bool s_restartScheduled = false;
+
+//按速率限制执行(重新)拉流，避免批量导入时瞬间发起大量连接
+static void scheduleProxyCfg(const Json::Value &channel) {
+    lock_guard<recursive_mutex> lck(s_restartMtx);
+    s_restartQueue.emplace_back(channel);
+    if (s_restartScheduled) {
+        return;
+    }
+    s_restartScheduled = true;
+    EventPollerPool::Instance().getPoller()->doDelayTask(100, []() -> uint64_t {
+        GET_CONFIG(int, restartPerSecond, API::kReconcileRestartPerSecond);
+        //每100ms执行一批
+        size_t batch = restartPerSecond > 0 ? MAX(1, restartPerSecond / 10) : SIZE_MAX;
+        deque<Json::Value> todo;
+        {
+            lock_guard<recursive_mutex> lck(s_restartMtx);
+            while (!s_restartQueue.empty() && todo.size() < batch) {
+                todo.emplace_back(std::move(s_restartQueue.front()));
+                s_restartQueue.pop_front();
+            }
+        }
+        for (auto &channel : todo) {
+            processProxyCfg(channel, true);
+        }
+        lock_guard<recursive_mutex> lck(s_restartMtx);
+        if (s_restartQueue.empty()) {
+            s_restartScheduled = false;
+            return 0;
+        }
+        return 100;
+    });
+}
+
+/**
+ * 批量应用通道配置
+ * 先在一个数据库事务中保存全部变化，再与正在运行的拉流代理/FFmpeg比对：
+ * 只对新增、拉流参数变化或未在运行的启用通道(重新)拉流，其余通道保持不动
+ * @param configs 通道参数数组
+ * @return 各类变化的统计
+ */
+static Value reconcileChannelCfgs(const Json::Value &configs) {
+    int created = 0, updated = 0, restarted = 0, unchanged = 0, failed = 0;
+    auto changes = ChannelCatalog::Instance().saveBatch(configs);
+    for (auto &change : changes) {
+        switch (change.type) {
+            case ChannelCatalog::Change::Created:
+                ++created;
+                scheduleProxyCfg(change.channel);
+                break;
+            case ChannelCatalog::Change::Updated:
+                ++updated;
+                if (!isStreamCfgChanged(change.original, change.channel)) {
+                    break;
+                }
+                ++restarted;
+                stopProxyCfg(change.original["proxyKey"].asString());
+                scheduleProxyCfg(change.channel);
+                break;
+            case ChannelCatalog::Change::Unchanged: {
+                ++unchanged;
+                auto &channel = change.channel;
+                bool onDemand = channel["on_demand"].asInt() && !channel["record_mp4"].asInt();
+                if (channel["active"].asInt() && !onDemand && !isProxyRunning(channel["proxyKey"].asString())) {
+                    //配置未变但拉流已停止，恢复之
+                    ++restarted;
+                    scheduleProxyCfg(channel);
+                }
+                break;
+            }
+            default:
+                ++failed;
+                break;
+        }
+    }
+    InfoL << "批量应用通道配置:" << changes.size()
+          << " 新增:" << created
+          << " 修改:" << updated
+          << " 重新拉流:" << restarted
+          << " 未变化:" << unchanged
+          << " 失败:" << failed;
+
+    Value ret;
+    ret["created"] = created;
+    ret["updated"] = updated;
+    ret["restarted"] = restarted;
+    ret["unchanged"] = unchanged;
+    ret["failed"] = failed;
+    return ret;
+}
+
 //chenxiaolei 配置生效方法
 void processProxyCfgs(const Json::Value &cfg_root) {
     for (unsigned int index = 0; index < cfg_root.size(); ++index) {
@@ -578,6 +717,35 @@ void installWebApi() {
         });
     })
 
+    //获取媒体包内存分配器各档位的占用、峰值与未命中率
+    //测试url http://127.0.0.1/index/api/getPacketArenaStatistic
+    API_REGIST(api, getPacketArenaStatistic, {
+        CHECK_SECRET();
+        for (auto &stat : PacketArena::Instance().getStatistic()) {
+            Value obj(objectValue);
+            obj["blockSize"] = (Json::UInt64) stat.block_size;
+            obj["inUse"] = (Json::UInt64) stat.in_use;
+            obj["highWater"] = (Json::UInt64) stat.high_water;
+            obj["cached"] = (Json::UInt64) stat.cached;
+            obj["allocCount"] = (Json::UInt64) stat.alloc_count;
+            obj["missCount"] = (Json::UInt64) stat.miss_count;
+            obj["missRate"] = stat.alloc_count ? (double) stat.miss_count / stat.alloc_count : 0.0;
+            val["data"].append(obj);
+        }
+        val["code"] = API::Success;
+    });
+
+    //获取各磁盘卷与各流的录像占用统计
+    //测试url http://127.0.0.1/index/api/getRecordUsage
+    API_REGIST_INVOKER(api, getRecordUsage, {
+        CHECK_SECRET();
+        RecordRetention::Instance().getStatistic([invoker, headerOut](const Value &usage) {
+            Value val = usage;
+            val["code"] = API::Success;
+            invoker("200 OK", headerOut, val.toStyledString());
+        });
+    });
+
 
     //chenxiaolei 登录, 判断 secret 是否正确
     //测试url http://127.0.0.1/index/api/login
@@ -705,27 +873,7 @@ void installWebApi() {
         //CHECK_ARGS("data");
 
         Json::Value configArray = jsonArgs["data"];
-
-        for (Json::Value::ArrayIndex i = 0; i != configArray.size(); i++) {
-            auto cConfig = configArray[i];
-            int rc = 0;
-            string idStr = cConfig["id"].asString();
-            int id= idStr.empty() ? 0:  atoi(idStr.c_str());
-            rc = saveChannel(id,cConfig,[](bool isCreate,Json::Value originalChannel, Json::Value channel){
-                if(isCreate){
-                    processProxyCfg(channel, true);
-                }else{
-                    //先把原来的尝试删除了
-                    if (!originalChannel.isNull()) {
-                        auto proxyKey = originalChannel["proxyKey"].asString();
-                        lock_guard<recursive_mutex> lck(m_s_proxyMapMtx);
-                        m_s_proxyMap.erase(proxyKey);
-                    }
-                    processProxyCfg(channel, true);
-                }
-            });
-        }
-
+        val["data"] = reconcileChannelCfgs(configArray);
         val["code"] = API::Success;
         val["msg"] = "success";
     })
@@ -793,30 +941,12 @@ void installWebApi() {
                 } else {
                     auto partContent = partList.front()["PartContent"];
                     Json::Value configArray=channelsCsvStrToJson(partContent);
+                    auto result = reconcileChannelCfgs(configArray);
+                    int changed = result["created"].asInt() + result["updated"].asInt();
 
-                    for (Json::Value::ArrayIndex i = 0; i != configArray.size(); i++) {
-                        auto cConfig = configArray[i];
-                        int rc = 0;
-                        string idStr = cConfig["id"].asString();
-                        int id= idStr.empty() ? 0:  atoi(idStr.c_str());
-                        rc = saveChannel(id,cConfig,[](bool isCreate,Json::Value originalChannel, Json::Value channel){
-                            if(isCreate){
-                                processProxyCfg(channel, true);
-                            }else{
-                                //先把原来的尝试删除了
-                                if (!originalChannel.isNull()) {
-                                    auto proxyKey = originalChannel["proxyKey"].asString();
-                                    lock_guard<recursive_mutex> lck(m_s_proxyMapMtx);
-                                    m_s_proxyMap.erase(proxyKey);
-                                }
-                                processProxyCfg(channel, true);
-                            }
-                        });
-                    }
-
-
+                    val["data"] = result;
                     val["code"] = API::Success;
-                    val["msg"] = "上传成功," + (configArray.isNull()? "0":to_string(configArray.size()-1)) + "条记录变化";
+                    val["msg"] = "上传成功," + to_string(changed) + "条记录变化";
                 }
             }
 
@@ -1193,6 +1323,139 @@ void installWebApi() {
     });
 #endif//#if !defined(_WIN32)
 
+#if defined(ENABLE_RTPPROXY)
+    //为GB28181流分配独立的udp+tcp收流端口，生成的流为 rtp_proxy.appName/stream_id
+    //测试url http://127.0.0.1/index/api/openRtpServer?stream_id=34020000001320000001
+    API_REGIST(api,openRtpServer,{
+        CHECK_SECRET();
+        CHECK_ARGS("stream_id");
+        auto port = RtpSelector::Instance().openRtpServer(allArgs["stream_id"]);
+        if(!port){
+            val["code"] = API::OtherFailed;
+            val["msg"] = "没有可用的收流端口";
+            return;
+        }
+        val["port"] = port;
+        val["code"] = API::Success;
+    });
+
+    //关闭独立收流端口并销毁该流
+    //测试url http://127.0.0.1/index/api/closeRtpServer?stream_id=34020000001320000001
+    API_REGIST(api,closeRtpServer,{
+        CHECK_SECRET();
+        CHECK_ARGS("stream_id");
+        val["hit"] = RtpSelector::Instance().closeRtpServer(allArgs["stream_id"]);
+        val["code"] = API::Success;
+    });
+
+    //把ssrc(十进制，与sdp中y=字段一致)绑定到指定流id，共享端口上该ssrc的rtp将生成该流
+    //测试url http://127.0.0.1/index/api/bindRtpSSRC?ssrc=100000001&stream_id=34020000001320000001
+    API_REGIST(api,bindRtpSSRC,{
+        CHECK_SECRET();
+        CHECK_ARGS("ssrc","stream_id");
+        RtpSelector::Instance().bindSSRC(strtoul(allArgs["ssrc"].data(), nullptr, 10), allArgs["stream_id"]);
+        val["code"] = API::Success;
+    });
+
+    //解除ssrc绑定
+    //测试url http://127.0.0.1/index/api/unbindRtpSSRC?ssrc=100000001
+    API_REGIST(api,unbindRtpSSRC,{
+        CHECK_SECRET();
+        CHECK_ARGS("ssrc");
+        val["hit"] = RtpSelector::Instance().unbindSSRC(strtoul(allArgs["ssrc"].data(), nullptr, 10));
+        val["code"] = API::Success;
+    });
+
+    //获取独立收流端口、ssrc绑定以及正在接收的GB28181流
+    //测试url http://127.0.0.1/index/api/listRtpServer
+    API_REGIST(api,listRtpServer,{
+        CHECK_SECRET();
+        auto &selector = RtpSelector::Instance();
+        val["servers"] = Value(arrayValue);
+        for(auto &pr : selector.getRtpServers()){
+            Value obj;
+            obj["stream_id"] = pr.first;
+            obj["port"] = pr.second;
+            val["servers"].append(obj);
+        }
+        val["bindings"] = Value(arrayValue);
+        for(auto &pr : selector.getSSRCBindings()){
+            Value obj;
+            obj["ssrc"] = (Json::UInt) pr.first;
+            obj["stream_id"] = pr.second;
+            val["bindings"].append(obj);
+        }
+        val["data"] = Value(arrayValue);
+        for(auto &pr : selector.getProcesses()){
+            Value obj;
+            obj["stream_id"] = pr.first;
+            obj["ssrc"] = (Json::UInt) pr.second->getSSRC();
+            obj["peer_ip"] = pr.second->getPeerIp();
+            obj["peer_port"] = pr.second->getPeerPort();
+            obj["totalBytes"] = (Json::UInt64) pr.second->getTotalBytes();
+            obj["readerCount"] = pr.second->readerCount();
+            val["data"].append(obj);
+        }
+        val["code"] = API::Success;
+    });
+
+    //接收mpeg-ts over udp(单播或组播，裸ts或rtp封装)，生成的流为 vhost/app/stream
+    //测试url http://127.0.0.1/index/api/addTsReceiver?vhost=__defaultVhost__&app=live&stream=ts&port=1234&multicast_ip=239.0.0.1
+    API_REGIST(api,addTsReceiver,{
+        CHECK_SECRET();
+        CHECK_ARGS("vhost","app","stream","port");
+        auto key = getProxyKey(allArgs["vhost"],allArgs["app"],allArgs["stream"]);
+        lock_guard<recursive_mutex> lck(s_tsReceiverMapMtx);
+        if(s_tsReceiverMap.find(key) != s_tsReceiverMap.end()){
+            val["code"] = API::OtherFailed;
+            val["msg"] = "该流已存在";
+            return;
+        }
+        auto local_ip = allArgs["local_ip"].empty() ? string("0.0.0.0") : allArgs["local_ip"];
+        auto receiver = std::make_shared<TsUdpReceiver>(allArgs["vhost"],allArgs["app"],allArgs["stream"]);
+        if(!receiver->start(allArgs["port"].as<uint16_t>(),allArgs["multicast_ip"],local_ip)){
+            val["code"] = API::OtherFailed;
+            val["msg"] = "绑定端口或加入组播失败";
+            return;
+        }
+        s_tsReceiverMap[key] = receiver;
+        val["data"]["key"] = key;
+        val["code"] = API::Success;
+    });
+
+    //关闭ts收流器
+    //测试url http://127.0.0.1/index/api/delTsReceiver?key=__defaultVhost__/live/ts
+    API_REGIST(api,delTsReceiver,{
+        CHECK_SECRET();
+        CHECK_ARGS("key");
+        lock_guard<recursive_mutex> lck(s_tsReceiverMapMtx);
+        val["data"]["flag"] = s_tsReceiverMap.erase(allArgs["key"]) == 1;
+        val["code"] = API::Success;
+    });
+
+    //获取ts收流器列表以及收流统计
+    //测试url http://127.0.0.1/index/api/listTsReceiver
+    API_REGIST(api,listTsReceiver,{
+        CHECK_SECRET();
+        val["data"] = Value(arrayValue);
+        lock_guard<recursive_mutex> lck(s_tsReceiverMapMtx);
+        for(auto &pr : s_tsReceiverMap){
+            Value obj;
+            obj["key"] = pr.first;
+            obj["port"] = pr.second->getPort();
+            obj["multicast_ip"] = pr.second->getMulticastIp();
+            obj["totalBytes"] = (Json::UInt64) pr.second->getTotalBytes();
+            obj["batchRatio"] = pr.second->getBatchRatio();
+            obj["idleTime"] = (Json::UInt64) pr.second->getIdleTime();
+            obj["discontinuity"] = pr.second->getDiscontinuityCount();
+            obj["ccErrors"] = pr.second->getCCErrorCount();
+            obj["readerCount"] = pr.second->readerCount();
+            val["data"].append(obj);
+        }
+        val["code"] = API::Success;
+    });
+#endif//defined(ENABLE_RTPPROXY)
+
 
     //获取流列表，可选筛选参数
     //测试url0(获取所有流) http://127.0.0.1/index/api/getMediaList
@@ -1575,6 +1838,13 @@ void unInstallWebApi(){
         s_proxyMap.clear();
     }
 
+#if defined(ENABLE_RTPPROXY)
+    {
+        lock_guard<recursive_mutex> lck(s_tsReceiverMapMtx);
+        s_tsReceiverMap.clear();
+    }
+#endif//defined(ENABLE_RTPPROXY)
+
 #if !defined(_WIN32)
     {
         lock_guard<recursive_mutex> lck(s_ffmpegMapMtx);
@@ -39,6 +39,7 @@
 #include "Rtsp/RtspSession.h"
 #include "Http/HttpSession.h"
 #include "WebHook.h"
+#include "AccessRule.h"
 
 using namespace Json;
 using namespace toolkit;
@@ -167,6 +168,25 @@ static void do_http_hook(const string &url,const ArgsType &body,const function<v
     },hook_timeoutSec);
 }
 
+//先用本地规则鉴权，命中规则返回true，否则需要回退到http hook
+static bool check_access_rule(bool isPlayer,const MediaInfo &args,TcpSession &sender,const Broadcast::AuthInvoker &invoker){
+    auto rules = AccessRuleEngine::current();
+    if(!rules){
+        return false;
+    }
+    string reason;
+    switch (rules->match(isPlayer,args,sender.get_peer_ip(),reason)){
+        case AccessRuleEngine::Rule_Allow:
+            invoker("");
+            return true;
+        case AccessRuleEngine::Rule_Deny:
+            invoker(reason);
+            return true;
+        default:
+            return false;
+    }
+}
+
 static ArgsType make_json(const MediaInfo &args){
     ArgsType body;
     body["schema"] = args._schema;
@@ -193,8 +213,22 @@ void installWebHook(){
     GET_CONFIG(string,hook_stream_none_reader,Hook::kOnStreamNoneReader);
     GET_CONFIG(string,hook_http_access,Hook::kOnHttpAccess);
 
+    //加载本地访问控制规则，配置文件重载时一并重载
+    AccessRuleEngine::reload();
+    NoticeCenter::Instance().addListener(nullptr,Broadcast::kBroadcastReloadConfig,[](BroadcastReloadConfigArgs){
+        AccessRuleEngine::reload();
+    });
+
     NoticeCenter::Instance().addListener(nullptr,Broadcast::kBroadcastMediaPublish,[](BroadcastMediaPublishArgs){
-        if(!hook_enable || args._param_strs == hook_adminparams || hook_publish.empty() || sender.get_peer_ip() == "127.0.0.1"){
+        if(args._param_strs == hook_adminparams || sender.get_peer_ip() == "127.0.0.1"){
+            invoker("");
+            return;
+        }
+        if(check_access_rule(false,args,sender,invoker)){
+            //本地规则已经做出决定
+            return;
+        }
+        if(!hook_enable || hook_publish.empty()){
             invoker("");
             return;
         }
@@ -210,7 +244,15 @@ void installWebHook(){
     });
 
     NoticeCenter::Instance().addListener(nullptr,Broadcast::kBroadcastMediaPlayed,[](BroadcastMediaPlayedArgs){
-        if(!hook_enable || args._param_strs == hook_adminparams || hook_play.empty() || sender.get_peer_ip() == "127.0.0.1"){
+        if(args._param_strs == hook_adminparams || sender.get_peer_ip() == "127.0.0.1"){
+            invoker("");
+            return;
+        }
+        if(check_access_rule(true,args,sender,invoker)){
+            //本地规则已经做出决定
+            return;
+        }
+        if(!hook_enable || hook_play.empty()){
             invoker("");
             return;
         }
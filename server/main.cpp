@@ -25,6 +25,7 @@
  */
 
 #include <map>
+#include <vector>
 #include <signal.h>
 #include <jsoncpp/value.h>
 #include <jsoncpp/json.h>
@@ -47,6 +48,8 @@
 #include "Rtmp/FlvMuxer.h"
 #include "Player/PlayerProxy.h"
 #include "Http/WebSocketSession.h"
+#include "MediaFile/RecordJournal.h"
+#include "RtpProxy/RtpServer.h"
 #include "WebApi.h"
 #include "WebHook.h"
 
@@ -106,8 +109,62 @@ onceToken token1([](){
     mINI::Instance()[kPort] = RTMP_PORT;
 },nullptr);
 } //namespace RTMP
+
+////////////通用配置///////////
+namespace General {
+#define GENERAL_FIELD "general."
+//是否每个poller线程各开一个SO_REUSEPORT监听socket
+//开启后由内核把新连接分摊到各个线程，会话直接在accept它的线程上运行，不再跨线程转交
+const string kReusePortListen = GENERAL_FIELD"reusePortListen";
+onceToken token1([](){
+    mINI::Instance()[kReusePortListen] = 0;
+},nullptr);
+} //namespace General
 }  // namespace mediakit
 
+/**
+ * 在指定poller上accept，并且会话也运行在该poller上的TcpServer
+ * 配合SO_REUSEPORT使用，每个poller一个监听socket
+ */
+class PollerTcpServer : public TcpServer {
+public:
+    PollerTcpServer(const EventPoller::Ptr &poller) : TcpServer(poller), _accept_poller(poller) {}
+    ~PollerTcpServer() override {}
+protected:
+    Socket::Ptr onBeforeAcceptConnection(const EventPoller::Ptr &poller) override {
+        //服务器器模型socket是线程安全的，所以为了提高性能，关闭互斥锁
+        return std::make_shared<Socket>(_accept_poller, false);
+    }
+private:
+    EventPoller::Ptr _accept_poller;
+};
+
+/**
+ * 启动tcp服务器
+ * @param port 监听端口
+ * @param reusePort 是否每个poller线程各开一个监听socket
+ * @return 服务器列表，需要持有直到程序退出
+ */
+template <typename SessionType>
+static vector<TcpServer::Ptr> startTcpServer(uint16_t port, bool reusePort) {
+    vector<TcpServer::Ptr> ret;
+    if (!reusePort) {
+        TcpServer::Ptr server(new TcpServer());
+        server->start<SessionType>(port);
+        ret.emplace_back(server);
+        return ret;
+    }
+    //ZLToolKit的监听socket默认设置了SO_REUSEADDR与SO_REUSEPORT，同一端口可以被多次监听
+    EventPollerPool::Instance().for_each([&](const TaskExecutor::Ptr &executor) {
+        auto poller = dynamic_pointer_cast<EventPoller>(executor);
+        TcpServer::Ptr server(new PollerTcpServer(poller));
+        server->start<SessionType>(port);
+        ret.emplace_back(server);
+    });
+    InfoL << "端口" << port << "开启了" << ret.size() << "个SO_REUSEPORT监听";
+    return ret;
+}
+
 
 class CMD_main : public CMD {
 public:
@@ -309,10 +366,6 @@ int main(int argc,char *argv[]) {
         uint16_t httpPort = mINI::Instance()[Http::kPort];
         uint16_t httpsPort = mINI::Instance()[Http::kSSLPort];
 
-
-        //清理下无效临时录像
-        clearInvalidRecord(mINI::Instance()[Record::kFilePath]);
-
         //执行转发规则
         Json::Value cfg_root = searchChannels();
         processProxyCfgs(cfg_root);
@@ -332,33 +385,46 @@ int main(int argc,char *argv[]) {
         //设置poller线程数,该函数必须在使用ZLToolKit网络相关对象之前调用才能生效
         EventPollerPool::setPoolSize(threads);
 
+        bool reusePort = mINI::Instance()[General::kReusePortListen];
+
         //简单的telnet服务器，可用于服务器调试，但是不能使用23端口，否则telnet上了莫名其妙的现象
         //测试方法:telnet 127.0.0.1 9000
-        TcpServer::Ptr shellSrv(new TcpServer());
-        TcpServer::Ptr rtspSrv(new TcpServer());
-        TcpServer::Ptr rtmpSrv(new TcpServer());
-        TcpServer::Ptr httpSrv(new TcpServer());
-
-        shellSrv->start<ShellSession>(shellPort);
-        rtspSrv->start<RtspSession>(rtspPort);//默认554
-        rtmpSrv->start<RtmpSession>(rtmpPort);//默认1935
+        //shell服务器连接数很少，无需多线程监听
+        auto shellSrv = startTcpServer<ShellSession>(shellPort, false);
+        auto rtspSrv = startTcpServer<RtspSession>(rtspPort, reusePort);//默认554
+        auto rtmpSrv = startTcpServer<RtmpSession>(rtmpPort, reusePort);//默认1935
         //http服务器,支持websocket
-        httpSrv->start<EchoWebSocketSession>(httpPort);//默认80
+        auto httpSrv = startTcpServer<EchoWebSocketSession>(httpPort, reusePort);//默认80
 
         //如果支持ssl，还可以开启https服务器
-        TcpServer::Ptr httpsSrv(new TcpServer());
         //https服务器,支持websocket
-        httpsSrv->start<SSLEchoWebSocketSession>(httpsPort);//默认443
+        auto httpsSrv = startTcpServer<SSLEchoWebSocketSession>(httpsPort, reusePort);//默认443
 
         //支持ssl加密的rtsp服务器，可用于诸如亚马逊echo show这样的设备访问
-        TcpServer::Ptr rtspSSLSrv(new TcpServer());
-        rtspSSLSrv->start<RtspSessionWithSSL>(rtspsPort);//默认322
+        auto rtspSSLSrv = startTcpServer<RtspSessionWithSSL>(rtspsPort, reusePort);//默认322
+
+#if defined(ENABLE_RTPPROXY)
+        //GB28181 PS over RTP共享收流端口，udp与tcp同时监听，按ssrc区分流
+        RtpServer::Ptr rtpServer;
+        uint16_t rtpProxyPort = mINI::Instance()[RtpProxy::kPort];
+        if (rtpProxyPort) {
+            rtpServer = std::make_shared<RtpServer>();
+            if (!rtpServer->start(rtpProxyPort)) {
+                WarnL << "GB28181收流端口启动失败:" << rtpProxyPort;
+            }
+        }
+#endif//defined(ENABLE_RTPPROXY)
 
         installWebApi();
         InfoL << "已启动http api 接口";
         installWebHook();
         InfoL << "已启动http hook 接口";
 
+#if defined(ENABLE_MP4V2)
+        //服务已启动，在后台修复上次异常退出时未完成的录像
+        RecordJournal::recoverAsync(mINI::Instance()[Record::kFilePath]);
+#endif//defined(ENABLE_MP4V2)
+
 #if !defined(_WIN32)
         if (!bDaemon) {
             //交互式shell输入
@@ -27,6 +27,7 @@
 
 #include "MediaSource.h"
 #include "MediaFile/MediaReader.h"
+#include "Rtmp/RtmpKeyFrameSource.h"
 #include "Util/util.h"
 #include "Network/sockutil.h"
 #include "Network/TcpSession.h"
@@ -43,6 +44,15 @@ void MediaSource::findAsync(const MediaInfo &info,
                             const std::shared_ptr<TcpSession> &session,
                             bool retry,
                             const function<void(const MediaSource::Ptr &src)> &cb){
+    auto it = info._params.find("only_key");
+    if(it != info._params.end() && it->second == "1"){
+        //播放源流的关键帧派生流
+        MediaInfo key_info = info;
+        key_info._params.erase("only_key");
+        key_info._streamid = RtmpKeyFrameSource::getStreamId(info._streamid);
+        findAsync(key_info,session,retry,cb);
+        return;
+    }
 
     auto src = MediaSource::find(info._schema,
                                  info._vhost,
@@ -141,6 +151,10 @@ MediaSource::Ptr MediaSource::find(
         //查找某一媒体源，找到后返回
         ret = MediaReader::onMakeMediaSource(schema, vhost,app,id);
     }
+    if(!ret && bMake && RtmpKeyFrameSource::make(vhost,app,id)){
+        //关键帧派生流异步注册，可能此时已经注册
+        ret = find(schema,vhost,app,id,false);
+    }
     return ret;
 }
 void MediaSource::regist() {
@@ -255,4 +269,83 @@ void MediaSourceEvent::onNoneReader(MediaSource &sender){
 }
 
 
+/////////////////////////////////////HlsViewerCounter//////////////////////////////////////
+unordered_map<string, std::weak_ptr<HlsViewerCounter> > HlsViewerCounter::s_counters;
+mutex HlsViewerCounter::s_mtx;
+
+HlsViewerCounter::HlsViewerCounter(const string &vhost, const string &app, const string &stream) :
+        _vhost(vhost), _app(app), _stream(stream) {}
+
+HlsViewerCounter::Ptr HlsViewerCounter::get(const string &vhost, const string &app, const string &stream) {
+    auto key = vhost + "/" + app + "/" + stream;
+    lock_guard<mutex> lck(s_mtx);
+    auto &weak_counter = s_counters[key];
+    auto counter = weak_counter.lock();
+    if (!counter) {
+        counter = std::make_shared<HlsViewerCounter>(vhost, app, stream);
+        weak_counter = counter;
+    }
+    //顺带清理一个已失效的计数器，防止map膨胀
+    for (auto it = s_counters.begin(); it != s_counters.end(); ++it) {
+        if (it->second.expired()) {
+            s_counters.erase(it);
+            break;
+        }
+    }
+    return counter;
+}
+
+void HlsViewerCounter::onViewerRequest(const string &uid) {
+    {
+        lock_guard<mutex> lck(_mtx);
+        _viewers[uid] = getCurrentMillisecond();
+        _count = _viewers.size();
+        if (_ticking) {
+            return;
+        }
+        _ticking = true;
+    }
+    weak_ptr<HlsViewerCounter> weakSelf = shared_from_this();
+    EventPollerPool::Instance().getPoller()->doDelayTask(1000, [weakSelf]() -> uint64_t {
+        auto strongSelf = weakSelf.lock();
+        if (!strongSelf) {
+            return 0;
+        }
+        return strongSelf->onTick() ? 1000 : 0;
+    });
+}
+
+bool HlsViewerCounter::onTick() {
+    //播放器至少每个切片时长刷新一次索引文件，超过3个切片时长未刷新则认为已经离开
+    GET_CONFIG(uint32_t, segDuration, Hls::kSegmentDuration);
+    auto timeout = 3 * 1000 * MAX(1, segDuration);
+    auto now = getCurrentMillisecond();
+    {
+        lock_guard<mutex> lck(_mtx);
+        for (auto it = _viewers.begin(); it != _viewers.end();) {
+            if (now - it->second > timeout) {
+                it = _viewers.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        _count = _viewers.size();
+        if (!_viewers.empty()) {
+            return true;
+        }
+        _ticking = false;
+    }
+
+    //最后一个hls观看者离开，rtsp/rtmp的消费者可能早已清零，需要重新检查是否无人观看
+    for (auto &schema : {RTMP_SCHEMA, RTSP_SCHEMA}) {
+        auto src = MediaSource::find(schema, _vhost, _app, _stream, false);
+        if (src && src->readerCount() == 0) {
+            //onNoneReader内部会再次校验总的观看人数(包括hls)
+            src->onNoneReader();
+            break;
+        }
+    }
+    return false;
+}
+
 } /* namespace mediakit */
\ No newline at end of file
@@ -29,6 +29,7 @@
 #define ZLMEDIAKIT_MEDIASOURCE_H
 
 #include <mutex>
+#include <atomic>
 #include <string>
 #include <memory>
 #include <functional>
@@ -243,6 +244,54 @@ private:
     static recursive_mutex g_mtxMediaSrc; //访问静态的媒体源表的互斥锁
 };
 
+/**
+ * hls观看人数计数器，同一vhost/app/stream共享一个计数
+ * hls基于短连接，观看者按用户id追踪，与鉴权cookie的有效期无关：
+ * 每次鉴权通过的hls.m3u8请求刷新该观看者的活跃时间，超过数个切片时长未请求索引文件则认为已经离开
+ */
+class HlsViewerCounter : public std::enable_shared_from_this<HlsViewerCounter> {
+public:
+    typedef std::shared_ptr<HlsViewerCounter> Ptr;
+
+    HlsViewerCounter(const string &vhost, const string &app, const string &stream);
+    ~HlsViewerCounter() = default;
+
+    /**
+     * 获取某个流的hls观看人数计数器
+     */
+    static Ptr get(const string &vhost, const string &app, const string &stream);
+
+    /**
+     * 观看者请求了索引文件
+     * @param uid 观看者id
+     */
+    void onViewerRequest(const string &uid);
+
+    /**
+     * 当前观看人数
+     */
+    int count() const {
+        return _count.load();
+    }
+
+private:
+    //定时清理不活跃的观看者，返回是否继续定时
+    bool onTick();
+
+private:
+    string _vhost;
+    string _app;
+    string _stream;
+    mutex _mtx;
+    //观看者id -> 最后请求时间(毫秒)
+    unordered_map<string, uint64_t> _viewers;
+    bool _ticking = false;
+    std::atomic<int> _count {0};
+
+    static unordered_map<string, std::weak_ptr<HlsViewerCounter> > s_counters;
+    static mutex s_mtx;
+};
+
 } /* namespace mediakit */
 
 
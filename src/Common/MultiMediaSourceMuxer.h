@@ -52,6 +52,9 @@ public:
             _rtsp = std::make_shared<RtspMediaSourceMuxer>(vhost, strApp, strId, std::make_shared<TitleSdp>(dur_sec));
         }
         _record = std::make_shared<MediaRecorder>(vhost,strApp,strId,bEanbleHls,bRecordMp4);
+        if (bEanbleHls) {
+            _hlsViewers = HlsViewerCounter::get(vhost, strApp, strId);
+        }
     }
     virtual ~MultiMediaSourceMuxer(){}
 
@@ -102,7 +105,7 @@ public:
      * @return
      */
     int readerCount() const{
-        return (_rtsp ? _rtsp->readerCount() : 0) + (_rtmp ? _rtmp->readerCount() : 0);
+        return (_rtsp ? _rtsp->readerCount() : 0) + (_rtmp ? _rtmp->readerCount() : 0) + (_hlsViewers ? _hlsViewers->count() : 0);
     }
 
     void setTimeStamp(uint32_t stamp){
@@ -114,6 +117,7 @@ private:
     RtmpMediaSourceMuxer::Ptr _rtmp;
     RtspMediaSourceMuxer::Ptr _rtsp;
     MediaRecorder::Ptr _record;
+    HlsViewerCounter::Ptr _hlsViewers;
 };
 
 
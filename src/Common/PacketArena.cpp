@@ -0,0 +1,349 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <stdlib.h>
+#include "PacketArena.h"
+
+namespace mediakit {
+
+//内存块头部，保存档位下标，保证负载16字节对齐
+#define BLOCK_HEADER_SIZE 16
+
+//各档位大小(不含头部)：小包/rtcp、rtmp头部与音频、MTU(1500)加rtp over tcp头部、
+//rtmp chunk(4096)加头部、大帧分片、rtmp大消息
+static const size_t kClassSize[] = {128, 512, 1600, 4224, 16 * 1024, 64 * 1024};
+static const int kClassCount = sizeof(kClassSize) / sizeof(kClassSize[0]);
+//超出所有档位直接malloc的内存块
+static const int kOversizeIndex = kClassCount;
+//线程缓存与全局仓库交换的批次大小
+static const int kBatchSize = 32;
+//每个档位全局仓库最多缓存的字节数，超出后直接free
+static const size_t kMaxDepotBytes = 32 * 1024 * 1024;
+
+namespace {
+
+class FreeNode {
+public:
+    FreeNode *next;
+};
+
+/**
+ * 单向链表实现的空闲列表
+ */
+class FreeList {
+public:
+    void push(FreeNode *node) {
+        node->next = head;
+        head = node;
+        ++count;
+    }
+
+    FreeNode *pop() {
+        auto node = head;
+        if (node) {
+            head = node->next;
+            --count;
+        }
+        return node;
+    }
+
+    //拆出最多n个节点
+    FreeList split(int n) {
+        FreeList ret;
+        while (n-- > 0 && head) {
+            ret.push(pop());
+        }
+        return ret;
+    }
+
+    FreeNode *head = nullptr;
+    int count = 0;
+};
+
+/**
+ * 单个档位的申请释放计数
+ */
+class Counter {
+public:
+    std::atomic<uint64_t> alloc_count{0};
+    std::atomic<uint64_t> free_count{0};
+    std::atomic<uint64_t> miss_count{0};
+};
+
+/**
+ * 每个档位的全局仓库与统计，按缓存行对齐避免不同档位互相干扰
+ */
+class alignas(64) SizeClass {
+public:
+    mutex mtx;
+    //批次列表，每个批次kBatchSize个节点
+    vector<FreeList> batches;
+
+    //已退出线程以及线程缓存析构后的计数
+    Counter retired;
+    //获取统计时采样得到的正在使用内存块数最大值
+    std::atomic<uint64_t> high_water{0};
+};
+
+SizeClass s_classes[kOversizeIndex + 1];
+
+//只有所属线程修改的计数，不需要加锁的读改写，获取统计的线程只读
+void increase(std::atomic<uint64_t> &val) {
+    val.store(val.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+int classIndex(size_t size) {
+    for (int i = 0; i < kClassCount; ++i) {
+        if (size <= kClassSize[i]) {
+            return i;
+        }
+    }
+    return kOversizeIndex;
+}
+
+char *blockOf(void *ptr) {
+    return (char *) ptr - BLOCK_HEADER_SIZE;
+}
+
+void *payloadOf(char *block) {
+    return block + BLOCK_HEADER_SIZE;
+}
+
+//把批次还给全局仓库，仓库满了则直接释放
+void releaseBatch(int index, FreeList &list) {
+    auto &cls = s_classes[index];
+    {
+        lock_guard<mutex> lck(cls.mtx);
+        if (cls.batches.size() * kBatchSize * kClassSize[index] < kMaxDepotBytes) {
+            cls.batches.emplace_back(list);
+            list = FreeList();
+            return;
+        }
+    }
+    while (auto node = list.pop()) {
+        free(blockOf(node));
+    }
+}
+
+//线程缓存已经析构，之后本线程申请释放的内存不再经过线程缓存
+thread_local bool s_thread_exited = false;
+
+class ThreadCache;
+
+/**
+ * 所有线程缓存的登记表，获取统计时汇总各线程的计数
+ * 线程退出时还需要访问，所以不析构
+ */
+class CacheRegistry {
+public:
+    static CacheRegistry &Instance() {
+        static CacheRegistry *s_instance = new CacheRegistry();
+        return *s_instance;
+    }
+
+    mutex mtx;
+    vector<ThreadCache *> caches;
+};
+
+/**
+ * 线程缓存，线程退出时归还给全局仓库
+ * 申请释放计数也保存在线程缓存中，避免所有线程竞争同一个原子变量
+ */
+class ThreadCache {
+public:
+    ThreadCache() {
+        auto &registry = CacheRegistry::Instance();
+        lock_guard<mutex> lck(registry.mtx);
+        registry.caches.emplace_back(this);
+    }
+
+    ~ThreadCache() {
+        s_thread_exited = true;
+        for (int i = 0; i < kClassCount; ++i) {
+            while (_lists[i].count) {
+                auto batch = _lists[i].split(kBatchSize);
+                releaseBatch(i, batch);
+            }
+        }
+        //计数合并到全局后注销，与获取统计互斥，避免计数被漏算或者重复计算
+        auto &registry = CacheRegistry::Instance();
+        lock_guard<mutex> lck(registry.mtx);
+        for (int i = 0; i <= kOversizeIndex; ++i) {
+            auto &retired = s_classes[i].retired;
+            retired.alloc_count.fetch_add(_counters[i].alloc_count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            retired.free_count.fetch_add(_counters[i].free_count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            retired.miss_count.fetch_add(_counters[i].miss_count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        registry.caches.erase(std::find(registry.caches.begin(), registry.caches.end(), this));
+    }
+
+    Counter &counter(int index) {
+        return _counters[index];
+    }
+
+    void *allocate(int index) {
+        auto &list = _lists[index];
+        auto node = list.pop();
+        if (!node) {
+            //从全局仓库批量取
+            auto &cls = s_classes[index];
+            lock_guard<mutex> lck(cls.mtx);
+            if (!cls.batches.empty()) {
+                list = cls.batches.back();
+                cls.batches.pop_back();
+                node = list.pop();
+            }
+        }
+        return node;
+    }
+
+    void deallocate(int index, void *ptr) {
+        auto &list = _lists[index];
+        list.push((FreeNode *) ptr);
+        if (list.count >= 2 * kBatchSize) {
+            auto batch = list.split(kBatchSize);
+            releaseBatch(index, batch);
+        }
+    }
+
+private:
+    FreeList _lists[kClassCount];
+    Counter _counters[kOversizeIndex + 1];
+};
+
+thread_local ThreadCache s_thread_cache;
+
+}//namespace
+
+PacketArena &PacketArena::Instance() {
+    //线程退出时线程缓存还需要访问本对象，所以不析构
+    static PacketArena *s_instance = new PacketArena();
+    return *s_instance;
+}
+
+PacketArena::PacketArena() {}
+
+//计数加一，线程缓存析构后只能使用全局计数
+static void addCount(int index, std::atomic<uint64_t> Counter::*field) {
+    if (s_thread_exited) {
+        (s_classes[index].retired.*field).fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    increase(s_thread_cache.counter(index).*field);
+}
+
+void *PacketArena::allocate(size_t size, size_t *capacity) {
+    auto index = classIndex(size);
+    addCount(index, &Counter::alloc_count);
+    if (index == kOversizeIndex) {
+        addCount(index, &Counter::miss_count);
+        auto block = (char *) malloc(BLOCK_HEADER_SIZE + size);
+        if (!block) {
+            throw std::bad_alloc();
+        }
+        *(int *) block = index;
+        if (capacity) {
+            *capacity = size;
+        }
+        return payloadOf(block);
+    }
+
+    if (capacity) {
+        *capacity = kClassSize[index];
+    }
+    if (!s_thread_exited) {
+        auto ptr = s_thread_cache.allocate(index);
+        if (ptr) {
+            return ptr;
+        }
+    }
+    addCount(index, &Counter::miss_count);
+    auto block = (char *) malloc(BLOCK_HEADER_SIZE + kClassSize[index]);
+    if (!block) {
+        throw std::bad_alloc();
+    }
+    *(int *) block = index;
+    return payloadOf(block);
+}
+
+void PacketArena::deallocate(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    auto block = blockOf(ptr);
+    auto index = *(int *) block;
+    addCount(index, &Counter::free_count);
+    if (index == kOversizeIndex) {
+        free(block);
+        return;
+    }
+    if (s_thread_exited) {
+        free(block);
+        return;
+    }
+    s_thread_cache.deallocate(index, ptr);
+}
+
+vector<PacketArena::Statistic> PacketArena::getStatistic() {
+    vector<Statistic> ret;
+    auto &registry = CacheRegistry::Instance();
+    for (int i = 0; i <= kOversizeIndex; ++i) {
+        auto &cls = s_classes[i];
+        Statistic stat;
+        stat.block_size = i == kOversizeIndex ? 0 : kClassSize[i];
+        uint64_t free_count = cls.retired.free_count.load(std::memory_order_relaxed);
+        stat.alloc_count = cls.retired.alloc_count.load(std::memory_order_relaxed);
+        stat.miss_count = cls.retired.miss_count.load(std::memory_order_relaxed);
+        {
+            //汇总各线程缓存中的计数
+            lock_guard<mutex> lck(registry.mtx);
+            for (auto cache : registry.caches) {
+                auto &counter = cache->counter(i);
+                free_count += counter.free_count.load(std::memory_order_relaxed);
+                stat.alloc_count += counter.alloc_count.load(std::memory_order_relaxed);
+                stat.miss_count += counter.miss_count.load(std::memory_order_relaxed);
+            }
+        }
+        //各线程计数不是同一时刻读取的，可能短暂出现释放数大于申请数
+        stat.in_use = stat.alloc_count > free_count ? stat.alloc_count - free_count : 0;
+        auto high_water = cls.high_water.load(std::memory_order_relaxed);
+        while (stat.in_use > high_water && !cls.high_water.compare_exchange_weak(high_water, stat.in_use, std::memory_order_relaxed));
+        stat.high_water = std::max(high_water, stat.in_use);
+        {
+            lock_guard<mutex> lck(cls.mtx);
+            for (auto &batch : cls.batches) {
+                stat.cached += batch.count;
+            }
+        }
+        ret.emplace_back(stat);
+    }
+    return ret;
+}
+
+} /* namespace mediakit */
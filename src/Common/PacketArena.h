@@ -0,0 +1,201 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ZLMEDIAKIT_PACKETARENA_H
+#define ZLMEDIAKIT_PACKETARENA_H
+
+#include <string.h>
+#include <memory>
+#include <vector>
+#include <stdexcept>
+#include "Network/Buffer.h"
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+/**
+ * 媒体包内存分配器
+ * 按MTU、rtmp chunk等常见大小划分若干档位，每个线程缓存各档位的空闲内存块(无锁)，
+ * 线程缓存满了或者空了才与全局仓库批量交换，稳定转发时不再调用malloc。
+ * 内存块在一个线程申请在另一个线程释放时，会留在释放线程的缓存中供其复用
+ */
+class PacketArena {
+public:
+    /**
+     * 单个档位的统计信息
+     */
+    class Statistic {
+    public:
+        //内存块大小，0代表超出所有档位直接malloc的内存
+        size_t block_size = 0;
+        //正在使用的内存块数
+        uint64_t in_use = 0;
+        //正在使用的内存块数最大值(获取统计时采样)
+        uint64_t high_water = 0;
+        //全局仓库中空闲的内存块数(不含线程缓存)
+        uint64_t cached = 0;
+        //累计申请次数
+        uint64_t alloc_count = 0;
+        //累计未命中缓存而调用malloc的次数
+        uint64_t miss_count = 0;
+    };
+
+    static PacketArena &Instance();
+
+    /**
+     * 申请内存
+     * @param size 需要的大小
+     * @param capacity 实际可用大小，可以为空
+     */
+    void *allocate(size_t size, size_t *capacity = nullptr);
+
+    /**
+     * 释放allocate申请的内存，可以在任意线程中调用
+     */
+    void deallocate(void *ptr);
+
+    /**
+     * 获取各档位统计信息
+     */
+    vector<Statistic> getStatistic();
+
+private:
+    PacketArena();
+    ~PacketArena() = delete;
+};
+
+/**
+ * 使用PacketArena的stl分配器，配合std::allocate_shared使对象与引用计数也不经过malloc
+ */
+template<typename T>
+class ArenaAllocator {
+public:
+    typedef T value_type;
+
+    ArenaAllocator() = default;
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U> &) {}
+
+    T *allocate(size_t n) {
+        return (T *) PacketArena::Instance().allocate(n * sizeof(T));
+    }
+
+    void deallocate(T *ptr, size_t) {
+        PacketArena::Instance().deallocate(ptr);
+    }
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U> &) const { return true; }
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U> &) const { return false; }
+};
+
+/**
+ * 内存来自PacketArena的buffer，接口与BufferRaw一致
+ * 容量足够时setCapacity不重新申请内存
+ */
+class ArenaBuffer : public Buffer {
+public:
+    typedef std::shared_ptr<ArenaBuffer> Ptr;
+
+    ArenaBuffer(uint32_t capacity = 0) {
+        if (capacity) {
+            setCapacity(capacity);
+        }
+    }
+
+    ArenaBuffer(const char *data, int size = 0) {
+        assign(data, size);
+    }
+
+    ArenaBuffer(const ArenaBuffer &that) = delete;
+    ArenaBuffer &operator=(const ArenaBuffer &that) = delete;
+
+    ~ArenaBuffer() override {
+        if (_data) {
+            PacketArena::Instance().deallocate(_data);
+        }
+    }
+
+    /**
+     * 在PacketArena中创建对象，对象与内存块都不经过malloc
+     */
+    template<typename ...ArgsType>
+    static Ptr create(ArgsType &&...args) {
+        return std::allocate_shared<ArenaBuffer>(ArenaAllocator<ArenaBuffer>(), std::forward<ArgsType>(args)...);
+    }
+
+    char *data() const override {
+        return _data;
+    }
+
+    uint32_t size() const override {
+        return _size;
+    }
+
+    uint32_t capacity() const {
+        return _capacity;
+    }
+
+    void setCapacity(uint32_t capacity) {
+        if (_data && capacity <= _capacity) {
+            //复用原来的内存块
+            return;
+        }
+        if (_data) {
+            PacketArena::Instance().deallocate(_data);
+        }
+        size_t real = 0;
+        _data = (char *) PacketArena::Instance().allocate(capacity, &real);
+        _capacity = real;
+    }
+
+    void setSize(uint32_t size) {
+        if (size > _capacity) {
+            throw std::invalid_argument("ArenaBuffer::setSize out of range");
+        }
+        _size = size;
+    }
+
+    void assign(const char *data, int size = 0) {
+        if (size <= 0) {
+            size = strlen(data);
+        }
+        setCapacity(size + 1);
+        memcpy(_data, data, size);
+        _data[size] = '\0';
+        setSize(size);
+    }
+
+private:
+    char *_data = nullptr;
+    uint32_t _size = 0;
+    uint32_t _capacity = 0;
+};
+
+} /* namespace mediakit */
+#endif //ZLMEDIAKIT_PACKETARENA_H
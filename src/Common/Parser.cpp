@@ -29,4 +29,148 @@ string FindField(const char* buf, const char* start, const char *end ,int bufSiz
     return string(msg_start, msg_end);
 }
 
+const int ParserView::kMaxHeaders;
+
+//查找\r\n，返回\r所在位置，未找到返回nullptr
+static inline const char *findLineEnd(const char *start, const char *end) {
+    while (start < end) {
+        auto pos = (const char *) memchr(start, '\r', end - start);
+        if (!pos || pos + 1 >= end) {
+            return nullptr;
+        }
+        if (pos[1] == '\n') {
+            return pos;
+        }
+        start = pos + 1;
+    }
+    return nullptr;
+}
+
+//查找": "，返回':'所在位置，未找到返回nullptr
+static inline const char *findKeyDelim(const char *start, const char *end) {
+    while (start < end) {
+        auto pos = (const char *) memchr(start, ':', end - start);
+        if (!pos || pos + 1 >= end) {
+            return nullptr;
+        }
+        if (pos[1] == ' ') {
+            return pos;
+        }
+        start = pos + 1;
+    }
+    return nullptr;
+}
+
+void ParserView::clear() {
+    _data = "";
+    _size = 0;
+    _header_size = 0;
+    _header_count = 0;
+    _overflow = false;
+    _method = _url = _full_url = _params = _tail = _content = Field();
+}
+
+size_t ParserView::parse(const char *data, size_t size) {
+    clear();
+    _data = data;
+    _size = size;
+
+    const char *ptr = data;
+    const char *end = data + size;
+    bool first_line = true;
+    while (ptr < end) {
+        auto line_end = findLineEnd(ptr, end);
+        if (!line_end) {
+            //头部不完整
+            break;
+        }
+        if (line_end == ptr && !first_line) {
+            //空行，协议头解析完毕
+            ptr += 2;
+            _content = makeField(ptr, end);
+            _header_size = ptr - data;
+            return _header_size;
+        }
+        if (first_line) {
+            first_line = false;
+            parseFirstLine(ptr, line_end);
+        } else {
+            auto delim = findKeyDelim(ptr, line_end);
+            if (delim && delim != ptr) {
+                if (_header_count < kMaxHeaders) {
+                    _keys[_header_count] = makeField(ptr, delim);
+                    _values[_header_count] = makeField(delim + 2, line_end);
+                    ++_header_count;
+                } else {
+                    _overflow = true;
+                }
+            }
+        }
+        ptr = line_end + 2;
+    }
+    _header_size = 0;
+    return 0;
+}
+
+void ParserView::parseFirstLine(const char *start, const char *end) {
+    //格式为: GET /live/test.m3u8?key=val HTTP/1.1 或 HTTP/1.1 200 OK
+    auto space0 = (const char *) memchr(start, ' ', end - start);
+    if (!space0) {
+        return;
+    }
+    _method = makeField(start, space0);
+    auto space1 = (const char *) memchr(space0 + 1, ' ', end - space0 - 1);
+    if (!space1) {
+        _tail = makeField(space0 + 1, end);
+        return;
+    }
+    _full_url = makeField(space0 + 1, space1);
+    _tail = makeField(space1 + 1, end);
+
+    auto args = (const char *) memchr(space0 + 1, '?', space1 - space0 - 1);
+    if (args) {
+        _url = makeField(space0 + 1, args);
+        _params = makeField(args + 1, space1);
+    } else {
+        _url = _full_url;
+    }
+}
+
+int ParserView::find(const char *name) const {
+    auto size = strlen(name);
+    for (int i = 0; i < _header_count; ++i) {
+        if (key(i).equalIgnoreCase(name, size)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void ParserView::forEachHeader(const function<void(const StrView &key, const StrView &value)> &cb) const {
+    if (!_overflow) {
+        for (int i = 0; i < _header_count; ++i) {
+            cb(key(i), value(i));
+        }
+        return;
+    }
+    //请求头数量超过索引上限，重新扫描原始数据
+    const char *end = _data + (_header_size ? _header_size : _size);
+    auto ptr = findLineEnd(_data, end);
+    if (!ptr) {
+        return;
+    }
+    ptr += 2;
+    while (ptr < end) {
+        auto line_end = findLineEnd(ptr, end);
+        if (!line_end || line_end == ptr) {
+            break;
+        }
+        auto delim = findKeyDelim(ptr, line_end);
+        if (delim && delim != ptr) {
+            cb(StrView(ptr, delim - ptr), StrView(delim + 2, line_end - delim - 2));
+        }
+        ptr = line_end + 2;
+    }
+}
+
 }//namespace mediakit
\ No newline at end of file
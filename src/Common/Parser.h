@@ -7,10 +7,17 @@
 
 #include <map>
 #include <string>
+#include <vector>
+#include <cstring>
+#include <functional>
 #include "Util/util.h"
 using namespace std;
 using namespace toolkit;
 
+#if defined(_WIN32) && !defined(strncasecmp)
+#define strncasecmp _strnicmp
+#endif
+
 namespace mediakit{
 
 string FindField(const char *buf, const char *start, const char *end, int bufSize = 0);
@@ -52,6 +59,123 @@ class StrCaseMap : public multimap<string, string, StrCaseCompare>{
     }
 };
 
+/**
+ * 不持有内存的字符串片段，仅用于解析阶段，避免构造临时string
+ */
+class StrView {
+public:
+    StrView() {}
+    StrView(const char *data, size_t size) : _data(data), _size(size) {}
+
+    const char *data() const { return _data; }
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    string str() const { return string(_data, _size); }
+
+    bool equalIgnoreCase(const char *str, size_t size) const {
+        return _size == size && strncasecmp(_data, str, size) == 0;
+    }
+
+    bool operator==(const char *str) const {
+        auto size = strlen(str);
+        return _size == size && memcmp(_data, str, size) == 0;
+    }
+private:
+    const char *_data = "";
+    size_t _size = 0;
+};
+
+/**
+ * http/rtsp头零拷贝解析器
+ * 只记录各字段在原始数据中的偏移，解析过程不分配任何内存；
+ * 请求头数量超过kMaxHeaders时，超出部分不进入索引(overflow()返回true)，
+ * 可以通过forEachHeader遍历全部请求头
+ */
+class ParserView {
+public:
+    static const int kMaxHeaders = 64;
+
+    ParserView() {}
+    ~ParserView() {}
+
+    /**
+     * 解析http/rtsp头
+     * @param data 数据指针，在使用本对象期间必须保持有效
+     * @param size 数据长度
+     * @return 头部长度(包括末尾的\r\n\r\n)，头部不完整时返回0
+     */
+    size_t parse(const char *data, size_t size);
+
+    /**
+     * 数据被整体拷贝到其他内存后，重新绑定数据指针，偏移量保持不变
+     */
+    void rebind(const char *data) { _data = data; }
+
+    void clear();
+
+    StrView method() const { return get(_method); }
+    StrView url() const { return get(_url); }
+    StrView fullUrl() const { return get(_full_url); }
+    StrView params() const { return get(_params); }
+    StrView tail() const { return get(_tail); }
+    StrView content() const { return get(_content); }
+
+    int headerCount() const { return _header_count; }
+    StrView key(int i) const { return get(_keys[i]); }
+    StrView value(int i) const { return get(_values[i]); }
+    bool overflow() const { return _overflow; }
+
+    /**
+     * 不区分大小写查找请求头
+     * @return 请求头在索引中的下标，未找到返回-1
+     */
+    int find(const char *name) const;
+
+    StrView operator[](const char *name) const {
+        auto i = find(name);
+        return i < 0 ? StrView() : value(i);
+    }
+
+    /**
+     * 遍历全部请求头，不受kMaxHeaders限制
+     */
+    void forEachHeader(const function<void(const StrView &key, const StrView &value)> &cb) const;
+
+private:
+    struct Field {
+        uint32_t offset = 0;
+        uint32_t size = 0;
+    };
+
+    StrView get(const Field &field) const {
+        return StrView(_data + field.offset, field.size);
+    }
+
+    Field makeField(const char *start, const char *end) const {
+        Field ret;
+        ret.offset = start - _data;
+        ret.size = end - start;
+        return ret;
+    }
+
+    void parseFirstLine(const char *start, const char *end);
+
+private:
+    const char *_data = "";
+    size_t _size = 0;
+    size_t _header_size = 0;
+    int _header_count = 0;
+    bool _overflow = false;
+    Field _method;
+    Field _url;
+    Field _full_url;
+    Field _params;
+    Field _tail;
+    Field _content;
+    Field _keys[kMaxHeaders];
+    Field _values[kMaxHeaders];
+};
+
 class Parser {
     public:
     Parser() {}
@@ -60,38 +184,21 @@ class Parser {
 
     void Parse(const char *buf) {
         //解析
-        const char *start = buf;
         Clear();
-        while (true) {
-            auto line = FindField(start, NULL, "\r\n");
-            if (line.size() == 0) {
-                break;
-            }
-            if (start == buf) {
-                _strMethod = FindField(line.data(), NULL, " ");
-                _strFullUrl = FindField(line.data(), " ", " ");
-                auto args_pos = _strFullUrl.find('?');
-                if (args_pos != string::npos) {
-                    _strUrl = _strFullUrl.substr(0, args_pos);
-                    _params = _strFullUrl.substr(args_pos + 1);
-                    _mapUrlArgs = parseArgs(_params);
-                } else {
-                    _strUrl = _strFullUrl;
-                }
-                _strTail = FindField(line.data(), (_strFullUrl + " ").data(), NULL);
-            } else {
-                auto field = FindField(line.data(), NULL, ": ");
-                auto value = FindField(line.data(), ": ", NULL);
-                if (field.size() != 0) {
-                    _mapHeaders.emplace_force(field,value);
-                }
-            }
-            start = start + line.size() + 2;
-            if (strncmp(start, "\r\n", 2) == 0) { //协议解析完毕
-                _strContent = FindField(start, "\r\n", NULL);
-                break;
-            }
+        auto size = strlen(buf);
+        //先在原始数据上建立索引，再只拷贝头部；字符串容量在Clear后得以复用，稳态下不分配内存
+        auto header_size = _view.parse(buf, size);
+        if (header_size == 0) {
+            header_size = size;
         }
+        _strHeader.assign(buf, header_size);
+        auto &view = getView();
+        assign(_strMethod, view.method());
+        assign(_strFullUrl, view.fullUrl());
+        assign(_strUrl, view.url());
+        assign(_params, view.params());
+        assign(_strTail, view.tail());
+        _strContent.assign(buf + header_size, size - header_size);
     }
 
     const string &Method() const {
@@ -116,11 +223,29 @@ class Parser {
 
     const string &operator[](const char *name) const {
         //rtsp field
-        auto it = _mapHeaders.find(name);
-        if (it == _mapHeaders.end()) {
+        if (_headersReady || getView().overflow()) {
+            auto it = getValues().find(name);
+            if (it == _mapHeaders.end()) {
+                return _strNull;
+            }
+            return it->second;
+        }
+        //未生成请求头map时，直接在索引中查找，找到后缓存到复用的字符串中
+        auto &view = getView();
+        auto index = view.find(name);
+        if (index < 0) {
             return _strNull;
         }
-        return it->second;
+        if (_headerCache.size() < (size_t) view.headerCount()) {
+            //按本次请求的请求头个数分配，同一次解析中不会再扩容，已返回的引用保持有效
+            _headerCache.resize(view.headerCount());
+        }
+        auto &ret = _headerCache[index];
+        if (!(_headerCacheMask & (1ULL << index))) {
+            _headerCacheMask |= (1ULL << index);
+            assign(ret, view.value(index));
+        }
+        return ret;
     }
 
     const string &Content() const {
@@ -134,6 +259,11 @@ class Parser {
         _params.clear();
         _strTail.clear();
         _strContent.clear();
+        _strHeader.clear();
+        _view.clear();
+        _headerCacheMask = 0;
+        _headersReady = false;
+        _urlArgsReady = false;
         _mapHeaders.clear();
         _mapUrlArgs.clear();
     }
@@ -149,11 +279,29 @@ class Parser {
         this->_strContent = content;
     }
 
+    /**
+     * 获取全部请求头，首次调用时才生成map
+     */
     StrCaseMap &getValues() const {
+        if (!_headersReady) {
+            _headersReady = true;
+            getView().forEachHeader([&](const StrView &key, const StrView &value) {
+                _mapHeaders.emplace_force(key.str(), value.str());
+            });
+        }
         return _mapHeaders;
     }
 
+    /**
+     * 获取url参数，首次调用时才解析
+     */
     StrCaseMap &getUrlArgs() const {
+        if (!_urlArgsReady) {
+            _urlArgsReady = true;
+            if (!_params.empty()) {
+                _mapUrlArgs = parseArgs(_params);
+            }
+        }
         return _mapUrlArgs;
     }
 
@@ -168,6 +316,17 @@ class Parser {
         return ret;
     }
 
+private:
+    const ParserView &getView() const {
+        //Parser可能被拷贝，每次使用前重新绑定到本对象持有的数据
+        _view.rebind(_strHeader.data());
+        return _view;
+    }
+
+    static void assign(string &str, const StrView &view) {
+        str.assign(view.data(), view.size());
+    }
+
 private:
     string _strMethod;
     string _strUrl;
@@ -176,6 +335,14 @@ private:
     string _strNull;
     string _strFullUrl;
     string _params;
+    //头部原始数据，_view中的偏移量基于此
+    string _strHeader;
+    mutable ParserView _view;
+    //按需分配，下标与_view中的请求头一致，Clear后保留以复用
+    mutable vector<string> _headerCache;
+    mutable uint64_t _headerCacheMask = 0;
+    mutable bool _headersReady = false;
+    mutable bool _urlArgsReady = false;
     mutable StrCaseMap _mapHeaders;
     mutable StrCaseMap _mapUrlArgs;
 };
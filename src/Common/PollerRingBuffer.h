@@ -0,0 +1,415 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ZLMEDIAKIT_POLLERRINGBUFFER_H
+#define ZLMEDIAKIT_POLLERRINGBUFFER_H
+
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include "Poller/EventPoller.h"
+#include "Util/logger.h"
+using namespace std;
+using namespace toolkit;
+
+//gop缓存个数为0(自动适应gop大小)时的安全上限，仅防止没有关键帧的流无限占用内存
+#define RING_AUTO_GOP_CACHE_MAX (32 * 1024)
+//每个poller待分发数据的最大积压个数，超过后说明该线程严重卡顿，丢弃积压数据并等待下一个关键帧
+#define RING_MAX_PENDING_SIZE (8 * 1024)
+
+namespace mediakit {
+
+template<typename T> class PollerRingBuffer;
+template<typename T> class RingDispatcher;
+
+/**
+ * 环形缓冲读取器
+ * 读取与detach回调只在attach时指定的poller线程中触发
+ */
+template<typename T>
+class PollerRingReader {
+public:
+    typedef std::shared_ptr<PollerRingReader> Ptr;
+    typedef function<void(const T &)> onRead;
+    typedef function<void()> onDetach;
+    friend class RingDispatcher<T>;
+
+    PollerRingReader(const EventPoller::Ptr &poller) : _poller(poller) {}
+    ~PollerRingReader() {}
+
+    void setReadCB(const onRead &cb) {
+        _read_cb = cb;
+    }
+
+    void setDetachCB(const onDetach &cb) {
+        _detach_cb = cb;
+    }
+
+    const EventPoller::Ptr &getPoller() const {
+        return _poller;
+    }
+
+private:
+    void read(const T &in) {
+        if (_read_cb) {
+            _read_cb(in);
+        }
+    }
+
+    void detach() {
+        if (_detach_cb) {
+            _detach_cb();
+        }
+    }
+
+private:
+    EventPoller::Ptr _poller;
+    onRead _read_cb;
+    onDetach _detach_cb;
+};
+
+/**
+ * 同一poller线程内读取器的分发器
+ * 写入线程只把数据追加到待分发队列，每批数据只切换一次线程，
+ * 在poller线程中再依次交给本线程的所有读取器
+ */
+template<typename T>
+class RingDispatcher : public std::enable_shared_from_this<RingDispatcher<T> > {
+public:
+    typedef std::shared_ptr<RingDispatcher> Ptr;
+    typedef PollerRingReader<T> Reader;
+    friend class PollerRingBuffer<T>;
+
+    RingDispatcher(const EventPoller::Ptr &poller, const std::weak_ptr<PollerRingBuffer<T> > &ring, void *key) :
+            _poller(poller), _ring(ring), _key(key) {}
+    ~RingDispatcher() {}
+
+    /**
+     * 移除读取器，只能在poller线程中调用，读取器对象在此之后才释放
+     */
+    void removeReader(Reader *reader) {
+        auto it = std::find(_readers.begin(), _readers.end(), reader);
+        if (it != _readers.end()) {
+            *it = _readers.back();
+            _readers.pop_back();
+        }
+        if (_readers.empty()) {
+            auto ring = _ring.lock();
+            if (ring) {
+                ring->removeDispatcher(_key, this);
+            }
+        }
+    }
+
+private:
+    class Adding {
+    public:
+        Reader *reader;
+        //在第几个待分发数据之前加入
+        size_t pos;
+        std::shared_ptr<vector<T> > cache;
+    };
+
+    /**
+     * 追加待分发数据
+     * @param is_key 是否为关键帧，积压溢出后从关键帧开始恢复分发
+     * @return 是否产生了一次跨线程唤醒
+     */
+    bool write(const T &in, bool is_key) {
+        lock_guard<mutex> lck(_mtx);
+        if (_pending.size() >= RING_MAX_PENDING_SIZE) {
+            //poller线程长时间未处理，丢弃积压数据，防止内存无限增长
+            WarnL << "poller线程积压数据过多，丢弃" << _pending.size() << "个待分发数据";
+            _pending.clear();
+            for (auto &adding : _adding) {
+                adding.pos = 0;
+            }
+            _wait_key = true;
+        }
+        if (_wait_key) {
+            if (!is_key) {
+                return false;
+            }
+            _wait_key = false;
+        }
+        _pending.emplace_back(in);
+        return schedule();
+    }
+
+    /**
+     * 加入读取器，在下一批数据分发时生效
+     * @param cache 加入后先读取的gop缓存，可以为空
+     * @return 是否产生了一次跨线程唤醒
+     */
+    bool addReader(Reader *reader, const std::shared_ptr<vector<T> > &cache) {
+        lock_guard<mutex> lck(_mtx);
+        Adding adding;
+        adding.reader = reader;
+        adding.pos = _pending.size();
+        adding.cache = cache;
+        _adding.emplace_back(std::move(adding));
+        return schedule();
+    }
+
+    //调用者需持有_mtx
+    bool schedule() {
+        if (_scheduled) {
+            //已经有分发任务在排队了，合并到该批次
+            return false;
+        }
+        _scheduled = true;
+        auto strongSelf = this->shared_from_this();
+        _poller->async([strongSelf]() {
+            strongSelf->flush();
+        }, false);
+        return !_poller->isCurrentThread();
+    }
+
+    //只能在poller线程中调用
+    void flush() {
+        {
+            lock_guard<mutex> lck(_mtx);
+            _pending.swap(_flushing);
+            _adding.swap(_flushing_adding);
+            _scheduled = false;
+        }
+        auto it = _flushing_adding.begin();
+        for (size_t i = 0; i < _flushing.size(); ++i) {
+            for (; it != _flushing_adding.end() && it->pos == i; ++it) {
+                onAddReader(*it);
+            }
+            for (auto reader : _readers) {
+                reader->read(_flushing[i]);
+            }
+        }
+        for (; it != _flushing_adding.end(); ++it) {
+            onAddReader(*it);
+        }
+        //保留内存，下次复用
+        _flushing.clear();
+        _flushing_adding.clear();
+    }
+
+    void onAddReader(const Adding &adding) {
+        _readers.emplace_back(adding.reader);
+        if (adding.cache) {
+            for (auto &in : *adding.cache) {
+                adding.reader->read(in);
+            }
+        }
+    }
+
+    //在poller线程中调用，调用者需持有环形缓冲的锁
+    bool empty() {
+        lock_guard<mutex> lck(_mtx);
+        return _readers.empty() && _adding.empty();
+    }
+
+    //环形缓冲已经销毁，只能在poller线程中调用
+    void detachAll() {
+        flush();
+        //回调中可能移除读取器，所以先拷贝
+        auto readers = _readers;
+        for (auto reader : readers) {
+            reader->detach();
+        }
+    }
+
+private:
+    EventPoller::Ptr _poller;
+    std::weak_ptr<PollerRingBuffer<T> > _ring;
+    void *_key;
+
+    mutex _mtx;
+    bool _scheduled = false;
+    bool _wait_key = false;
+    vector<T> _pending;
+    vector<Adding> _adding;
+
+    //以下只在poller线程中访问
+    vector<T> _flushing;
+    vector<Adding> _flushing_adding;
+    //读取器总是先在本线程中移除再释放，所以可以保存裸指针
+    vector<Reader *> _readers;
+};
+
+/**
+ * 按poller线程分组分发的环形缓冲
+ * 同一poller线程中的所有读取器共享一个分发器，每次写入每个poller最多投递一个任务，
+ * 任务执行前的后续写入合并到同一批次，避免观看者很多时每个包产生成千上万个跨线程任务；
+ * 关闭分组时每个读取器独占一个分发器，即每个读取器各自投递任务。
+ * 同时缓存最近一个gop，新的读取器可以从关键帧开始读取
+ */
+template<typename T>
+class PollerRingBuffer : public std::enable_shared_from_this<PollerRingBuffer<T> > {
+public:
+    typedef std::shared_ptr<PollerRingBuffer> Ptr;
+    typedef PollerRingReader<T> RingReader;
+    typedef function<void(const EventPoller::Ptr &poller, int size, bool add)> onReaderChanged;
+    friend class RingDispatcher<T>;
+
+    /**
+     * 构造环形缓冲
+     * @param max_cache gop缓存最大个数，gop超过该大小时不缓存；0则自动适应gop大小(仅受安全上限限制)
+     * @param cb 读取器个数变化回调
+     * @param group_by_poller 是否按poller线程分组分发
+     */
+    PollerRingBuffer(int max_cache = 0, const onReaderChanged &cb = nullptr, bool group_by_poller = true) :
+            _max_cache(max_cache > 0 ? max_cache : RING_AUTO_GOP_CACHE_MAX),
+            _on_reader_changed(cb),
+            _group_by_poller(group_by_poller) {}
+
+    ~PollerRingBuffer() {
+        //通知所有读取器环形缓冲已经销毁
+        for (auto &pr : _dispatchers) {
+            auto dispatcher = pr.second;
+            dispatcher->_poller->async([dispatcher]() {
+                dispatcher->detachAll();
+            }, false);
+        }
+    }
+
+    /**
+     * 添加读取器
+     * @param poller 读取器所在线程，回调都在该线程中触发
+     * @param use_cache 是否先读取gop缓存
+     */
+    typename RingReader::Ptr attach(const EventPoller::Ptr &poller, bool use_cache = true) {
+        std::weak_ptr<PollerRingBuffer> weakSelf = this->shared_from_this();
+        auto reader = new RingReader(poller);
+        typename RingDispatcher<T>::Ptr dispatcher;
+        {
+            lock_guard<mutex> lck(_mtx);
+            void *key = _group_by_poller ? (void *) poller.get() : (void *) reader;
+            auto &ref = _dispatchers[key];
+            if (!ref) {
+                ref = std::make_shared<RingDispatcher<T> >(poller, weakSelf, key);
+            }
+            dispatcher = ref;
+            std::shared_ptr<vector<T> > cache;
+            if (use_cache && !_cache.empty()) {
+                cache = std::make_shared<vector<T> >(_cache);
+            }
+            if (dispatcher->addReader(reader, cache)) {
+                _wakeups.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        _reader_size.fetch_add(1);
+        onReaderSizeChanged(poller, true);
+
+        return typename RingReader::Ptr(reader, [weakSelf, poller, dispatcher](RingReader *ptr) {
+            //在读取器所在线程中先移除再释放，所以分发器中的裸指针总是有效的
+            poller->async([weakSelf, poller, dispatcher, ptr]() {
+                dispatcher->removeReader(ptr);
+                delete ptr;
+                auto strongSelf = weakSelf.lock();
+                if (strongSelf) {
+                    strongSelf->_reader_size.fetch_sub(1);
+                    strongSelf->onReaderSizeChanged(poller, false);
+                }
+            }, false);
+        });
+    }
+
+    /**
+     * 写入数据，每个分发器最多投递一个任务
+     * @param in 数据
+     * @param is_key 是否为关键帧，关键帧开始新的gop缓存
+     */
+    void write(const T &in, bool is_key = true) {
+        lock_guard<mutex> lck(_mtx);
+        if (is_key) {
+            _cache.clear();
+            _cache_started = true;
+        }
+        if (_cache_started) {
+            if (_cache.size() < _max_cache) {
+                _cache.emplace_back(in);
+            } else {
+                //gop太大，等待下一个关键帧
+                _cache.clear();
+                _cache_started = false;
+            }
+        }
+        for (auto &pr : _dispatchers) {
+            if (pr.second->write(in, is_key)) {
+                _wakeups.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * 读取器个数
+     */
+    int readerCount() const {
+        return _reader_size.load();
+    }
+
+    /**
+     * 累计的跨线程唤醒次数(投递到其他poller线程的任务数)
+     */
+    uint64_t wakeupCount() const {
+        return _wakeups.load(std::memory_order_relaxed);
+    }
+
+private:
+    //分发器已经没有读取器了，在分发器所在poller线程中调用
+    void removeDispatcher(void *key, RingDispatcher<T> *dispatcher) {
+        lock_guard<mutex> lck(_mtx);
+        auto it = _dispatchers.find(key);
+        if (it == _dispatchers.end() || it->second.get() != dispatcher) {
+            return;
+        }
+        if (it->second->empty()) {
+            _dispatchers.erase(it);
+        }
+    }
+
+    void onReaderSizeChanged(const EventPoller::Ptr &poller, bool add) {
+        if (_on_reader_changed) {
+            _on_reader_changed(poller, _reader_size.load(), add);
+        }
+    }
+
+private:
+    mutex _mtx;
+    size_t _max_cache;
+    bool _cache_started = false;
+    vector<T> _cache;
+    unordered_map<void *, typename RingDispatcher<T>::Ptr> _dispatchers;
+
+    onReaderChanged _on_reader_changed;
+    bool _group_by_poller;
+    std::atomic<int> _reader_size {0};
+    std::atomic<uint64_t> _wakeups {0};
+};
+
+} /* namespace mediakit */
+#endif //ZLMEDIAKIT_POLLERRINGBUFFER_H
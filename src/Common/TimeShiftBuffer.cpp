@@ -0,0 +1,110 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "TimeShiftBuffer.h"
+#include "Util/File.h"
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Util/uv_errno.h"
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif //!defined(_WIN32)
+
+namespace mediakit {
+
+TimeShiftFile::Ptr TimeShiftFile::create(const string &dir, size_t capacity) {
+#if !defined(_WIN32)
+    if (!capacity) {
+        return nullptr;
+    }
+    string path = dir;
+    if (path.empty() || path.back() != '/') {
+        path.push_back('/');
+    }
+    //确保目录存在
+    File::createfile_path(path.data(), S_IRWXO | S_IRWXG | S_IRWXU);
+    path += "timeshift_XXXXXX";
+    int fd = mkstemp((char *) path.data());
+    if (fd == -1) {
+        WarnL << "创建时移溢出文件失败:" << path << " " << get_uv_errmsg();
+        return nullptr;
+    }
+    //文件只通过mmap访问，立即删除，进程退出后由系统回收
+    unlink(path.data());
+    if (ftruncate(fd, capacity) == -1) {
+        WarnL << "设置时移溢出文件大小失败:" << capacity << " " << get_uv_errmsg();
+        close(fd);
+        return nullptr;
+    }
+    auto base = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        WarnL << "映射时移溢出文件失败:" << capacity << " " << get_uv_errmsg();
+        return nullptr;
+    }
+    Ptr ret(new TimeShiftFile);
+    ret->_base = (char *) base;
+    ret->_capacity = capacity;
+    return ret;
+#else
+    return nullptr;
+#endif //!defined(_WIN32)
+}
+
+TimeShiftFile::~TimeShiftFile() {
+#if !defined(_WIN32)
+    if (_base) {
+        munmap(_base, _capacity);
+    }
+#endif //!defined(_WIN32)
+}
+
+char *TimeShiftFile::alloc(size_t size, uint64_t &pos) {
+    if (size > _capacity) {
+        return nullptr;
+    }
+    auto offset = _write_pos % _capacity;
+    if (offset + size > _capacity) {
+        //文件末尾剩余空间不够，从头开始写
+        _write_pos += _capacity - offset;
+        offset = 0;
+    }
+    pos = _write_pos;
+    _write_pos += size;
+    return _base + offset;
+}
+
+const char *TimeShiftFile::data(uint64_t pos) const {
+    return _base + pos % _capacity;
+}
+
+uint64_t TimeShiftFile::overwritten() const {
+    return _write_pos > _capacity ? _write_pos - _capacity : 0;
+}
+
+}//namespace mediakit
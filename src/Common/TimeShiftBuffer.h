@@ -0,0 +1,451 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ZLMEDIAKIT_TIMESHIFTBUFFER_H
+#define ZLMEDIAKIT_TIMESHIFTBUFFER_H
+
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <functional>
+#include "Common/config.h"
+#include "Util/TimeTicker.h"
+#include "Poller/EventPoller.h"
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+/**
+ * 时移缓存的溢出文件
+ * 创建后立即删除的临时文件通过mmap映射，按环形方式写入；
+ * 写入位置使用单调递增的逻辑偏移，物理偏移为逻辑偏移对容量取模，单个数据块不会跨越文件末尾
+ */
+class TimeShiftFile {
+public:
+    typedef std::shared_ptr<TimeShiftFile> Ptr;
+
+    /**
+     * 创建溢出文件
+     * @param dir 文件所在目录
+     * @param capacity 文件大小
+     * @return 失败(或平台不支持mmap)时返回nullptr
+     */
+    static Ptr create(const string &dir, size_t capacity);
+    ~TimeShiftFile();
+
+    /**
+     * 分配一块写入空间
+     * @param size 大小
+     * @param pos 分配到的逻辑偏移
+     * @return 写入地址，size超过文件大小时返回nullptr
+     */
+    char *alloc(size_t size, uint64_t &pos);
+
+    /**
+     * 获取逻辑偏移对应的地址
+     */
+    const char *data(uint64_t pos) const;
+
+    /**
+     * 逻辑偏移在此之前的数据已经被覆盖
+     */
+    uint64_t overwritten() const;
+private:
+    TimeShiftFile() = default;
+private:
+    char *_base = nullptr;
+    size_t _capacity = 0;
+    uint64_t _write_pos = 0;
+};
+
+/**
+ * 时移缓存中数据包的序列化方式，由各协议特化
+ * static uint32_t size(const Packet &pkt);
+ * static void save(const Packet &pkt, char *dst);
+ * static std::shared_ptr<Packet> load(const char *src, uint32_t size);
+ */
+template<typename Packet>
+class TimeShiftCodec;
+
+/**
+ * 直播时移缓存
+ * 保存媒体源最近若干时间内的数据包以及关键帧索引，同一媒体源的所有回看观看者共享；
+ * 最新的数据包保存在内存中(与环形缓冲共享同一个对象，不拷贝)，超过内存上限后按写入顺序溢出到mmap文件，
+ * 超过时移窗口或被溢出文件覆盖的数据包被淘汰；
+ * write只允许媒体源写线程调用，其他接口可以在任意线程调用
+ */
+template<typename Packet>
+class TimeShiftBuffer {
+public:
+    typedef std::shared_ptr<TimeShiftBuffer> Ptr;
+    typedef std::shared_ptr<Packet> PacketPtr;
+    typedef TimeShiftCodec<Packet> Codec;
+
+    /**
+     * @param max_ms 时移窗口时长,单位毫秒
+     * @param mem_bytes 内存缓存上限
+     * @param file 溢出文件，为空则只使用内存
+     */
+    TimeShiftBuffer(uint32_t max_ms, size_t mem_bytes, const TimeShiftFile::Ptr &file) {
+        _max_ms = max_ms;
+        _mem_limit = mem_bytes;
+        _file = file;
+    }
+
+    ~TimeShiftBuffer() {}
+
+    /**
+     * 按配置创建时移缓存，未开启直播时移时返回nullptr
+     */
+    static Ptr create() {
+        GET_CONFIG(uint32_t,maxSec,TimeShift::kMaxSec);
+        if (!maxSec) {
+            return nullptr;
+        }
+        GET_CONFIG(uint32_t,memMB,TimeShift::kMemMB);
+        GET_CONFIG(uint32_t,fileMB,TimeShift::kFileMB);
+        GET_CONFIG(string,filePath,TimeShift::kFilePath);
+        auto file = TimeShiftFile::create(filePath, (size_t) fileMB * 1024 * 1024);
+        return std::make_shared<TimeShiftBuffer>(maxSec * 1000, (size_t) memMB * 1024 * 1024, file);
+    }
+
+    /**
+     * 写入数据包
+     * @param pkt 数据包
+     * @param stamp 时间戳,单位毫秒
+     * @param key 是否为关键帧(纯音频时每个包都可以作为起始位置)
+     */
+    void write(const PacketPtr &pkt, uint32_t stamp, bool key) {
+        lock_guard<mutex> lck(_mtx);
+        if (key && (_keys.empty() || _keys.back().first != stamp)) {
+            //同一关键帧拆分成的多个包只索引第一个
+            _keys.emplace_back(stamp, _front_seq + _entries.size());
+        }
+        Entry entry;
+        entry.stamp = stamp;
+        entry.size = Codec::size(*pkt);
+        entry.pkt = pkt;
+        _mem_bytes += entry.size;
+        _entries.emplace_back(std::move(entry));
+        _live_stamp = stamp;
+
+        //按写入顺序把最老的内存数据包溢出到文件
+        while (_mem_bytes > _mem_limit && _mem_index + 1 < _entries.size()) {
+            spill();
+        }
+        //淘汰超过时移窗口的数据包
+        while (!_entries.empty() && (int32_t) (_live_stamp - _entries.front().stamp) > (int32_t) _max_ms) {
+            popFront();
+        }
+    }
+
+    /**
+     * 查找时间戳不大于stamp的最后一个关键帧，早于最老的关键帧时返回最老的关键帧
+     * @param stamp 时间戳,单位毫秒
+     * @param seq 该关键帧的序号
+     * @return 是否找到关键帧
+     */
+    bool seek(uint32_t stamp, uint64_t &seq) {
+        lock_guard<mutex> lck(_mtx);
+        if (_keys.empty()) {
+            return false;
+        }
+        for (auto it = _keys.rbegin(); it != _keys.rend(); ++it) {
+            if ((int32_t) (it->first - stamp) <= 0) {
+                seq = it->second;
+                return true;
+            }
+        }
+        seq = _keys.front().second;
+        return true;
+    }
+
+    /**
+     * 读取数据包
+     * @param seq 序号
+     * @param stamp 该包的时间戳
+     * @return 尚未写入或已经淘汰时返回nullptr
+     */
+    PacketPtr read(uint64_t seq, uint32_t &stamp) {
+        lock_guard<mutex> lck(_mtx);
+        if (seq < _front_seq || seq >= _front_seq + _entries.size()) {
+            return nullptr;
+        }
+        auto &entry = _entries[seq - _front_seq];
+        stamp = entry.stamp;
+        if (entry.pkt) {
+            return entry.pkt;
+        }
+        //从溢出文件中加载，持有锁期间该区域不会被覆盖
+        return Codec::load(_file->data(entry.pos), entry.size);
+    }
+
+    /**
+     * 最老的数据包序号，序号小于该值的数据包已经淘汰
+     */
+    uint64_t frontSeq() {
+        lock_guard<mutex> lck(_mtx);
+        return _front_seq;
+    }
+
+    /**
+     * 最新写入的时间戳
+     */
+    uint32_t liveStamp() {
+        lock_guard<mutex> lck(_mtx);
+        return _live_stamp;
+    }
+
+    /**
+     * 媒体源已经注销，不再写入
+     */
+    void close() {
+        lock_guard<mutex> lck(_mtx);
+        _closed = true;
+    }
+
+    bool closed() {
+        lock_guard<mutex> lck(_mtx);
+        return _closed;
+    }
+private:
+    struct Entry {
+        uint32_t stamp = 0;
+        uint32_t size = 0;
+        //在内存中时不为空
+        PacketPtr pkt;
+        //在溢出文件中的逻辑偏移
+        uint64_t pos = 0;
+    };
+
+    void spill() {
+        uint64_t pos;
+        char *dst = _file ? _file->alloc(_entries[_mem_index].size, pos) : nullptr;
+        if (!dst) {
+            //没有溢出文件(或者数据包比文件还大)，只能淘汰最老的数据包
+            popFront();
+            return;
+        }
+        //先淘汰将被覆盖的数据包
+        while (_mem_index > 0 && _entries.front().pos < _file->overwritten()) {
+            popFront();
+        }
+        auto &entry = _entries[_mem_index];
+        Codec::save(*entry.pkt, dst);
+        entry.pos = pos;
+        entry.pkt = nullptr;
+        _mem_bytes -= entry.size;
+        ++_mem_index;
+    }
+
+    void popFront() {
+        auto &front = _entries.front();
+        if (_mem_index > 0) {
+            --_mem_index;
+        } else {
+            _mem_bytes -= front.size;
+        }
+        _entries.pop_front();
+        ++_front_seq;
+        while (!_keys.empty() && _keys.front().second < _front_seq) {
+            _keys.pop_front();
+        }
+    }
+private:
+    mutex _mtx;
+    uint32_t _max_ms;
+    size_t _mem_limit;
+    size_t _mem_bytes = 0;
+    //_entries中第一个在内存中的数据包下标，之前的都在溢出文件中
+    size_t _mem_index = 0;
+    uint64_t _front_seq = 0;
+    uint32_t _live_stamp = 0;
+    bool _closed = false;
+    std::deque<Entry> _entries;
+    //关键帧索引:时间戳,序号
+    std::deque<std::pair<uint32_t, uint64_t> > _keys;
+    TimeShiftFile::Ptr _file;
+};
+
+/**
+ * 时移回看读取器
+ * 从时移缓存中指定位置开始，在poller线程中按时间戳节奏读取数据包；
+ * 读取器只保存读取位置，数据由时移缓存共享
+ */
+template<typename Packet>
+class TimeShiftReader : public std::enable_shared_from_this<TimeShiftReader<Packet> > {
+public:
+    typedef std::shared_ptr<TimeShiftReader> Ptr;
+    typedef std::shared_ptr<Packet> PacketPtr;
+    typedef function<void(const PacketPtr &)> onRead;
+    typedef function<void()> onDetach;
+
+    TimeShiftReader(const typename TimeShiftBuffer<Packet>::Ptr &buffer, const EventPoller::Ptr &poller) {
+        _buffer = buffer;
+        _poller = poller;
+    }
+
+    ~TimeShiftReader() {
+        if (_timer) {
+            _timer->cancel();
+        }
+    }
+
+    void setReadCB(const onRead &cb) {
+        _read_cb = cb;
+    }
+
+    void setDetachCB(const onDetach &cb) {
+        _detach_cb = cb;
+    }
+
+    /**
+     * 跳转到不晚于stamp的关键帧开始读取，只能在poller线程中调用
+     * @param stamp 时间戳,单位毫秒
+     * @return 缓存中是否有关键帧
+     */
+    bool seek(uint32_t stamp) {
+        if (!_buffer->seek(stamp, _seq)) {
+            return false;
+        }
+        _rebase = true;
+        if (!_timer) {
+            weak_ptr<TimeShiftReader> weakSelf = this->shared_from_this();
+            _timer = _poller->doDelayTask(TICK_MS, [weakSelf]() -> uint64_t {
+                auto strongSelf = weakSelf.lock();
+                if (!strongSelf) {
+                    return 0;
+                }
+                return strongSelf->onTick() ? TICK_MS : 0;
+            });
+        }
+        return true;
+    }
+
+    /**
+     * 暂停或恢复，恢复后从暂停位置继续，时移时长随之增加
+     */
+    void pause(bool paused) {
+        _paused = paused;
+        _rebase = true;
+    }
+
+    /**
+     * 当前读取到的时间戳
+     */
+    uint32_t getStamp() const {
+        return _stamp;
+    }
+
+    /**
+     * 下一个将要读取的数据包序号
+     */
+    uint64_t getSeq() const {
+        return _seq;
+    }
+
+    /**
+     * 当前位置落后直播的时长,单位毫秒
+     */
+    uint32_t getDelay() const {
+        return _buffer->liveStamp() - _stamp;
+    }
+private:
+    //定时读取的间隔
+    static constexpr uint64_t TICK_MS = 10;
+    //单次最多读取的包数
+    static constexpr int MAX_PACKETS_PER_TICK = 512;
+    //时间戳跳变超过该值时重新计时
+    static constexpr int32_t MAX_STAMP_JUMP_MS = 10 * 1000;
+
+    bool onTick() {
+        if (_paused) {
+            return true;
+        }
+        for (int i = 0; i < MAX_PACKETS_PER_TICK; ++i) {
+            uint32_t stamp;
+            auto pkt = _buffer->read(_seq, stamp);
+            if (!pkt) {
+                if (_seq < _buffer->frontSeq()) {
+                    //读取太慢，数据已经被淘汰，跳到最老的关键帧
+                    if (!_buffer->seek(0, _seq)) {
+                        _seq = _buffer->frontSeq();
+                    }
+                    _rebase = true;
+                    continue;
+                }
+                if (_buffer->closed()) {
+                    //媒体源已经注销并且数据已经读完
+                    if (_detach_cb) {
+                        _detach_cb();
+                    }
+                    return false;
+                }
+                //已经追上直播
+                break;
+            }
+            if (_rebase) {
+                _rebase = false;
+                _base_stamp = stamp;
+                _ticker.resetTime();
+            }
+            int32_t due = (int32_t) (stamp - _base_stamp) - (int32_t) _ticker.elapsedTime();
+            if (due > MAX_STAMP_JUMP_MS || due < -MAX_STAMP_JUMP_MS) {
+                //时间戳跳变，重新计时
+                _base_stamp = stamp;
+                _ticker.resetTime();
+                due = 0;
+            }
+            if (due > 0) {
+                //还未到发送时间
+                break;
+            }
+            _stamp = stamp;
+            ++_seq;
+            if (_read_cb) {
+                _read_cb(pkt);
+            }
+        }
+        return true;
+    }
+private:
+    bool _paused = false;
+    bool _rebase = true;
+    uint64_t _seq = 0;
+    uint32_t _stamp = 0;
+    uint32_t _base_stamp = 0;
+    Ticker _ticker;
+    onRead _read_cb;
+    onDetach _detach_cb;
+    EventPoller::Ptr _poller;
+    EventPoller::DelayTask::Ptr _timer;
+    typename TimeShiftBuffer<Packet>::Ptr _buffer;
+};
+
+}//namespace mediakit
+#endif //ZLMEDIAKIT_TIMESHIFTBUFFER_H
@@ -76,11 +76,19 @@ const string kFlowThreshold = GENERAL_FIELD"flowThreshold";
 const string kStreamNoneReaderDelayMS = GENERAL_FIELD"streamNoneReaderDelayMS";
 const string kMaxStreamWaitTimeMS = GENERAL_FIELD"maxStreamWaitMS";
 const string kEnableVhost = GENERAL_FIELD"enableVhost";
+const string kRingGroupByPoller = GENERAL_FIELD"ringGroupByPoller";
+const string kKeyFrameStreamSuffix = GENERAL_FIELD"keyFrameStreamSuffix";
+const string kKeyFrameStreamDropAudio = GENERAL_FIELD"keyFrameStreamDropAudio";
+const string kShareProxyUpstream = GENERAL_FIELD"shareProxyUpstream";
 onceToken token([](){
     mINI::Instance()[kFlowThreshold] = 1024;
     mINI::Instance()[kStreamNoneReaderDelayMS] = 5 * 1000;
     mINI::Instance()[kMaxStreamWaitTimeMS] = 5 * 1000;
     mINI::Instance()[kEnableVhost] = 1;
+    mINI::Instance()[kRingGroupByPoller] = 1;
+    mINI::Instance()[kKeyFrameStreamSuffix] = "_key";
+    mINI::Instance()[kKeyFrameStreamDropAudio] = 1;
+    mINI::Instance()[kShareProxyUpstream] = 1;
 },nullptr);
 
 }//namespace General
@@ -178,11 +186,15 @@ namespace Rtmp {
 const string kModifyStamp = RTMP_FIELD"modifyStamp";
 const string kHandshakeSecond = RTMP_FIELD"handshakeSecond";
 const string kKeepAliveSecond = RTMP_FIELD"keepAliveSecond";
+const string kAggregate = RTMP_FIELD"aggregate";
+const string kAggregateMS = RTMP_FIELD"aggregateMS";
 
 onceToken token([](){
 	mINI::Instance()[kModifyStamp] = true;
     mINI::Instance()[kHandshakeSecond] = 15;
     mINI::Instance()[kKeepAliveSecond] = 15;
+    mINI::Instance()[kAggregate] = false;
+    mINI::Instance()[kAggregateMS] = 40;
 },nullptr);
 
 } //namespace RTMP
@@ -211,6 +223,9 @@ const string kClearCount = RTP_FIELD"clearCount";
 #define RTP_CYCLE_MS (13*60*60*1000)
 const string kCycleMS = RTP_FIELD"cycleMS";
 
+//aac rtp聚合打包的最大时长,单位毫秒，多个AU打包进同一个rtp包以降低包速率，
+//单个rtp包不超过audioMtuSize，0则每个AU单独打包
+const string kAudioAggregateMS = RTP_FIELD"audioAggregateMS";
 
 onceToken token([](){
 	mINI::Instance()[kVideoMtuSize] = RTP_VIDOE_MTU_SIZE;
@@ -218,6 +233,7 @@ onceToken token([](){
 	mINI::Instance()[kMaxRtpCount] = RTP_MAX_RTP_COUNT;
 	mINI::Instance()[kClearCount] = RTP_CLEAR_COUNT;
 	mINI::Instance()[kCycleMS] = RTP_CYCLE_MS;
+	mINI::Instance()[kAudioAggregateMS] = 0;
 },nullptr);
 } //namespace Rtsp
 
@@ -231,15 +247,42 @@ const string kAddrMax = MULTI_FIELD"addrMax";
 //组播TTL
 #define MULTI_UDP_TTL 64
 const string kUdpTTL = MULTI_FIELD"udpTTL";
+//音频与视频是否分配不同的组播地址
+const string kGroupPerTrack = MULTI_FIELD"groupPerTrack";
+//组播发送限速，单位kbps，0为不限速
+const string kPacingKbps = MULTI_FIELD"pacingKbps";
 
 onceToken token([](){
 	mINI::Instance()[kAddrMin] = "239.0.0.0";
 	mINI::Instance()[kAddrMax] = "239.255.255.255";
 	mINI::Instance()[kUdpTTL] = MULTI_UDP_TTL;
+	mINI::Instance()[kGroupPerTrack] = 0;
+	mINI::Instance()[kPacingKbps] = 0;
 },nullptr);
 
 } //namespace MultiCast
 
+////////////rtp代理(GB28181 PS over RTP收流)配置///////////
+namespace RtpProxy {
+#define RTP_PROXY_FIELD "rtp_proxy."
+//共享的udp/tcp收流端口，按ssrc区分流，0则不开启
+const string kPort = RTP_PROXY_FIELD"port";
+//为单个流分配独立收流端口的端口范围
+const string kPortRange = RTP_PROXY_FIELD"portRange";
+//收流的应用名
+const string kAppName = RTP_PROXY_FIELD"appName";
+//多久没收到rtp数据则认为流已断开，单位秒
+const string kTimeoutSec = RTP_PROXY_FIELD"timeoutSec";
+
+onceToken token([](){
+	mINI::Instance()[kPort] = 10000;
+	mINI::Instance()[kPortRange] = "30000-30500";
+	mINI::Instance()[kAppName] = "rtp";
+	mINI::Instance()[kTimeoutSec] = 15;
+},nullptr);
+
+} //namespace RtpProxy
+
 ////////////录像配置///////////
 namespace Record {
 #define RECORD_FIELD "record."
@@ -260,11 +303,35 @@ const string kFileSecond = RECORD_FIELD"fileSecond";
 #define RECORD_FILE_PATH HTTP_ROOT_PATH
 const string kFilePath = RECORD_FIELD"filePath";
 
+//录像保留策略检查间隔,单位秒
+const string kRetentionSecond = RECORD_FIELD"retentionSecond";
+
+//磁盘使用率高水位与低水位(百分比)
+const string kDiskUsageHigh = RECORD_FIELD"diskUsageHigh";
+const string kDiskUsageLow = RECORD_FIELD"diskUsageLow";
+
+//每批删除的录像文件个数，以及每批之间的休眠时间
+const string kDeleteBatch = RECORD_FIELD"deleteBatch";
+const string kDeleteIntervalMS = RECORD_FIELD"deleteIntervalMS";
+
+//每次检查时因磁盘使用率最多删除的录像文件个数
+const string kMaxDeletePerTick = RECORD_FIELD"maxDeletePerTick";
+
+//启动时修复未完成录像的读写速度上限,单位MB/s
+const string kRecoverSpeedMB = RECORD_FIELD"recoverSpeedMB";
+
 onceToken token([](){
 	mINI::Instance()[kAppName] = RECORD_APP_NAME;
 	mINI::Instance()[kSampleMS] = RECORD_SAMPLE_MS;
 	mINI::Instance()[kFileSecond] = RECORD_FILE_SECOND;
 	mINI::Instance()[kFilePath] = RECORD_FILE_PATH;
+	mINI::Instance()[kRetentionSecond] = 60;
+	mINI::Instance()[kDiskUsageHigh] = 90;
+	mINI::Instance()[kDiskUsageLow] = 85;
+	mINI::Instance()[kDeleteBatch] = 20;
+	mINI::Instance()[kDeleteIntervalMS] = 100;
+	mINI::Instance()[kMaxDeletePerTick] = 500;
+	mINI::Instance()[kRecoverSpeedMB] = 20;
 },nullptr);
 
 } //namespace Record
@@ -289,15 +356,50 @@ const string kFileBufSize = HLS_FIELD"fileBufSize";
 #define HLS_FILE_PATH (HTTP_ROOT_PATH)
 const string kFilePath = HLS_FIELD"filePath";
 
+//是否开启低延时hls(LL-HLS)，开启后切片同时切分为part并支持阻塞式索引刷新
+const string kLowLatency = HLS_FIELD"lowLatency";
+
+//低延时hls的part时长,单位秒
+#define HLS_PART_DURATION 0.5
+const string kPartDuration = HLS_FIELD"partDur";
+
 onceToken token([](){
 	mINI::Instance()[kSegmentDuration] = HLS_SEGMENT_DURATION;
 	mINI::Instance()[kSegmentNum] = HLS_SEGMENT_NUM;
 	mINI::Instance()[kFileBufSize] = HLS_FILE_BUF_SIZE;
 	mINI::Instance()[kFilePath] = HLS_FILE_PATH;
+	mINI::Instance()[kLowLatency] = 0;
+	mINI::Instance()[kPartDuration] = HLS_PART_DURATION;
 },nullptr);
 
 } //namespace Hls
 
+////////////直播时移配置///////////
+namespace TimeShift {
+#define TIMESHIFT_FIELD "timeshift."
+
+//时移窗口时长,单位秒，0则关闭直播时移
+const string kMaxSec = TIMESHIFT_FIELD"maxSec";
+
+//每个流的内存缓存上限,单位MB，超出部分溢出到mmap映射的文件
+const string kMemMB = TIMESHIFT_FIELD"memMB";
+
+//每个流的溢出文件大小上限,单位MB，0则只使用内存
+const string kFileMB = TIMESHIFT_FIELD"fileMB";
+
+//溢出文件所在目录，文件创建后立即删除，进程退出后自动回收
+#define TIMESHIFT_FILE_PATH "./timeshift/"
+const string kFilePath = TIMESHIFT_FIELD"filePath";
+
+onceToken token([](){
+	mINI::Instance()[kMaxSec] = 0;
+	mINI::Instance()[kMemMB] = 16;
+	mINI::Instance()[kFileMB] = 256;
+	mINI::Instance()[kFilePath] = TIMESHIFT_FILE_PATH;
+},nullptr);
+
+} //namespace TimeShift
+
 
 namespace Client {
 const string kNetAdapter = "net_adapter";
@@ -168,6 +168,18 @@ extern const string kStreamNoneReaderDelayMS;
 extern const string kMaxStreamWaitTimeMS;
 //是否启动虚拟主机
 extern const string kEnableVhost;
+//rtsp/rtmp环形缓冲是否按poller线程分组分发，
+//开启后每次写入每个poller线程只投递一个任务，而不是每个观看者一个任务
+extern const string kRingGroupByPoller;
+//只包含关键帧的派生流id后缀，播放 app/stream_key 或者在url中添加only_key=1参数时，
+//服务器从源流中过滤出关键帧生成派生流，为空则关闭该功能
+extern const string kKeyFrameStreamSuffix;
+//关键帧派生流是否去除音频
+extern const string kKeyFrameStreamDropAudio;
+//上游url(以及rtsp传输方式)相同的拉流代理是否共享同一个拉流，
+//开启后每个上游只拉一路流，再分发给各拉流代理的MediaSource，
+//只有创建上游的第一个拉流代理可以rtsp直接代理(rtsp.directProxy)，之后加入的拉流代理经过复用器输出
+extern const string kShareProxyUpstream;
 }//namespace General
 
 
@@ -218,6 +230,11 @@ extern const string kModifyStamp;
 extern const string kHandshakeSecond;
 //维持链接超时时间，默认15秒
 extern const string kKeepAliveSecond;
+//播放器是否默认接收聚合消息(MSG_AGGREGATE)，播放url中可以通过aggregate=0/1参数单独指定，
+//不支持聚合消息的播放器可以通过aggregate=0回退到普通消息
+extern const string kAggregate;
+//单个聚合消息最大时长,单位毫秒
+extern const string kAggregateMS;
 } //namespace RTMP
 
 
@@ -233,6 +250,8 @@ extern const string kMaxRtpCount;
 extern const string kClearCount;
 //最大RTP时间为13个小时，每13小时回环一次
 extern const string kCycleMS;
+//aac rtp聚合打包(RFC 3640 多AU)的最大时长,单位毫秒，0则每个AU单独打包
+extern const string kAudioAggregateMS;
 } //namespace Rtsp
 
 ////////////组播配置///////////
@@ -243,8 +262,24 @@ extern const string kAddrMin;
 extern const string kAddrMax;
 //组播TTL
 extern const string kUdpTTL;
+//音频与视频是否分配不同的组播地址，方便机顶盒只加入需要的组
+extern const string kGroupPerTrack;
+//组播发送限速，单位kbps，0为不限速，防止I帧瞬间冲击交换机缓存
+extern const string kPacingKbps;
 } //namespace MultiCast
 
+////////////rtp代理(GB28181 PS over RTP收流)配置///////////
+namespace RtpProxy {
+//共享的udp/tcp收流端口，按ssrc区分流，0则不开启
+extern const string kPort;
+//为单个流分配独立收流端口的端口范围，格式为 起始端口-截止端口
+extern const string kPortRange;
+//收流的应用名
+extern const string kAppName;
+//多久没收到rtp数据则认为流已断开，单位秒
+extern const string kTimeoutSec;
+} //namespace RtpProxy
+
 ////////////录像配置///////////
 namespace Record {
 //查看录像的应用名称
@@ -255,6 +290,20 @@ extern const string kSampleMS;
 extern const string kFileSecond;
 //录制文件路径
 extern const string kFilePath;
+//录像保留策略检查间隔,单位秒
+extern const string kRetentionSecond;
+//磁盘使用率(百分比)超过该值时开始按时间从旧到新删除录像
+extern const string kDiskUsageHigh;
+//删除录像直到磁盘使用率低于该值
+extern const string kDiskUsageLow;
+//每批删除的录像文件个数
+extern const string kDeleteBatch;
+//每批删除之间的间隔时间,单位毫秒，避免删除操作影响录像写入
+extern const string kDeleteIntervalMS;
+//每次检查时因磁盘使用率最多删除的录像文件个数，剩余的留到下次检查
+extern const string kMaxDeletePerTick;
+//启动时修复未完成录像的读写速度上限,单位MB/s
+extern const string kRecoverSpeedMB;
 } //namespace Record
 
 ////////////HLS相关配置///////////
@@ -267,8 +316,26 @@ extern const string kSegmentNum;
 extern const string kFileBufSize;
 //录制文件路径
 extern const string kFilePath;
+//是否开启低延时hls(LL-HLS)
+extern const string kLowLatency;
+//低延时hls的part时长,单位秒
+extern const string kPartDuration;
 } //namespace Hls
 
+////////////直播时移配置///////////
+namespace TimeShift {
+//时移窗口时长,单位秒，0则关闭直播时移；开启后rtsp/rtmp可以回看，hls额外生成同时长的回看索引文件
+//rtsp/rtmp的时移缓存在某个流的该协议第一次被请求回看、seek或暂停时才创建，只能回看创建之后的内容；
+//每个被回看的流每种协议最多占用kMemMB内存加kFileMB溢出文件
+extern const string kMaxSec;
+//每个流每种协议的内存缓存上限,单位MB
+extern const string kMemMB;
+//每个流每种协议的溢出文件大小上限,单位MB，0则只使用内存
+extern const string kFileMB;
+//溢出文件所在目录
+extern const string kFilePath;
+} //namespace TimeShift
+
 
 /**
  * rtsp/rtmp播放器、推流器相关设置名，
@@ -43,10 +43,19 @@ void AACRtpEncoder::inputFrame(const Frame::Ptr &frame) {
     RtpCodec::inputFrame(frame);
 
     GET_CONFIG(uint32_t, cycleMS, Rtp::kCycleMS);
+    GET_CONFIG(uint32_t, aggregateMS, Rtp::kAudioAggregateMS);
     auto uiStamp = frame->stamp();
     auto pcData = frame->data() + frame->prefixSize();
     auto iLen = frame->size() - frame->prefixSize();
 
+    //4字节为AU-headers-length与一个AU-header
+    if (aggregateMS && iLen + 4 <= maxAggregateSize()) {
+        inputAggregate(pcData, iLen, uiStamp, aggregateMS);
+        return;
+    }
+    //需要分片的AU不参与聚合，先发送之前缓存的AU
+    flushAggregate();
+
     uiStamp %= cycleMS;
     char *ptr = (char *) pcData;
     int iSize = iLen;
@@ -75,6 +84,59 @@ void AACRtpEncoder::makeAACRtp(const void *data, unsigned int len, bool mark, ui
     RtpCodec::inputRtp(makeRtp(getTrackType(),data,len,mark,uiStamp), false);
 }
 
+unsigned int AACRtpEncoder::maxAggregateSize() const {
+    //rtp over tcp头(4字节)与rtp头(12字节)
+    return MIN(_ui32MtuSize - 16, sizeof(_aucSectionBuf));
+}
+
+void AACRtpEncoder::inputAggregate(const char *pData, unsigned int uiLen, uint32_t uiStamp, uint32_t aggregateMS) {
+    //每个AU固定1024个采样
+    uint32_t frameMS = 1024 * 1000 / MAX(1, _ui32SampleRate);
+    if (!_aggregateSizes.empty()) {
+        //聚合包内的AU必须连续，接收端按首个AU的时间戳依次递增1024个采样计算后续AU的时间戳
+        int64_t delta = (int64_t) uiStamp - (int64_t) _aggregateLastStamp;
+        bool continuous = delta >= 0 && delta <= 2 * frameMS;
+        auto packetSize = 2 + 2 * (_aggregateSizes.size() + 1) + _aggregateBuf.size() + uiLen;
+        if (!continuous || packetSize > maxAggregateSize()) {
+            flushAggregate();
+        }
+    }
+    if (_aggregateSizes.empty()) {
+        _aggregateFirstStamp = uiStamp;
+    }
+    _aggregateSizes.push_back(uiLen);
+    _aggregateBuf.append(pData, uiLen);
+    _aggregateLastStamp = uiStamp;
+
+    //缓存的音频时长达到上限，立即发送，限制聚合带来的延时
+    if (uiStamp - _aggregateFirstStamp + frameMS >= aggregateMS) {
+        flushAggregate();
+    }
+}
+
+void AACRtpEncoder::flushAggregate() {
+    if (_aggregateSizes.empty()) {
+        return;
+    }
+    GET_CONFIG(uint32_t, cycleMS, Rtp::kCycleMS);
+    //AU-headers-length，单位bit
+    uint16_t headersBits = _aggregateSizes.size() * 16;
+    _aucSectionBuf[0] = headersBits >> 8;
+    _aucSectionBuf[1] = headersBits & 0xFF;
+    auto ptr = _aucSectionBuf + 2;
+    for (auto size : _aggregateSizes) {
+        //高13位为AU长度，低3位AU-Index/AU-Index-delta为0，表示AU连续
+        ptr[0] = size >> 5;
+        ptr[1] = (size & 0x1F) << 3;
+        ptr += 2;
+    }
+    memcpy(ptr, _aggregateBuf.data(), _aggregateBuf.size());
+    ptr += _aggregateBuf.size();
+    makeAACRtp(_aucSectionBuf, ptr - _aucSectionBuf, true, _aggregateFirstStamp % cycleMS);
+    _aggregateSizes.clear();
+    _aggregateBuf.clear();
+}
+
 /////////////////////////////////////////////////////////////////////////////////////
 
 AACRtpDecoder::AACRtpDecoder(const Track::Ptr &track){
@@ -112,6 +174,8 @@ bool AACRtpDecoder::inputRtp(const RtpPacket::Ptr &rtppack, bool key_pos) {
 	
 	do
 	{
+		if (length < 2)
+			break;
 		// 查询头部的偏移，每次2字节
 		uint32_t au_header_offset = 0;
 		//首2字节表示Au-Header的长度，单位bit，所以除以16得到Au-Header字节数
@@ -136,12 +200,15 @@ bool AACRtpDecoder::inputRtp(const RtpPacket::Ptr &rtppack, bool key_pos) {
 
 		// 真正aac负载开始处
 		const uint8_t *rtp_packet_payload = rtp_packet_buf + au_header_offset;
+		const uint32_t payload_len = length - au_header_offset;
 		// 载荷查找
 		uint32_t next_aac_payload_offset = 0;
-		for (int j = 0; j < au_header_length; ++j)
+		// 一个包聚合多个AU时，后续AU的时间戳依次递增1024个采样
+		auto sample_rate = _aac_cfg.empty() ? 0 : samplingFrequencyTable[_adts->sf_index & 0x0F];
+		for (int j = 0; j < au_header_length && next_aac_payload_offset < payload_len; ++j)
 		{
-			// 当前aac包长度
-			const uint32_t cur_aac_payload_len = vec_aac_len.at(j);
+			// 当前aac包长度，分片时AU-header中为完整AU长度，只取本包中剩余的数据
+			const uint32_t cur_aac_payload_len = MIN(vec_aac_len.at(j), payload_len - next_aac_payload_offset);
 
 			if (_adts->aac_frame_length + cur_aac_payload_len > sizeof(AACFrame::buffer)) {
 				_adts->aac_frame_length = 7;
@@ -154,7 +221,7 @@ bool AACRtpDecoder::inputRtp(const RtpPacket::Ptr &rtppack, bool key_pos) {
 			_adts->aac_frame_length += (cur_aac_payload_len);
 			if (rtppack->mark == true) {
 				_adts->sequence = rtppack->sequence;
-				_adts->timeStamp = rtppack->timeStamp;
+				_adts->timeStamp = rtppack->timeStamp + (sample_rate ? j * 1024 * 1000 / sample_rate : 0);
 				writeAdtsHeader(*_adts, _adts->buffer);
 				onGetAAC(_adts);
 			}
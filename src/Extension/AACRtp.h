@@ -28,6 +28,7 @@
 #define ZLMEDIAKIT_AACRTPCODEC_H
 
 #include "Rtsp/RtpCodec.h"
+#include <vector>
 #include "Extension/AAC.h"
 namespace mediakit{
 /**
@@ -92,8 +93,18 @@ public:
     void inputFrame(const Frame::Ptr &frame) override;
 private:
     void makeAACRtp(const void *pData, unsigned int uiLen, bool bMark, uint32_t uiStamp);
+    //聚合打包时单个rtp负载的最大长度
+    unsigned int maxAggregateSize() const;
+    void inputAggregate(const char *pData, unsigned int uiLen, uint32_t uiStamp, uint32_t aggregateMS);
+    //把缓存的AU打包成一个rtp包
+    void flushAggregate();
 private:
     unsigned char _aucSectionBuf[1600];
+    //聚合模式下缓存的AU负载与长度
+    string _aggregateBuf;
+    vector<uint16_t> _aggregateSizes;
+    uint32_t _aggregateFirstStamp = 0;
+    uint32_t _aggregateLastStamp = 0;
 };
 
 }//namespace mediakit
@@ -92,9 +92,30 @@ bool H265RtpDecoder::decodeRtp(const RtpPacket::Ptr &rtppack) {
     }
     switch (nal) {
         case 50:
-        case 48: // aggregated packet (AP) - with two or more NAL units
             WarnL << "不支持该类型的265 RTP包" << nal;
             return false;
+        case 48: {
+            // aggregated packet (AP) - with two or more NAL units
+            // 2字节PayloadHdr之后为若干个 2字节NALU长度 + NALU
+            bool haveIDR = false;
+            int offset = 2;
+            while (offset + 2 <= length) {
+                int size = (frame[offset] << 8) | frame[offset + 1];
+                offset += 2;
+                if (size == 0 || offset + size > length) {
+                    break;
+                }
+                _h265frame->buffer.assign("\x0\x0\x0\x1", 4);
+                _h265frame->buffer.append((char *) frame + offset, size);
+                _h265frame->type = H265_TYPE(frame[offset]);
+                _h265frame->timeStamp = rtppack->timeStamp;
+                _h265frame->sequence = rtppack->sequence;
+                haveIDR |= _h265frame->keyFrame();
+                onGetH265(_h265frame);
+                offset += size;
+            }
+            return haveIDR;
+        }
         case 49: {
             // fragmentation unit (FU)
             FU fu;
@@ -177,6 +198,14 @@ void H265RtpEncoder::inputFrame(const Frame::Ptr &frame) {
     unsigned char naluType = H265_TYPE(pcData[0]); //获取NALU的5bit 帧类型
     uiStamp %= cycleMS;
 
+    if (isParameterSet(naluType) && 2 + 2 + iLen <= _ui32MtuSize) {
+        //VPS/SPS/PPS先缓存，与后续帧之前以一个AP包发送
+        inputAP(pcData, iLen, uiStamp);
+        return;
+    }
+    //关键帧前的参数集AP包作为gop起始位置
+    bool keyAP = flushAP(H265Frame::isKeyFrame(naluType));
+
     int maxSize = _ui32MtuSize - 3;
     if (iLen > maxSize) { //超过MTU
         //获取帧头数据，1byte
@@ -201,12 +230,55 @@ void H265RtpEncoder::inputFrame(const Frame::Ptr &frame) {
             _aucSectionBuf[2] = s_e_type;
             memcpy(_aucSectionBuf + 3, pcData + nOffset, maxSize);
             nOffset += maxSize;
-            makeH265Rtp(naluType,_aucSectionBuf, maxSize + 3, mark,bFirst, uiStamp);
+            makeH265Rtp(naluType,_aucSectionBuf, maxSize + 3, mark,bFirst && !keyAP, uiStamp);
             bFirst = false;
         }
     } else {
-        makeH265Rtp(naluType,pcData, iLen, true, true, uiStamp);
+        makeH265Rtp(naluType,pcData, iLen, true, !keyAP, uiStamp);
+    }
+}
+
+bool H265RtpEncoder::isParameterSet(int nal_type) {
+    switch (nal_type) {
+        case H265Frame::NAL_VPS:
+        case H265Frame::NAL_SPS:
+        case H265Frame::NAL_PPS:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void H265RtpEncoder::inputAP(const uint8_t *pcData, unsigned int iLen, uint32_t uiStamp) {
+    if (_apCount && (_apStamp != uiStamp || _apBuf.size() + 2 + iLen > _ui32MtuSize)) {
+        //时间戳不同或超过MTU，先发送之前缓存的参数集
+        flushAP(false);
+    }
+    if (!_apCount) {
+        //PayloadHdr: F=0, Type=48, LayerId=0, TID=1
+        _apBuf.assign(1, (char) (48 << 1));
+        _apBuf.push_back(1);
+        _apStamp = uiStamp;
+    }
+    _apBuf.push_back(iLen >> 8);
+    _apBuf.push_back(iLen & 0xFF);
+    _apBuf.append((char *) pcData, iLen);
+    ++_apCount;
+}
+
+bool H265RtpEncoder::flushAP(bool key_pos) {
+    if (!_apCount) {
+        return false;
+    }
+    if (_apCount == 1) {
+        //只有一个NALU时以单NALU包发送
+        RtpCodec::inputRtp(makeRtp(getTrackType(), _apBuf.data() + 4, _apBuf.size() - 4, false, _apStamp), key_pos);
+    } else {
+        RtpCodec::inputRtp(makeRtp(getTrackType(), _apBuf.data(), _apBuf.size(), false, _apStamp), key_pos);
     }
+    _apCount = 0;
+    _apBuf.clear();
+    return key_pos;
 }
 
 void H265RtpEncoder::makeH265Rtp(int nal_type,const void* data, unsigned int len, bool mark, bool first_packet, uint32_t uiStamp) {
@@ -95,8 +95,20 @@ public:
     void inputFrame(const Frame::Ptr &frame) override;
 private:
     void makeH265Rtp(int nal_type,const void *pData, unsigned int uiLen, bool bMark, bool first_packet,uint32_t uiStamp);
+    static bool isParameterSet(int nal_type);
+    //缓存参数集，用于聚合成AP包(RFC 7798 4.4.2)
+    void inputAP(const uint8_t *pcData, unsigned int iLen, uint32_t uiStamp);
+    /**
+     * 发送缓存的参数集
+     * @param key_pos 是否作为gop起始位置
+     * @return 是否发送了作为gop起始位置的包
+     */
+    bool flushAP(bool key_pos);
 private:
     unsigned char _aucSectionBuf[1600];
+    string _apBuf;
+    int _apCount = 0;
+    uint32_t _apStamp = 0;
 };
 
 }//namespace mediakit{
@@ -76,6 +76,10 @@ bool HttpServerCookie::isExpired() {
     return _ticker.elapsedTime() > _max_elapsed * 1000;
 }
 
+int64_t HttpServerCookie::remainMS() {
+    return (int64_t)(_max_elapsed * 1000) - (int64_t)_ticker.elapsedTime();
+}
+
 std::shared_ptr<lock_guard<mutex> > HttpServerCookie::getLock(){
     return std::make_shared<lock_guard<mutex> >(_mtx);
 }
@@ -89,9 +93,23 @@ string HttpServerCookie::cookieExpireTime() const{
 //////////////////////////////CookieManager////////////////////////////////////
 INSTANCE_IMP(HttpCookieManager);
 
+static inline string makeCookieKey(const string &cookie_name,const string &val){
+    string ret;
+    ret.reserve(cookie_name.size() + 1 + val.size());
+    ret.append(cookie_name);
+    ret.push_back('\n');
+    ret.append(val);
+    return ret;
+}
+
+template <typename Shard, int N>
+static inline Shard &getShard(Shard (&shards)[N],const string &key){
+    return shards[std::hash<string>()(key) % N];
+}
+
 HttpCookieManager::HttpCookieManager() {
-    //定时删除过期的cookie，防止内存膨胀
-    _timer = std::make_shared<Timer>(10,[this](){
+    //每秒推进一格时间轮，删除过期的cookie，防止内存膨胀
+    _timer = std::make_shared<Timer>(1,[this](){
         onManager();
         return true;
     }, nullptr);
@@ -101,34 +119,50 @@ HttpCookieManager::~HttpCookieManager() {
     _timer.reset();
 }
 
+void HttpCookieManager::addToWheel(CookieShard &shard,const string &key,int64_t remain_ms){
+    //超出时间轮一圈的，先放在最远的槽位，到期后再重新计算
+    int64_t ticks = MAX(remain_ms, 0) / 1000 + 1;
+    if(ticks >= kWheelSize){
+        ticks = kWheelSize - 1;
+    }
+    shard._wheel[(_wheel_pos.load() + ticks) % kWheelSize].emplace_back(key);
+}
+
 void HttpCookieManager::onManager() {
-    lock_guard<recursive_mutex> lck(_mtx_cookie);
-    //先遍历所有类型
-    for(auto it_name = _map_cookie.begin() ; it_name != _map_cookie.end() ;){
-        //再遍历该类型下的所有cookie
-        for (auto it_cookie = it_name->second.begin() ; it_cookie != it_name->second.end() ; ){
-            if(it_cookie->second->isExpired()){
-                //cookie过期,移除记录
-                DebugL << it_cookie->second->getUid() << " cookie过期:" << it_cookie->second->getCookie();
-                it_cookie = it_name->second.erase(it_cookie);
+    auto pos = _wheel_pos.load();
+    for(auto &shard : _cookie_shards){
+        //过期的cookie在锁外析构，析构时会访问uid分片
+        vector<HttpServerCookie::Ptr> expired;
+        lock_guard<mutex> lck(shard._mtx);
+        vector<string> slot;
+        slot.swap(shard._wheel[pos]);
+        for(auto &key : slot){
+            auto it = shard._cookies.find(key);
+            if(it == shard._cookies.end()){
+                //已经被删除
                 continue;
             }
-            ++it_cookie;
-        }
-
-        if(it_name->second.empty()){
-            //该类型下没有任何cooki记录,移除之
-            DebugL << "该path下没有任何cooki记录:" << it_name->first;
-            it_name = _map_cookie.erase(it_name);
-            continue;
+            auto remain = it->second->remainMS();
+            if(remain > 0){
+                //cookie被续期了，或者超出了时间轮一圈，重新放入时间轮
+                addToWheel(shard,key,remain);
+                continue;
+            }
+            //cookie过期,移除记录
+            DebugL << it->second->getUid() << " cookie过期:" << it->second->getCookie();
+            expired.emplace_back(std::move(it->second));
+            shard._cookies.erase(it);
         }
-        ++it_name;
     }
+    _wheel_pos = (pos + 1) % kWheelSize;
 }
 
 HttpServerCookie::Ptr HttpCookieManager::addCookie(const string &cookie_name,const string &uidIn,uint64_t max_elapsed,int max_client) {
-    lock_guard<recursive_mutex> lck(_mtx_cookie);
-    auto cookie = _geneator.obtain();
+    string cookie;
+    {
+        lock_guard<mutex> lck(_mtx_geneator);
+        cookie = _geneator.obtain();
+    }
     auto uid = uidIn.empty() ? cookie : uidIn;
     auto oldCookie = getOldestCookie(cookie_name , uid, max_client);
     if(!oldCookie.empty()){
@@ -138,29 +172,35 @@ HttpServerCookie::Ptr HttpCookieManager::addCookie(const string &cookie_name,con
     }
     HttpServerCookie::Ptr data(new HttpServerCookie(shared_from_this(),cookie_name,uid,cookie,max_elapsed));
     //保存该账号下的新cookie
-    _map_cookie[cookie_name][cookie] = data;
+    auto key = makeCookieKey(cookie_name,cookie);
+    auto &shard = getShard(_cookie_shards,key);
+    lock_guard<mutex> lck(shard._mtx);
+    shard._cookies[key] = data;
+    addToWheel(shard,key,max_elapsed * 1000);
     return data;
 }
 
 HttpServerCookie::Ptr HttpCookieManager::getCookie(const string &cookie_name,const string &cookie) {
-    lock_guard<recursive_mutex> lck(_mtx_cookie);
-    auto it_name = _map_cookie.find(cookie_name);
-    if(it_name == _map_cookie.end()){
-        //不存在该类型的cookie
-        return nullptr;
-    }
-    auto it_cookie = it_name->second.find(cookie);
-    if(it_cookie == it_name->second.end()){
-        //该类型下没有对应的cookie
-        return nullptr;
-    }
-    if(it_cookie->second->isExpired()){
+    auto key = makeCookieKey(cookie_name,cookie);
+    auto &shard = getShard(_cookie_shards,key);
+    //过期的cookie在锁外析构
+    HttpServerCookie::Ptr expired;
+    {
+        lock_guard<mutex> lck(shard._mtx);
+        auto it_cookie = shard._cookies.find(key);
+        if(it_cookie == shard._cookies.end()){
+            //不存在该cookie
+            return nullptr;
+        }
+        if(!it_cookie->second->isExpired()){
+            return it_cookie->second;
+        }
         //cookie过期
         DebugL << "cookie过期:" << it_cookie->second->getCookie();
-        it_name->second.erase(it_cookie);
-        return nullptr;
+        expired = std::move(it_cookie->second);
+        shard._cookies.erase(it_cookie);
     }
-    return it_cookie->second;
+    return nullptr;
 }
 
 HttpServerCookie::Ptr HttpCookieManager::getCookie(const string &cookie_name,const StrCaseMap &http_header) {
@@ -168,14 +208,21 @@ HttpServerCookie::Ptr HttpCookieManager::getCookie(const string &cookie_name,con
     if (it == http_header.end()) {
         return nullptr;
     }
-    auto cookie = FindField(it->second.data(), (cookie_name + "=").data(), ";");
+    return getCookieFromHeader(cookie_name, it->second);
+}
+
+HttpServerCookie::Ptr HttpCookieManager::getCookieFromHeader(const string &cookie_name,const string &cookie_header) {
+    if (cookie_header.empty()) {
+        return nullptr;
+    }
+    auto cookie = FindField(cookie_header.data(), (cookie_name + "=").data(), ";");
     if (!cookie.size()) {
-        cookie = FindField(it->second.data(), (cookie_name + "=").data(), nullptr);
+        cookie = FindField(cookie_header.data(), (cookie_name + "=").data(), nullptr);
     }
     if(cookie.empty()){
         return nullptr;
     }
-    return HttpCookieManager::Instance().getCookie(cookie_name , cookie);
+    return getCookie(cookie_name , cookie);
 }
 
 HttpServerCookie::Ptr HttpCookieManager::getCookieByUid(const string &cookie_name,const string &uid){
@@ -197,32 +244,43 @@ bool HttpCookieManager::delCookie(const HttpServerCookie::Ptr &cookie) {
 }
 
 bool HttpCookieManager::delCookie(const string &cookie_name,const string &cookie) {
-    lock_guard<recursive_mutex> lck(_mtx_cookie);
-    auto it_name = _map_cookie.find(cookie_name);
-    if(it_name == _map_cookie.end()){
-        return false;
+    auto key = makeCookieKey(cookie_name,cookie);
+    auto &shard = getShard(_cookie_shards,key);
+    //在锁外析构
+    HttpServerCookie::Ptr removed;
+    {
+        lock_guard<mutex> lck(shard._mtx);
+        auto it = shard._cookies.find(key);
+        if(it == shard._cookies.end()){
+            return false;
+        }
+        removed = std::move(it->second);
+        shard._cookies.erase(it);
     }
-    return it_name->second.erase(cookie);
+    return true;
 }
 
 void HttpCookieManager::onAddCookie(const string &cookie_name,const string &uid,const string &cookie){
     //添加新的cookie，我们记录下这个uid下有哪些cookie，目的是实现单账号多地登录时挤占登录
-    lock_guard<recursive_mutex> lck(_mtx_cookie);
+    auto key = makeCookieKey(cookie_name,uid);
+    auto &shard = getShard(_uid_shards,key);
+    lock_guard<mutex> lck(shard._mtx);
     //相同用户下可以存在多个cookie(意味多地登录)，这些cookie根据登录时间的早晚依次排序
-    _map_uid_to_cookie[cookie_name][uid][getCurrentMillisecond()] = cookie;
+    shard._uid_to_cookie[key][getCurrentMillisecond()] = cookie;
 }
-void HttpCookieManager::onDelCookie(const string &cookie_name,const string &uid,const string &cookie){
-    lock_guard<recursive_mutex> lck(_mtx_cookie);
-    //回收随机字符串
-    _geneator.release(cookie);
 
-    auto it_name = _map_uid_to_cookie.find(cookie_name);
-    if(it_name == _map_uid_to_cookie.end()){
-        //该类型下未有任意用户登录
-        return;
+void HttpCookieManager::onDelCookie(const string &cookie_name,const string &uid,const string &cookie){
+    {
+        //回收随机字符串
+        lock_guard<mutex> lck(_mtx_geneator);
+        _geneator.release(cookie);
     }
-    auto it_uid = it_name->second.find(uid);
-    if(it_uid == it_name->second.end()){
+
+    auto key = makeCookieKey(cookie_name,uid);
+    auto &shard = getShard(_uid_shards,key);
+    lock_guard<mutex> lck(shard._mtx);
+    auto it_uid = shard._uid_to_cookie.find(key);
+    if(it_uid == shard._uid_to_cookie.end()){
         //该用户尚未登录
         return;
     }
@@ -236,32 +294,20 @@ void HttpCookieManager::onDelCookie(const string &cookie_name,const string &uid,
         //移除该用户名下的某个cookie，这个设备cookie将失效
         it_uid->second.erase(it_cookie);
 
-        if(it_uid->second.size() != 0) {
-            break;
+        if(it_uid->second.size() == 0) {
+            //该用户名下没有任何设备在线，移除之
+            shard._uid_to_cookie.erase(it_uid);
         }
-
-        //该用户名下没有任何设备在线，移除之
-        it_name->second.erase(it_uid);
-
-        if(it_name->second.size() != 0) {
-            break;
-        }
-        //该类型下未有任何用户在线，移除之
-        _map_uid_to_cookie.erase(it_name);
         break;
     }
-
 }
 
 string HttpCookieManager::getOldestCookie(const string &cookie_name,const string &uid, int max_client){
-    lock_guard<recursive_mutex> lck(_mtx_cookie);
-    auto it_name = _map_uid_to_cookie.find(cookie_name);
-    if(it_name == _map_uid_to_cookie.end()){
-        //不存在该类型的cookie
-        return "";
-    }
-    auto it_uid = it_name->second.find(uid);
-    if(it_uid == it_name->second.end()){
+    auto key = makeCookieKey(cookie_name,uid);
+    auto &shard = getShard(_uid_shards,key);
+    lock_guard<mutex> lck(shard._mtx);
+    auto it_uid = shard._uid_to_cookie.find(key);
+    if(it_uid == shard._uid_to_cookie.end()){
         //该用户从未登录过
         return "";
     }
@@ -27,7 +27,10 @@
 #ifndef SRC_HTTP_COOKIEMANAGER_H
 #define SRC_HTTP_COOKIEMANAGER_H
 
+#include <mutex>
+#include <atomic>
 #include <memory>
+#include <vector>
 #include <unordered_map>
 #include "Util/mini.h"
 #include "Util/TimeTicker.h"
@@ -103,6 +106,11 @@ public:
      */
     bool isExpired();
 
+    /**
+     * 距离过期的剩余时间，单位毫秒，已过期时小于等于0
+     */
+    int64_t remainMS();
+
     /**
      * 获取区域锁
      * @return
@@ -151,6 +159,7 @@ private:
 /**
  * cookie管理器，用于管理cookie的生成以及过期管理，同时实现了同账号异地挤占登录功能
  * 该对象实现了同账号最多登录若干个设备
+ * cookie按哈希分片存储，每个分片独立加锁；过期由每秒推进一格的时间轮处理，不再全量扫描
  */
 class HttpCookieManager : public std::enable_shared_from_this<HttpCookieManager> {
 public:
@@ -189,6 +198,14 @@ public:
      */
     HttpServerCookie::Ptr getCookie(const string &cookie_name,const StrCaseMap &http_header);
 
+    /**
+     * 从http头的Cookie字段值中获取cookie对象
+     * @param cookie_name cookie名，例如MY_SESSION
+     * @param cookie_header Cookie字段的值，例如 MY_SESSION=XXXXXX; other=YYY
+     * @return cookie对象
+     */
+    HttpServerCookie::Ptr getCookieFromHeader(const string &cookie_name,const string &cookie_header);
+
     /**
      * 根据uid获取cookie
      * @param cookie_name cookie名，例如MY_SESSION
@@ -204,8 +221,35 @@ public:
      */
     bool delCookie(const HttpServerCookie::Ptr &cookie);
 private:
+    //分片个数
+    static const int kShardCount = 32;
+    //时间轮槽位数，每个槽位1秒
+    static const int kWheelSize = 512;
+
+    class CookieShard {
+    public:
+        mutex _mtx;
+        unordered_map<string/*cookie_name + cookie*/,HttpServerCookie::Ptr/*cookie_data*/> _cookies;
+        //时间轮，槽位中记录可能在该时刻过期的cookie
+        vector<string/*cookie_name + cookie*/> _wheel[kWheelSize];
+    };
+
+    class UidShard {
+    public:
+        mutex _mtx;
+        unordered_map<string/*cookie_name + uid*/,map<uint64_t/*cookie time stamp*/,string/*cookie*/> > _uid_to_cookie;
+    };
+
     HttpCookieManager();
     void onManager();
+
+    /**
+     * 把cookie加入时间轮，调用者需持有分片锁
+     * @param shard 分片
+     * @param key cookie_name + cookie
+     * @param remain_ms 剩余有效时间
+     */
+    void addToWheel(CookieShard &shard,const string &key,int64_t remain_ms);
     /**
      * 构造cookie对象时触发，目的是记录某账号下多个cookie
      * @param cookie_name cookie名，例如MY_SESSION
@@ -239,10 +283,12 @@ private:
      */
     bool delCookie(const string &cookie_name,const string &cookie);
 private:
-    unordered_map<string/*cookie_name*/,unordered_map<string/*cookie*/,HttpServerCookie::Ptr/*cookie_data*/> >_map_cookie;
-    unordered_map<string/*cookie_name*/,unordered_map<string/*uid*/,map<uint64_t/*cookie time stamp*/,string/*cookie*/> > >_map_uid_to_cookie;
-    recursive_mutex _mtx_cookie;
+    CookieShard _cookie_shards[kShardCount];
+    UidShard _uid_shards[kShardCount];
+    //时间轮当前位置
+    atomic<uint32_t> _wheel_pos{0};
     Timer::Ptr _timer;
+    mutex _mtx_geneator;
     RandStrGeneator _geneator;
 };
 
@@ -78,8 +78,7 @@ void HttpRequestSplitter::input(const char *data,uint64_t len) {
 
     if(_content_len == 0){
         //尚未找到http头，缓存定位到剩余数据部分
-        string str(ptr,_remain_data_size);
-        _remain_data = str;
+        cacheRemainData(data, ptr, _remain_data_size);
         return;
     }
 
@@ -88,8 +87,7 @@ void HttpRequestSplitter::input(const char *data,uint64_t len) {
         //数据按照固定长度content处理
         if(_remain_data_size < _content_len){
             //数据不够，缓存定位到剩余数据部分
-            string str(ptr,_remain_data_size);
-            _remain_data = str;
+            cacheRemainData(data, ptr, _remain_data_size);
             return;
         }
         //收到content数据，并且接受content完毕
@@ -102,9 +100,13 @@ void HttpRequestSplitter::input(const char *data,uint64_t len) {
 
         if(_remain_data_size > 0){
             //还有数据没有处理完毕
-            string str(ptr,_remain_data_size);
-            _remain_data = str;
-
+            if(data != _remain_data.data()){
+                //数据来自调用者，在调用者内存上继续切割，不必拷贝
+                data = ptr;
+                len = _remain_data_size;
+                goto splitPacket;
+            }
+            cacheRemainData(data, ptr, _remain_data_size);
             data = ptr = (char *)_remain_data.data();
             len = _remain_data.size();
             goto splitPacket;
@@ -119,6 +121,15 @@ void HttpRequestSplitter::input(const char *data,uint64_t len) {
     _remain_data.clear();
 }
 
+void HttpRequestSplitter::cacheRemainData(const char *data, const char *ptr, uint64_t size) {
+    if (data == _remain_data.data() && ptr + size == data + _remain_data.size()) {
+        //剩余数据就在缓存末尾，原地移动即可，不重新分配内存
+        _remain_data.erase(0, ptr - data);
+        return;
+    }
+    _remain_data.assign(ptr, size);
+}
+
 void HttpRequestSplitter::setContentLen(int64_t content_len) {
     _content_len = content_len;
 }
@@ -141,6 +152,18 @@ int64_t HttpRequestSplitter::remainDataSize() {
     return _remain_data_size;
 }
 
+bool HttpRequestSplitter::isPending() const {
+    return !_remain_data.empty() || _content_len != 0;
+}
+
+bool HttpRequestSplitter::isRecvContent() const {
+    return _content_len != 0;
+}
+
+const string &HttpRequestSplitter::remainData() const {
+    return _remain_data;
+}
+
 
 } /* namespace mediakit */
 
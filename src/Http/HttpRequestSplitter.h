@@ -80,12 +80,35 @@ protected:
     /**
      * 恢复初始设置
      */
-     void reset();
+     virtual void reset();
 
      /**
       * 剩余数据大小
       */
      int64_t remainDataSize();
+
+     /**
+      * 是否有缓存的未处理数据或者尚未接收完毕的content
+      */
+     bool isPending() const;
+
+     /**
+      * 是否正在接收content
+      */
+     bool isRecvContent() const;
+
+     /**
+      * 缓存的未处理数据
+      */
+     const string &remainData() const;
+private:
+    /**
+     * 缓存剩余未处理的数据
+     * @param data 本次处理的数据起始地址
+     * @param ptr 剩余数据起始地址
+     * @param size 剩余数据大小
+     */
+    void cacheRemainData(const char *data, const char *ptr, uint64_t size);
 private:
     string _remain_data;
     int64_t _content_len = 0;
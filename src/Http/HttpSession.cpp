@@ -44,6 +44,7 @@
 #include "Util/base64.h"
 #include "Util/SHA1.h"
 #include "Rtmp/utils.h"
+#include "MediaFile/HlsPartCache.h"
 using namespace toolkit;
 
 namespace mediakit {
@@ -92,6 +93,7 @@ get_mime_type(const char* name) {
 		mapType.emplace(".ogg","application/ogg");
 		mapType.emplace(".pac","application/x-ns-proxy-autoconfig");
         mapType.emplace(".flv","video/x-flv");
+        mapType.emplace(".ts","video/mp2t");
 	}, nullptr);
 	if(!dot){
 		return "text/plain";
@@ -216,29 +218,65 @@ inline bool HttpSession::checkWebSocket(){
 //http-flv 链接格式:http://vhost-url:port/app/streamid.flv?key1=value1&key2=value2
 //如果url(除去?以及后面的参数)后缀是.flv,那么表明该url是一个http-flv直播。
 inline bool HttpSession::checkLiveFlvStream(){
-	auto pos = strrchr(_parser.Url().data(),'.');
-	if(!pos){
-		//未找到".flv"后缀
-		return false;
-	}
-	if(strcasecmp(pos,".flv") != 0){
-		//未找到".flv"后缀
+    return checkLiveStream(".flv",[this](const RtmpMediaSource::Ptr &rtmp_src){
+        //开始发送rtmp负载
+        start(getPoller(),rtmp_src);
+    });
+}
+
+//http-ts 链接格式:http://vhost-url:port/app/streamid.live.ts?key1=value1&key2=value2
+//为了与hls切片区分，http-ts直播的后缀为.live.ts
+inline bool HttpSession::checkLiveTsStream(){
+#if defined(ENABLE_HLS)
+    return checkLiveStream(".live.ts",[this](const RtmpMediaSource::Ptr &rtmp_src){
+        //同一个流的所有观看者共享一个ts复用器
+        _tsSource = TsLiveSource::get(rtmp_src);
+        auto ring = _tsSource->getRing();
+        if(!ring){
+            throw std::runtime_error("ts live source released");
+        }
+        weak_ptr<HttpSession> weakSelf = dynamic_pointer_cast<HttpSession>(shared_from_this());
+        _tsReader = ring->attach(getPoller());
+        _tsReader->setDetachCB([weakSelf](){
+            auto strongSelf = weakSelf.lock();
+            if(!strongSelf){
+                return;
+            }
+            strongSelf->shutdown(SockException(Err_shutdown,"ts ring buffer detached"));
+        });
+        _tsReader->setReadCB([weakSelf](const Buffer::Ptr &ts){
+            auto strongSelf = weakSelf.lock();
+            if(!strongSelf){
+                return;
+            }
+            strongSelf->onWrite(ts);
+        });
+    });
+#else
+    return false;
+#endif //defined(ENABLE_HLS)
+}
+
+inline bool HttpSession::checkLiveStream(const string &suffix,const function<void(const RtmpMediaSource::Ptr &rtmp_src)> &onStart){
+	auto &url = _parser.Url();
+	if(url.size() <= suffix.size() || strcasecmp(url.data() + url.size() - suffix.size(),suffix.data()) != 0){
+		//未找到后缀
 		return false;
 	}
 
-	//这是个.flv的流
+	//这是个直播流
     _mediaInfo.parse(string(RTMP_SCHEMA) + "://" + _parser["Host"] + _parser.FullUrl());
-	if(_mediaInfo._app.empty() || _mediaInfo._streamid.size() < 5){
+	if(_mediaInfo._app.empty() || _mediaInfo._streamid.size() <= suffix.size()){
 	    //url不合法
         return false;
 	}
-    _mediaInfo._streamid.erase(_mediaInfo._streamid.size() - 4);//去除.flv后缀
+    _mediaInfo._streamid.erase(_mediaInfo._streamid.size() - suffix.size());//去除后缀
 
     GET_CONFIG(uint32_t,reqCnt,Http::kMaxReqCount);
     bool bClose = (strcasecmp(_parser["Connection"].data(),"close") == 0) || ( ++_iReqCnt > reqCnt);
 
     weak_ptr<HttpSession> weakSelf = dynamic_pointer_cast<HttpSession>(shared_from_this());
-    MediaSource::findAsync(_mediaInfo,weakSelf.lock(), true,[weakSelf,bClose,this](const MediaSource::Ptr &src){
+    MediaSource::findAsync(_mediaInfo,weakSelf.lock(), true,[weakSelf,bClose,suffix,onStart,this](const MediaSource::Ptr &src){
         auto strongSelf = weakSelf.lock();
         if(!strongSelf){
             //本对象已经销毁
@@ -249,12 +287,12 @@ inline bool HttpSession::checkLiveFlvStream(){
             //未找到该流
             sendNotFound(bClose);
             if(bClose){
-                shutdown(SockException(Err_shutdown,"flv stream not found"));
+                shutdown(SockException(Err_shutdown,"live stream not found"));
             }
             return;
         }
         //找到流了
-        auto onRes = [this,rtmp_src](const string &err){
+        auto onRes = [this,rtmp_src,suffix,onStart](const string &err){
             bool authSuccess = err.empty();
             if(!authSuccess){
                 sendResponse("401 Unauthorized", makeHttpHeader(true,err.size()),err);
@@ -263,15 +301,14 @@ inline bool HttpSession::checkLiveFlvStream(){
             }
 
             //找到rtmp源，发送http头，负载后续发送
-            sendResponse("200 OK", makeHttpHeader(false,0,get_mime_type(".flv")), "");
+            sendResponse("200 OK", makeHttpHeader(false,0,get_mime_type(suffix.data())), "");
 
-            //开始发送rtmp负载
             //关闭tcp_nodelay ,优化性能
             SockUtil::setNoDelay(_sock->rawFD(),false);
             (*this) << SocketFlags(kSockFlags);
 
             try{
-                start(getPoller(),rtmp_src);
+                onStart(rtmp_src);
             }catch (std::exception &ex){
                 //该rtmp源不存在
                 shutdown(SockException(Err_shutdown,"rtmp mediasource released"));
@@ -374,8 +411,17 @@ inline void HttpSession::canAccessPath(const string &path_in,bool is_dir,const f
 
     //获取用户唯一id
     auto uid = getClientUid();
+
+    //hls播放请求，鉴权通过后刷新该观看者的活跃时间，观看人数与鉴权cookie的有效期无关
+    HlsViewerCounter::Ptr hlsCounter;
+    if(end_of(_mediaInfo._streamid,"/hls.m3u8")){
+        auto stream = _mediaInfo._streamid;
+        replace(stream,"/hls.m3u8","");
+        hlsCounter = HlsViewerCounter::get(_mediaInfo._vhost,_mediaInfo._app,stream);
+    }
+
     //先根据http头中的cookie字段获取cookie
-    HttpServerCookie::Ptr cookie = HttpCookieManager::Instance().getCookie(kCookieName, _parser.getValues());
+    HttpServerCookie::Ptr cookie = HttpCookieManager::Instance().getCookieFromHeader(kCookieName, _parser["Cookie"]);
     if(!cookie){
         //客户端请求中无cookie,再根据该用户的用户id获取cookie
         cookie = HttpCookieManager::Instance().getCookieByUid(kCookieName, uid);
@@ -389,6 +435,9 @@ inline void HttpSession::canAccessPath(const string &path_in,bool is_dir,const f
             //上次cookie是限定本目录
             if(accessErr.empty()){
                 //上次鉴权成功
+                if(hlsCounter){
+                    hlsCounter->onViewerRequest(cookie->getUid());
+                }
                 callback("", nullptr);
                 return;
             }
@@ -405,7 +454,7 @@ inline void HttpSession::canAccessPath(const string &path_in,bool is_dir,const f
 
     //该用户从来未获取过cookie，这个时候我们广播是否允许该用户访问该http目录
     weak_ptr<HttpSession> weakSelf = dynamic_pointer_cast<HttpSession>(shared_from_this());
-    HttpAccessPathInvoker accessPathInvoker = [weakSelf,callback,uid,path,is_dir] (const string &errMsg,const string &cookie_path_in, int cookieLifeSecond) {
+    HttpAccessPathInvoker accessPathInvoker = [weakSelf,callback,uid,path,is_dir,hlsCounter] (const string &errMsg,const string &cookie_path_in, int cookieLifeSecond) {
         HttpServerCookie::Ptr cookie ;
         if(cookieLifeSecond) {
             //本次鉴权设置了有效期，我们把鉴权结果缓存在cookie中
@@ -423,6 +472,9 @@ inline void HttpSession::canAccessPath(const string &path_in,bool is_dir,const f
             //记录能否访问
             (*cookie)[kAccessErrKey] = errMsg;
         }
+        if(hlsCounter && errMsg.empty()){
+            hlsCounter->onViewerRequest(cookie ? cookie->getUid() : uid);
+        }
 
         auto strongSelf = weakSelf.lock();
         if (!strongSelf) {
@@ -453,6 +505,131 @@ inline void HttpSession::canAccessPath(const string &path_in,bool is_dir,const f
 
 }
 
+//拦截低延时hls的索引与part请求
+inline bool HttpSession::checkLowLatencyHls(bool bClose){
+    GET_CONFIG(bool,lowLatency,Hls::kLowLatency);
+    if(!lowLatency){
+        return false;
+    }
+    auto pos = _mediaInfo._streamid.rfind('/');
+    if(pos == string::npos){
+        return false;
+    }
+    auto stream = _mediaInfo._streamid.substr(0,pos);
+    auto fileName = _mediaInfo._streamid.substr(pos + 1);
+
+    bool isPlaylist = fileName == "hls.m3u8";
+    long long msn = -1, part = -1;
+    if(isPlaylist){
+        auto &args = _parser.getUrlArgs();
+        auto it = args.find("_HLS_msn");
+        if(it != args.end()){
+            msn = atoll(it->second.data());
+        }
+        it = args.find("_HLS_part");
+        if(it != args.end()){
+            part = atoll(it->second.data());
+        }
+    }else if(!end_of(fileName,".part.ts") || 2 != sscanf(fileName.data(),"%lld.%lld.part.ts",&msn,&part) || msn < 0 || part < 0){
+        //不是part请求
+        return false;
+    }
+
+    auto cache = HlsPartCache::find(_mediaInfo._vhost,_mediaInfo._app,stream);
+    if(!cache){
+        //未生成低延时hls，按普通文件处理
+        return false;
+    }
+
+    if(isPlaylist && part >= 0 && msn < 0){
+        //协议规定_HLS_part必须与_HLS_msn一起使用
+        string strContent = "_HLS_part without _HLS_msn";
+        sendResponse("400 Bad Request", makeHttpHeader(bClose,strContent.size()), strContent);
+        if(bClose){
+            shutdown(SockException(Err_shutdown,"close connection after send 400 bad request"));
+        }
+        return true;
+    }
+
+    auto Origin = _parser["Origin"];
+    //判断是否有权限访问
+    canAccessPath(_parser.Url(),false,[this,cache,isPlaylist,msn,part,bClose,Origin](const string &errMsg,const HttpServerCookie::Ptr &cookie){
+        if(!errMsg.empty()){
+            auto headerOut = makeHttpHeader(bClose,errMsg.size());
+            if(cookie){
+                headerOut["Set-Cookie"] = cookie->getCookie((*cookie)[kCookiePathKey]);
+            }
+            sendResponse("401 Unauthorized" , headerOut, errMsg);
+            throw SockException(bClose ? Err_shutdown : Err_success,"close connection after access file failed");
+        }
+
+        string setCookie;
+        if(cookie){
+            setCookie = cookie->getCookie((*cookie)[kCookiePathKey]);
+        }
+        //被阻塞的请求只登记回调，超时定时器与回复都在本会话线程中执行，不占用额外线程
+        auto responded = std::make_shared<bool>(false);
+        weak_ptr<HttpSession> weakSelf = dynamic_pointer_cast<HttpSession>(shared_from_this());
+        auto onResponse = [weakSelf,responded,isPlaylist,bClose,Origin,setCookie](int code,const Buffer::Ptr &data){
+            auto strongSelf = weakSelf.lock();
+            if(!strongSelf || *responded){
+                return;
+            }
+            *responded = true;
+            const char *status = code == 200 ? "200 OK" : (code == 400 ? "400 Bad Request" : (code == 404 ? "404 Not Found" : "503 Service Unavailable"));
+            auto headerOut = makeHttpHeader(bClose, data ? data->size() : 0, isPlaylist ? "application/vnd.apple.mpegurl" : "video/mp2t");
+            headerOut["Cache-Control"] = "no-cache";
+            if(!data){
+                headerOut["Content-Length"] = "0";
+            }
+            if(!Origin.empty()){
+                headerOut["Access-Control-Allow-Origin"] = Origin;
+                headerOut["Access-Control-Allow-Credentials"] = "true";
+            }
+            if(!setCookie.empty()){
+                headerOut["Set-Cookie"] = setCookie;
+            }
+            strongSelf->sendResponse(status, headerOut, "");
+            if(data){
+                strongSelf->_ui64TotalBytes += data->size();
+                strongSelf->send(data);
+            }
+            if(bClose){
+                strongSelf->shutdown(SockException(Err_shutdown,"Connection: close"));
+            }
+        };
+
+        //协议规定阻塞请求最长等待3倍切片时长
+        GET_CONFIG(uint32_t,segDuration,Hls::kSegmentDuration);
+        auto onTimeout = getPoller()->doDelayTask(3 * 1000 * MAX(1,segDuration),[onResponse](){
+            onResponse(503, nullptr);
+            return 0;
+        });
+
+        auto onResult = [weakSelf,onResponse,onTimeout](int code,const Buffer::Ptr &data){
+            auto strongSelf = weakSelf.lock();
+            if(!strongSelf){
+                //取消延时任务，及时释放其持有的回复闭包
+                onTimeout->cancel();
+                return;
+            }
+            //可能在切片线程中回调，切换到自己线程
+            strongSelf->async([onResponse,onTimeout,code,data](){
+                //取消延时任务，防止回复闭包在定时器中滞留数倍切片时长
+                onTimeout->cancel();
+                onResponse(code,data);
+            });
+        };
+
+        if(isPlaylist){
+            cache->getPlaylist(msn,part,onResult);
+        }else{
+            cache->getPart(msn,part,onResult);
+        }
+    });
+    return true;
+}
+
 inline void HttpSession::Handle_Req_GET(int64_t &content_len) {
 	//先看看是否为WebSocket请求
 	if(checkWebSocket()){
@@ -476,6 +653,11 @@ inline void HttpSession::Handle_Req_GET(int64_t &content_len) {
 		return;
 	}
 
+    //再看看是否为http-ts直播请求
+    if(checkLiveTsStream()){
+        return;
+    }
+
 	//事件未被拦截，则认为是http下载请求
 	auto fullUrl = string(HTTP_SCHEMA) + "://" + _parser["Host"] + _parser.FullUrl();
     _mediaInfo.parse(fullUrl);
@@ -487,6 +669,20 @@ inline void HttpSession::Handle_Req_GET(int64_t &content_len) {
     string strFile = enableVhost ?  rootPath + "/" + _mediaInfo._vhost + _parser.Url() :rootPath + _parser.Url();
     bool bClose = (strcasecmp(_parser["Connection"].data(),"close") == 0) || ( ++_iReqCnt > reqCnt);
 
+    //低延时hls的索引与part从内存回复
+    if(checkLowLatencyHls(bClose)){
+        return;
+    }
+
+    //hls.m3u8?dvr=1 回复直播时移索引，鉴权与观看人数统计仍按hls.m3u8处理
+    if(end_of(strFile,"/hls.m3u8")){
+        auto &args = _parser.getUrlArgs();
+        auto it = args.find("dvr");
+        if(it != args.end() && atoi(it->second.data())){
+            replace(strFile,"/hls.m3u8","/hls_dvr.m3u8");
+        }
+    }
+
     do{
         //访问的是文件夹
         if (strFile.back() == '/' || File::is_dir(strFile.data())) {
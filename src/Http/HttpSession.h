@@ -33,6 +33,7 @@
 #include "Network/TcpServer.h"
 #include "Rtmp/RtmpMediaSource.h"
 #include "Rtmp/FlvMuxer.h"
+#include "MediaFile/TsLiveSource.h"
 #include "HttpRequestSplitter.h"
 #include "WebSocketSplitter.h"
 #include "HttpCookieManager.h"
@@ -108,6 +109,9 @@ private:
 	inline void Handle_Req_GET(int64_t &content_len);
 	inline void Handle_Req_POST(int64_t &content_len);
 	inline bool checkLiveFlvStream();
+	inline bool checkLiveTsStream();
+	inline bool checkLiveStream(const string &suffix,const function<void(const RtmpMediaSource::Ptr &rtmp_src)> &onStart);
+	inline bool checkLowLatencyHls(bool bClose);
 	inline bool checkWebSocket();
 	inline bool emitHttpEvent(bool doInvoke);
 	inline void urlDecode(Parser &parser);
@@ -148,6 +152,11 @@ private:
     uint64_t _ui64TotalBytes = 0;
     //flv over http
     MediaInfo _mediaInfo;
+#if defined(ENABLE_HLS)
+    //ts over http，同一个流的观看者共享TsLiveSource
+    TsLiveSource::Ptr _tsSource;
+    TsLiveSource::RingType::RingReader::Ptr _tsReader;
+#endif //defined(ENABLE_HLS)
     //处理content数据的callback
     function<bool (const char *data,uint64_t len) > _contentCallBack;
 };
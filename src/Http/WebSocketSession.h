@@ -89,7 +89,8 @@ protected:
                     header._reserved = 0;
                     header._opcode = WebSocketHeader::TEXT;
                     header._mask_flag = false;
-                    strongSelf->WebSocketSplitter::encode(header,(uint8_t *)buf->data(),buf->size());
+                    //服务端数据不带掩码，负载数据不拷贝直接发送，包头复用缓存
+                    strongSelf->WebSocketSplitter::encode(header,buf);
                 }
                 return buf->size();
             });
@@ -151,6 +152,14 @@ protected:
     void onWebSocketEncodeData(const uint8_t *ptr,uint64_t len) override{
         SocketHelper::send((char *)ptr,len);
     }
+
+    /**
+     * 发送数据进行websocket协议打包后回调，数据不拷贝
+     * @param buffer
+     */
+    void onWebSocketEncodeData(const Buffer::Ptr &buffer) override{
+        SocketHelper::send(buffer);
+    }
 private:
     typedef function<int(const Buffer::Ptr &buf)> onBeforeSendCB;
     /**
@@ -35,6 +35,16 @@
 #include "Util/util.h"
 using namespace toolkit;
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif //defined(__AVX2__)
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif //defined(__SSE2__)
+
 namespace mediakit {
 
 /**
@@ -59,157 +69,228 @@ namespace mediakit {
  +---------------------------------------------------------------+
  */
 
-#define CHECK_LEN(size) \
-do{ \
-    if(len - (ptr - data) < size){ \
-        if(_remain_data.empty()){ \
-            _remain_data.assign((char *)data,len); \
-        } \
-        return ; \
-    } \
-}while(0) \
+void WebSocketSplitter::maskData(uint8_t *data,uint64_t len,const uint8_t *mask,uint64_t offset) {
+    //按偏移量旋转掩码，之后每4字节对齐使用同一个掩码
+    uint8_t key[4] = {mask[offset % 4], mask[(offset + 1) % 4], mask[(offset + 2) % 4], mask[(offset + 3) % 4]};
+    uint32_t key32;
+    memcpy(&key32, key, 4);
 
-void WebSocketSplitter::decode(uint8_t *data,uint64_t len) {
     uint8_t *ptr = data;
-    if(!_got_header) {
-        //还没有获取数据头
-        if(!_remain_data.empty()){
-            _remain_data.append((char *)data,len);
-            data = ptr = (uint8_t *)_remain_data.data();
-            len = _remain_data.size();
-        }
-
-begin_decode:
-        CHECK_LEN(1);
-        _fin = (*ptr & 0x80) >> 7;
-        _reserved = (*ptr & 0x70) >> 4;
-        _opcode = (WebSocketHeader::Type) (*ptr & 0x0F);
-        ptr += 1;
-
-        CHECK_LEN(1);
-        _mask_flag = (*ptr & 0x80) >> 7;
-        _playload_len = (*ptr & 0x7F);
-        ptr += 1;
-
-        if (_playload_len == 126) {
-            CHECK_LEN(2);
-            _playload_len = (*ptr << 8) | *(ptr + 1);
-            ptr += 2;
-        } else if (_playload_len == 127) {
-            CHECK_LEN(8);
-            _playload_len = ((uint64_t) ptr[0] << (8 * 7)) |
-                            ((uint64_t) ptr[1] << (8 * 6)) |
-                            ((uint64_t) ptr[2] << (8 * 5)) |
-                            ((uint64_t) ptr[3] << (8 * 4)) |
-                            ((uint64_t) ptr[4] << (8 * 3)) |
-                            ((uint64_t) ptr[5] << (8 * 2)) |
-                            ((uint64_t) ptr[6] << (8 * 1)) |
-                            ((uint64_t) ptr[7] << (8 * 0));
-            ptr += 8;
-        }
-        if (_mask_flag) {
-            CHECK_LEN(4);
-            _mask.assign(ptr, ptr + 4);
-            ptr += 4;
-        }
-        _got_header = true;
-        _mask_offset = 0;
-        _playload_offset = 0;
-        onWebSocketDecodeHeader(*this);
-        if(_playload_len == 0){
-            onWebSocketDecodeComplete(*this);
-        }
+    uint8_t *end = data + len;
+#if defined(__AVX2__)
+    __m256i key256 = _mm256_set1_epi32(key32);
+    for (; end - ptr >= 32; ptr += 32) {
+        __m256i val = _mm256_loadu_si256((const __m256i *) ptr);
+        _mm256_storeu_si256((__m256i *) ptr, _mm256_xor_si256(val, key256));
     }
+#endif //defined(__AVX2__)
 
-    //进入后面逻辑代表已经获取到了webSocket协议头，
+#if defined(__SSE2__)
+    __m128i key128 = _mm_set1_epi32(key32);
+    for (; end - ptr >= 16; ptr += 16) {
+        __m128i val = _mm_loadu_si128((const __m128i *) ptr);
+        _mm_storeu_si128((__m128i *) ptr, _mm_xor_si128(val, key128));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    uint8x16_t key128 = vreinterpretq_u8_u32(vdupq_n_u32(key32));
+    for (; end - ptr >= 16; ptr += 16) {
+        vst1q_u8(ptr, veorq_u8(vld1q_u8(ptr), key128));
+    }
+#endif //defined(__SSE2__)
+
+    //无simd指令集时每次处理8字节，memcpy防止非对齐访问
+    uint64_t key64 = ((uint64_t) key32 << 32) | key32;
+    for (; end - ptr >= 8; ptr += 8) {
+        uint64_t val;
+        memcpy(&val, ptr, 8);
+        val ^= key64;
+        memcpy(ptr, &val, 8);
+    }
+    //以上每次处理的字节数都是4的倍数，剩余部分从key[0]开始
+    for (int i = 0; ptr < end; ++ptr, ++i) {
+        *ptr ^= key[i % 4];
+    }
+}
 
-    uint64_t remain = len - (ptr - data);
-    if(remain > 0){
-        uint64_t playload_slice_len = remain;
-        if(playload_slice_len + _playload_offset > _playload_len){
-            playload_slice_len = _playload_len - _playload_offset;
-        }
-        _playload_offset += playload_slice_len;
-        onPlayloadData(ptr,playload_slice_len);
+uint64_t WebSocketSplitter::parseHeader(const uint8_t *ptr,uint64_t len) {
+    if (len < 2) {
+        return 0;
+    }
+    uint64_t header_size = 2;
+    bool mask_flag = (ptr[1] & 0x80) >> 7;
+    uint8_t playload_len = ptr[1] & 0x7F;
+    if (playload_len == 126) {
+        header_size += 2;
+    } else if (playload_len == 127) {
+        header_size += 8;
+    }
+    if (mask_flag) {
+        header_size += 4;
+    }
+    if (len < header_size) {
+        //包头不完整
+        return 0;
+    }
 
-        if(_playload_offset == _playload_len){
-            onWebSocketDecodeComplete(*this);
+    _fin = (ptr[0] & 0x80) >> 7;
+    _reserved = (ptr[0] & 0x70) >> 4;
+    _opcode = (WebSocketHeader::Type) (ptr[0] & 0x0F);
+    _mask_flag = mask_flag;
+    _playload_len = playload_len;
+    ptr += 2;
+
+    if (_playload_len == 126) {
+        _playload_len = (ptr[0] << 8) | ptr[1];
+        ptr += 2;
+    } else if (_playload_len == 127) {
+        _playload_len = ((uint64_t) ptr[0] << (8 * 7)) |
+                        ((uint64_t) ptr[1] << (8 * 6)) |
+                        ((uint64_t) ptr[2] << (8 * 5)) |
+                        ((uint64_t) ptr[3] << (8 * 4)) |
+                        ((uint64_t) ptr[4] << (8 * 3)) |
+                        ((uint64_t) ptr[5] << (8 * 2)) |
+                        ((uint64_t) ptr[6] << (8 * 1)) |
+                        ((uint64_t) ptr[7] << (8 * 0));
+        ptr += 8;
+    }
+    if (_mask_flag) {
+        _mask.assign(ptr, ptr + 4);
+    }
+    return header_size;
+}
 
-            //这是下一个包
-            remain -= playload_slice_len;
-            ptr += playload_slice_len;
-            _got_header = false;
+uint64_t WebSocketSplitter::decodeHeader(const uint8_t *ptr,uint64_t len) {
+    auto cached = _header_len;
+    const uint8_t *header = ptr;
+    uint64_t header_len = len;
+    if (cached) {
+        //拼接上次残留的包头
+        auto append = MIN(len, sizeof(_header_buf) - cached);
+        memcpy(_header_buf + cached, ptr, append);
+        header = _header_buf;
+        header_len = cached + append;
+    }
 
-            if(remain > 0){
-                //剩余数据是下一个包，把它的数据放置在缓存中
-                string str((char *)ptr,remain);
-                _remain_data = str;
+    auto header_size = parseHeader(header, header_len);
+    if (!header_size) {
+        //包头不完整(不足14字节)，缓存后等待后续数据
+        if (!cached) {
+            memcpy(_header_buf, ptr, len);
+        }
+        _header_len = header_len;
+        return 0;
+    }
+    _header_len = 0;
+    //返回本次输入数据中被包头消耗的字节数
+    return header_size - cached;
+}
 
-                data = ptr = (uint8_t *)_remain_data.data();
-                len = _remain_data.size();
-                goto begin_decode;
+void WebSocketSplitter::decode(uint8_t *data,uint64_t len) {
+    uint8_t *ptr = data;
+    uint8_t *end = data + len;
+    while (ptr < end) {
+        if (!_got_header) {
+            auto header_size = decodeHeader(ptr, end - ptr);
+            if (!header_size) {
+                return;
+            }
+            ptr += header_size;
+            _got_header = true;
+            _mask_offset = 0;
+            _playload_offset = 0;
+            onWebSocketDecodeHeader(*this);
+            if (_playload_len == 0) {
+                _got_header = false;
+                onWebSocketDecodeComplete(*this);
             }
+            continue;
+        }
+
+        //进入后面逻辑代表已经获取到了webSocket协议头，负载数据直接在输入buffer上处理
+        uint64_t playload_slice_len = MIN((uint64_t) (end - ptr), _playload_len - _playload_offset);
+        _playload_offset += playload_slice_len;
+        onPlayloadData(ptr, playload_slice_len);
+        ptr += playload_slice_len;
+
+        if (_playload_offset == _playload_len) {
+            //这个包结束，后面是下一个包
+            _got_header = false;
+            onWebSocketDecodeComplete(*this);
         }
     }
-    _remain_data.clear();
 }
 
 void WebSocketSplitter::onPlayloadData(uint8_t *ptr, uint64_t len) {
     if(_mask_flag){
-        for(int i = 0; i < len ; ++i,++ptr){
-            *(ptr) ^= _mask[(i + _mask_offset) % 4];
-        }
+        maskData(ptr, len, _mask.data(), _mask_offset);
         _mask_offset = (_mask_offset + len) % 4;
     }
-    onWebSocketDecodePlayload(*this, _mask_flag ? ptr - len : ptr, len, _playload_offset);
+    onWebSocketDecodePlayload(*this, ptr, len, _playload_offset);
 }
 
-void WebSocketSplitter::encode(const WebSocketHeader &header,uint8_t *data, const uint64_t len) {
-    string ret;
-
-    uint8_t byte = header._fin << 7 | ((header._reserved & 0x07) << 4) | (header._opcode & 0x0F) ;
-    ret.push_back(byte);
+int WebSocketSplitter::makeHeader(const WebSocketHeader &header,uint64_t len,uint8_t *ret) {
+    int size = 0;
+    ret[size++] = header._fin << 7 | ((header._reserved & 0x07) << 4) | (header._opcode & 0x0F);
 
     auto mask_flag = (header._mask_flag && header._mask.size() >= 4);
-    byte = mask_flag << 7;
+    uint8_t byte = mask_flag << 7;
 
     if(len < 126){
-        byte |= len;
-        ret.push_back(byte);
+        ret[size++] = byte | len;
     }else if(len <= 0xFFFF){
-        byte |= 126;
-        ret.push_back(byte);
-
-        auto len_low = htons(len);
-        ret.append((char *)&len_low,2);
+        ret[size++] = byte | 126;
+        ret[size++] = (len >> 8) & 0xFF;
+        ret[size++] = len & 0xFF;
     }else{
-        byte |= 127;
-        ret.push_back(byte);
-
-        uint32_t len_high = htonl(len >> 32) ;
-        uint32_t len_low = htonl(len & 0xFFFFFFFF);
-        ret.append((char *)&len_high,4);
-        ret.append((char *)&len_low,4);
+        ret[size++] = byte | 127;
+        for (int i = 7; i >= 0; --i) {
+            ret[size++] = (len >> (8 * i)) & 0xFF;
+        }
     }
     if(mask_flag){
-        ret.append((char *)header._mask.data(),4);
+        memcpy(ret + size, header._mask.data(), 4);
+        size += 4;
     }
+    return size;
+}
 
-    onWebSocketEncodeData((uint8_t*)ret.data(),ret.size());
-
+void WebSocketSplitter::encode(const WebSocketHeader &header,const uint8_t *data, const uint64_t len) {
+    //包头最长14字节，直接生成在新buffer头部，随后拷贝负载数据，整个包一次输出
+    auto buffer = std::make_shared<BufferRaw>(14 + len);
+    auto ptr = (uint8_t *) buffer->data();
+    auto head_size = makeHeader(header, len, ptr);
     if(len > 0){
-        if(mask_flag){
-            uint8_t *ptr = data;
-            for(int i = 0; i < len ; ++i,++ptr){
-                *(ptr) ^= header._mask[i % 4];
-            }
+        memcpy(ptr + head_size, data, len);
+        if(header._mask_flag && header._mask.size() >= 4){
+            //在拷贝后的数据上加掩码，不修改调用者的数据
+            maskData(ptr + head_size, len, header._mask.data());
         }
-        onWebSocketEncodeData(data,len);
     }
-
+    buffer->setSize(head_size + len);
+    onWebSocketEncodeData(buffer);
 }
 
+//不带掩码的包负载小于该值时合并为一个连续buffer输出，否则负载数据不拷贝
+static const uint64_t kMergeSize = 1024;
 
+void WebSocketSplitter::encode(const WebSocketHeader &header,const Buffer::Ptr &buffer) {
+    uint64_t len = buffer->size();
+    if(header._mask_flag || len <= kMergeSize){
+        encode(header,(const uint8_t *)buffer->data(),len);
+        return;
+    }
+    uint8_t first_byte = header._fin << 7 | ((header._reserved & 0x07) << 4) | (header._opcode & 0x0F);
+    auto &cache = _header_cache[len % (sizeof(_header_cache) / sizeof(_header_cache[0]))];
+    if(!cache.buffer || cache.first_byte != first_byte || cache.len != len){
+        uint8_t head[14];
+        auto head_size = makeHeader(header, len, head);
+        cache.first_byte = first_byte;
+        cache.len = len;
+        cache.buffer = std::make_shared<BufferString>(string((char *) head, head_size));
+    }
+    onWebSocketEncodeData(cache.buffer);
+    onWebSocketEncodeData(buffer);
+}
 
 } /* namespace mediakit */
 
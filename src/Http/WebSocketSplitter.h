@@ -31,7 +31,9 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include "Network/Buffer.h"
 using namespace std;
+using namespace toolkit;
 
 
 namespace mediakit {
@@ -77,6 +79,7 @@ public:
     /**
      * 输入数据以便解包webSocket数据以及处理粘包问题
      * 可能触发onWebSocketDecodeHeader和onWebSocketDecodePlayload回调
+     * 负载数据直接在输入buffer上原地解掩码后回调，只有不完整的包头(最多14字节)会被缓存
      * @param data 需要解包的数据，可能是不完整的包或多个包
      * @param len 数据长度
      */
@@ -84,13 +87,33 @@ public:
 
     /**
      * 编码一个数据包
-     * 将触发2次onWebSocketEncodeData回调
-     * 第一次是数据头，第二次是负载数据
+     * 包头与负载数据拷贝到同一个新buffer中(带掩码时在拷贝上加掩码)，
+     * 整个数据包只触发1次onWebSocketEncodeData(const Buffer::Ptr &)回调，调用者的负载数据不会被修改
      * @param header 数据头
      * @param data 负载数据
      * @param len 负载数据长度
      */
-    void encode(const WebSocketHeader &header,uint8_t *data,const uint64_t len);
+    void encode(const WebSocketHeader &header,const uint8_t *data,const uint64_t len);
+
+    /**
+     * 编码一个数据包
+     * 带掩码或负载较小的包与上面相同，合并为一个连续buffer输出；
+     * 不带掩码的大包不拷贝负载数据，触发2次onWebSocketEncodeData(const Buffer::Ptr &)回调，
+     * 包头只与fin/opcode/长度有关，相同的包头会被缓存复用
+     * @param header 数据头
+     * @param buffer 负载数据
+     */
+    void encode(const WebSocketHeader &header,const Buffer::Ptr &buffer);
+
+    /**
+     * 对数据进行websocket掩码运算(加掩码与解掩码相同)
+     * 支持AVX2/SSE2/NEON时每次处理32/16字节，否则每次处理8字节
+     * @param data 数据，原地修改
+     * @param len 数据长度
+     * @param mask 4字节掩码
+     * @param offset 该数据在负载中的偏移量
+     */
+    static void maskData(uint8_t *data,uint64_t len,const uint8_t *mask,uint64_t offset = 0);
 protected:
     /**
      * 收到一个webSocket数据包包头，后续将继续触发onWebSocketDecodePlayload回调
@@ -120,11 +143,33 @@ protected:
      * @param len 数据指针长度
      */
     virtual void onWebSocketEncodeData(const uint8_t *ptr,uint64_t len){};
+
+    /**
+     * websocket数据编码回调，数据可以直接发送，不必拷贝
+     * 默认转换为指针形式的回调
+     * @param buffer 数据
+     */
+    virtual void onWebSocketEncodeData(const Buffer::Ptr &buffer){
+        onWebSocketEncodeData((uint8_t *)buffer->data(),buffer->size());
+    };
 private:
     void onPlayloadData(uint8_t *data,uint64_t len);
+    uint64_t decodeHeader(const uint8_t *ptr,uint64_t len);
+    uint64_t parseHeader(const uint8_t *ptr,uint64_t len);
+    static int makeHeader(const WebSocketHeader &header,uint64_t len,uint8_t *ret);
 private:
-    string _remain_data;
-    int _mask_offset = 0;
+    class HeaderCache {
+    public:
+        uint8_t first_byte = 0;
+        uint64_t len = 0;
+        Buffer::Ptr buffer;
+    };
+    //不带掩码的包头缓存，按长度直接映射
+    HeaderCache _header_cache[16];
+    //不完整的包头
+    uint8_t _header_buf[14];
+    uint64_t _header_len = 0;
+    uint64_t _mask_offset = 0;
     bool _got_header = false;
     uint64_t _playload_offset = 0;
 };
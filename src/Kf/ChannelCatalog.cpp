@@ -0,0 +1,418 @@
+//
+// 通道目录，内存索引 + sqlite异步落盘
+//
+#include <algorithm>
+#include "ChannelCatalog.h"
+#include "Globals.h"
+#include "Common/config.h"
+#include "Util/logger.h"
+#include "Util/onceToken.h"
+#include <sqlite3pp/sqlite3pp.h>
+
+using namespace toolkit;
+
+//名称索引分片长度(字节)，中文按utf8字节切分同样适用
+static const size_t kNameGramSize = 3;
+
+static string toLowerAscii(const string &str) {
+    string ret = str;
+    //与sqlite的LIKE保持一致，只忽略ASCII字母大小写
+    for (auto &ch : ret) {
+        if (ch >= 'A' && ch <= 'Z') {
+            ch = ch - 'A' + 'a';
+        }
+    }
+    return ret;
+}
+
+ChannelCatalog &ChannelCatalog::Instance() {
+    static ChannelCatalog instance;
+    return instance;
+}
+
+Json::Value ChannelCatalog::makeChannel(const Json::Value &args, int id) {
+    string vhost = args.get("vhost", DEFAULT_VHOST).asString();
+    string app = args["app"].asString();
+    string stream = args["stream"].asString();
+
+    Json::Value ret;
+    ret["id"] = id;
+    ret["proxyKey"] = getProxyKey(vhost, app, stream);
+    ret["name"] = args["name"].asString();
+    ret["vhost"] = vhost;
+    ret["app"] = app;
+    ret["stream"] = stream;
+    ret["source_url"] = args["source_url"].asString();
+    ret["ffmpeg_cmd"] = args.get("ffmpeg_cmd", "").asString();
+    ret["enable_hls"] = args.get("enable_hls", 1).asInt();
+    ret["record_mp4"] = args.get("record_mp4", 0).asInt();
+    ret["rtsp_transport"] = args.get("rtsp_transport", 1).asInt();
+    ret["on_demand"] = args.get("on_demand", 1).asInt();
+    ret["active"] = args.get("active", 0).asInt();
+    return ret;
+}
+
+void ChannelCatalog::load(const string &dbpath) {
+    lock_guard<recursive_mutex> lck(_mtx);
+    _db = std::make_shared<sqlite3pp::database>(dbpath.data());
+    //WAL模式下写操作不阻塞读，synchronous=NORMAL在WAL下仍能保证数据库一致性
+    _db->execute("PRAGMA journal_mode=WAL");
+    _db->execute("PRAGMA synchronous=NORMAL");
+
+    _channels.clear();
+    _proxyKeyIndex.clear();
+    _nameIndex.clear();
+    _maxId = 0;
+
+    sqlite3pp::query qry(*_db, "SELECT ID, PROXY_KEY, NAME, VHOST, APP, STREAM, SOURCE_URL, FFMPEG_CMD, ENABLE_HLS, RECORD_MP4, RTSP_TRANSPORT, ON_DEMAND, ACTIVE FROM CHANNEL ORDER BY ID");
+    for (sqlite3pp::query::iterator i = qry.begin(); i != qry.end(); ++i) {
+        int id, enable_hls, record_mp4, rtsp_transport, on_demand, active;
+        std::string proxyKey, name, vhost, app, stream, source_url, ffmpeg_cmd;
+
+        std::tie(id, proxyKey, name, vhost, app, stream, source_url, ffmpeg_cmd, enable_hls, record_mp4, rtsp_transport,
+                 on_demand, active) =
+                (*i).get_columns <
+                int, char const*, char const*, char const*, char const*, char const*, char const*, char const*, int, int, int, int,
+                int > (0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12);
+
+        Json::Value channel;
+        channel["id"] = id;
+        channel["proxyKey"] = proxyKey;
+        channel["vhost"] = vhost;
+        channel["name"] = name;
+        channel["app"] = app;
+        channel["stream"] = stream;
+        channel["source_url"] = source_url;
+        channel["ffmpeg_cmd"] = ffmpeg_cmd;
+        channel["enable_hls"] = enable_hls;
+        channel["record_mp4"] = record_mp4;
+        channel["rtsp_transport"] = rtsp_transport;
+        channel["on_demand"] = on_demand;
+        channel["active"] = active;
+        indexChannel(id, channel);
+    }
+
+    //AUTOINCREMENT不复用已删除的id，以sqlite_sequence为准
+    sqlite3pp::query seq(*_db, "SELECT seq FROM sqlite_sequence WHERE name='CHANNEL'");
+    for (sqlite3pp::query::iterator i = seq.begin(); i != seq.end(); ++i) {
+        int maxId;
+        std::tie(maxId) = (*i).get_columns<int>(0);
+        _maxId = MAX(_maxId, maxId);
+    }
+
+    if (!_dbThread) {
+        _dbThread = std::make_shared<ThreadPool>(1);
+    }
+    InfoL << "加载通道:" << _channels.size() << "个";
+}
+
+void ChannelCatalog::indexChannel(int id, const Json::Value &channel) {
+    _channels[id] = channel;
+    _proxyKeyIndex[channel["proxyKey"].asString()] = id;
+    auto name = toLowerAscii(channel["name"].asString());
+    for (size_t pos = 0; pos + kNameGramSize <= name.size(); ++pos) {
+        _nameIndex[name.substr(pos, kNameGramSize)].emplace(id);
+    }
+    _maxId = MAX(_maxId, id);
+}
+
+void ChannelCatalog::unindexChannel(int id, const Json::Value &channel) {
+    //channel可能引用_channels中的记录，最后再移除
+    _proxyKeyIndex.erase(channel["proxyKey"].asString());
+    auto name = toLowerAscii(channel["name"].asString());
+    for (size_t pos = 0; pos + kNameGramSize <= name.size(); ++pos) {
+        auto it = _nameIndex.find(name.substr(pos, kNameGramSize));
+        if (it == _nameIndex.end()) {
+            continue;
+        }
+        it->second.erase(id);
+        if (it->second.empty()) {
+            _nameIndex.erase(it);
+        }
+    }
+    _channels.erase(id);
+}
+
+Json::Value ChannelCatalog::findById(int id) const {
+    lock_guard<recursive_mutex> lck(_mtx);
+    auto it = _channels.find(id);
+    if (it == _channels.end()) {
+        return Json::Value();
+    }
+    return it->second;
+}
+
+Json::Value ChannelCatalog::findByProxyKey(const string &proxyKey) const {
+    lock_guard<recursive_mutex> lck(_mtx);
+    auto it = _proxyKeyIndex.find(proxyKey);
+    if (it == _proxyKeyIndex.end()) {
+        return Json::Value();
+    }
+    return _channels.at(it->second);
+}
+
+int ChannelCatalog::create(Json::Value &args) {
+    lock_guard<recursive_mutex> lck(_mtx);
+    int id = args["id"].isNull() ? _maxId + 1 : args["id"].asInt();
+    auto channel = makeChannel(args, id);
+    if (_channels.count(id) || _proxyKeyIndex.count(channel["proxyKey"].asString())) {
+        WarnL << "通道已存在:" << id << " " << channel["proxyKey"].asString();
+        return SQLITE_CONSTRAINT;
+    }
+    indexChannel(id, channel);
+    args["id"] = id;
+    args["proxyKey"] = channel["proxyKey"];
+    saveToDb(channel, true);
+    return SQLITE_OK;
+}
+
+int ChannelCatalog::update(int id, Json::Value &args) {
+    lock_guard<recursive_mutex> lck(_mtx);
+    auto it = _channels.find(id);
+    if (it == _channels.end()) {
+        return SQLITE_NOTFOUND;
+    }
+    auto channel = makeChannel(args, id);
+    auto proxyKey = channel["proxyKey"].asString();
+    auto it_key = _proxyKeyIndex.find(proxyKey);
+    if (it_key != _proxyKeyIndex.end() && it_key->second != id) {
+        WarnL << "通道已存在:" << proxyKey;
+        return SQLITE_CONSTRAINT;
+    }
+    unindexChannel(id, it->second);
+    indexChannel(id, channel);
+    args["proxyKey"] = proxyKey;
+    saveToDb(channel, false);
+    return SQLITE_OK;
+}
+
+int ChannelCatalog::remove(int id) {
+    lock_guard<recursive_mutex> lck(_mtx);
+    auto it = _channels.find(id);
+    if (it == _channels.end()) {
+        return SQLITE_NOTFOUND;
+    }
+    unindexChannel(id, it->second);
+    removeFromDb(id);
+    return SQLITE_OK;
+}
+
+void ChannelCatalog::forEachMatch(const string &searchText, bool recordMp4Only, const string &active,
+                                  const function<bool(const Json::Value &channel)> &cb) const {
+    int activeVal = atoi(active.data());
+    auto filter = [&](const Json::Value &channel) {
+        if (recordMp4Only && channel["record_mp4"].asInt() <= 0) {
+            return false;
+        }
+        if (!active.empty() && channel["active"].asInt() != activeVal) {
+            return false;
+        }
+        return true;
+    };
+
+    auto text = toLowerAscii(searchText);
+    if (text.size() < kNameGramSize) {
+        //搜索文本过短无法使用分片索引，顺序扫描(仅内存操作)
+        for (auto &pr : _channels) {
+            if (!text.empty() && toLowerAscii(pr.second["name"].asString()).find(text) == string::npos) {
+                continue;
+            }
+            if (filter(pr.second) && !cb(pr.second)) {
+                return;
+            }
+        }
+        return;
+    }
+
+    //取命中数最少的分片作为候选集，再逐条校验完整包含关系
+    const set<int> *candidates = nullptr;
+    for (size_t pos = 0; pos + kNameGramSize <= text.size(); ++pos) {
+        auto it = _nameIndex.find(text.substr(pos, kNameGramSize));
+        if (it == _nameIndex.end()) {
+            return;
+        }
+        if (!candidates || it->second.size() < candidates->size()) {
+            candidates = &it->second;
+        }
+    }
+    for (auto id : *candidates) {
+        auto &channel = _channels.at(id);
+        if (toLowerAscii(channel["name"].asString()).find(text) == string::npos) {
+            continue;
+        }
+        if (filter(channel) && !cb(channel)) {
+            return;
+        }
+    }
+}
+
+int ChannelCatalog::count(const string &searchText, bool recordMp4Only, const string &active) const {
+    lock_guard<recursive_mutex> lck(_mtx);
+    int ret = 0;
+    forEachMatch(searchText, recordMp4Only, active, [&](const Json::Value &) {
+        ++ret;
+        return true;
+    });
+    return ret;
+}
+
+Json::Value ChannelCatalog::search(const string &searchText, bool recordMp4Only, const string &active, int page, int pageSize) const {
+    lock_guard<recursive_mutex> lck(_mtx);
+    Json::Value ret;
+    int64_t skip = pageSize > 0 ? (int64_t) pageSize * (MAX(page, 1) - 1) : 0;
+    forEachMatch(searchText, recordMp4Only, active, [&](const Json::Value &channel) {
+        if (skip > 0) {
+            --skip;
+            return true;
+        }
+        ret.append(channel);
+        return pageSize <= 0 || (int) ret.size() < pageSize;
+    });
+    return ret;
+}
+
+void ChannelCatalog::asyncDb(const function<void(sqlite3pp::database &db)> &task) {
+    if (!_dbThread) {
+        ErrorL << "数据库未加载";
+        return;
+    }
+    auto db = _db;
+    _dbThread->async([task, db]() {
+        try {
+            task(*db);
+        } catch (std::exception &ex) {
+            ErrorL << "数据库操作失败:" << ex.what();
+        }
+    }, false);
+}
+
+void ChannelCatalog::saveToDb(const Json::Value &channel, bool isCreate) {
+    if (_batching) {
+        return;
+    }
+    asyncDb([this, channel, isCreate](sqlite3pp::database &db) {
+        writeChannel(db, channel, isCreate);
+    });
+}
+
+void ChannelCatalog::writeChannel(sqlite3pp::database &db, const Json::Value &channel, bool isCreate) {
+    auto &cmd = isCreate ? _insertCmd : _updateCmd;
+    if (!cmd) {
+        //预编译语句只在数据库线程中创建与使用
+        cmd = std::make_shared<sqlite3pp::command>(db, isCreate ?
+                "INSERT INTO CHANNEL " \
+                " (ID, PROXY_KEY, NAME, VHOST, APP, STREAM, SOURCE_URL, FFMPEG_CMD, ENABLE_HLS, RECORD_MP4, RTSP_TRANSPORT, ON_DEMAND, ACTIVE, CREATE_TIME)" \
+                " VALUES" \
+                " (:id, :proxyKey, :name, :vhost, :app, :stream, :source_url, :ffmpeg_cmd, :enable_hls, :record_mp4, :rtsp_transport, :on_demand, :active, datetime('now', 'localtime'))" :
+                "UPDATE CHANNEL " \
+                "SET " \
+                "PROXY_KEY=:proxyKey, " \
+                "NAME=:name, " \
+                "VHOST=:vhost, " \
+                "APP=:app, "\
+                "STREAM=:stream, "\
+                "SOURCE_URL=:source_url, " \
+                "FFMPEG_CMD=:ffmpeg_cmd, " \
+                "ENABLE_HLS=:enable_hls, " \
+                "RECORD_MP4=:record_mp4, " \
+                "RTSP_TRANSPORT=:rtsp_transport, " \
+                "ON_DEMAND=:on_demand, " \
+                "ACTIVE=:active," \
+                "MODIFY_TIME=datetime('now', 'localtime') " \
+                "WHERE " \
+                "ID = :id");
+    }
+    cmd->reset();
+    cmd->bind(":id", channel["id"].asInt());
+    cmd->bind(":proxyKey", channel["proxyKey"].asString(), sqlite3pp::copy);
+    cmd->bind(":name", channel["name"].asString(), sqlite3pp::copy);
+    cmd->bind(":vhost", channel["vhost"].asString(), sqlite3pp::copy);
+    cmd->bind(":app", channel["app"].asString(), sqlite3pp::copy);
+    cmd->bind(":stream", channel["stream"].asString(), sqlite3pp::copy);
+    cmd->bind(":source_url", channel["source_url"].asString(), sqlite3pp::copy);
+    cmd->bind(":ffmpeg_cmd", channel["ffmpeg_cmd"].asString(), sqlite3pp::copy);
+    cmd->bind(":enable_hls", channel["enable_hls"].asInt());
+    cmd->bind(":record_mp4", channel["record_mp4"].asInt());
+    cmd->bind(":rtsp_transport", channel["rtsp_transport"].asInt());
+    cmd->bind(":on_demand", channel["on_demand"].asInt());
+    cmd->bind(":active", channel["active"].asInt());
+    int rc = cmd->execute();
+    if (rc != SQLITE_OK) {
+        ErrorL << (isCreate ? "创建" : "更新") << " channel通道 失败:" << channel["proxyKey"].asString() << " " << db.error_msg();
+    }
+}
+
+ChannelCatalog::Change ChannelCatalog::saveLocked(const Json::Value &args) {
+    Change ret;
+    string idStr = args["id"].asString();
+    int id = idStr.empty() ? 0 : atoi(idStr.c_str());
+    auto it = id > 0 ? _channels.find(id) : _channels.end();
+    if (it == _channels.end()) {
+        Json::Value channel = args;
+        channel["id"] = id > 0 ? Json::Value(id) : Json::Value();
+        ret.rc = create(channel);
+        ret.type = ret.rc == SQLITE_OK ? Change::Created : Change::Failed;
+        ret.channel = findById(channel["id"].asInt());
+        return ret;
+    }
+
+    auto channel = makeChannel(args, id);
+    if (channel == it->second) {
+        ret.type = Change::Unchanged;
+        ret.channel = it->second;
+        return ret;
+    }
+    ret.original = it->second;
+    Json::Value updated = args;
+    ret.rc = update(id, updated);
+    ret.type = ret.rc == SQLITE_OK ? Change::Updated : Change::Failed;
+    ret.channel = channel;
+    return ret;
+}
+
+vector<ChannelCatalog::Change> ChannelCatalog::saveBatch(const Json::Value &configs) {
+    vector<Change> ret;
+    vector<std::pair<Json::Value, bool> > dirty;
+    {
+        lock_guard<recursive_mutex> lck(_mtx);
+        //批量期间暂停逐条落盘，最后合并成一个事务
+        _batching = true;
+        //saveLocked抛异常时也要恢复逐条落盘，否则之后的修改都不会保存
+        onceToken token(nullptr, [this]() {
+            _batching = false;
+        });
+        for (Json::Value::ArrayIndex i = 0; i != configs.size(); ++i) {
+            auto change = saveLocked(configs[i]);
+            if (change.type == Change::Created || change.type == Change::Updated) {
+                dirty.emplace_back(change.channel, change.type == Change::Created);
+            }
+            ret.emplace_back(std::move(change));
+        }
+    }
+
+    if (!dirty.empty()) {
+        asyncDb([this, dirty](sqlite3pp::database &db) {
+            sqlite3pp::transaction xct(db);
+            for (auto &pr : dirty) {
+                writeChannel(db, pr.first, pr.second);
+            }
+            xct.commit();
+            InfoL << "批量保存通道:" << dirty.size() << "个";
+        });
+    }
+    return ret;
+}
+
+void ChannelCatalog::removeFromDb(int id) {
+    asyncDb([this, id](sqlite3pp::database &db) {
+        if (!_deleteCmd) {
+            _deleteCmd = std::make_shared<sqlite3pp::command>(db, "DELETE FROM CHANNEL WHERE ID = :id");
+        }
+        _deleteCmd->reset();
+        _deleteCmd->bind(":id", id);
+        int rc = _deleteCmd->execute();
+        if (rc != SQLITE_OK) {
+            ErrorL << "删除 channel通道 失败:" << id << " " << db.error_msg();
+        }
+    });
+}
@@ -0,0 +1,156 @@
+//
+// 通道目录，内存索引 + sqlite异步落盘
+//
+#ifndef KF_CHANNELCATALOG_H
+#define KF_CHANNELCATALOG_H
+
+#include <map>
+#include <set>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include "jsoncpp/json.h"
+#include "Thread/ThreadPool.h"
+
+namespace sqlite3pp {
+class database;
+class command;
+}
+
+/**
+ * 通道目录
+ * 全部通道常驻内存，按id、proxyKey(vhost/app/stream)以及名称建立索引，按需拉流等热点路径只查内存；
+ * 写操作先更新内存，再投递到唯一的数据库线程，以预编译语句异步写入sqlite(WAL模式)
+ */
+class ChannelCatalog {
+public:
+    /**
+     * 批量保存时单个通道的变化
+     */
+    class Change {
+    public:
+        typedef enum {
+            Created = 0,
+            Updated,
+            Unchanged,
+            Failed
+        } Type;
+
+        Type type = Failed;
+        //失败时的错误码
+        int rc = 0;
+        //修改前的通道记录，仅Updated有效
+        Json::Value original;
+        //保存后的通道记录
+        Json::Value channel;
+    };
+
+    static ChannelCatalog &Instance();
+
+    /**
+     * 打开数据库并加载全部通道，启动时调用一次
+     * @param dbpath 数据库文件路径
+     */
+    void load(const std::string &dbpath);
+
+    /**
+     * 按id查找通道，未找到返回null
+     */
+    Json::Value findById(int id) const;
+
+    /**
+     * 按proxyKey(vhost/app/stream)查找通道，未找到返回null
+     */
+    Json::Value findByProxyKey(const std::string &proxyKey) const;
+
+    /**
+     * 新增通道，id为空时自动分配
+     * @param channel 通道参数，成功后写入id与proxyKey
+     * @return SQLITE_OK:成功，SQLITE_CONSTRAINT:id或proxyKey冲突
+     */
+    int create(Json::Value &channel);
+
+    /**
+     * 修改通道
+     * @param id 通道id
+     * @param channel 通道参数，成功后写入proxyKey
+     * @return SQLITE_OK:成功，SQLITE_NOTFOUND:通道不存在，SQLITE_CONSTRAINT:proxyKey冲突
+     */
+    int update(int id, Json::Value &channel);
+
+    /**
+     * 删除通道
+     * @return SQLITE_OK:成功，SQLITE_NOTFOUND:通道不存在
+     */
+    int remove(int id);
+
+    /**
+     * 批量保存通道(有id且存在则更新，否则创建)
+     * 与原记录完全相同的通道不做任何修改，全部变化在一个数据库事务中落盘
+     * @param configs 通道参数数组
+     * @return 与configs一一对应的变化
+     */
+    std::vector<Change> saveBatch(const Json::Value &configs);
+
+    /**
+     * 统计满足条件的通道数
+     * @param searchText 名称包含的文本，为空不过滤
+     * @param recordMp4Only 是否只统计开启录像的通道
+     * @param active 启用状态，为空不过滤
+     */
+    int count(const std::string &searchText, bool recordMp4Only, const std::string &active) const;
+
+    /**
+     * 分页查询通道，按id升序
+     * @param page 页码，从1开始
+     * @param pageSize 每页条数，小于等于0时不分页
+     */
+    Json::Value search(const std::string &searchText, bool recordMp4Only, const std::string &active, int page, int pageSize) const;
+
+    /**
+     * 在数据库线程中执行任务，任务按投递顺序串行执行
+     */
+    void asyncDb(const std::function<void(sqlite3pp::database &db)> &task);
+
+private:
+    ChannelCatalog() = default;
+    ~ChannelCatalog() = default;
+
+    //把接口参数整理成完整的通道记录
+    static Json::Value makeChannel(const Json::Value &args, int id);
+
+    void indexChannel(int id, const Json::Value &channel);
+    void unindexChannel(int id, const Json::Value &channel);
+    void forEachMatch(const std::string &searchText, bool recordMp4Only, const std::string &active,
+                      const std::function<bool(const Json::Value &channel)> &cb) const;
+
+    //在内存中保存单个通道，调用者需持有锁
+    Change saveLocked(const Json::Value &args);
+
+    void saveToDb(const Json::Value &channel, bool isCreate);
+    void removeFromDb(int id);
+    //只能在数据库线程中调用
+    void writeChannel(sqlite3pp::database &db, const Json::Value &channel, bool isCreate);
+
+private:
+    mutable std::recursive_mutex _mtx;
+    //按id升序排列，用于分页
+    std::map<int, Json::Value> _channels;
+    std::unordered_map<std::string, int> _proxyKeyIndex;
+    //名称(小写)的3字节分片倒排索引，用于包含匹配
+    std::unordered_map<std::string, std::set<int> > _nameIndex;
+    int _maxId = 0;
+    //saveBatch执行期间，写操作由saveBatch统一落盘
+    bool _batching = false;
+
+    std::shared_ptr<toolkit::ThreadPool> _dbThread;
+    std::shared_ptr<sqlite3pp::database> _db;
+    std::shared_ptr<sqlite3pp::command> _insertCmd;
+    std::shared_ptr<sqlite3pp::command> _updateCmd;
+    std::shared_ptr<sqlite3pp::command> _deleteCmd;
+};
+
+#endif //KF_CHANNELCATALOG_H
@@ -4,6 +4,7 @@
 #include <string>
 #include "DbUtil.h"
 #include "Globals.h"
+#include "ChannelCatalog.h"
 #include <functional>
 #include <sqlite3pp/sqlite3pp.h>
 #include "jsoncpp/json.h"
@@ -140,6 +141,8 @@ void initDatabase(string dbpathParent) {
 
         db.execute(channelTableCreateSql.data());
 
+        //加载全部通道到内存，此后查询不再访问数据库
+        ChannelCatalog::Instance().load(dbpath);
     } catch (exception &ex) {
         ErrorL << ex.what();
     }
@@ -147,91 +150,25 @@ void initDatabase(string dbpathParent) {
 
 
 int deleteChannel(int channelId, std::function<void()> cb) {
-    try {
-        sqlite3pp::database db(dbpath.data());
-
-        sqlite3pp::transaction xct(db, true);
-        sqlite3pp::command cmd(db, " DELETE FROM CHANNEL " \
-                                       "WHERE " \
-                                       "ID = :id");
-
-        cmd.bind(":id", channelId);
-        int rc = cmd.execute();
-        xct.commit();
-
-        if (rc == SQLITE_OK) {
-            //回调
-            cb();
-        }
-
-        return rc;
-
-    } catch (exception &ex) {
-        ErrorL << "删除 channel通道 失败" << ex.what();
+    int rc = ChannelCatalog::Instance().remove(channelId);
+    if (rc == SQLITE_OK) {
+        //回调
+        cb();
     }
-
-    return -1;
+    return rc;
 }
 
 
 int updateChannel(int channelId, Json::Value jsonArgs, std::function<void(Json::Value channel)> cb) {
-    try {
-        sqlite3pp::database db(dbpath.data());
-
-        sqlite3pp::transaction xct(db, true);
-        sqlite3pp::command cmd(db, "UPDATE CHANNEL " \
-                                       "SET " \
-                                       "PROXY_KEY=:proxyKey, " \
-                                       "NAME=:name, " \
-                                       "VHOST=:vhost, " \
-                                       "APP=:app, "\
-                                       "STREAM=:stream, "\
-                                       "SOURCE_URL=:source_url, " \
-                                       "FFMPEG_CMD=:ffmpeg_cmd, " \
-                                       "ENABLE_HLS=:enable_hls, " \
-                                       "RECORD_MP4=:record_mp4, " \
-                                       "RTSP_TRANSPORT=:rtsp_transport, " \
-                                       "ON_DEMAND=:on_demand, " \
-                                       "ACTIVE=:active," \
-                                       "MODIFY_TIME=datetime('now', 'localtime') " \
-                                       "WHERE " \
-                                       "ID = :id");
-
-        string vhost = jsonArgs.get("vhost", DEFAULT_VHOST).asString();
-        string app = jsonArgs["app"].asString();
-        string stream = jsonArgs["stream"].asString();
-
-        string proxyKey = getProxyKey(vhost, app, stream);
-        cmd.bind(":proxyKey", proxyKey, sqlite3pp::copy);
-        cmd.bind(":name", jsonArgs["name"].asString(), sqlite3pp::copy);
-        cmd.bind(":vhost", vhost, sqlite3pp::copy);
-        cmd.bind(":app", app, sqlite3pp::copy);
-        cmd.bind(":stream", stream, sqlite3pp::copy);
-        cmd.bind(":source_url", jsonArgs["source_url"].asString(), sqlite3pp::copy);
-        cmd.bind(":ffmpeg_cmd", jsonArgs.get("ffmpeg_cmd", "").asString(), sqlite3pp::copy);
-        cmd.bind(":enable_hls", jsonArgs.get("enable_hls", 1).asInt());
-        cmd.bind(":record_mp4", jsonArgs.get("record_mp4", 0).asInt());
-        cmd.bind(":rtsp_transport", jsonArgs.get("rtsp_transport", 1).asInt());
-        cmd.bind(":on_demand", jsonArgs.get("on_demand", 1).asInt());
-        cmd.bind(":active", jsonArgs.get("active", 0).asInt());
-        cmd.bind(":id", channelId);
-        int rc = cmd.execute();
-        xct.commit();
-
-        if (rc == SQLITE_OK) {
-            Json::Value ret = jsonArgs;
-            ret["proxyKey"] = proxyKey;
-            //回调
-            cb(ret);
-        }
-
-        return rc;
-
-    } catch (exception &ex) {
-        ErrorL << "更新 channel通道 失败" << ex.what();
+    Json::Value ret = jsonArgs;
+    int rc = ChannelCatalog::Instance().update(channelId, ret);
+    if (rc == SQLITE_OK) {
+        //回调
+        cb(ret);
+    } else {
+        ErrorL << "更新 channel通道 失败:" << channelId << " " << rc;
     }
-
-    return -1;
+    return rc;
 }
 
 extern int saveChannel(int channelId, Json::Value jsonArgs,
@@ -258,63 +195,14 @@ extern int saveChannel(int channelId, Json::Value jsonArgs,
 }
 
 int createChannel(Json::Value jsonArgs, std::function<void(Json::Value channel)> cb) {
-    try {
-
-        sqlite3pp::database db(dbpath.data());
-
-        sqlite3pp::transaction xct(db, true);
-        sqlite3pp::command cmd(db, "INSERT INTO CHANNEL " \
-                                       " (ID, PROXY_KEY, NAME, VHOST, APP, STREAM, SOURCE_URL, FFMPEG_CMD, ENABLE_HLS, RECORD_MP4, RTSP_TRANSPORT, ON_DEMAND, ACTIVE, CREATE_TIME)" \
-                                       " VALUES" \
-                                       " (:id, :proxyKey, :name, :vhost, :app, :stream, :source_url, :ffmpeg_cmd, :enable_hls, :record_mp4, :rtsp_transport, :on_demand, :active, datetime('now', 'localtime'))");
-
-
-        string vhost = jsonArgs.get("vhost", DEFAULT_VHOST).asString();
-        string app = jsonArgs["app"].asString();
-        string stream = jsonArgs["stream"].asString();
-
-        string proxyKey = getProxyKey(vhost, app, stream);
-
-
-        cmd.bind(":proxyKey", proxyKey, sqlite3pp::copy);
-        if (jsonArgs["id"].isNull()) {
-            cmd.bind(":id", sqlite3pp::null_type());
-        } else {
-            cmd.bind(":id", jsonArgs["id"].asInt());
-        }
-
-        cmd.bind(":name", jsonArgs["name"].asString(), sqlite3pp::copy);
-        cmd.bind(":vhost", vhost, sqlite3pp::copy);
-        cmd.bind(":app", app, sqlite3pp::copy);
-        cmd.bind(":stream", stream, sqlite3pp::copy);
-        cmd.bind(":source_url", jsonArgs["source_url"].asString(), sqlite3pp::copy);
-        cmd.bind(":ffmpeg_cmd", jsonArgs.get("ffmpeg_cmd", "").asString(), sqlite3pp::copy);
-        cmd.bind(":enable_hls", jsonArgs.get("enable_hls", 1).asInt());
-        cmd.bind(":record_mp4", jsonArgs.get("record_mp4", 0).asInt());
-        cmd.bind(":rtsp_transport", jsonArgs.get("rtsp_transport", 1).asInt());
-        cmd.bind(":on_demand", jsonArgs.get("on_demand", 1).asInt());
-        cmd.bind(":active", jsonArgs.get("active", 0).asInt());
-
-        int rc = cmd.execute();
-        xct.commit();
-
-        if (rc == SQLITE_OK) {
-            sqlite3pp::query qry(db, "select last_insert_rowid()");
-            sqlite3pp::query::iterator lastRowIdIter = qry.begin();
-            int lastInsertId;
-            std::tie(lastInsertId) = (*lastRowIdIter).get_columns<int>(0);
-
-            Json::Value ret = jsonArgs;
-            ret["proxyKey"] = proxyKey;
-            ret["id"] = lastInsertId;
-            cb(ret);
-        }
-
-        return rc;
-    } catch (exception &ex) {
-        ErrorL << "创建 channel通道 失败" << ex.what();
+    Json::Value ret = jsonArgs;
+    int rc = ChannelCatalog::Instance().create(ret);
+    if (rc == SQLITE_OK) {
+        cb(ret);
+    } else {
+        ErrorL << "创建 channel通道 失败:" << rc;
     }
-    return -1;
+    return rc;
 }
 
 Json::Value searchChannels() {
@@ -322,125 +210,17 @@ Json::Value searchChannels() {
 }
 
 int countChannels(string searchText, string enableMp4, string active) {
-    sqlite3pp::database db(dbpath.data());
-
-
-    string baseQuery = "SELECT count(*) FROM CHANNEL ";
-    string where = " where 1=1 ";
-    string conditions = "";
-
-    string query = baseQuery;
-
-    if (!enableMp4.empty() && atoi(enableMp4.c_str())) {
-        conditions += " and record_mp4 > 0 ";
-    }
-    if (!active.empty()) {
-        conditions += " and active=:active ";
-    }
-
-    if (!searchText.empty()) {
-        conditions += " and name like :searchText ";
-    }
-    if (!conditions.empty()) {
-        query += where + conditions;
-    }
-
-    sqlite3pp::query qry(db, query.c_str());
-    if (!searchText.empty()) {
-        qry.bind(":searchText", "%" + searchText + "%", sqlite3pp::copy);
-    }
-    if (!active.empty()) {
-        qry.bind(":active", atoi(active.c_str()));
-    }
-
-    sqlite3pp::query::iterator lastRowIdIter = qry.begin();
-    int total;
-    std::tie(total) = (*lastRowIdIter).get_columns<int>(0);
-
-    return total;
+    bool recordMp4Only = !enableMp4.empty() && atoi(enableMp4.c_str());
+    return ChannelCatalog::Instance().count(searchText, recordMp4Only, active);
 }
 
 Json::Value searchChannels(string searchText, string enableMp4, string active, int page, int pageSize) {
-    sqlite3pp::database db(dbpath.data());
-
-    string baseQuery = "SELECT ID, PROXY_KEY, NAME, VHOST, APP, STREAM, SOURCE_URL, FFMPEG_CMD, ENABLE_HLS, RECORD_MP4, RTSP_TRANSPORT, ON_DEMAND, ACTIVE FROM CHANNEL ";
-    string where = " where 1=1 ";
-    string conditions = "";
-
-    string limit = " limit :pageSize offset :pageSize*(:page-1)";
-    string order = " order by ID ";
-
-    string query = baseQuery;
-
-    if (!enableMp4.empty() && atoi(enableMp4.c_str())) {
-        conditions += " and record_mp4 > 0 ";
-    }
-    if (!active.empty()) {
-        conditions += " and active=:active ";
-    }
-
-    if (!searchText.empty()) {
-        conditions += " and name like :searchText ";
-    }
-    if (!conditions.empty()) {
-        query += where + conditions;
-    }
-    query += order;
-
-    if (!(page == 1 && pageSize == 99999)) {
-        query = query + limit;
-    }
-
-    sqlite3pp::query qry(db, query.c_str());
-
-
-    if (!searchText.empty()) {
-        qry.bind(":searchText", "%" + searchText + "%", sqlite3pp::copy);
-    }
-    if (!active.empty()) {
-        qry.bind(":active", atoi(active.c_str()));
-
-    }
-
-
-    if (!(page == 1 && pageSize == 99999)) {
-        qry.bind(":pageSize", pageSize);
-        qry.bind(":page", page);
-    }
-
-
-    Json::Value ret;
-
-    for (sqlite3pp::query::iterator i = qry.begin(); i != qry.end(); ++i) {
-        int id, enable_hls, record_mp4, rtsp_transport, on_demand, active;
-        std::string proxyKey, name, vhost, app, stream, source_url, ffmpeg_cmd;
-
-        std::tie(id, proxyKey, name, vhost, app, stream, source_url, ffmpeg_cmd, enable_hls, record_mp4, rtsp_transport,
-                 on_demand, active) =
-                (*i).get_columns <
-                int, char const*, char const*, char const*, char const*, char const*, char const*, char const*, int, int, int, int,
-                int > (0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12);
-        //(*i).getter() >> sqlite3pp::ignore >> id >> name >>  vhost >> app >> stream >> source_url >> ffmpeg_cmd >>enable_hls >> record_mp4 >> rtsp_transport >> on_demand >> active;
-
-        Json::Value rowRet;
-        rowRet["id"] = id;
-        rowRet["proxyKey"] = proxyKey;
-        rowRet["vhost"] = vhost;
-        rowRet["name"] = name;
-        rowRet["app"] = app;
-        rowRet["stream"] = stream;
-        rowRet["source_url"] = source_url;
-        rowRet["ffmpeg_cmd"] = ffmpeg_cmd;
-        rowRet["enable_hls"] = enable_hls;
-        rowRet["record_mp4"] = record_mp4;
-        rowRet["rtsp_transport"] = rtsp_transport;
-        rowRet["on_demand"] = on_demand;
-        rowRet["active"] = active;
-
-        ret.append(rowRet);
+    bool recordMp4Only = !enableMp4.empty() && atoi(enableMp4.c_str());
+    if (page == 1 && pageSize == 99999) {
+        //不分页
+        pageSize = 0;
     }
-
-    return ret;
+    return ChannelCatalog::Instance().search(searchText, recordMp4Only, active, page, pageSize);
 }
 
 
@@ -449,84 +229,10 @@ Json::Value searchChannel(std::string vhost, std::string app, std::string stream
 }
 
 Json::Value searchChannel(std::string proxyKey) {
-    sqlite3pp::database db(dbpath.data());
-
-    std::string query =
-            "SELECT ID, PROXY_KEY, NAME, VHOST, APP, STREAM, SOURCE_URL, FFMPEG_CMD, ENABLE_HLS, RECORD_MP4, RTSP_TRANSPORT, ON_DEMAND, ACTIVE FROM CHANNEL WHERE PROXY_KEY=:proxyKey";
-    sqlite3pp::query qry(db, query.c_str());
-    qry.bind(":proxyKey", proxyKey, sqlite3pp::copy);
-
-
-    Json::Value rowRet;
-
-    for (sqlite3pp::query::iterator i = qry.begin(); i != qry.end(); ++i) {
-        int id, enable_hls, record_mp4, rtsp_transport, on_demand, active;
-        std::string proxyKey, name, vhost, app, stream, source_url, ffmpeg_cmd;
-
-        std::tie(id, proxyKey, name, vhost, app, stream, source_url, ffmpeg_cmd, enable_hls, record_mp4, rtsp_transport,
-                 on_demand, active) =
-                (*i).get_columns <
-                int, char const*, char const*, char const*, char const*, char const*, char const*, char const*, int, int, int, int,
-                int > (0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12);
-        //(*i).getter() >> sqlite3pp::ignore >> id >> name >>  vhost >> app >> stream >> source_url >> ffmpeg_cmd >>enable_hls >> record_mp4 >> rtsp_transport >> on_demand >> active;
-
-        rowRet["id"] = id;
-        rowRet["proxyKey"] = proxyKey;
-        rowRet["vhost"] = vhost;
-        rowRet["name"] = name;
-        rowRet["app"] = app;
-        rowRet["stream"] = stream;
-        rowRet["source_url"] = source_url;
-        rowRet["ffmpeg_cmd"] = ffmpeg_cmd;
-        rowRet["enable_hls"] = enable_hls;
-        rowRet["record_mp4"] = record_mp4;
-        rowRet["rtsp_transport"] = rtsp_transport;
-        rowRet["on_demand"] = on_demand;
-        rowRet["active"] = active;
-        break;
-    }
-
-    return rowRet;
+    return ChannelCatalog::Instance().findByProxyKey(proxyKey);
 }
 
 
 Json::Value searchChannel(int channelId) {
-    sqlite3pp::database db(dbpath.data());
-
-    std::string query =
-            "SELECT ID, PROXY_KEY, NAME, VHOST, APP, STREAM, SOURCE_URL, FFMPEG_CMD, ENABLE_HLS, RECORD_MP4, RTSP_TRANSPORT, ON_DEMAND, ACTIVE FROM CHANNEL WHERE ID=:channelId";
-    sqlite3pp::query qry(db, query.c_str());
-    qry.bind(":channelId", channelId);
-
-
-    Json::Value rowRet;
-
-    for (sqlite3pp::query::iterator i = qry.begin(); i != qry.end(); ++i) {
-        int id, enable_hls, record_mp4, rtsp_transport, on_demand, active;
-        std::string proxyKey, name, vhost, app, stream, source_url, ffmpeg_cmd;
-
-        std::tie(id, proxyKey, name, vhost, app, stream, source_url, ffmpeg_cmd, enable_hls, record_mp4, rtsp_transport,
-                 on_demand, active) =
-                (*i).get_columns <
-                int, char const*, char const*, char const*, char const*, char const*, char const*, char const*, int, int, int, int,
-                int > (0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12);
-        //(*i).getter() >> sqlite3pp::ignore >> id >> name >>  vhost >> app >> stream >> source_url >> ffmpeg_cmd >>enable_hls >> record_mp4 >> rtsp_transport >> on_demand >> active;
-
-        rowRet["id"] = id;
-        rowRet["proxyKey"] = proxyKey;
-        rowRet["vhost"] = vhost;
-        rowRet["name"] = name;
-        rowRet["app"] = app;
-        rowRet["stream"] = stream;
-        rowRet["source_url"] = source_url;
-        rowRet["ffmpeg_cmd"] = ffmpeg_cmd;
-        rowRet["enable_hls"] = enable_hls;
-        rowRet["record_mp4"] = record_mp4;
-        rowRet["rtsp_transport"] = rtsp_transport;
-        rowRet["on_demand"] = on_demand;
-        rowRet["active"] = active;
-        break;
-    }
-
-    return rowRet;
+    return ChannelCatalog::Instance().findById(channelId);
 }
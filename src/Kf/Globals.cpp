@@ -9,7 +9,6 @@
 #include "Util/File.h"
 #include <vector>
 #include <dirent.h>
-#include <regex>
 
 string getProxyKey(const string &vhost, const string &app, const string &stream) {
     return vhost + "/" + app + "/" + stream;
@@ -52,28 +51,6 @@ vector<string> forEachFile(const std::string &dir_name, file_filter_type filter,
     return v;
 }
 
-/**
- * 清除无效的录像文件
- *  如:  .14-33-01.mp4 这种前面有个.的文件名格式的录像会被清除
- * @param recordFilePath
- */
-void clearInvalidRecord(const string &recordFilePath) {
-    forEachFile(recordFilePath,
-            // filter函数，lambda表达式
-                [&](const char *path, const char *name, const char *fullpath) {
-                    //判断时临时录像文件
-                    if (std::regex_match(name, std::regex("\\.\\d{2}-\\d{2}-\\d{2}\\.mp4"))) {
-                        File::delete_file(fullpath);
-                        InfoL << "清理无效的临时录像文件成功:" << fullpath;
-                    }
-                    //因为文件已经已经在lambda表达式中处理了，
-                    //不需要for_each_file返回文件列表，所以这里返回false
-                    return false;
-                }, true//递归子目录
-    );
-}
-
-
 int getNumberOfDays(int year, int month) {
     //leap year condition, if month is 2
     if (month == 2) {
@@ -16,9 +16,6 @@ extern string getProxyKey(const string &vhost,const string &app,const string &st
 //遍历文件夹
 extern vector<string> forEachFile(const string &dir_name, function<bool(const char *, const char *,const char*)> filter, bool sub);
 
-//清除无效的录像文件
-extern void clearInvalidRecord(const string &recordFilePath);
-
 //获取指定月份的天数
 extern int getNumberOfDays(int year, int month);
 
@@ -50,13 +50,19 @@ void HlsMaker::makeIndexFile(bool eof) {
             maxSegmentDuration = dur;
         }
     }
+    //_file_index为已创建的切片个数，其中最后一个尚未完成
     PRINT("#EXTM3U\n"
           "#EXT-X-VERSION:3\n"
           "#EXT-X-ALLOW-CACHE:NO\n"
           "#EXT-X-TARGETDURATION:%u\n"
           "#EXT-X-MEDIA-SEQUENCE:%llu\n",
           (maxSegmentDuration + 999) / 1000,
-          _file_index);
+          (unsigned long long) (_file_index - 1 - _seg_dur_list.size()));
+
+    if (_has_video) {
+        //每个切片都以关键帧开始，播放器可以直接从最新切片开始播放
+        PRINT("#EXT-X-INDEPENDENT-SEGMENTS\n");
+    }
 
     for (auto &tp : _seg_dur_list) {
         PRINT("#EXTINF:%.3f,\n%s\n", std::get<0>(tp) / 1000.0, std::get<1>(tp).data());
@@ -69,11 +75,111 @@ void HlsMaker::makeIndexFile(bool eof) {
 }
 
 
-void HlsMaker::inputData(void *data, uint32_t len, uint32_t timestamp) {
-    addNewFile(timestamp);
+void HlsMaker::makeDvrIndexFile() {
+    //时移索引可能包含上千个切片，不使用固定大小的缓存
+    int maxSegmentDuration = 0;
+    for (auto &tp : _dvr_dur_list) {
+        maxSegmentDuration = MAX(maxSegmentDuration, std::get<0>(tp));
+    }
+    //切片会从头部移除，所以不能使用EXT-X-PLAYLIST-TYPE:EVENT，
+    //播放器把整个滑动窗口作为可seek范围
+    _StrPrinter printer;
+    printer << "#EXTM3U\n"
+            << "#EXT-X-VERSION:3\n"
+            << "#EXT-X-ALLOW-CACHE:NO\n"
+            << "#EXT-X-TARGETDURATION:" << (maxSegmentDuration + 999) / 1000 << "\n"
+            << "#EXT-X-MEDIA-SEQUENCE:" << _dvr_first_index << "\n";
+    if (_has_video) {
+        printer << "#EXT-X-INDEPENDENT-SEGMENTS\n";
+    }
+    char extinf[32];
+    for (auto &tp : _dvr_dur_list) {
+        snprintf(extinf, sizeof(extinf), "#EXTINF:%.3f,\n", std::get<0>(tp) / 1000.0);
+        printer << extinf << std::get<1>(tp) << "\n";
+    }
+    onWriteDvrHls(printer.data(), printer.size());
+}
+
+void HlsMaker::setDvrDuration(uint32_t dvr_sec) {
+    _dvr_ms = dvr_sec * 1000;
+}
+
+void HlsMaker::setPartCache(const HlsPartCache::Ptr &cache) {
+    _part_cache = cache;
+}
+
+void HlsMaker::setHasVideo(bool has_video) {
+    _has_video = has_video;
+}
+
+void HlsMaker::inputData(void *data, uint32_t len, uint32_t timestamp, bool frame_start, bool key_frame) {
+    //只在帧边界处切分part与切片
+    if (frame_start) {
+        onFrameStart(timestamp, key_frame);
+    }
+    if (!_frame_started) {
+        //还未收到第一个关键帧
+        return;
+    }
+    if (_part_cache) {
+        _part_data.append((char *) data, len);
+    }
     onWriteFile((char *) data, len);
 }
 
+void HlsMaker::onFrameStart(uint32_t timestamp, bool key_frame) {
+    //有视频时切片只能从关键帧开始
+    bool can_cut = key_frame || !_has_video;
+    if (!_frame_started) {
+        if (!can_cut) {
+            //第一个切片从关键帧开始，之前的数据无法解码，直接丢弃
+            return;
+        }
+        _frame_started = true;
+        _seg_stamp = _part_stamp = _max_stamp = timestamp;
+        _part_independent = key_frame;
+        newSegment(0);
+        return;
+    }
+    if (timestamp + 10 * 1000 < _max_stamp) {
+        //时间戳大幅回退(例如推流端重启)，重新计时
+        _seg_stamp = _part_stamp = _max_stamp = timestamp;
+    }
+    //音视频交织时时间戳会小幅回退，按最大时间戳计算时长
+    uint32_t stamp_inc = timestamp > _max_stamp ? timestamp - _max_stamp : 0;
+    _max_stamp = MAX(_max_stamp, timestamp);
+    uint32_t seg_dur = _max_stamp - _seg_stamp;
+    uint32_t part_dur = _max_stamp - _part_stamp;
+    if (can_cut && seg_dur >= _seg_duration * 1000) {
+        //按dts计算的切片时长已达到要求，并且当前为关键帧，开始新切片
+        if (_part_cache) {
+            //切片结束，最后一个part随之结束
+            flushPart(part_dur);
+            _part_cache->inputSegment(_file_index - 1, seg_dur, _last_file_name);
+            _part_index = 0;
+        }
+        _seg_stamp = _part_stamp = _max_stamp;
+        newSegment(seg_dur);
+    } else if (_part_cache && part_dur + stamp_inc > _part_cache->partDuration()) {
+        //part时长不能超过PART-TARGET，预计再加一帧将超出时提前切分
+        flushPart(part_dur);
+        _part_stamp = _max_stamp;
+    }
+    if (key_frame) {
+        _part_independent = true;
+    }
+}
+
+void HlsMaker::flushPart(uint32_t duration) {
+    if (_part_data.empty()) {
+        return;
+    }
+    auto data = std::make_shared<BufferString>(std::move(_part_data));
+    _part_data.clear();
+    _part_cache->inputPart(_file_index - 1, _part_index++, data, duration, _part_independent);
+    _part_independent = false;
+}
+
 void HlsMaker::delOldFile() {
     //在hls m3u8索引文件中,我们保存的切片个数跟_seg_number相关设置一致
     if (_file_index >= _seg_number + 2) {
@@ -81,23 +187,38 @@ void HlsMaker::delOldFile() {
     }
 
     //但是实际保存的切片个数比m3u8所述多两个,这样做的目的是防止播放器在切片删除前能下载完毕
-    if (_file_index >= _seg_number + 4) {
-        onDelFile(_file_index - _seg_number - 4);
+    if (_file_index < _seg_number + 4) {
+        return;
+    }
+    uint64_t del_end = _file_index - _seg_number - 3;
+    if (_dvr_ms) {
+        //开启直播时移时，切片同时移出时移索引(并多保留两个)后才删除
+        del_end = MIN(del_end, _dvr_first_index >= 2 ? _dvr_first_index - 2 : 0);
+    }
+    while (_del_index < del_end) {
+        onDelFile(_del_index++);
     }
 }
 
-void HlsMaker::addNewFile(uint32_t) {
-    int stampInc = _ticker.elapsedTime();
-    if (stampInc >= _seg_duration * 1000) {
-        _ticker.resetTime();
-        auto file_name = onOpenFile(_file_index);
-        if (_file_index++ > 0) {
-            _seg_dur_list.push_back(std::make_tuple(stampInc, _last_file_name));
-            delOldFile();
-            makeIndexFile();
+void HlsMaker::newSegment(int duration) {
+    auto file_name = onOpenFile(_file_index);
+    if (_file_index++ > 0) {
+        _seg_dur_list.push_back(std::make_tuple(duration, _last_file_name));
+        if (_dvr_ms) {
+            _dvr_dur_list.push_back(std::make_tuple(duration, _last_file_name));
+            _dvr_total_ms += duration;
+            //时移索引至少保留与普通索引相同个数的切片
+            while (_dvr_dur_list.size() > _seg_number && _dvr_total_ms - std::get<0>(_dvr_dur_list.front()) >= _dvr_ms) {
+                _dvr_total_ms -= std::get<0>(_dvr_dur_list.front());
+                _dvr_dur_list.pop_front();
+                ++_dvr_first_index;
+            }
+            makeDvrIndexFile();
         }
-        _last_file_name = file_name;
+        delOldFile();
+        makeIndexFile();
     }
+    _last_file_name = file_name;
 }
 
 }//namespace mediakit
\ No newline at end of file
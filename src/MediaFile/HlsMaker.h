@@ -34,6 +34,7 @@
 #include "Util/File.h"
 #include "Util/util.h"
 #include "Util/logger.h"
+#include "HlsPartCache.h"
 using namespace toolkit;
 
 namespace mediakit {
@@ -47,13 +48,34 @@ public:
     HlsMaker(float seg_duration = 5, uint32_t seg_number = 3);
     virtual ~HlsMaker();
 
+    /**
+     * 开启低延时hls，切片在帧边界处再切分为part写入内存缓存
+     * @param cache part缓存
+     */
+    void setPartCache(const HlsPartCache::Ptr &cache);
+
+    /**
+     * 设置是否有视频，有视频时切片只在关键帧处切分
+     * @param has_video 是否有视频
+     */
+    void setHasVideo(bool has_video);
+
+    /**
+     * 开启直播时移，额外生成一个包含最近dvr_sec秒切片的索引文件，
+     * 切片在移出该索引之前不会被删除
+     * @param dvr_sec 时移窗口时长,单位秒
+     */
+    void setDvrDuration(uint32_t dvr_sec);
+
     /**
      * 写入ts数据
      * @param data 数据
      * @param len 数据长度
-     * @param timestamp 毫秒时间戳
+     * @param timestamp 所属帧的dts，单位毫秒
+     * @param frame_start 该数据是否为一帧的开始
+     * @param key_frame 该数据是否属于关键帧
      */
-    void inputData(void *data, uint32_t len, uint32_t timestamp);
+    void inputData(void *data, uint32_t len, uint32_t timestamp, bool frame_start, bool key_frame);
 protected:
     /**
      * 创建ts切片文件回调
@@ -81,17 +103,44 @@ protected:
      * @param len
      */
     virtual void onWriteHls(const char *data, int len) = 0;
+
+    /**
+     * 写直播时移m3u8文件回调
+     * @param data
+     * @param len
+     */
+    virtual void onWriteDvrHls(const char *data, int len) {}
 private:
     void delOldFile();
-    void addNewFile(uint32_t timestamp);
+    void newSegment(int duration);
     void makeIndexFile(bool eof = false);
+    void makeDvrIndexFile();
+    void onFrameStart(uint32_t timestamp, bool key_frame);
+    void flushPart(uint32_t duration);
 private:
     float _seg_duration = 0;
     uint32_t _seg_number = 0;
     uint64_t _file_index = 0;
-    Ticker _ticker;
     string _last_file_name;
     std::deque<tuple<int,string> > _seg_dur_list;
+    //直播时移相关
+    uint32_t _dvr_ms = 0;
+    uint32_t _dvr_total_ms = 0;
+    //时移索引中第一个切片的序号
+    uint64_t _dvr_first_index = 0;
+    //下一个待删除切片的序号
+    uint64_t _del_index = 0;
+    std::deque<tuple<int,string> > _dvr_dur_list;
+    //低延时hls相关
+    HlsPartCache::Ptr _part_cache;
+    string _part_data;
+    uint32_t _part_index = 0;
+    bool _part_independent = false;
+    bool _has_video = false;
+    bool _frame_started = false;
+    uint32_t _seg_stamp = 0;
+    uint32_t _part_stamp = 0;
+    uint32_t _max_stamp = 0;
 };
 
 }//namespace mediakit
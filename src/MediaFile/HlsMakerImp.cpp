@@ -38,6 +38,8 @@ HlsMakerImp::HlsMakerImp(const string &m3u8_file,
                          uint32_t seg_number) : HlsMaker(seg_duration, seg_number) {
     _path_prefix = m3u8_file.substr(0, m3u8_file.rfind('/'));
     _path_hls = m3u8_file;
+    //直播时移索引与hls.m3u8位于同一目录，例如hls_dvr.m3u8
+    _path_dvr_hls = m3u8_file.substr(0, m3u8_file.rfind('.')) + "_dvr.m3u8";
     _params = params;
     _buf_size = bufSize;
     _file_buf.reset(new char[bufSize],[](char *ptr){
@@ -85,6 +87,16 @@ void HlsMakerImp::onWriteHls(const char *data, int len) {
     //DebugL << "\r\n"  << string(data,len);
 }
 
+void HlsMakerImp::onWriteDvrHls(const char *data, int len) {
+    auto hls = makeFile(_path_dvr_hls);
+    if(hls){
+        fwrite(data,len,1,hls.get());
+        hls.reset();
+    } else{
+        WarnL << "create dvr hls file falied," << _path_dvr_hls << " " <<  get_uv_errmsg();
+    }
+}
+
 string HlsMakerImp::fullPath(int index) {
     return StrPrinter << _path_prefix << "/" << index << ".ts";
 }
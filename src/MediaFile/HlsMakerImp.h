@@ -48,6 +48,7 @@ protected:
     void onDelFile(int index) override;
     void onWriteFile(const char *data, int len) override;
     void onWriteHls(const char *data, int len) override;
+    void onWriteDvrHls(const char *data, int len) override;
 private:
     string fullPath(int index);
     std::shared_ptr<FILE> makeFile(const string &file,bool setbuf = false);
@@ -56,6 +57,7 @@ private:
     std::shared_ptr<char> _file_buf;
     string _path_prefix;
     string _path_hls;
+    string _path_dvr_hls;
     string _params;
     int _buf_size;
 };
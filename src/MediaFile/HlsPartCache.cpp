@@ -0,0 +1,299 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include "HlsPartCache.h"
+#include "Common/config.h"
+#include "Util/mini.h"
+#include "Util/util.h"
+#include "Util/logger.h"
+
+namespace mediakit {
+
+//已完成的切片中，保留part的切片个数
+static const uint32_t kPartSegmentCount = 2;
+
+unordered_map<string, std::weak_ptr<HlsPartCache> > HlsPartCache::s_caches;
+mutex HlsPartCache::s_mtx;
+
+string HlsPartCache::makeKey(const string &vhost, const string &app, const string &stream) {
+    GET_CONFIG(bool,enableVhost,General::kEnableVhost);
+    return (enableVhost ? vhost : string(DEFAULT_VHOST)) + "/" + app + "/" + stream;
+}
+
+HlsPartCache::Ptr HlsPartCache::create(const string &vhost, const string &app, const string &stream, const string &params,
+                                       float seg_duration, float part_duration, uint32_t seg_number) {
+    Ptr ret(new HlsPartCache(params, seg_duration, part_duration, seg_number));
+    lock_guard<mutex> lck(s_mtx);
+    s_caches[makeKey(vhost, app, stream)] = ret;
+    //顺带清理一个已失效的缓存，防止map膨胀
+    for (auto it = s_caches.begin(); it != s_caches.end(); ++it) {
+        if (it->second.expired()) {
+            s_caches.erase(it);
+            break;
+        }
+    }
+    return ret;
+}
+
+HlsPartCache::Ptr HlsPartCache::find(const string &vhost, const string &app, const string &stream) {
+    lock_guard<mutex> lck(s_mtx);
+    auto it = s_caches.find(makeKey(vhost, app, stream));
+    if (it == s_caches.end()) {
+        return nullptr;
+    }
+    return it->second.lock();
+}
+
+HlsPartCache::HlsPartCache(const string &params, float seg_duration, float part_duration, uint32_t seg_number) {
+    _params = params;
+    _seg_duration = MAX(1, seg_duration) * 1000;
+    //part时长限制在[100ms, 切片时长]之间
+    _part_duration = MIN(MAX(0.1, part_duration) * 1000, _seg_duration);
+    _seg_number = MAX(1, seg_number);
+}
+
+HlsPartCache::~HlsPartCache() {
+    //流已注销，通知所有等待者
+    for (auto &waiter : _waiters) {
+        waiter.cb(404, nullptr);
+    }
+}
+
+uint32_t HlsPartCache::partDuration() const {
+    return _part_duration;
+}
+
+string HlsPartCache::partUri(uint64_t msn, uint32_t part) const {
+    if (_params.empty()) {
+        return StrPrinter << msn << "." << part << ".part.ts";
+    }
+    return StrPrinter << msn << "." << part << ".part.ts" << "?" << _params;
+}
+
+HlsPartCache::Segment &HlsPartCache::currentSegment(uint64_t msn) {
+    if (_segments.empty() || _segments.back().msn != msn) {
+        _segments.emplace_back();
+        _segments.back().msn = msn;
+    }
+    return _segments.back();
+}
+
+void HlsPartCache::inputPart(uint64_t msn, uint32_t part, const Buffer::Ptr &data, uint32_t duration, bool independent) {
+    vector<std::pair<onResult, Buffer::Ptr> > ready;
+    {
+        lock_guard<mutex> lck(_mtx);
+        auto &segment = currentSegment(msn);
+        if (segment.parts.size() != part) {
+            WarnL << "part序号不连续:" << msn << "." << part;
+        }
+        segment.parts.emplace_back(Part{data, duration, independent});
+        makePlaylist();
+        collectReady(ready);
+    }
+    //在锁外回调，防止回调中再次访问本对象
+    for (auto &pr : ready) {
+        pr.first(200, pr.second);
+    }
+}
+
+void HlsPartCache::inputSegment(uint64_t msn, uint32_t duration, const string &uri) {
+    vector<std::pair<onResult, Buffer::Ptr> > ready;
+    {
+        lock_guard<mutex> lck(_mtx);
+        auto &segment = currentSegment(msn);
+        segment.duration = duration;
+        segment.uri = uri;
+        segment.complete = true;
+
+        //m3u8中只保留_seg_number个已完成切片
+        while (_segments.size() > _seg_number) {
+            _segments.pop_front();
+        }
+        //较早切片的part已不在m3u8中，释放其内存
+        for (uint32_t i = 0; i + kPartSegmentCount < _segments.size(); ++i) {
+            _segments[i].parts.clear();
+        }
+        makePlaylist();
+        collectReady(ready);
+    }
+    for (auto &pr : ready) {
+        pr.first(200, pr.second);
+    }
+}
+
+bool HlsPartCache::isPlaylistReady(uint64_t msn, int64_t part) const {
+    if (!_playlist) {
+        return false;
+    }
+    auto &back = _segments.back();
+    if (back.complete) {
+        //最后一个切片已完成
+        return msn <= back.msn;
+    }
+    if (msn < back.msn) {
+        return true;
+    }
+    return msn == back.msn && part >= 0 && part < (int64_t) back.parts.size();
+}
+
+bool HlsPartCache::isAhead(uint64_t msn) const {
+    if (_segments.empty()) {
+        //还未生成任何part
+        return false;
+    }
+    auto &back = _segments.back();
+    auto next_msn = back.complete ? back.msn + 1 : back.msn;
+    //协议规定请求的msn超出最新切片2个以上时回复400
+    return msn > next_msn + 2;
+}
+
+const HlsPartCache::Part *HlsPartCache::findPart(uint64_t msn, uint32_t part) const {
+    for (auto &segment : _segments) {
+        if (segment.msn == msn) {
+            return part < segment.parts.size() ? &segment.parts[part] : nullptr;
+        }
+    }
+    return nullptr;
+}
+
+void HlsPartCache::getPlaylist(int64_t msn, int64_t part, const onResult &cb) {
+    Buffer::Ptr playlist;
+    {
+        lock_guard<mutex> lck(_mtx);
+        if (msn < 0) {
+            //非阻塞请求，还未生成索引时等待第一个part
+            if (_playlist) {
+                playlist = _playlist;
+            } else {
+                _waiters.emplace_back(true, 0, 0, cb);
+                return;
+            }
+        } else if (isPlaylistReady(msn, part)) {
+            playlist = _playlist;
+        } else if (isAhead(msn)) {
+            playlist = nullptr;
+        } else {
+            //阻塞式索引刷新，登记后等待对应part生成
+            _waiters.emplace_back(true, (uint64_t) msn, part, cb);
+            return;
+        }
+    }
+    cb(playlist ? 200 : 400, playlist);
+}
+
+void HlsPartCache::getPart(uint64_t msn, uint32_t part, const onResult &cb) {
+    Buffer::Ptr data;
+    int code = 404;
+    {
+        lock_guard<mutex> lck(_mtx);
+        auto ptr = findPart(msn, part);
+        if (ptr) {
+            data = ptr->data;
+            code = 200;
+        } else if (isAhead(msn)) {
+            code = 400;
+        } else if (_segments.empty() || msn >= _segments.back().msn) {
+            //请求的是尚未生成的part(preload hint)，等待其生成
+            _waiters.emplace_back(false, msn, part, cb);
+            return;
+        }
+    }
+    cb(code, data);
+}
+
+void HlsPartCache::collectReady(vector<std::pair<onResult, Buffer::Ptr> > &ready) {
+    //等待者由HttpSession负责超时回复，这里只清理残留的过期登记
+    auto max_wait = 3 * _seg_duration;
+    for (auto it = _waiters.begin(); it != _waiters.end();) {
+        if (it->playlist) {
+            if (isPlaylistReady(it->msn, it->part)) {
+                ready.emplace_back(it->cb, _playlist);
+                it = _waiters.erase(it);
+                continue;
+            }
+        } else {
+            auto ptr = findPart(it->msn, it->part);
+            if (ptr) {
+                ready.emplace_back(it->cb, ptr->data);
+                it = _waiters.erase(it);
+                continue;
+            }
+        }
+        if (it->ticker.elapsedTime() > max_wait) {
+            it = _waiters.erase(it);
+            continue;
+        }
+        ++it;
+    }
+}
+
+void HlsPartCache::makePlaylist() {
+    uint32_t max_duration = _seg_duration;
+    for (auto &segment : _segments) {
+        max_duration = MAX(max_duration, segment.duration);
+    }
+
+    char line[512];
+    string playlist;
+    playlist.reserve(1024 + _segments.size() * 1024);
+#define PRINT(...) playlist.append(line, MIN((int) sizeof(line) - 1, snprintf(line, sizeof(line), ##__VA_ARGS__)))
+    PRINT("#EXTM3U\n"
+          "#EXT-X-VERSION:6\n"
+          "#EXT-X-TARGETDURATION:%u\n"
+          "#EXT-X-SERVER-CONTROL:CAN-BLOCK-RELOAD=YES,PART-HOLD-BACK=%.3f\n"
+          "#EXT-X-PART-INF:PART-TARGET=%.3f\n"
+          "#EXT-X-MEDIA-SEQUENCE:%llu\n",
+          (max_duration + 999) / 1000,
+          3 * _part_duration / 1000.0,
+          _part_duration / 1000.0,
+          (unsigned long long) _segments.front().msn);
+
+    for (auto &segment : _segments) {
+        for (uint32_t i = 0; i < segment.parts.size(); ++i) {
+            auto &part = segment.parts[i];
+            PRINT("#EXT-X-PART:DURATION=%.3f,URI=\"%s\"%s\n",
+                  part.duration / 1000.0,
+                  partUri(segment.msn, i).data(),
+                  part.independent ? ",INDEPENDENT=YES" : "");
+        }
+        if (segment.complete) {
+            PRINT("#EXTINF:%.3f,\n%s\n", segment.duration / 1000.0, segment.uri.data());
+        }
+    }
+
+    //提示播放器预加载下一个part
+    auto &back = _segments.back();
+    if (back.complete) {
+        PRINT("#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"%s\"\n", partUri(back.msn + 1, 0).data());
+    } else {
+        PRINT("#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"%s\"\n", partUri(back.msn, back.parts.size()).data());
+    }
+#undef PRINT
+    _playlist = std::make_shared<BufferString>(std::move(playlist));
+}
+
+}//namespace mediakit
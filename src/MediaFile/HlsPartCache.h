@@ -0,0 +1,170 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef HLSPARTCACHE_H
+#define HLSPARTCACHE_H
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include "Network/Buffer.h"
+#include "Util/TimeTicker.h"
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+/**
+ * 低延时hls(LL-HLS)内存缓存
+ * 保存最近几个切片的partial segment以及对应的m3u8索引，由HttpSession直接从内存回复；
+ * 支持_HLS_msn/_HLS_part阻塞式索引刷新以及preload hint预加载：
+ * 请求的数据尚未生成时只登记回调，待对应part生成后在写入线程中回调，不占用任何线程
+ */
+class HlsPartCache {
+public:
+    typedef std::shared_ptr<HlsPartCache> Ptr;
+
+    /**
+     * 请求结果回调
+     * @param code http状态码，200:成功，400:请求的msn/part超出范围，404:数据不存在或流已结束
+     * @param data 成功时为m3u8索引或part数据
+     */
+    typedef std::function<void(int code, const Buffer::Ptr &data)> onResult;
+
+    /**
+     * 创建并登记某个流的缓存，同名旧缓存被替换
+     * @param params 切片url后附带的参数
+     * @param seg_duration 切片时长，单位秒
+     * @param part_duration part时长，单位秒
+     * @param seg_number m3u8中的切片个数
+     */
+    static Ptr create(const string &vhost, const string &app, const string &stream, const string &params,
+                      float seg_duration, float part_duration, uint32_t seg_number);
+
+    /**
+     * 查找某个流的缓存，未开启低延时hls或流不存在时返回null
+     */
+    static Ptr find(const string &vhost, const string &app, const string &stream);
+
+    ~HlsPartCache();
+
+    /**
+     * part时长，单位毫秒
+     */
+    uint32_t partDuration() const;
+
+    /**
+     * 写入一个part，由切片线程调用
+     * @param msn 所属切片序号
+     * @param part 在切片中的序号，从0开始
+     * @param data part数据
+     * @param duration part时长，单位毫秒
+     * @param independent part是否包含关键帧
+     */
+    void inputPart(uint64_t msn, uint32_t part, const Buffer::Ptr &data, uint32_t duration, bool independent);
+
+    /**
+     * 切片生成完毕，由切片线程调用
+     * @param msn 切片序号
+     * @param duration 切片时长，单位毫秒
+     * @param uri 切片url
+     */
+    void inputSegment(uint64_t msn, uint32_t duration, const string &uri);
+
+    /**
+     * 获取m3u8索引，_HLS_msn/_HLS_part指定的part尚未生成时阻塞等待
+     * @param msn _HLS_msn参数，小于0时立即返回
+     * @param part _HLS_part参数，小于0时等待整个切片
+     * @param cb 结果回调，可能在调用线程或切片线程中触发
+     */
+    void getPlaylist(int64_t msn, int64_t part, const onResult &cb);
+
+    /**
+     * 获取part数据，请求的是下一个即将生成的part(preload hint)时阻塞等待
+     */
+    void getPart(uint64_t msn, uint32_t part, const onResult &cb);
+
+private:
+    HlsPartCache(const string &params, float seg_duration, float part_duration, uint32_t seg_number);
+
+    class Part {
+    public:
+        Buffer::Ptr data;
+        uint32_t duration;
+        bool independent;
+    };
+
+    class Segment {
+    public:
+        uint64_t msn;
+        uint32_t duration = 0;
+        bool complete = false;
+        string uri;
+        vector<Part> parts;
+    };
+
+    class Waiter {
+    public:
+        Waiter(bool playlist_in, uint64_t msn_in, int64_t part_in, const onResult &cb_in)
+                : playlist(playlist_in), msn(msn_in), part(part_in), cb(cb_in) {}
+        //等待的是m3u8还是part
+        bool playlist;
+        uint64_t msn;
+        int64_t part;
+        onResult cb;
+        Ticker ticker;
+    };
+
+    static string makeKey(const string &vhost, const string &app, const string &stream);
+    string partUri(uint64_t msn, uint32_t part) const;
+    Segment &currentSegment(uint64_t msn);
+    //以下函数调用者需持有锁
+    bool isPlaylistReady(uint64_t msn, int64_t part) const;
+    bool isAhead(uint64_t msn) const;
+    const Part *findPart(uint64_t msn, uint32_t part) const;
+    void makePlaylist();
+    void collectReady(vector<std::pair<onResult, Buffer::Ptr> > &ready);
+
+private:
+    string _params;
+    uint32_t _seg_duration;
+    uint32_t _part_duration;
+    uint32_t _seg_number;
+    mutex _mtx;
+    std::deque<Segment> _segments;
+    std::vector<Waiter> _waiters;
+    Buffer::Ptr _playlist;
+
+    static unordered_map<string, std::weak_ptr<HlsPartCache> > s_caches;
+    static mutex s_mtx;
+};
+
+}//namespace mediakit
+#endif //HLSPARTCACHE_H
@@ -37,9 +37,17 @@ public:
     template<typename ...ArgsType>
     HlsRecorder(ArgsType &&...args):HlsMakerImp(std::forward<ArgsType>(args)...){}
     ~HlsRecorder(){};
+
+    void addTrack(const Track::Ptr &track) {
+        if (track->getTrackType() == TrackVideo) {
+            //有视频时切片对齐关键帧
+            setHasVideo(true);
+        }
+        TsMuxer::addTrack(track);
+    }
 protected:
     void onTs(const void *packet, int bytes,uint32_t timestamp,int flags) override {
-        inputData((char *)packet,bytes,timestamp);
+        inputData((char *)packet,bytes,timestamp,flags & kFlagFrameStart,flags & kFlagKeyFrame);
     };
 };
 
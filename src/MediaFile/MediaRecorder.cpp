@@ -46,6 +46,8 @@ MediaRecorder::MediaRecorder(const string &strVhost_tmp,
     GET_CONFIG(uint32_t,hlsBufSize,Hls::kFileBufSize);
     GET_CONFIG(uint32_t,hlsDuration,Hls::kSegmentDuration);
     GET_CONFIG(uint32_t,hlsNum,Hls::kSegmentNum);
+    GET_CONFIG(bool,hlsLowLatency,Hls::kLowLatency);
+    GET_CONFIG(float,hlsPartDuration,Hls::kPartDuration);
     GET_CONFIG(bool,enableVhost,General::kEnableVhost);
 
     string strVhost = strVhost_tmp;
@@ -57,12 +59,22 @@ MediaRecorder::MediaRecorder(const string &strVhost_tmp,
 #if defined(ENABLE_HLS)
     if(enableHls) {
         string m3u8FilePath;
+        string params;
         if(enableVhost){
             m3u8FilePath = hlsPath + "/" + strVhost + "/" + strApp + "/" + strId + "/hls.m3u8";
-            _hlsMaker.reset(new HlsRecorder(m3u8FilePath,string(VHOST_KEY) + "=" + strVhost ,hlsBufSize, hlsDuration, hlsNum));
+            params = string(VHOST_KEY) + "=" + strVhost;
         }else{
             m3u8FilePath = hlsPath + "/" + strApp + "/" + strId + "/hls.m3u8";
-            _hlsMaker.reset(new HlsRecorder(m3u8FilePath,"",hlsBufSize, hlsDuration, hlsNum));
+        }
+        _hlsMaker.reset(new HlsRecorder(m3u8FilePath,params,hlsBufSize, hlsDuration, hlsNum));
+        if(hlsLowLatency){
+            //低延时hls的索引与part由HttpSession直接从内存回复
+            _hlsMaker->setPartCache(HlsPartCache::create(strVhost,strApp,strId,params,hlsDuration,hlsPartDuration,hlsNum));
+        }
+        GET_CONFIG(uint32_t,timeShiftSec,TimeShift::kMaxSec);
+        if(timeShiftSec){
+            //hls.m3u8?dvr=1 获取直播时移索引
+            _hlsMaker->setDvrDuration(timeShiftSec);
         }
     }
 #endif //defined(ENABLE_HLS)
@@ -30,6 +30,8 @@
 #include "Common/config.h"
 #include "Mp4Maker.h"
 #include "MediaRecorder.h"
+#include "RecordRetention.h"
+#include "RecordJournal.h"
 #include "Util/File.h"
 #include "Util/mini.h"
 #include "Util/util.h"
@@ -38,8 +40,6 @@
 #include "Extension/AAC.h"
 #include "Thread/WorkThreadPool.h"
 #include <stdio.h>
-#include <dirent.h>
-#include <regex>
 #include "jsoncpp/json.h"
 #include <vector>
 
@@ -108,6 +108,7 @@ Mp4Maker::Mp4Maker(const string& strPath,
 	DebugL << strPath;
 	_strPath = strPath;
 	_recordMp4 = recordMp4;
+	RecordRetention::Instance().addStream(strPath, recordMp4);
 
 	/////record 业务逻辑//////
 	_info.strAppName = strApp;
@@ -118,6 +119,7 @@ Mp4Maker::Mp4Maker(const string& strPath,
 }
 Mp4Maker::~Mp4Maker() {
 	closeFile();
+	RecordRetention::Instance().removeStream(_strPath);
 }
 
 void Mp4Maker::inputH264(void *pData, uint32_t ui32Length, uint32_t ui32TimeStamp){
@@ -169,7 +171,12 @@ void Mp4Maker::inputH264_l(void *pData, uint32_t ui32Length, uint32_t ui32Durati
 		createFile();
 	}
 	if (_hVideo != MP4_INVALID_TRACK_ID) {
-		MP4WriteSample(_hMp4, _hVideo, (uint8_t *) pData, ui32Length,ui32Duration * 90,0,iType == 5);
+		//时长至少为1，保证每个sample单独成chunk并按写入顺序落盘
+		uint32_t duration = MAX(1, ui32Duration * 90);
+		MP4WriteSample(_hMp4, _hVideo, (uint8_t *) pData, ui32Length,duration,0,iType == 5);
+		if (_journal) {
+			_journal->writeSample(true, ui32Length, duration, iType == 5);
+		}
 	}
 }
 
@@ -183,8 +190,11 @@ void Mp4Maker::inputAAC_l(void *pData, uint32_t ui32Length, uint32_t ui32Duratio
 		createFile();
 	}
 	if (_hAudio != MP4_INVALID_TRACK_ID) {
-		auto duration = ui32Duration * _audioSampleRate /1000.0;
+		uint32_t duration = MAX(1, ui32Duration * _audioSampleRate / 1000);
 		MP4WriteSample(_hMp4, _hAudio, (uint8_t*)pData, ui32Length,duration,0,false);
+		if (_journal) {
+			_journal->writeSample(false, ui32Length, duration, false);
+		}
 	}
 }
 
@@ -226,6 +236,7 @@ void Mp4Maker::createFile() {
 	_strFileTmp = strFileTmp;
 	_strFile = strFile;
 	_ticker.resetTime();
+	_journal = std::make_shared<RecordJournal>(strFileTmp, _info, _strPath);
 
 	auto videoTrack = dynamic_pointer_cast<H264Track>(getTrack(TrackVideo));
 	if(videoTrack){
@@ -243,6 +254,9 @@ void Mp4Maker::createFile() {
 		if(_hVideo != MP4_INVALID_TRACK_ID){
 			MP4AddH264SequenceParameterSet(_hMp4, _hVideo, (uint8_t *)sps.data(), sps.size());
 			MP4AddH264PictureParameterSet(_hMp4, _hVideo, (uint8_t *)pps.data(), pps.size());
+			//每个sample单独成chunk，异常退出后可按录像日志从mdat中顺序恢复sample
+			MP4SetTrackDurationPerChunk(_hMp4, _hVideo, 1);
+			_journal->setVideo(sps, pps, videoTrack->getVideoWidth(), videoTrack->getVideoHeight());
 		}else{
 			WarnL << "添加视频通道失败:" << strFileTmp;
 		}
@@ -255,10 +269,13 @@ void Mp4Maker::createFile() {
 		if (_hAudio != MP4_INVALID_TRACK_ID) {
 			auto &cfg =  audioTrack->getAacCfg();
 			MP4SetTrackESConfiguration(_hMp4, _hAudio,(uint8_t *)cfg.data(), cfg.size());
+			MP4SetTrackDurationPerChunk(_hMp4, _hAudio, 1);
+			_journal->setAudio(cfg, _audioSampleRate);
 		}else{
 			WarnL << "添加音频通道失败:" << strFileTmp;
 		}
 	}
+	_journal->start();
 }
 
 void Mp4Maker::asyncClose() {
@@ -266,10 +283,10 @@ void Mp4Maker::asyncClose() {
 	auto strFileTmp = _strFileTmp;
 	auto strFile = _strFile;
     auto info = _info;
-    //chenxiaolei 支持删除过期录像
     auto strPath = _strPath;
-    auto recordMp4 = _recordMp4;
-	WorkThreadPool::Instance().getExecutor()->async([hMp4,strFileTmp,strFile,strPath,recordMp4,info]() {
+    auto journal = _journal;
+    _journal.reset();
+	WorkThreadPool::Instance().getExecutor()->async([hMp4,strFileTmp,strFile,strPath,info,journal]() {
 		//获取文件录制时间，放在MP4Close之前是为了忽略MP4Close执行时间
         InfoL << "获取文件录制时间";
 		const_cast<Mp4Info&>(info).ui64TimeLen = ::time(NULL) - info.ui64StartedTime;
@@ -280,68 +297,41 @@ void Mp4Maker::asyncClose() {
         InfoL << "临时文件名改成正式文件名，防止mp4未完成时被访问: rename " << strFileTmp.data() << ">" << strFile.data();
 		//临时文件名改成正式文件名，防止mp4未完成时被访问
 		rename(strFileTmp.data(),strFile.data());
-
-        InfoL << "删除过期录像";
-		//chenxiaolei 删除过期录像
-        if(recordMp4){
-            auto curTimeStr = timeStr("%Y%m%d");
-
-            DIR *dr = opendir(strPath.data());
-            if (dr != NULL)  {
-                std::vector<string> delDirPaths;
-                struct dirent *de;
-                while ((de = readdir(dr)) != NULL){
-                    if(!std::regex_match(de->d_name, std::regex("\\d{4}\\d{2}\\d{2}"))){
-                        continue;
-                    }
-                    auto curTime=string2time(curTimeStr);
-                    auto targetTime=string2time(de->d_name);
-                    double dSec= std::difftime(curTime, targetTime);
-                    double dDay= dSec/60/60/24;
-                    if( dDay >  recordMp4){
-                        /*auto delDirPath= (strPath + (de->d_name)).data();
-                        File::delete_file(delDirPath);*/
-                        auto delDirPath= (strPath + (de->d_name));
-                        delDirPaths.emplace_back(delDirPath);
-
-                        //system(("rm -rf " + delDirPath+"").data());
-                        //WarnL << "删除过期录像文件:"<< (strPath + (de->d_name)).data() ;
-                    }
-                }
-                closedir(dr);
-
-                for (auto val : delDirPaths){
-                    File::delete_file(val.data());
-                    WarnL << "删除过期录像文件:"<< val;
-                }
-            }
-        }
-
-		//获取文件大小
-		struct stat fileData;
-		stat(strFile.data(), &fileData);
-		const_cast<Mp4Info&>(info).ui64FileSize = fileData.st_size;
-
-
-		//chenxiaolei 生成录像文件的信息文件(记录录像时长,开始时间,持续时长等)
-        InfoL << "生成录像文件的信息文件";
-        Json::Value infoJson;
-        infoJson["startAt"] = timeStr2(info.ui64StartedTime,"%Y%m%d%H%M%S");
-        infoJson["duration"] = (int)(info.ui64TimeLen) ;
-        infoJson["mp4"] = info.strUrl;
-
-        auto strInfoFile =	strFile +".json";
-        ofstream os;
-        os.open(strInfoFile);
-        Json::StyledWriter sw;
-        os << sw.write(infoJson);
-        os.close();
-        InfoL << "emitEvent kBroadcastRecordMP4";
-		/////record 业务逻辑//////
-		NoticeCenter::Instance().emitEvent(Broadcast::kBroadcastRecordMP4,info);
+		//录像已完整落盘，不再需要修复
+		if (journal) {
+			journal->finish();
+		}
+		reportRecord(const_cast<Mp4Info&>(info), strPath);
 	});
 }
 
+void Mp4Maker::reportRecord(Mp4Info &info, const string &strPath) {
+	//获取文件大小
+	struct stat fileData;
+	stat(info.strFilePath.data(), &fileData);
+	info.ui64FileSize = fileData.st_size;
+	//过期与超出磁盘水位的录像由RecordRetention统一在后台删除
+	RecordRetention::Instance().onFileClosed(strPath, info.strFilePath, fileData.st_size);
+
+
+	//chenxiaolei 生成录像文件的信息文件(记录录像时长,开始时间,持续时长等)
+    InfoL << "生成录像文件的信息文件";
+    Json::Value infoJson;
+    infoJson["startAt"] = timeStr2(info.ui64StartedTime,"%Y%m%d%H%M%S");
+    infoJson["duration"] = (int)(info.ui64TimeLen) ;
+    infoJson["mp4"] = info.strUrl;
+
+    auto strInfoFile =	info.strFilePath +".json";
+    ofstream os;
+    os.open(strInfoFile);
+    Json::StyledWriter sw;
+    os << sw.write(infoJson);
+    os.close();
+    InfoL << "emitEvent kBroadcastRecordMP4";
+	/////record 业务逻辑//////
+	NoticeCenter::Instance().emitEvent(Broadcast::kBroadcastRecordMP4,info);
+}
+
 void Mp4Maker::closeFile() {
 	if (_hMp4 != MP4_INVALID_FILE_HANDLE) {
 		asyncClose();
@@ -57,6 +57,7 @@ public:
 	string strStreamId;//流ID
 	string strVhost;//vhost
 };
+class RecordJournal;
 class Mp4Maker : public MediaSink{
 public:
 	typedef std::shared_ptr<Mp4Maker> Ptr;
@@ -67,6 +68,13 @@ public:
 			 //chenxiaolei 修改为int, 录像最大录制天数,0就是不录
 			 const int &recordMp4);
 	virtual ~Mp4Maker();
+
+	/**
+	 * 录像文件已生成正式文件，统计大小、生成信息文件并广播录像完成事件
+	 * @param info 录像信息，会写入文件大小
+	 * @param strPath 流录像目录
+	 */
+	static void reportRecord(Mp4Info &info, const string &strPath);
 private:
 	/**
      * 某Track输出frame，在onAllTrackReady触发后才会调用此方法
@@ -99,6 +107,7 @@ private:
 	string _strPath;
 	string _strFile;
 	string _strFileTmp;
+	std::shared_ptr<RecordJournal> _journal;
 	Ticker _ticker;
 
 	string _strLastVideo;
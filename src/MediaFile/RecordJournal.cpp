@@ -0,0 +1,490 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifdef ENABLE_MP4V2
+#include <mutex>
+#include <ctype.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <unordered_set>
+#include "RecordJournal.h"
+#include "Common/config.h"
+#include "Util/MD5.h"
+#include "Util/File.h"
+#include "Util/logger.h"
+#include "Thread/ThreadPool.h"
+
+using namespace toolkit;
+
+namespace mediakit {
+
+#pragma pack(push, 1)
+//日志文件中每个sample的定长记录
+typedef struct {
+    uint8_t video;
+    uint8_t sync;
+    uint8_t reserved[2];
+    uint32_t size;
+    uint32_t duration;
+} SampleRecord;
+#pragma pack(pop)
+
+//本进程正在写入的日志，修复时需要跳过
+static mutex s_mtx;
+static unordered_set<string> s_active;
+//进程启动时间，此后修改的临时文件属于本进程
+static time_t s_startTime = ::time(NULL);
+
+static string toHex(const string &str) {
+    static const char digits[] = "0123456789abcdef";
+    string ret;
+    ret.reserve(str.size() * 2);
+    for (auto ch : str) {
+        ret.push_back(digits[((uint8_t) ch) >> 4]);
+        ret.push_back(digits[((uint8_t) ch) & 0x0F]);
+    }
+    return ret;
+}
+
+static string fromHex(const string &str) {
+    string ret;
+    ret.reserve(str.size() / 2);
+    for (size_t i = 0; i + 1 < str.size(); i += 2) {
+        ret.push_back((char) strtol(str.substr(i, 2).data(), nullptr, 16));
+    }
+    return ret;
+}
+
+static bool readFile(const string &path, string &out) {
+    auto fp = fopen(path.data(), "rb");
+    if (!fp) {
+        return false;
+    }
+    char buf[4096];
+    size_t size;
+    while ((size = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        out.append(buf, size);
+    }
+    fclose(fp);
+    return true;
+}
+
+//查找mdat数据的起始位置，未找到返回-1
+static int64_t findMdatData(FILE *fp, uint64_t fileSize) {
+    uint64_t offset = 0;
+    uint8_t hdr[16];
+    while (offset + 8 <= fileSize) {
+        if (fseek(fp, offset, SEEK_SET) != 0 || fread(hdr, 1, 8, fp) != 8) {
+            return -1;
+        }
+        uint64_t size = (hdr[0] << 24) | (hdr[1] << 16) | (hdr[2] << 8) | hdr[3];
+        uint64_t headerSize = 8;
+        if (size == 1) {
+            //64位长度
+            if (fread(hdr + 8, 1, 8, fp) != 8) {
+                return -1;
+            }
+            size = 0;
+            for (int i = 8; i < 16; ++i) {
+                size = (size << 8) | hdr[i];
+            }
+            headerSize = 16;
+        }
+        if (memcmp(hdr + 4, "mdat", 4) == 0) {
+            //未正常关闭的文件mdat长度可能未回写，数据总是紧跟在头部之后
+            return offset + headerSize;
+        }
+        if (size < headerSize) {
+            return -1;
+        }
+        offset += size;
+    }
+    return -1;
+}
+
+//按日志把临时文件中的sample重新封装为新的mp4，返回是否至少恢复了一个sample
+static bool remux(const Json::Value &header, const SampleRecord *records, size_t count,
+                  const string &src, const string &dst, time_t &timeLen) {
+    struct stat st;
+    if (stat(src.data(), &st) != 0) {
+        return false;
+    }
+    uint64_t fileSize = st.st_size;
+    auto in = fopen(src.data(), "rb");
+    if (!in) {
+        return false;
+    }
+    auto offset = findMdatData(in, fileSize);
+    if (offset < 0 || fseek(in, offset, SEEK_SET) != 0) {
+        fclose(in);
+        return false;
+    }
+    auto hMp4 = MP4Create(dst.data());
+    if (hMp4 == MP4_INVALID_FILE_HANDLE) {
+        fclose(in);
+        return false;
+    }
+
+    MP4TrackId hVideo = MP4_INVALID_TRACK_ID;
+    MP4TrackId hAudio = MP4_INVALID_TRACK_ID;
+    uint32_t sampleRate = 0;
+    auto &video = header["video"];
+    if (video.isObject()) {
+        auto sps = fromHex(video["sps"].asString());
+        auto pps = fromHex(video["pps"].asString());
+        if (sps.size() >= 4) {
+            hVideo = MP4AddH264VideoTrack(hMp4, 90000, MP4_INVALID_DURATION,
+                                          video["width"].asInt(), video["height"].asInt(),
+                                          sps[1], sps[2], sps[3], 3);
+        }
+        if (hVideo != MP4_INVALID_TRACK_ID) {
+            MP4AddH264SequenceParameterSet(hMp4, hVideo, (uint8_t *) sps.data(), sps.size());
+            MP4AddH264PictureParameterSet(hMp4, hVideo, (uint8_t *) pps.data(), pps.size());
+        }
+    }
+    auto &audio = header["audio"];
+    if (audio.isObject()) {
+        sampleRate = audio["sampleRate"].asUInt();
+        hAudio = MP4AddAudioTrack(hMp4, sampleRate, MP4_INVALID_DURATION, MP4_MPEG4_AUDIO_TYPE);
+        if (hAudio != MP4_INVALID_TRACK_ID) {
+            auto cfg = fromHex(audio["cfg"].asString());
+            MP4SetTrackESConfiguration(hMp4, hAudio, (uint8_t *) cfg.data(), cfg.size());
+        }
+    }
+
+    GET_CONFIG(uint32_t, speedMB, Record::kRecoverSpeedMB);
+    uint64_t bytesPerSecond = 1024 * 1024 * (uint64_t) MAX(1, speedMB);
+    uint64_t bytes = 0;
+    uint64_t videoDuration = 0;
+    uint64_t audioDuration = 0;
+    size_t written = 0;
+    string buf;
+    Ticker ticker;
+    for (size_t i = 0; i < count; ++i) {
+        auto &record = records[i];
+        if (offset + record.size > fileSize) {
+            //日志已落盘但sample数据未落盘
+            break;
+        }
+        buf.resize(record.size);
+        if (fread((char *) buf.data(), 1, record.size, in) != record.size) {
+            break;
+        }
+        offset += record.size;
+        auto track = record.video ? hVideo : hAudio;
+        if (track == MP4_INVALID_TRACK_ID) {
+            continue;
+        }
+        if (!MP4WriteSample(hMp4, track, (uint8_t *) buf.data(), record.size, record.duration, 0, record.sync)) {
+            break;
+        }
+        ++written;
+        (record.video ? videoDuration : audioDuration) += record.duration;
+
+        //限制读写速度，避免影响正在录制的写入io
+        bytes += record.size;
+        auto expectMS = bytes * 1000 / bytesPerSecond;
+        auto elapsedMS = ticker.elapsedTime();
+        if (expectMS > elapsedMS) {
+            usleep((expectMS - elapsedMS) * 1000);
+        }
+    }
+    MP4Close(hMp4, MP4_CLOSE_DO_NOT_COMPUTE_BITRATE);
+    fclose(in);
+
+    if (hVideo != MP4_INVALID_TRACK_ID) {
+        timeLen = videoDuration / 90000;
+    } else if (sampleRate) {
+        timeLen = audioDuration / sampleRate;
+    }
+    return written > 0;
+}
+
+RecordJournal::RecordJournal(const string &tmpFile, const Mp4Info &info, const string &strPath) {
+    GET_CONFIG(string, recordPath, Record::kFilePath);
+    _entry = journalDir(recordPath) + MD5(tmpFile).hexdigest() + ".idx";
+    _header["tmp"] = tmpFile;
+    _header["path"] = strPath;
+    _header["startAt"] = (Json::UInt64) info.ui64StartedTime;
+    _header["file"] = info.strFilePath;
+    _header["fileName"] = info.strFileName;
+    _header["folder"] = info.strFolder;
+    _header["url"] = info.strUrl;
+    _header["app"] = info.strAppName;
+    _header["stream"] = info.strStreamId;
+    _header["vhost"] = info.strVhost;
+}
+
+RecordJournal::~RecordJournal() {
+    if (_fp) {
+        fclose(_fp);
+    }
+}
+
+void RecordJournal::setVideo(const string &sps, const string &pps, int width, int height) {
+    auto &video = _header["video"];
+    video["sps"] = toHex(sps);
+    video["pps"] = toHex(pps);
+    video["width"] = width;
+    video["height"] = height;
+}
+
+void RecordJournal::setAudio(const string &cfg, int sampleRate) {
+    auto &audio = _header["audio"];
+    audio["cfg"] = toHex(cfg);
+    audio["sampleRate"] = sampleRate;
+}
+
+bool RecordJournal::start() {
+#if !defined(_WIN32)
+    File::createfile_path(_entry.data(), S_IRWXO | S_IRWXG | S_IRWXU);
+#else
+    File::createfile_path(_entry.data(), 0);
+#endif
+    _fp = fopen(_entry.data(), "wb");
+    if (!_fp) {
+        WarnL << "创建录像日志失败:" << _entry;
+        return false;
+    }
+    {
+        lock_guard<mutex> lck(s_mtx);
+        s_active.emplace(_entry);
+    }
+    //FastWriter输出单行json并以\n结尾
+    Json::FastWriter writer;
+    auto str = writer.write(_header);
+    fwrite(str.data(), 1, str.size(), _fp);
+    fflush(_fp);
+    _flushTicker.resetTime();
+    return true;
+}
+
+void RecordJournal::writeSample(bool video, uint32_t size, uint32_t duration, bool sync) {
+    if (!_fp) {
+        return;
+    }
+    SampleRecord record = {0};
+    record.video = video;
+    record.sync = sync;
+    record.size = size;
+    record.duration = duration;
+    fwrite(&record, sizeof(record), 1, _fp);
+    //每秒落盘一次，异常退出时最多丢失最后一秒的记录
+    if (_flushTicker.elapsedTime() > 1000) {
+        fflush(_fp);
+        _flushTicker.resetTime();
+    }
+}
+
+void RecordJournal::finish() {
+    if (!_fp) {
+        return;
+    }
+    fclose(_fp);
+    _fp = nullptr;
+    File::delete_file(_entry.data());
+    lock_guard<mutex> lck(s_mtx);
+    s_active.erase(_entry);
+}
+
+string RecordJournal::journalDir(const string &recordPath) {
+    return recordPath + "/.journal/";
+}
+
+void RecordJournal::recoverAsync(const string &recordPath) {
+    static auto s_thread = std::make_shared<ThreadPool>(1, ThreadPool::PRIORITY_LOWEST);
+    s_thread->async([recordPath]() {
+        recover(recordPath);
+    });
+}
+
+void RecordJournal::recover(const string &recordPath) {
+    auto dir = journalDir(recordPath);
+    vector<string> entries;
+    auto pDir = opendir(dir.data());
+    if (!pDir) {
+        sweepLegacy(recordPath);
+        return;
+    }
+    struct dirent *pEnt;
+    while ((pEnt = readdir(pDir)) != NULL) {
+        string name = pEnt->d_name;
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".idx") == 0) {
+            entries.emplace_back(dir + name);
+        }
+    }
+    closedir(pDir);
+
+    for (auto &entry : entries) {
+        {
+            lock_guard<mutex> lck(s_mtx);
+            if (s_active.count(entry)) {
+                continue;
+            }
+        }
+        recoverEntry(entry);
+    }
+    sweepLegacy(recordPath);
+}
+
+void RecordJournal::recoverEntry(const string &entryPath) {
+    string content;
+    readFile(entryPath, content);
+    auto pos = content.find('\n');
+    Json::Value header;
+    Json::Reader reader;
+    if (pos == string::npos || !reader.parse(content.substr(0, pos), header)) {
+        WarnL << "录像日志已损坏:" << entryPath;
+        File::delete_file(entryPath.data());
+        return;
+    }
+
+    Mp4Info info;
+    info.ui64StartedTime = (time_t) header["startAt"].asUInt64();
+    info.ui64TimeLen = 0;
+    info.strFilePath = header["file"].asString();
+    info.strFileName = header["fileName"].asString();
+    info.strFolder = header["folder"].asString();
+    info.strUrl = header["url"].asString();
+    info.strAppName = header["app"].asString();
+    info.strStreamId = header["stream"].asString();
+    info.strVhost = header["vhost"].asString();
+    auto strFileTmp = header["tmp"].asString();
+    auto strPath = header["path"].asString();
+
+    struct stat st;
+    if (stat(strFileTmp.data(), &st) != 0) {
+        //临时文件已改名为正式文件，只是日志未删除
+        File::delete_file(entryPath.data());
+        return;
+    }
+
+    //MP4Close已完成但改名前退出，文件本身是完整的
+    auto hRead = MP4Read(strFileTmp.data());
+    if (hRead != MP4_INVALID_FILE_HANDLE) {
+        bool complete = MP4GetNumberOfTracks(hRead) > 0;
+        if (complete) {
+            auto timeScale = MP4GetTimeScale(hRead);
+            info.ui64TimeLen = timeScale ? MP4GetDuration(hRead) / timeScale : 0;
+        }
+        MP4Close(hRead);
+        if (complete) {
+            rename(strFileTmp.data(), info.strFilePath.data());
+            Mp4Maker::reportRecord(info, strPath);
+            File::delete_file(entryPath.data());
+            InfoL << "恢复已完成的临时录像:" << info.strFilePath;
+            return;
+        }
+    }
+
+    auto strFileRepair = strFileTmp + ".repair";
+    auto records = (const SampleRecord *) (content.data() + pos + 1);
+    auto count = (content.size() - pos - 1) / sizeof(SampleRecord);
+    if (remux(header, records, count, strFileTmp, strFileRepair, info.ui64TimeLen)) {
+        rename(strFileRepair.data(), info.strFilePath.data());
+        File::delete_file(strFileTmp.data());
+        Mp4Maker::reportRecord(info, strPath);
+        InfoL << "修复未完成的录像成功:" << info.strFilePath << " 共" << count << "个sample";
+    } else {
+        File::delete_file(strFileRepair.data());
+        File::delete_file(strFileTmp.data());
+        WarnL << "未完成的录像无法修复，已删除:" << strFileTmp;
+    }
+    //修复完成后才删除日志，修复中途退出下次启动会重新修复
+    File::delete_file(entryPath.data());
+}
+
+//.HH-MM-SS.mp4 格式的临时录像文件
+static bool isTmpRecord(const char *name) {
+    static const char pattern[] = ".dd-dd-dd.mp4";
+    if (strlen(name) != sizeof(pattern) - 1) {
+        return false;
+    }
+    for (size_t i = 0; i < sizeof(pattern) - 1; ++i) {
+        if (pattern[i] == 'd' ? !isdigit(name[i]) : pattern[i] != name[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void sweepDir(const string &dir, int &deleteCount) {
+    auto pDir = opendir(dir.data());
+    if (!pDir) {
+        return;
+    }
+    struct dirent *pEnt;
+    while ((pEnt = readdir(pDir)) != NULL) {
+        if (strcmp(pEnt->d_name, ".") == 0 || strcmp(pEnt->d_name, "..") == 0 || strcmp(pEnt->d_name, ".journal") == 0) {
+            continue;
+        }
+        auto path = dir + "/" + pEnt->d_name;
+        if (File::is_dir(path.data())) {
+            sweepDir(path, deleteCount);
+            continue;
+        }
+        struct stat st;
+        if (!isTmpRecord(pEnt->d_name) || stat(path.data(), &st) != 0 || st.st_mtime >= s_startTime) {
+            //本进程正在录制的临时文件不能删除
+            continue;
+        }
+        File::delete_file(path.data());
+        InfoL << "清理无效的临时录像文件成功:" << path;
+        GET_CONFIG(uint32_t, deleteBatch, Record::kDeleteBatch);
+        GET_CONFIG(uint32_t, deleteIntervalMS, Record::kDeleteIntervalMS);
+        if (++deleteCount >= (int) MAX(1, deleteBatch)) {
+            deleteCount = 0;
+            usleep(deleteIntervalMS * 1000);
+        }
+    }
+    closedir(pDir);
+}
+
+void RecordJournal::sweepLegacy(const string &recordPath) {
+    //升级前遗留的临时录像没有日志，无法修复，只能删除；
+    //遍历完成后写入标记文件，以后启动不再遍历整个录像目录
+    auto marker = journalDir(recordPath) + ".swept";
+    if (access(marker.data(), F_OK) == 0) {
+        return;
+    }
+    int deleteCount = 0;
+    sweepDir(recordPath, deleteCount);
+#if !defined(_WIN32)
+    File::createfile_path(marker.data(), S_IRWXO | S_IRWXG | S_IRWXU);
+#else
+    File::createfile_path(marker.data(), 0);
+#endif
+    auto fp = fopen(marker.data(), "wb");
+    if (fp) {
+        fclose(fp);
+    }
+}
+
+} /* namespace mediakit */
+
+#endif ///ENABLE_MP4V2
@@ -0,0 +1,109 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ZLMEDIAKIT_RECORDJOURNAL_H
+#define ZLMEDIAKIT_RECORDJOURNAL_H
+
+#ifdef ENABLE_MP4V2
+
+#include <stdio.h>
+#include <string>
+#include <memory>
+#include "Mp4Maker.h"
+#include "jsoncpp/json.h"
+#include "Util/TimeTicker.h"
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+/**
+ * 录像日志
+ * 每个正在录制的临时mp4文件在 录像根目录/.journal/ 下对应一个日志文件，
+ * 日志文件首行为json格式的录像信息与音视频参数，其后为每个sample的定长记录(track、大小、时长、是否关键帧)。
+ * 录像正常结束后删除日志；进程异常退出后，启动时只需读取日志目录(无需遍历整个录像目录)，
+ * 在低优先级后台线程中按日志把临时文件中已写入的sample重新封装为完整的mp4，
+ * 每个日志在修复完成后才删除，中途退出下次启动会重新修复
+ */
+class RecordJournal {
+public:
+    typedef std::shared_ptr<RecordJournal> Ptr;
+
+    /**
+     * @param tmpFile 临时录像文件
+     * @param info 录像信息
+     * @param strPath 流录像目录
+     */
+    RecordJournal(const string &tmpFile, const Mp4Info &info, const string &strPath);
+    ~RecordJournal();
+
+    void setVideo(const string &sps, const string &pps, int width, int height);
+    void setAudio(const string &cfg, int sampleRate);
+
+    /**
+     * 写入日志文件头，音视频参数设置完毕后调用
+     */
+    bool start();
+
+    /**
+     * 记录一个已写入mp4的sample，必须与MP4WriteSample顺序一致
+     * @param video 是否为视频
+     * @param size sample大小
+     * @param duration sample时长，单位为track的timescale
+     * @param sync 是否为关键帧
+     */
+    void writeSample(bool video, uint32_t size, uint32_t duration, bool sync);
+
+    /**
+     * 录像已正常结束并改名为正式文件，删除日志
+     */
+    void finish();
+
+    /**
+     * 在后台线程修复上次异常退出时未完成的录像，不阻塞调用者
+     * @param recordPath 录像根目录
+     */
+    static void recoverAsync(const string &recordPath);
+
+private:
+    static string journalDir(const string &recordPath);
+    static void recover(const string &recordPath);
+    static void recoverEntry(const string &entryPath);
+    //清理没有日志的临时录像(升级前遗留)，只执行一次
+    static void sweepLegacy(const string &recordPath);
+
+private:
+    FILE *_fp = nullptr;
+    string _entry;
+    Json::Value _header;
+    Ticker _flushTicker;
+};
+
+} /* namespace mediakit */
+
+#endif ///ENABLE_MP4V2
+
+#endif //ZLMEDIAKIT_RECORDJOURNAL_H
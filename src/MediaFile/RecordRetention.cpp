@@ -0,0 +1,452 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <ctime>
+#include <queue>
+#include <stdio.h>
+#include <ctype.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#if !defined(_WIN32)
+#include <sys/statvfs.h>
+#endif //!defined(_WIN32)
+#include "RecordRetention.h"
+#include "Common/config.h"
+#include "Util/File.h"
+#include "Util/logger.h"
+#include "Poller/EventPoller.h"
+
+using namespace toolkit;
+
+namespace mediakit {
+
+//yyyyMMdd格式的日期距今天数，格式错误返回-1
+static int dayAge(const string &day) {
+    struct tm tm_day = {0};
+    if (sscanf(day.data(), "%4d%2d%2d", &tm_day.tm_year, &tm_day.tm_mon, &tm_day.tm_mday) != 3) {
+        return -1;
+    }
+    tm_day.tm_year -= 1900;
+    tm_day.tm_mon -= 1;
+    tm_day.tm_isdst = -1;
+
+    auto now = ::time(NULL);
+    struct tm tm_today;
+#if defined(_WIN32)
+    localtime_s(&tm_today, &now);
+#else
+    localtime_r(&now, &tm_today);
+#endif
+    tm_today.tm_hour = 0;
+    tm_today.tm_min = 0;
+    tm_today.tm_sec = 0;
+    tm_today.tm_isdst = -1;
+    return (int) (std::difftime(mktime(&tm_today), mktime(&tm_day)) / (24 * 60 * 60) + 0.5);
+}
+
+static bool isDayDir(const char *name) {
+    if (strlen(name) != 8) {
+        return false;
+    }
+    for (int i = 0; i < 8; ++i) {
+        if (!isdigit(name[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool isRecordFile(const string &name) {
+    //以.开头的是正在录制的临时文件
+    return name.size() > 4 && name[0] != '.' && name.compare(name.size() - 4, 4, ".mp4") == 0;
+}
+
+//磁盘使用率(百分比)，失败返回-1；total_bytes返回用于计算使用率的总字节数
+static int diskUsage(const string &path, uint64_t *total_bytes = nullptr) {
+#if !defined(_WIN32)
+    struct statvfs st;
+    if (statvfs(path.data(), &st) != 0) {
+        return -1;
+    }
+    //与df命令的计算方式一致
+    uint64_t used = st.f_blocks - st.f_bfree;
+    uint64_t total = used + st.f_bavail;
+    if (!total) {
+        return -1;
+    }
+    if (total_bytes) {
+        *total_bytes = total * st.f_frsize;
+    }
+    return (int) ((used * 100 + total - 1) / total);
+#else
+    return -1;
+#endif //!defined(_WIN32)
+}
+
+RecordRetention &RecordRetention::Instance() {
+    static RecordRetention s_instance;
+    return s_instance;
+}
+
+RecordRetention::RecordRetention() {
+    _thread = std::make_shared<ThreadPool>(1, ThreadPool::PRIORITY_LOWEST);
+    GET_CONFIG(uint32_t, intervalSec, Record::kRetentionSecond);
+    EventPollerPool::Instance().getPoller()->doDelayTask(1000 * MAX(1, intervalSec), []() {
+        auto &self = RecordRetention::Instance();
+        self._thread->async([]() {
+            RecordRetention::Instance().onTick();
+        });
+        GET_CONFIG(uint32_t, intervalSec, Record::kRetentionSecond);
+        return 1000 * MAX(1, intervalSec);
+    });
+}
+
+void RecordRetention::addStream(const string &streamPath, int days) {
+    _thread->async([this, streamPath, days]() {
+        auto it = _streams.find(streamPath);
+        if (it != _streams.end()) {
+            //流重新开始录制，只更新保留天数
+            it->second.days = days;
+            ++it->second.recorders;
+            return;
+        }
+        auto &stream = _streams[streamPath];
+        stream.path = streamPath;
+        stream.days = days;
+        stream.recorders = 1;
+        scanStream(stream);
+    });
+}
+
+void RecordRetention::removeStream(const string &streamPath) {
+    _thread->async([this, streamPath]() {
+        auto it = _streams.find(streamPath);
+        if (it != _streams.end() && it->second.recorders > 0) {
+            --it->second.recorders;
+        }
+    });
+}
+
+void RecordRetention::onFileClosed(const string &streamPath, const string &filePath, uint64_t fileSize) {
+    _thread->async([this, streamPath, filePath, fileSize]() {
+        auto it = _streams.find(streamPath);
+        if (it == _streams.end() || filePath.compare(0, streamPath.size(), streamPath) != 0) {
+            return;
+        }
+        //流目录/yyyyMMdd/HH-mm-ss.mp4
+        auto relative = filePath.substr(streamPath.size());
+        auto pos = relative.find('/');
+        if (pos == string::npos) {
+            return;
+        }
+        auto &stream = it->second;
+        addFile(stream, relative.substr(0, pos), relative.substr(pos + 1), fileSize);
+        checkVolume(stream);
+    });
+}
+
+void RecordRetention::getStatistic(const function<void(const Json::Value &val)> &cb) {
+    _thread->async([this, cb]() {
+        Json::Value val;
+        for (auto &pr : _volumes) {
+            Json::Value obj;
+            obj["path"] = pr.second.path;
+            obj["bytes"] = (Json::UInt64) pr.second.bytes;
+            obj["usage"] = diskUsage(pr.second.path);
+            val["volumes"].append(obj);
+        }
+        for (auto &pr : _streams) {
+            auto &stream = pr.second;
+            uint64_t files = 0;
+            for (auto &day : stream.dayMap) {
+                files += day.second.files.size();
+            }
+            Json::Value obj;
+            obj["path"] = stream.path;
+            obj["days"] = stream.days;
+            obj["bytes"] = (Json::UInt64) stream.bytes;
+            obj["dayCount"] = (int) stream.dayMap.size();
+            obj["fileCount"] = (Json::UInt64) files;
+            val["streams"].append(obj);
+        }
+        cb(val);
+    });
+}
+
+void RecordRetention::scanStream(StreamInfo &stream) {
+    //每个流只在首次登记时扫描一次，之后增量更新
+    DIR *dir = opendir(stream.path.data());
+    if (!dir) {
+        return;
+    }
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+        if (!isDayDir(ent->d_name)) {
+            continue;
+        }
+        string day = ent->d_name;
+        stream.dayMap[day];
+        auto dayPath = stream.path + day + "/";
+        DIR *dayDir = opendir(dayPath.data());
+        if (!dayDir) {
+            continue;
+        }
+        struct dirent *file;
+        while ((file = readdir(dayDir)) != NULL) {
+            string name = file->d_name;
+            if (!isRecordFile(name)) {
+                continue;
+            }
+            struct stat st;
+            if (stat((dayPath + name).data(), &st) == 0) {
+                addFile(stream, day, name, st.st_size);
+            }
+        }
+        closedir(dayDir);
+    }
+    closedir(dir);
+    checkVolume(stream);
+}
+
+void RecordRetention::addFile(StreamInfo &stream, const string &day, const string &file, uint64_t size) {
+    auto &info = stream.dayMap[day];
+    if (!info.files.emplace(file, size).second) {
+        return;
+    }
+    info.bytes += size;
+    stream.bytes += size;
+    if (stream.volume) {
+        _volumes[stream.volume].bytes += size;
+    }
+}
+
+void RecordRetention::checkVolume(StreamInfo &stream) {
+    if (stream.volume) {
+        return;
+    }
+    struct stat st;
+    if (stat(stream.path.data(), &st) != 0) {
+        //流目录还未创建
+        return;
+    }
+    //加1避免与未确定的0冲突
+    stream.volume = (uint64_t) st.st_dev + 1;
+    auto &volume = _volumes[stream.volume];
+    if (volume.path.empty()) {
+        volume.path = stream.path;
+    }
+    volume.bytes += stream.bytes;
+}
+
+bool RecordRetention::deleteOldestFile(StreamInfo &stream) {
+    if (stream.dayMap.empty()) {
+        return false;
+    }
+    auto day_it = stream.dayMap.begin();
+    auto &day = day_it->second;
+    auto dayPath = stream.path + day_it->first + "/";
+    if (!day.files.empty()) {
+        auto file_it = day.files.begin();
+        auto filePath = dayPath + file_it->first;
+        remove(filePath.data());
+        remove((filePath + ".json").data());
+        day.bytes -= file_it->second;
+        stream.bytes -= file_it->second;
+        if (stream.volume) {
+            _volumes[stream.volume].bytes -= file_it->second;
+        }
+        day.files.erase(file_it);
+        --_batchLeft;
+    }
+    if (day.files.empty()) {
+        //只删除空目录，目录中可能还有正在录制的临时文件
+        rmdir(dayPath.data());
+        stream.dayMap.erase(day_it);
+    }
+    return true;
+}
+
+bool RecordRetention::enforceAge(StreamInfo &stream) {
+    if (stream.days <= 0) {
+        return true;
+    }
+    while (!stream.dayMap.empty()) {
+        auto day = stream.dayMap.begin()->first;
+        if (dayAge(day) <= stream.days) {
+            break;
+        }
+        auto dayPath = stream.path + day;
+        while (!stream.dayMap.empty() && stream.dayMap.begin()->first == day) {
+            if (_batchLeft <= 0) {
+                //剩余的过期录像留到下一批删除
+                return false;
+            }
+            deleteOldestFile(stream);
+        }
+        //过期目录中未被记录的文件一并删除
+        if (File::is_dir(dayPath.data())) {
+            File::delete_file(dayPath.data());
+        }
+        WarnL << "删除过期录像:" << dayPath;
+    }
+    return true;
+}
+
+bool RecordRetention::isProtectedDay(const StreamInfo &stream, const string &day) {
+    if (dayAge(day) <= 0) {
+        //当天的录像
+        return true;
+    }
+    //正在录制的流，其最新一天的录像可能是跨天录制中的当前录像
+    return stream.recorders > 0 && !stream.dayMap.empty() && day == stream.dayMap.rbegin()->first;
+}
+
+bool RecordRetention::enforceWatermark(uint64_t volume, VolumeInfo &info) {
+    GET_CONFIG(int, usageHigh, Record::kDiskUsageHigh);
+    GET_CONFIG(int, usageLow, Record::kDiskUsageLow);
+    GET_CONFIG(int, maxDeletePerTick, Record::kMaxDeletePerTick);
+    if (info.finished) {
+        return true;
+    }
+    uint64_t totalBytes = 0;
+    auto usage = diskUsage(info.path, &totalBytes);
+    //超过高水位才开始删除，开始后删除到低水位为止
+    if (usage < 0 || usage <= (info.deleted ? usageLow : usageHigh)) {
+        if (info.deleted) {
+            WarnL << "磁盘使用率降至:" << usage << "%，共删除:" << info.deleted << "个录像文件:" << info.path;
+        }
+        info.finished = true;
+        return true;
+    }
+
+    if (!info.deleted) {
+        //可以删除的录像总大小，不足以降至低水位时说明磁盘主要被其他文件占用，
+        //仍然删除到只剩受保护的录像为止，并告警
+        uint64_t deletableBytes = 0;
+        for (auto &pr : _streams) {
+            if (pr.second.volume != volume) {
+                continue;
+            }
+            for (auto &day : pr.second.dayMap) {
+                if (!isProtectedDay(pr.second, day.first)) {
+                    deletableBytes += day.second.bytes;
+                }
+            }
+        }
+        auto neededBytes = totalBytes / 100 * (usage - MIN(usage, usageLow));
+        if (deletableBytes < neededBytes) {
+            ErrorL << "磁盘使用率:" << usage << "% 超过 " << usageHigh << "%，但可删除的录像只有:" << deletableBytes
+                   << "字节，不足以降至 " << usageLow << "%(需要释放:" << neededBytes << "字节)，请检查磁盘上的其他文件:" << info.path;
+        }
+        WarnL << "磁盘使用率:" << usage << "% 超过 " << usageHigh << "%，开始删除最旧的录像:" << info.path;
+    }
+
+    //按(日期,文件名)从旧到新依次删除所有流的录像
+    auto oldest = [](StreamInfo *stream) {
+        auto &day = *stream->dayMap.begin();
+        return day.second.files.empty() ? day.first : day.first + "/" + day.second.files.begin()->first;
+    };
+    auto cmp = [&oldest](StreamInfo *a, StreamInfo *b) {
+        return oldest(a) > oldest(b);
+    };
+    //最旧的一天也受保护的流不参与删除
+    auto deletable = [this](StreamInfo *stream) {
+        return !stream->dayMap.empty() && !isProtectedDay(*stream, stream->dayMap.begin()->first);
+    };
+    std::priority_queue<StreamInfo *, vector<StreamInfo *>, decltype(cmp)> heap(cmp);
+    for (auto &pr : _streams) {
+        if (pr.second.volume == volume && deletable(&pr.second)) {
+            heap.push(&pr.second);
+        }
+    }
+
+    while (!heap.empty()) {
+        if (info.deleted >= MAX(1, maxDeletePerTick)) {
+            WarnL << "本次已删除:" << info.deleted << "个录像文件，剩余的留到下次检查:" << info.path;
+            break;
+        }
+        if (_batchLeft <= 0) {
+            //本批额度已用完，下一批重新检查使用率
+            return false;
+        }
+        auto stream = heap.top();
+        heap.pop();
+        deleteOldestFile(*stream);
+        ++info.deleted;
+        if (deletable(stream)) {
+            heap.push(stream);
+        }
+    }
+    usage = diskUsage(info.path);
+    if (heap.empty() && usage > usageLow) {
+        ErrorL << "已删除所有允许删除的录像，磁盘使用率仍为:" << usage << "%，停止删除:" << info.path;
+    }
+    WarnL << "磁盘使用率降至:" << usage << "%，共删除:" << info.deleted << "个录像文件:" << info.path;
+    info.finished = true;
+    return true;
+}
+
+void RecordRetention::onTick() {
+    if (_deleting) {
+        //上一轮删除还未完成
+        return;
+    }
+    for (auto &pr : _volumes) {
+        pr.second.deleted = 0;
+        pr.second.finished = false;
+    }
+    deleteBatch();
+}
+
+void RecordRetention::deleteBatch() {
+    GET_CONFIG(int, batchSize, Record::kDeleteBatch);
+    GET_CONFIG(uint32_t, deleteIntervalMS, Record::kDeleteIntervalMS);
+    _batchLeft = MAX(1, batchSize);
+    bool done = true;
+    for (auto &pr : _streams) {
+        checkVolume(pr.second);
+        done = enforceAge(pr.second) && done;
+    }
+    for (auto &pr : _volumes) {
+        done = enforceWatermark(pr.first, pr.second) && done;
+    }
+    _deleting = !done;
+    if (done) {
+        return;
+    }
+    //延时后在后台线程中删除下一批，期间后台线程仍然可以处理其他任务
+    EventPollerPool::Instance().getPoller()->doDelayTask(MAX(1u, deleteIntervalMS), []() {
+        auto &self = RecordRetention::Instance();
+        self._thread->async([]() {
+            RecordRetention::Instance().deleteBatch();
+        });
+        return 0;
+    });
+}
+
+} /* namespace mediakit */
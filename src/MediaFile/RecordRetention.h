@@ -0,0 +1,141 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ZLMEDIAKIT_RECORDRETENTION_H
+#define ZLMEDIAKIT_RECORDRETENTION_H
+
+#include <map>
+#include <string>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include "jsoncpp/json.h"
+#include "Thread/ThreadPool.h"
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+/**
+ * 录像保留策略服务
+ * 全局只有一个低优先级后台线程，按流与磁盘卷增量记录录像占用空间，
+ * 定时删除超过保留天数的录像，以及在磁盘使用率超过高水位时按时间从旧到新分批删除录像直到低水位，
+ * 每批删除之后通过定时器延时再删除下一批，避免删除操作抢占正在录制的写入io，且不阻塞后台线程中的其他任务。
+ * 按磁盘使用率删除时永远不删除当天的录像以及正在录制的流最新一天的录像，每次检查最多删除一定个数。
+ * 录像目录结构为 流目录/yyyyMMdd/HH-mm-ss.mp4
+ */
+class RecordRetention {
+public:
+    static RecordRetention &Instance();
+
+    /**
+     * 登记录像流目录，首次登记时在后台线程中扫描一次已有录像
+     * @param streamPath 流录像目录，以/结尾
+     * @param days 录像保留天数
+     */
+    void addStream(const string &streamPath, int days);
+
+    /**
+     * 流停止录制，其录像仍然按保留策略管理
+     * @param streamPath 流录像目录
+     */
+    void removeStream(const string &streamPath);
+
+    /**
+     * 一个录像文件录制完成
+     * @param streamPath 流录像目录
+     * @param filePath 录像文件路径
+     * @param fileSize 文件大小
+     */
+    void onFileClosed(const string &streamPath, const string &filePath, uint64_t fileSize);
+
+    /**
+     * 获取各磁盘卷与各流的录像占用统计，在后台线程中回调
+     */
+    void getStatistic(const function<void(const Json::Value &val)> &cb);
+
+private:
+    class DayInfo {
+    public:
+        //文件名 -> 文件大小，文件名按时间排序
+        map<string, uint64_t> files;
+        uint64_t bytes = 0;
+    };
+
+    class StreamInfo {
+    public:
+        string path;
+        int days = 0;
+        //正在录制该目录的录制器个数
+        int recorders = 0;
+        uint64_t bytes = 0;
+        //所在磁盘卷，0代表尚未确定
+        uint64_t volume = 0;
+        //yyyyMMdd -> 当天录像，按日期排序
+        map<string, DayInfo> dayMap;
+    };
+
+    class VolumeInfo {
+    public:
+        //用于查询磁盘使用率的路径
+        string path;
+        uint64_t bytes = 0;
+        //本轮检查已因使用率删除的文件个数
+        int deleted = 0;
+        //本轮检查是否已完成该磁盘卷的删除
+        bool finished = false;
+    };
+
+    RecordRetention();
+    ~RecordRetention() = default;
+
+    //以下函数只在后台线程中调用
+    void scanStream(StreamInfo &stream);
+    void addFile(StreamInfo &stream, const string &day, const string &file, uint64_t size);
+    bool deleteOldestFile(StreamInfo &stream);
+    void checkVolume(StreamInfo &stream);
+    void onTick();
+    //删除一批录像，本批额度用完还有未删除的录像时定时删除下一批
+    void deleteBatch();
+    //返回false表示本批额度已用完，还有过期录像未删除
+    bool enforceAge(StreamInfo &stream);
+    //返回false表示本批额度已用完，还需要继续删除
+    bool enforceWatermark(uint64_t volume, VolumeInfo &info);
+    //是否禁止因磁盘使用率删除该天的录像
+    bool isProtectedDay(const StreamInfo &stream, const string &day);
+
+private:
+    std::shared_ptr<ThreadPool> _thread;
+    unordered_map<string, StreamInfo> _streams;
+    map<uint64_t, VolumeInfo> _volumes;
+    //本批还可以删除的文件个数
+    int _batchLeft = 0;
+    //是否有未完成的删除，此时定时检查不再开始新一轮删除
+    bool _deleting = false;
+};
+
+} /* namespace mediakit */
+#endif //ZLMEDIAKIT_RECORDRETENTION_H
@@ -0,0 +1,158 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "TsLiveSource.h"
+#if defined(ENABLE_HLS)
+#include "Util/logger.h"
+
+namespace mediakit {
+
+unordered_map<string, std::weak_ptr<TsLiveSource> > TsLiveSource::s_sources;
+mutex TsLiveSource::s_mtx;
+
+TsLiveSource::Ptr TsLiveSource::get(const RtmpMediaSource::Ptr &src) {
+    auto key = src->getVhost() + "/" + src->getApp() + "/" + src->getId();
+    lock_guard<mutex> lck(s_mtx);
+    auto it = s_sources.find(key);
+    if (it != s_sources.end()) {
+        auto ret = it->second.lock();
+        //rtmp源没有被替换时直接复用
+        if (ret && ret->_src.lock() == src) {
+            return ret;
+        }
+    }
+    Ptr ret(new TsLiveSource(key, src));
+    s_sources[key] = ret;
+    auto poller = EventPollerPool::Instance().getPoller();
+    weak_ptr<TsLiveSource> weakSelf = ret;
+    poller->async([weakSelf, src]() {
+        auto strongSelf = weakSelf.lock();
+        if (strongSelf) {
+            strongSelf->start(src);
+        }
+    });
+    return ret;
+}
+
+TsLiveSource::TsLiveSource(const string &key, const RtmpMediaSource::Ptr &src) {
+    _key = key;
+    _src = src;
+    _ring = std::make_shared<RingType>();
+    _demuxer = std::make_shared<RtmpDemuxer>(src->getMetaData());
+    _frame_writer = std::make_shared<FrameWriterInterfaceHelper>([this](const Frame::Ptr &frame) {
+        inputFrame(frame);
+    });
+    InfoL << _key;
+}
+
+TsLiveSource::~TsLiveSource() {
+    InfoL << _key;
+    lock_guard<mutex> lck(s_mtx);
+    auto it = s_sources.find(_key);
+    if (it != s_sources.end() && it->second.expired()) {
+        s_sources.erase(it);
+    }
+}
+
+TsLiveSource::RingType::Ptr TsLiveSource::getRing() const {
+    return std::atomic_load(&_ring);
+}
+
+void TsLiveSource::start(const RtmpMediaSource::Ptr &src) {
+    //先输入config帧，以便解析出sps/pps/aac config
+    src->getConfigFrame([&](const RtmpPacket::Ptr &pkt) {
+        onRtmp(pkt);
+    });
+
+    auto ring = src->getRing();
+    if (!ring) {
+        onDetach();
+        return;
+    }
+    weak_ptr<TsLiveSource> weakSelf = shared_from_this();
+    //读取rtmp的gop缓存，首个观看者也能立即从关键帧开始播放
+    _rtmp_reader = ring->attach(EventPollerPool::Instance().getPoller());
+    _rtmp_reader->setDetachCB([weakSelf]() {
+        auto strongSelf = weakSelf.lock();
+        if (strongSelf) {
+            strongSelf->onDetach();
+        }
+    });
+    _rtmp_reader->setReadCB([weakSelf](const RtmpPacket::Ptr &pkt) {
+        auto strongSelf = weakSelf.lock();
+        if (strongSelf) {
+            strongSelf->onRtmp(pkt);
+        }
+    });
+}
+
+void TsLiveSource::onRtmp(const RtmpPacket::Ptr &pkt) {
+    _demuxer->inputRtmp(pkt);
+    //track可能在收到第一个音视频包后才能确定
+    for (auto &track : _demuxer->getTracks(false)) {
+        if (_tracks.emplace(track.get()).second) {
+            if (track->getTrackType() == TrackVideo) {
+                _has_video = true;
+            }
+            addTrack(track);
+            track->addDelegate(_frame_writer);
+        }
+    }
+    flush();
+}
+
+void TsLiveSource::onTs(const void *packet, int bytes, uint32_t timestamp, int flags) {
+    bool key = (flags & kFlagFrameStart) && (!_has_video || (flags & kFlagKeyFrame));
+    if (key) {
+        //关键帧(含其前面的PAT/PMT)必须位于一个缓存块的开头，这样gop缓存可以独立解码
+        flush();
+        _ts_cache_key = true;
+    }
+    _ts_cache.append((char *) packet, bytes);
+}
+
+void TsLiveSource::flush() {
+    if (_ts_cache.empty() || !_ring) {
+        return;
+    }
+    _ring->write(std::make_shared<BufferString>(std::move(_ts_cache)), _ts_cache_key);
+    _ts_cache.clear();
+    _ts_cache_key = false;
+}
+
+void TsLiveSource::onDetach() {
+    if (_detached) {
+        return;
+    }
+    _detached = true;
+    WarnL << "rtmp源已注销:" << _key;
+    //销毁环形缓冲会通知所有观看者断开
+    std::atomic_store(&_ring, RingType::Ptr());
+    _rtmp_reader.reset();
+}
+
+}//namespace mediakit
+#endif //defined(ENABLE_HLS)
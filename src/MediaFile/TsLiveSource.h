@@ -0,0 +1,98 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ZLMEDIAKIT_TSLIVESOURCE_H
+#define ZLMEDIAKIT_TSLIVESOURCE_H
+
+#if defined(ENABLE_HLS)
+#include <set>
+#include <mutex>
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include "TsMuxer.h"
+#include "Network/Buffer.h"
+#include "Rtmp/RtmpDemuxer.h"
+#include "Rtmp/RtmpMediaSource.h"
+#include "Common/PollerRingBuffer.h"
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+/**
+ * http-ts直播源
+ * 同一个流的所有http-ts观看者共享一个TsLiveSource：只从rtmp源读取一次并只复用一次ts，
+ * 生成的ts数据写入环形缓冲(带gop缓存)，观看者只做发送；
+ * 最后一个观看者离开后自动销毁
+ */
+class TsLiveSource : public TsMuxer, public std::enable_shared_from_this<TsLiveSource> {
+public:
+    typedef std::shared_ptr<TsLiveSource> Ptr;
+    typedef PollerRingBuffer<Buffer::Ptr> RingType;
+
+    /**
+     * 获取rtmp源对应的http-ts源，不存在则创建
+     */
+    static Ptr get(const RtmpMediaSource::Ptr &src);
+
+    ~TsLiveSource() override;
+
+    /**
+     * 获取ts数据环形缓冲，观看者attach后即可收到从关键帧开始的ts数据
+     */
+    RingType::Ptr getRing() const;
+protected:
+    void onTs(const void *packet, int bytes, uint32_t timestamp, int flags) override;
+private:
+    TsLiveSource(const string &key, const RtmpMediaSource::Ptr &src);
+    void start(const RtmpMediaSource::Ptr &src);
+    void onRtmp(const RtmpPacket::Ptr &pkt);
+    void onDetach();
+    void flush();
+private:
+    string _key;
+    std::weak_ptr<RtmpMediaSource> _src;
+    RtmpDemuxer::Ptr _demuxer;
+    //已经添加到TsMuxer的track
+    set<Track *> _tracks;
+    FrameWriterInterface::Ptr _frame_writer;
+    RtmpMediaSource::RingType::RingReader::Ptr _rtmp_reader;
+    RingType::Ptr _ring;
+    //rtmp源已经注销
+    bool _detached = false;
+    bool _has_video = false;
+    //尚未写入环形缓冲的ts数据
+    string _ts_cache;
+    bool _ts_cache_key = false;
+
+    static unordered_map<string, std::weak_ptr<TsLiveSource> > s_sources;
+    static mutex s_mtx;
+};
+
+}//namespace mediakit
+#endif //defined(ENABLE_HLS)
+#endif //ZLMEDIAKIT_TSLIVESOURCE_H
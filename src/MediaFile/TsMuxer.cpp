@@ -79,21 +79,31 @@ void TsMuxer::inputFrame(const Frame::Ptr &frame) {
                     });
                     merged_frame = std::make_shared<BufferString>(std::move(merged));
                 }
-                _timestamp = back->dts();
-                mpeg_ts_write(_context, it->second, back->keyFrame() ? 0x0001 : 0, back->pts() * 90LL, back->dts() * 90LL, merged_frame->data(),  merged_frame->size());
+                writeFrame(it->second, back->keyFrame(), back->pts(), back->dts(), merged_frame->data(), merged_frame->size());
                 _frameCached.clear();
             }
             _frameCached.emplace_back(Frame::getCacheAbleFrame(frame));
         }
             break;
         default: {
-            _timestamp = frame->dts();
-            mpeg_ts_write(_context, it->second, frame->keyFrame() ? 0x0001 : 0, frame->pts() * 90LL, frame->dts() * 90LL, frame->data(), frame->size());
+            writeFrame(it->second, frame->keyFrame(), frame->pts(), frame->dts(), frame->data(), frame->size());
         }
             break;
     }
 }
 
+void TsMuxer::writeFrame(int stream_id, bool key_frame, uint32_t pts, uint32_t dts, const char *data, int size) {
+    _timestamp = dts;
+    _key_frame = key_frame;
+    _frame_start = true;
+    if (key_frame) {
+        //关键帧前强制输出PAT/PMT，这样从关键帧开始的切片可以独立解码
+        mpeg_ts_reset(_context);
+    }
+    //0x0001(MPEG_FLAG_IDR_FRAME)使关键帧的第一个ts包带上random_access_indicator
+    mpeg_ts_write(_context, stream_id, key_frame ? 0x0001 : 0, pts * 90LL, dts * 90LL, data, size);
+}
+
 void TsMuxer::resetTracks() {
     uninit();
     init();
@@ -111,7 +121,13 @@ void TsMuxer::init() {
             },
             [](void* param, const void* packet, size_t bytes){
                 TsMuxer *muxer = (TsMuxer *)param;
-                muxer->onTs(packet, bytes,muxer->_timestamp,0);
+                int flags = muxer->_key_frame ? kFlagKeyFrame : 0;
+                if (muxer->_frame_start) {
+                    //PAT/PMT在帧数据之前输出，所以它们也算作该帧的开始
+                    flags |= kFlagFrameStart;
+                    muxer->_frame_start = false;
+                }
+                muxer->onTs(packet, bytes,muxer->_timestamp,flags);
             }
     };
     if(_context == nullptr){
@@ -37,20 +37,38 @@ namespace mediakit {
 
 class TsMuxer {
 public:
+    //onTs回调的flags
+    typedef enum {
+        //所属帧为关键帧
+        kFlagKeyFrame = 0x01,
+        //该ts包为一帧的第一个包
+        kFlagFrameStart = 0x02,
+    } TsFlag;
+
     TsMuxer();
     virtual ~TsMuxer();
     void addTrack(const Track::Ptr &track);
     void inputFrame(const Frame::Ptr &frame);
 protected:
+    /**
+     * 输出ts包回调
+     * @param packet ts包
+     * @param bytes ts包长度
+     * @param timestamp 所属帧的dts，单位毫秒
+     * @param flags TsFlag的组合
+     */
     virtual void onTs(const void *packet, int bytes,uint32_t timestamp,int flags) = 0;
     void resetTracks();
 private:
     void init();
     void uninit();
+    void writeFrame(int stream_id, bool key_frame, uint32_t pts, uint32_t dts, const char *data, int size);
 private:
     void  *_context = nullptr;
     char *_tsbuf[188];
     uint32_t _timestamp = 0;
+    bool _key_frame = false;
+    bool _frame_start = false;
     unordered_map<int,int > _codecid_to_stream_id;
     List<Frame::Ptr> _frameCached;
 };
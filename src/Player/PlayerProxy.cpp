@@ -24,6 +24,7 @@
  * SOFTWARE.
  */
 
+#include <algorithm>
 #include "Common/config.h"
 #include "PlayerProxy.h"
 #include "Util/mini.h"
@@ -62,6 +63,281 @@ static uint8_t s_mute_adts[] = {0xff, 0xf1, 0x6c, 0x40, 0x2d, 0x3f, 0xfc, 0x00,
 #define MUTE_ADTS_DATA_LEN sizeof(s_mute_adts)
 #define MUTE_ADTS_DATA_MS 130
 
+/**
+ * 拉流代理共享的上游拉流
+ * 所有回调以及对拉流代理的通知都在本拉流器的poller线程中执行
+ */
+class ProxyUpstream : public MediaPlayer,
+                      public std::enable_shared_from_this<ProxyUpstream> {
+public:
+    typedef std::shared_ptr<ProxyUpstream> Ptr;
+
+    /**
+     * 获取上游拉流，不存在时创建并开始拉流
+     * 索引只包含url与kRtpType，复用时上游的拉流参数、重试次数以及poller仍是第一个拉流代理的设置
+     * @param url 上游url
+     * @param proxy 发起拉流的拉流代理，创建时使用其拉流参数、重试次数以及poller
+     */
+    static Ptr get(const string &url, const PlayerProxy::Ptr &proxy);
+
+    ProxyUpstream(const string &key, int iRetryCount, const EventPoller::Ptr &poller) : MediaPlayer(poller) {
+        _strKey = key;
+        _iRetryCount = iRetryCount;
+    }
+
+    ~ProxyUpstream() override {
+        {
+            lock_guard<recursive_mutex> lck(s_mtx);
+            auto it = s_upstreamMap.find(_strKey);
+            if (it != s_upstreamMap.end() && it->second.expired()) {
+                s_upstreamMap.erase(it);
+            }
+        }
+        _timer.reset();
+        teardown();
+        InfoL << "停止上游拉流:" << _strKey;
+    }
+
+    /**
+     * 添加拉流代理，如果已经有拉流结果则立即通知该代理
+     * 已经放弃重试的上游重新开始拉流，该代理在拉流结果返回时得到通知
+     */
+    void addProxy(const PlayerProxy::Ptr &proxy) {
+        {
+            lock_guard<recursive_mutex> lck(_mtx);
+            _proxies.emplace(proxy.get(), proxy);
+        }
+        if (_bPlaying) {
+            proxy->onUpstreamResult(SockException(Err_success, "play success"));
+            return;
+        }
+        if (_bGiveUp) {
+            //上游已经停止重试，由新加入的拉流代理重新触发拉流
+            WarnL << "重新开始已放弃重试的上游拉流:" << _strKey;
+            _bGiveUp = false;
+            _iFailedCnt = 0;
+            _timer.reset();
+            MediaPlayer::play(_strUrl);
+            return;
+        }
+        if (_lastErr) {
+            //上游正在重试，先把最近一次错误通知给该代理，重试成功后拉流代理仍会生成媒体源
+            proxy->onUpstreamResult(_lastErr);
+        }
+    }
+
+    /**
+     * 移除拉流代理，并把其MultiMediaSourceMuxer与静音生成器从track中移除
+     */
+    void removeProxy(PlayerProxy *proxy, void *muxer, void *muteMaker) {
+        {
+            lock_guard<recursive_mutex> lck(_mtx);
+            _proxies.erase(proxy);
+        }
+        if (proxy == _directProxy) {
+            //直接代理的媒体源属于该代理，其他代理仍然通过各自的MultiMediaSourceMuxer输出
+            setMediaSouce(nullptr);
+            _directProxy = nullptr;
+        }
+        delDelegate(muxer, muteMaker);
+    }
+
+    void delDelegate(void *muxer, void *muteMaker) {
+        for (auto &track : getTracks(false)) {
+            if (muxer) {
+                track->delDelegate(muxer);
+            }
+            if (muteMaker) {
+                track->delDelegate(muteMaker);
+            }
+        }
+    }
+
+    /**
+     * 该拉流代理直接代理的媒体源，只有创建上游的第一个拉流代理才能直接代理
+     */
+    MediaSource::Ptr getDirectSource(PlayerProxy *proxy) const {
+        return proxy == _directProxy ? _pMediaSrc : nullptr;
+    }
+
+    void start(const string &strUrl, const PlayerProxy::Ptr &directProxy) {
+        _strUrl = strUrl;
+        weak_ptr<ProxyUpstream> weakSelf = shared_from_this();
+        setOnPlayResult([weakSelf](const SockException &err) {
+            auto strongSelf = weakSelf.lock();
+            if(!strongSelf) {
+                return;
+            }
+            strongSelf->_bPlaying = !err;
+            strongSelf->_lastErr = err;
+            for (auto &proxy : strongSelf->getProxies()) {
+                proxy->onUpstreamResult(err);
+            }
+            if(!err) {
+                // 播放成功
+                strongSelf->_iFailedCnt = 0;//连续播放失败次数清0
+            }else{
+                // 播放失败，延时重试播放
+                strongSelf->tryRePlay();
+            }
+        });
+        setOnShutdown([weakSelf](const SockException &err) {
+            auto strongSelf = weakSelf.lock();
+            if(!strongSelf) {
+                return;
+            }
+            strongSelf->_bPlaying = false;
+            strongSelf->_lastErr = err;
+            for (auto &proxy : strongSelf->getProxies()) {
+                proxy->onUpstreamShutdown();
+            }
+            //播放异常中断，延时重试播放
+            strongSelf->tryRePlay();
+        });
+        MediaPlayer::play(strUrl);
+
+        MediaSource::Ptr mediaSource;
+        if(directProxy && dynamic_pointer_cast<RtspPlayer>(_parser)){
+            //rtsp拉流，之后加入的拉流代理通过各自的MultiMediaSourceMuxer输出
+            GET_CONFIG(bool,enableDirectProxy,Rtsp::kDirectProxy);
+            if(enableDirectProxy && directProxy->_bEnableRtsp){
+                mediaSource = std::make_shared<RtspMediaSource>(directProxy->_strVhost,directProxy->_strApp,directProxy->_strSrc);
+            }
+        }else if(directProxy && dynamic_pointer_cast<RtmpPlayer>(_parser)){
+            //rtmp拉流
+            if(directProxy->_bEnableRtmp){
+                mediaSource = std::make_shared<RtmpMediaSource>(directProxy->_strVhost,directProxy->_strApp,directProxy->_strSrc);
+            }
+        }
+        if(mediaSource){
+            setMediaSouce(mediaSource);
+            mediaSource->setListener(directProxy);
+            _directProxy = directProxy.get();
+        }
+    }
+private:
+    vector<PlayerProxy::Ptr> getProxies() {
+        vector<PlayerProxy::Ptr> ret;
+        lock_guard<recursive_mutex> lck(_mtx);
+        for (auto &pr : _proxies) {
+            auto proxy = pr.second.lock();
+            if (proxy) {
+                ret.emplace_back(std::move(proxy));
+            }
+        }
+        return ret;
+    }
+
+    void tryRePlay(){
+        if(_iFailedCnt < _iRetryCount || _iRetryCount < 0) {
+            rePlay(_strUrl,_iFailedCnt++);
+            return;
+        }
+        //不再重试，等待新的拉流代理加入时重新拉流
+        _bGiveUp = true;
+        WarnL << "上游拉流失败次数超过上限，停止重试:" << _strKey << " " << _lastErr.what();
+    }
+
+    void rePlay(const string &strUrl,int iFailedCnt){
+        auto iDelay = MAX(2 * 1000, MIN(iFailedCnt * 3000,60*1000));
+        weak_ptr<ProxyUpstream> weakSelf = shared_from_this();
+        _timer = std::make_shared<Timer>(iDelay / 1000.0f,[weakSelf,strUrl,iFailedCnt]() {
+            //播放失败次数越多，则延时越长
+            auto strongPlayer = weakSelf.lock();
+            if(!strongPlayer) {
+                return false;
+            }
+            WarnL << "重试播放[" << iFailedCnt << "]:"  << strUrl;
+            strongPlayer->MediaPlayer::play(strUrl);
+            return false;
+        }, getPoller());
+    }
+private:
+    string _strKey;
+    string _strUrl;
+    int _iRetryCount;
+    //连续播放失败次数
+    int _iFailedCnt = 0;
+    bool _bPlaying = false;
+    //是否已经放弃重试
+    bool _bGiveUp = false;
+    //最近一次拉流失败或中断的原因
+    SockException _lastErr;
+    Timer::Ptr _timer;
+    recursive_mutex _mtx;
+    unordered_map<PlayerProxy *, weak_ptr<PlayerProxy> > _proxies;
+    //直接代理的拉流代理，即创建上游的第一个拉流代理
+    PlayerProxy *_directProxy = nullptr;
+    //上游拉流索引
+    static recursive_mutex s_mtx;
+    static unordered_map<string, weak_ptr<ProxyUpstream> > s_upstreamMap;
+};
+
+recursive_mutex ProxyUpstream::s_mtx;
+unordered_map<string, weak_ptr<ProxyUpstream> > ProxyUpstream::s_upstreamMap;
+
+//上游拉流的索引，url的schema与host不区分大小写并去除默认端口，rtsp还区分传输方式
+static string getUpstreamKey(const string &url, int rtpType) {
+    auto schema_pos = url.find("://");
+    if (schema_pos == string::npos) {
+        return url;
+    }
+    string schema = url.substr(0, schema_pos);
+    std::transform(schema.begin(), schema.end(), schema.begin(), ::tolower);
+    auto host_start = schema_pos + 3;
+    auto host_end = url.find('/', host_start);
+    if (host_end == string::npos) {
+        host_end = url.size();
+    }
+    //用户名密码区分大小写
+    auto at_pos = url.rfind('@', host_end);
+    if (at_pos != string::npos && at_pos >= host_start) {
+        host_start = at_pos + 1;
+    }
+    string host = url.substr(host_start, host_end - host_start);
+    std::transform(host.begin(), host.end(), host.begin(), ::tolower);
+    string default_port = schema == "rtsp" ? ":554" : (schema == "rtmp" ? ":1935" : "");
+    if (!default_port.empty() && host.size() > default_port.size() &&
+        host.compare(host.size() - default_port.size(), default_port.size(), default_port) == 0) {
+        host.erase(host.size() - default_port.size());
+    }
+    string path = url.substr(host_end);
+    while (!path.empty() && path.back() == '/') {
+        path.pop_back();
+    }
+    string key = schema + "://" + url.substr(schema_pos + 3, host_start - schema_pos - 3) + host + path;
+    if (schema == "rtsp") {
+        key += "#" + to_string(rtpType);
+    }
+    return key;
+}
+
+ProxyUpstream::Ptr ProxyUpstream::get(const string &url, const PlayerProxy::Ptr &proxy) {
+    GET_CONFIG(bool,shareUpstream,General::kShareProxyUpstream);
+    int rtpType = (*proxy)[kRtpType];
+    auto key = getUpstreamKey(url, rtpType);
+    if (!shareUpstream) {
+        //不共享时每个拉流代理独占上游
+        key += "@" + to_string((uint64_t) proxy.get());
+    }
+
+    lock_guard<recursive_mutex> lck(s_mtx);
+    auto it = s_upstreamMap.find(key);
+    if (it != s_upstreamMap.end()) {
+        auto upstream = it->second.lock();
+        if (upstream) {
+            InfoL << "复用上游拉流:" << key << " -> " << proxy->_strVhost << "/" << proxy->_strApp << "/" << proxy->_strSrc;
+            return upstream;
+        }
+    }
+    auto upstream = std::make_shared<ProxyUpstream>(key, proxy->_iRetryCount, proxy->_poller);
+    upstream->mINI::operator=(*proxy);
+    s_upstreamMap[key] = upstream;
+    //第一个拉流代理仍然可以直接代理，共享只影响之后加入的拉流代理
+    upstream->start(url, proxy);
+    return upstream;
+}
+
 PlayerProxy::PlayerProxy(const string &strVhost,
                          const string &strApp,
                          const string &strSrc,
@@ -71,7 +347,7 @@ PlayerProxy::PlayerProxy(const string &strVhost,
                         //chenxiaolei 修改为int, 录像最大录制天数,0就是不录
                          int bRecordMp4,
                          int iRetryCount,
-						 const EventPoller::Ptr &poller) : MediaPlayer(poller){
+						 const EventPoller::Ptr &poller) {
 	_strVhost = strVhost;
 	_strApp = strApp;
 	_strSrc = strSrc;
@@ -81,6 +357,10 @@ PlayerProxy::PlayerProxy(const string &strVhost,
     //chenxiaolei 修改为int, 录像最大录制天数,0就是不录
     _bRecordMp4 = bRecordMp4;
     _iRetryCount = iRetryCount;
+    _poller = poller;
+    if(!_poller){
+        _poller = EventPollerPool::Instance().getPoller();
+    }
 }
 
 void PlayerProxy::setPlayCallbackOnce(const function<void(const SockException &ex)> &cb){
@@ -91,87 +371,61 @@ void PlayerProxy::setOnClose(const function<void()> &cb){
     _onClose = cb;
 }
 
+EventPoller::Ptr PlayerProxy::getPoller(){
+    return _upstream ? _upstream->getPoller() : _poller;
+}
+
 void PlayerProxy::play(const string &strUrlTmp) {
+	_upstream = ProxyUpstream::get(strUrlTmp, shared_from_this());
 	weak_ptr<PlayerProxy> weakSelf = shared_from_this();
-	std::shared_ptr<int> piFailedCnt(new int(0)); //连续播放失败次数
-	setOnPlayResult([weakSelf,strUrlTmp,piFailedCnt](const SockException &err) {
+	auto upstream = _upstream;
+	upstream->getPoller()->async([weakSelf,upstream]() {
 		auto strongSelf = weakSelf.lock();
-		if(!strongSelf) {
-			return;
+		if(strongSelf) {
+			upstream->addProxy(strongSelf);
 		}
+	}, false);
+}
 
-		if(strongSelf->_playCB) {
-            strongSelf->_playCB(err);
-            strongSelf->_playCB = nullptr;
-        }
-
-		if(!err) {
-			// 播放成功
-			*piFailedCnt = 0;//连续播放失败次数清0
-			strongSelf->onPlaySuccess();
-		}else if(*piFailedCnt < strongSelf->_iRetryCount || strongSelf->_iRetryCount < 0) {
-			// 播放失败，延时重试播放
-			strongSelf->rePlay(strUrlTmp,(*piFailedCnt)++);
-		}
-	});
-	setOnShutdown([weakSelf,strUrlTmp,piFailedCnt](const SockException &err) {
-		auto strongSelf = weakSelf.lock();
-		if(!strongSelf) {
-			return;
-		}
-		if(strongSelf->_mediaMuxer) {
-			auto tracks = strongSelf->getTracks(false);
-			for (auto & track : tracks){
-				track->delDelegate(strongSelf->_mediaMuxer.get());
-			}
-			strongSelf->_mediaMuxer.reset();
-		}
-		//播放异常中断，延时重试播放
-		if(*piFailedCnt < strongSelf->_iRetryCount || strongSelf->_iRetryCount < 0) {
-			strongSelf->rePlay(strUrlTmp,(*piFailedCnt)++);
-		}
+PlayerProxy::~PlayerProxy() {
+	if(!_upstream){
+		return;
+	}
+	//在上游拉流的poller线程中移除本代理，最后一个代理移除后上游停止拉流
+	auto upstream = _upstream;
+	auto muxer = _mediaMuxer;
+	auto muteMaker = _muteMaker;
+	auto self = this;
+	upstream->getPoller()->async([upstream,muxer,muteMaker,self]() {
+		upstream->removeProxy(self, muxer.get(), muteMaker.get());
 	});
-	MediaPlayer::play(strUrlTmp);
-
-	MediaSource::Ptr mediaSource;
-	if(dynamic_pointer_cast<RtspPlayer>(_parser)){
-		//rtsp拉流
-		GET_CONFIG(bool,directProxy,Rtsp::kDirectProxy);
-		if(directProxy && _bEnableRtsp){
-			mediaSource = std::make_shared<RtspMediaSource>(_strVhost,_strApp,_strSrc);
-		}
-	}else if(dynamic_pointer_cast<RtmpPlayer>(_parser)){
-		//rtmp拉流
-		if(_bEnableRtmp){
-			mediaSource = std::make_shared<RtmpMediaSource>(_strVhost,_strApp,_strSrc);
-		}
+}
+
+void PlayerProxy::onUpstreamResult(const SockException &ex) {
+	if(_playCB) {
+		_playCB(ex);
+		_playCB = nullptr;
 	}
-	if(mediaSource){
-		setMediaSouce(mediaSource);
-		mediaSource->setListener(shared_from_this());
+	if(!ex && !_mediaMuxer) {
+		onPlaySuccess();
 	}
 }
 
-PlayerProxy::~PlayerProxy() {
-	_timer.reset();
+void PlayerProxy::onUpstreamShutdown() {
+	detachTracks();
 }
-void PlayerProxy::rePlay(const string &strUrl,int iFailedCnt){
-	auto iDelay = MAX(2 * 1000, MIN(iFailedCnt * 3000,60*1000));
-	weak_ptr<PlayerProxy> weakSelf = shared_from_this();
-	_timer = std::make_shared<Timer>(iDelay / 1000.0f,[weakSelf,strUrl,iFailedCnt]() {
-		//播放失败次数越多，则延时越长
-		auto strongPlayer = weakSelf.lock();
-		if(!strongPlayer) {
-			return false;
-		}
-		WarnL << "重试播放[" << iFailedCnt << "]:"  << strUrl;
-		strongPlayer->MediaPlayer::play(strUrl);
-		return false;
-	}, getPoller());
+
+void PlayerProxy::detachTracks() {
+	if(_mediaMuxer || _muteMaker) {
+		_upstream->delDelegate(_mediaMuxer.get(), _muteMaker.get());
+	}
+	_mediaMuxer.reset();
+	_muteMaker.reset();
 }
 
 int PlayerProxy::readerCount(){
-	return (_mediaMuxer ? _mediaMuxer->readerCount() : 0) + (_pMediaSrc ? _pMediaSrc->readerCount() : 0);
+	auto directSrc = _upstream ? _upstream->getDirectSource(this) : nullptr;
+	return (_mediaMuxer ? _mediaMuxer->readerCount() : 0) + (directSrc ? directSrc->readerCount() : 0);
 }
 
 bool PlayerProxy::close(MediaSource &sender,bool force) {
@@ -179,14 +433,15 @@ bool PlayerProxy::close(MediaSource &sender,bool force) {
         return false;
     }
 
-	//通知其停止推流
+	//停止本代理，其他代理仍在使用时上游继续拉流
 	weak_ptr<PlayerProxy> weakSlef = dynamic_pointer_cast<PlayerProxy>(shared_from_this());
 	getPoller()->async_first([weakSlef]() {
 		auto stronSelf = weakSlef.lock();
-		if (stronSelf) {
-			stronSelf->_mediaMuxer.reset();
-			stronSelf->setMediaSouce(nullptr);
-			stronSelf->teardown();
+		if (stronSelf && stronSelf->_upstream) {
+			stronSelf->detachTracks();
+			//同时停止本代理的直接代理
+			stronSelf->_upstream->removeProxy(stronSelf.get(), nullptr, nullptr);
+			stronSelf->_upstream.reset();
 			if(stronSelf->_onClose){
                 stronSelf->_onClose();
 			}
@@ -225,23 +480,13 @@ private:
 	int _iAudioIndex = 0;
 };
 
+
 void PlayerProxy::onPlaySuccess() {
-    //chenxiaolei 修改为int, 录像最大录制天数,0就是不录
-	/*if (dynamic_pointer_cast<RtspMediaSource>(_pMediaSrc)) {
-		//rtsp拉流代理
-		_mediaMuxer.reset(new MultiMediaSourceMuxer(_strVhost, _strApp, _strSrc, getDuration(), false, _bEnableRtmp, _bEnableHls, _bRecordMp4));
-	} else if (dynamic_pointer_cast<RtmpMediaSource>(_pMediaSrc)) {
-		//rtmp拉流代理
-		_mediaMuxer.reset(new MultiMediaSourceMuxer(_strVhost, _strApp, _strSrc, getDuration(), _bEnableRtsp, false, _bEnableHls, _bRecordMp4));
-	} else {
-		//其他拉流代理
-		_mediaMuxer.reset(new MultiMediaSourceMuxer(_strVhost, _strApp, _strSrc, getDuration(), _bEnableRtsp, _bEnableRtmp, _bEnableHls, _bRecordMp4));
-	}*/
 	//chenxiaolei 根据配置来做 类型输出, 而不是根据接入源类型, 有些时候就是想要 rtmp->rtmp
-    _mediaMuxer.reset(new MultiMediaSourceMuxer(_strVhost, _strApp, _strSrc, getDuration(), _bEnableRtsp, _bEnableRtmp, _bEnableHls, _bRecordMp4));
+    _mediaMuxer.reset(new MultiMediaSourceMuxer(_strVhost, _strApp, _strSrc, _upstream->getDuration(), _bEnableRtsp, _bEnableRtmp, _bEnableHls, _bRecordMp4));
 	_mediaMuxer->setListener(shared_from_this());
 
-	auto videoTrack = getTrack(TrackVideo,false);
+	auto videoTrack = _upstream->getTrack(TrackVideo,false);
 	if(videoTrack){
 		//添加视频
 		_mediaMuxer->addTrack(videoTrack);
@@ -249,7 +494,7 @@ void PlayerProxy::onPlaySuccess() {
 		videoTrack->addDelegate(_mediaMuxer);
 	}
 
-	auto audioTrack = getTrack(TrackAudio, false);
+	auto audioTrack = _upstream->getTrack(TrackAudio, false);
 	if(audioTrack){
 		//添加音频
 		_mediaMuxer->addTrack(audioTrack);
@@ -257,13 +502,13 @@ void PlayerProxy::onPlaySuccess() {
         audioTrack->addDelegate(_mediaMuxer);
     }else if(videoTrack){
 		//没有音频信息，产生一个静音音频
-		MuteAudioMaker::Ptr audioMaker = std::make_shared<MuteAudioMaker>();
+		_muteMaker = std::make_shared<MuteAudioMaker>();
 		//videoTrack把数据写入MuteAudioMaker
-		videoTrack->addDelegate(audioMaker);
+		videoTrack->addDelegate(_muteMaker);
 		//添加一个静音Track至_mediaMuxer
 		_mediaMuxer->addTrack(std::make_shared<AACTrack>());
 		//MuteAudioMaker生成静音音频然后写入_mediaMuxer；
-		audioMaker->addDelegate(_mediaMuxer);
+		_muteMaker->addDelegate(_mediaMuxer);
 	}
 }
 
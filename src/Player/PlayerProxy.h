@@ -38,7 +38,19 @@ using namespace toolkit;
 
 namespace mediakit {
 
-class PlayerProxy :public MediaPlayer,
+class ProxyUpstream;
+
+/**
+ * 拉流代理
+ * 上游url(以及rtsp传输方式)相同的拉流代理共享同一个上游拉流(ProxyUpstream)，
+ * 每个拉流代理按各自的vhost/app/stream以及hls、录像设置生成MediaSource，
+ * 其中创建上游的第一个拉流代理仍然可以直接代理(rtsp.directProxy)；
+ * 上游拉流由拉流代理引用计数，最后一个拉流代理释放后停止拉流；
+ * 拉流参数(例如kRtpType)通过mINI接口在play之前设置；
+ * 共享上游时，上游的重试次数、poller以及除kRtpType外的拉流参数都取自创建该上游的第一个拉流代理，
+ * 之后加入的拉流代理的这些设置不生效
+ */
+class PlayerProxy :public mINI,
 				   public std::enable_shared_from_this<PlayerProxy> ,
 				   public MediaSourceEvent{
 public:
@@ -72,10 +84,15 @@ public:
     void setOnClose(const function<void()> &cb);
 
     /**
-     * 开始拉流播放
+     * 开始拉流播放，已有相同上游的拉流时直接复用
      * @param strUrl
      */
-    void play(const string &strUrl) override;
+    void play(const string &strUrl);
+
+    /**
+     * 获取上游拉流所在的poller线程
+     */
+    EventPoller::Ptr getPoller();
 
 
     /**
@@ -84,9 +101,13 @@ public:
      */
     bool close(MediaSource &sender,bool force) override;
 private:
+    friend class ProxyUpstream;
     void onNoneReader(MediaSource &sender) override;
-	void rePlay(const string &strUrl,int iFailedCnt);
+    //以下由ProxyUpstream在其poller线程中调用
+	void onUpstreamResult(const SockException &ex);
+	void onUpstreamShutdown();
 	void onPlaySuccess();
+	void detachTracks();
 	int readerCount() ;
 private:
     bool _bEnableRtsp;
@@ -96,10 +117,13 @@ private:
     int _bRecordMp4;
     int _iRetryCount;
 	MultiMediaSourceMuxer::Ptr _mediaMuxer;
+	//没有音频时生成静音音频
+	FrameRingInterfaceDelegate::Ptr _muteMaker;
     string _strVhost;
     string _strApp;
     string _strSrc;
-    Timer::Ptr _timer;
+    EventPoller::Ptr _poller;
+    std::shared_ptr<ProxyUpstream> _upstream;
     function<void(const SockException &ex)> _playCB;
     function<void()> _onClose;
 };
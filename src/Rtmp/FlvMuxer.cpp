@@ -75,8 +75,13 @@ void FlvMuxer::start(const EventPoller::Ptr &poller,const RtmpMediaSource::Ptr &
     });
 }
 
+void FlvMuxer::setRebaseStamp(bool rebase) {
+    _rebaseStamp = rebase;
+}
+
 void FlvMuxer::onWriteFlvHeader(const RtmpMediaSource::Ptr &mediaSrc) {
-    CLEAR_ARR(_aui32FirstStamp);
+    _started = false;
+    _configFrames.clear();
 
     //发送flv文件头
     char flv_file_header[] = "FLV\x1\x5\x0\x0\x0\x9"; // have audio and have video
@@ -111,67 +116,61 @@ void FlvMuxer::onWriteFlvHeader(const RtmpMediaSource::Ptr &mediaSrc) {
     //metadata
     AMFEncoder invoke;
     invoke << "onMetaData" << mediaSrc->getMetaData();
-    onWriteFlvTag(MSG_DATA, std::make_shared<BufferString>(invoke.data()), 0);
+    _metadata = std::make_shared<BufferString>(invoke.data());
 
     //config frame
     mediaSrc->getConfigFrame([&](const RtmpPacket::Ptr &pkt){
-        onWriteRtmp(pkt);
+        _configFrames.emplace_back(pkt);
     });
 }
 
-
-
-#if defined(_WIN32)
-#pragma pack(push, 1)
-#endif // defined(_WIN32)
-
-class RtmpTagHeader {
-public:
-    uint8_t type = 0;
-    uint8_t data_size[3] = {0};
-    uint8_t timestamp[3] = {0};
-    uint8_t timestamp_ex = 0;
-    uint8_t streamid[3] = {0}; /* Always 0. */
-}PACKED;
-
-#if defined(_WIN32)
-#pragma pack(pop)
-#endif // defined(_WIN32)
-
-void FlvMuxer::onWriteFlvTag(const RtmpPacket::Ptr &pkt, uint32_t ui32TimeStamp) {
-    onWriteFlvTag(pkt->typeId,pkt,ui32TimeStamp);
+void FlvMuxer::onWriteConfig(uint32_t ui32TimeStamp) {
+    //与第一个包(gop起始位置)使用相同的时间戳，避免时间戳跳变
+    if(_metadata){
+        onWriteFlvTag(MSG_DATA, _metadata, ui32TimeStamp);
+        _metadata.reset();
+    }
+    for(auto &pkt : _configFrames){
+        onWriteFlvTag(pkt->typeId, pkt, ui32TimeStamp);
+    }
+    _configFrames.clear();
 }
 
-void FlvMuxer::onWriteFlvTag(uint8_t ui8Type, const Buffer::Ptr &buffer, uint32_t ui32TimeStamp) {
-    RtmpTagHeader header;
-    header.type = ui8Type;
-    set_be24(header.data_size, buffer->size());
-    header.timestamp_ex = (uint8_t) ((ui32TimeStamp >> 24) & 0xff);
-    set_be24(header.timestamp,ui32TimeStamp & 0xFFFFFF);
+
+void FlvMuxer::onWriteFlvTag(const FlvTag::Ptr &tag, const Buffer::Ptr &buffer) {
     //tag header
-    onWrite(std::make_shared<BufferRaw>((char *)&header, sizeof(header)));
+    onWrite(tag->header);
     //tag data
     onWrite(buffer);
-    auto size = htonl((buffer->size() + sizeof(header)));
     //PreviousTagSize
-    onWrite(std::make_shared<BufferRaw>((char *)&size,4));
+    onWrite(tag->previousTagSize);
+}
+
+void FlvMuxer::onWriteFlvTag(uint8_t ui8Type, const Buffer::Ptr &buffer, uint32_t ui32TimeStamp) {
+    onWriteFlvTag(FlvTag::create(ui8Type, buffer->size(), ui32TimeStamp), buffer);
 }
 
 void FlvMuxer::onWriteRtmp(const RtmpPacket::Ptr &pkt) {
-    auto modifiedStamp = pkt->timeStamp;
-    auto &firstStamp = _aui32FirstStamp[pkt->typeId % 2];
-    if(!firstStamp){
-        firstStamp = modifiedStamp;
+    if(!_started){
+        _started = true;
+        _baseStamp = pkt->sourceStamp;
+        onWriteConfig(_rebaseStamp ? 0 : _baseStamp);
     }
-    if(modifiedStamp >= firstStamp){
-        //计算时间戳增量
-        modifiedStamp -= firstStamp;
-    }else{
-        //发生回环，重新计算时间戳增量
-        CLEAR_ARR(_aui32FirstStamp);
-        modifiedStamp = 0;
+    //tag头尾以及时间戳(相对媒体源)只生成一次，所有观看者共享，
+    //中途加入的观看者从gop缓存起始位置的时间戳开始播放
+    auto tag = pkt->getFlvTag();
+    if(_rebaseStamp){
+        if(pkt->sourceStamp < _baseStamp){
+            //发生回环或另一轨道的包更早，重新计算时间戳增量
+            _baseStamp = pkt->sourceStamp;
+        }
+        auto modifiedStamp = pkt->sourceStamp - _baseStamp;
+        if(tag->stamp != modifiedStamp){
+            //仅重新生成tag头，PreviousTagSize仍然共享
+            tag = FlvTag::create(tag, pkt->typeId, modifiedStamp);
+        }
     }
-    onWriteFlvTag(pkt, modifiedStamp);
+    onWriteFlvTag(tag, pkt);
 }
 
 void FlvMuxer::stop() {
@@ -228,6 +227,8 @@ std::shared_ptr<FlvMuxer> FlvRecorder::getSharedPtr() {
 }
 
 FlvRecorder::FlvRecorder() {
+    //录制文件的时间戳从0开始
+    setRebaseStamp(true);
 }
 
 FlvRecorder::~FlvRecorder() {
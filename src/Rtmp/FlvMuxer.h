@@ -45,15 +45,26 @@ protected:
     virtual void onWrite(const Buffer::Ptr &data) = 0;
     virtual void onDetach() = 0;
     virtual std::shared_ptr<FlvMuxer> getSharedPtr() = 0;
+    /**
+     * 设置是否把时间戳改为从0开始(录制文件时使用)
+     * 默认时间戳相对于媒体源起始时间，中途加入的观看者也直接共享媒体源生成的flv tag
+     */
+    void setRebaseStamp(bool rebase);
 private:
     void onWriteFlvHeader(const RtmpMediaSource::Ptr &media);
+    void onWriteConfig(uint32_t ui32TimeStamp);
     void onWriteRtmp(const RtmpPacket::Ptr &pkt);
-    void onWriteFlvTag(const RtmpPacket::Ptr &pkt, uint32_t ui32TimeStamp);
+    void onWriteFlvTag(const FlvTag::Ptr &tag, const Buffer::Ptr &buffer);
     void onWriteFlvTag(uint8_t ui8Type, const Buffer::Ptr &buffer, uint32_t ui32TimeStamp);
 private:
     RtmpMediaSource::RingType::RingReader::Ptr _ring_reader;
-    uint32_t _aui32FirstStamp[2] = {0};
-
+    bool _rebaseStamp = false;
+    //是否已经收到第一个包
+    bool _started = false;
+    uint32_t _baseStamp = 0;
+    //metadata与config帧在收到第一个包后才能确定时间戳
+    Buffer::Ptr _metadata;
+    vector<RtmpPacket::Ptr> _configFrames;
 };
 
 class FlvRecorder : public FlvMuxer , public std::enable_shared_from_this<FlvRecorder>{
@@ -24,9 +24,37 @@
  * SOFTWARE.
  */
 #include "Rtmp.h"
+#include "utils.h"
 #include "Extension/Factory.h"
 namespace mediakit{
 
+static Buffer::Ptr makeTagHeader(uint8_t type, uint32_t data_size, uint32_t stamp) {
+    RtmpTagHeader header;
+    header.type = type;
+    set_be24(header.data_size, data_size);
+    header.timestamp_ex = (uint8_t) ((stamp >> 24) & 0xff);
+    set_be24(header.timestamp, stamp & 0xFFFFFF);
+    return std::make_shared<BufferRaw>((char *) &header, sizeof(header));
+}
+
+FlvTag::Ptr FlvTag::create(uint8_t type, uint32_t data_size, uint32_t stamp) {
+    std::shared_ptr<FlvTag> ret = std::make_shared<FlvTag>();
+    ret->stamp = stamp;
+    ret->data_size = data_size;
+    ret->header = makeTagHeader(type, data_size, stamp);
+
+    uint32_t size = htonl(data_size + sizeof(RtmpTagHeader));
+    ret->previousTagSize = std::make_shared<BufferRaw>((char *) &size, 4);
+    return ret;
+}
+
+FlvTag::Ptr FlvTag::create(const Ptr &tag, uint8_t type, uint32_t stamp) {
+    std::shared_ptr<FlvTag> ret = std::make_shared<FlvTag>(*tag);
+    ret->stamp = stamp;
+    ret->header = makeTagHeader(type, tag->data_size, stamp);
+    return ret;
+}
+
 VideoMete::VideoMete(const VideoTrack::Ptr &video,int datarate ){
     if(video->getVideoWidth() > 0 ){
         _metedata.set("width", video->getVideoWidth());
@@ -33,6 +33,7 @@
 #include "Util/logger.h"
 #include "Network/Buffer.h"
 #include "Network/sockutil.h"
+#include "Common/PacketArena.h"
 #include "amf.h"
 #include "Extension/Track.h"
 
@@ -128,10 +129,48 @@ public:
     uint8_t streamId[4]; /* Note, this is little-endian while others are BE */
 }PACKED;
 
+class RtmpTagHeader {
+public:
+    uint8_t type = 0;
+    uint8_t data_size[3] = {0};
+    uint8_t timestamp[3] = {0};
+    uint8_t timestamp_ex = 0;
+    uint8_t streamid[3] = {0}; /* Always 0. */
+}PACKED;
+
 #if defined(_WIN32)
 #pragma pack(pop)
 #endif // defined(_WIN32)
 
+/**
+ * flv tag的头部与尾部(PreviousTagSize)，tag数据即RtmpPacket本身
+ * 生成后不可修改，可以被多个线程的多个观看者共享
+ */
+class FlvTag {
+public:
+    typedef std::shared_ptr<const FlvTag> Ptr;
+
+    /**
+     * @param type tag类型
+     * @param data_size tag数据长度
+     * @param stamp 毫秒时间戳
+     */
+    static Ptr create(uint8_t type, uint32_t data_size, uint32_t stamp);
+
+    /**
+     * 以新的时间戳重新生成tag头，tag尾与原tag共享
+     * @param tag 原tag
+     * @param type tag类型
+     * @param stamp 毫秒时间戳
+     */
+    static Ptr create(const Ptr &tag, uint8_t type, uint32_t stamp);
+
+    uint32_t stamp;
+    uint32_t data_size;
+    Buffer::Ptr header;
+    Buffer::Ptr previousTagSize;
+};
+
 class RtmpPacket : public Buffer{
 public:
     typedef std::shared_ptr<RtmpPacket> Ptr;
@@ -143,6 +182,8 @@ public:
     uint32_t deltaStamp = 0;
     uint32_t streamId;
     uint32_t chunkId;
+    //相对媒体源起始时间的时间戳，由RtmpMediaSource在写入环形缓冲前设置，flv输出使用
+    uint32_t sourceStamp = 0;
     std::string strBuf;
 public:
     char *data() const override{
@@ -152,6 +193,14 @@ public:
         return strBuf.size();
     };
 public:
+    /**
+     * 在PacketArena中创建对象，避免每个消息一次malloc
+     */
+    template<typename ...ArgsType>
+    static Ptr create(ArgsType &&...args) {
+        return std::allocate_shared<RtmpPacket>(ArenaAllocator<RtmpPacket>(), std::forward<ArgsType>(args)...);
+    }
+
     RtmpPacket() = default;
     RtmpPacket(const RtmpPacket &that) = default;
     RtmpPacket &operator=(const RtmpPacket &that) = default;
@@ -166,8 +215,25 @@ public:
         deltaStamp = that.deltaStamp;
         streamId = that.streamId;
         chunkId = that.chunkId;
+        sourceStamp = that.sourceStamp;
         strBuf = std::move(that.strBuf);
     }
+
+    /**
+     * 获取本包对应的flv tag头尾，同一个包只生成一次，由所有flv观看者共享
+     */
+    FlvTag::Ptr getFlvTag() const {
+        auto tag = std::atomic_load(&_flvTag);
+        if (tag && tag->stamp == sourceStamp && tag->data_size == strBuf.size()) {
+            return tag;
+        }
+        //多个线程同时生成时以先写入者为准，结果相同
+        auto ret = FlvTag::create(typeId, strBuf.size(), sourceStamp);
+        if (std::atomic_compare_exchange_strong(&_flvTag, &tag, ret)) {
+            return ret;
+        }
+        return tag && tag->stamp == sourceStamp && tag->data_size == strBuf.size() ? tag : ret;
+    }
     bool isVideoKeyFrame() const {
         return typeId == MSG_VIDEO && (uint8_t) strBuf[0] >> 4 == FLV_KEY_FRAME
         && (uint8_t) strBuf[1] == 1;
@@ -293,6 +359,9 @@ public:
         ret = strBuf.substr(2, 2);
         return ret;
     }
+private:
+    //flv tag头尾缓存，通过原子操作读写
+    mutable FlvTag::Ptr _flvTag;
 };
 
 
@@ -0,0 +1,88 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "RtmpAggregator.h"
+#include "utils.h"
+
+//子消息头: type(1) + size(3) + timestamp(3) + timestamp_ext(1) + stream_id(3)
+#define SUB_HEADER_SIZE 11
+//子消息尾部的back pointer长度
+#define SUB_TAIL_SIZE 4
+//单个聚合消息最大字节数，避免单个消息过大
+#define AGGREGATE_MAX_SIZE (512 * 1024)
+
+namespace mediakit {
+
+RtmpAggregator::RtmpAggregator(uint32_t max_ms, const onAggregate &cb) {
+    _max_ms = max_ms;
+    _cb = cb;
+}
+
+void RtmpAggregator::input(const RtmpPacket::Ptr &pkt, bool key) {
+    if (_pending) {
+        //音频时间戳可能略小于前面视频的时间戳，所以按有符号数比较
+        bool timeout = (int32_t) (pkt->timeStamp - _pending->timeStamp) >= (int32_t) _max_ms;
+        if (pkt->typeId == MSG_VIDEO || timeout || _pending->strBuf.size() + pkt->size() > AGGREGATE_MAX_SIZE) {
+            //每个聚合消息以一帧视频开头，保证关键帧位于聚合消息起始处
+            flush();
+        }
+    }
+    if (!_pending) {
+        //聚合消息的时间戳、chunk id与第一个子消息一致
+        _pending = RtmpPacket::create();
+        _pending->typeId = MSG_AGGREGATE;
+        _pending->streamId = pkt->streamId;
+        _pending->chunkId = pkt->chunkId;
+        _pending->timeStamp = pkt->timeStamp;
+        _pending->sourceStamp = pkt->sourceStamp;
+        //视频总是开始新的聚合消息，所以只需要看第一个子消息
+        _key = key;
+    }
+
+    auto &buf = _pending->strBuf;
+    auto offset = buf.size();
+    buf.resize(offset + SUB_HEADER_SIZE + pkt->size() + SUB_TAIL_SIZE);
+    auto ptr = (uint8_t *) &buf[offset];
+    ptr[0] = pkt->typeId;
+    set_be24(ptr + 1, pkt->size());
+    //子消息时间戳为绝对时间戳，接收端按与聚合消息时间戳的差值重新计算
+    set_be24(ptr + 4, pkt->timeStamp & 0xFFFFFF);
+    ptr[7] = pkt->timeStamp >> 24;
+    set_be24(ptr + 8, 0);
+    memcpy(ptr + SUB_HEADER_SIZE, pkt->data(), pkt->size());
+    set_be32(ptr + SUB_HEADER_SIZE + pkt->size(), SUB_HEADER_SIZE + pkt->size());
+}
+
+void RtmpAggregator::flush() {
+    if (!_pending) {
+        return;
+    }
+    _pending->bodySize = _pending->strBuf.size();
+    auto pkt = std::move(_pending);
+    _cb(pkt, _key);
+}
+
+}//namespace mediakit
@@ -0,0 +1,71 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ZLMEDIAKIT_RTMPAGGREGATOR_H
+#define ZLMEDIAKIT_RTMPAGGREGATOR_H
+
+#include <functional>
+#include "Rtmp.h"
+
+namespace mediakit {
+
+/**
+ * 把一小段时间内的音视频消息合并成rtmp聚合消息(MSG_AGGREGATE)
+ * 每个聚合消息以一帧视频开头，后面跟随其后到达的音频，纯音频流按时长切分；
+ * 聚合消息在媒体源写线程中只生成一次，所有观看者共享，以降低每个消息的头部、分块以及Buffer开销
+ */
+class RtmpAggregator {
+public:
+    /**
+     * @param key 该聚合消息是否可以作为播放起始位置(以视频关键帧开头或者为纯音频流)
+     */
+    typedef std::function<void(const RtmpPacket::Ptr &pkt, bool key)> onAggregate;
+
+    /**
+     * @param max_ms 单个聚合消息最大时长，单位毫秒
+     */
+    RtmpAggregator(uint32_t max_ms, const onAggregate &cb);
+    ~RtmpAggregator() = default;
+
+    /**
+     * 输入音视频消息(不含config帧)
+     * @param key 该消息是否可以作为播放起始位置，规则与媒体源环形缓冲一致
+     */
+    void input(const RtmpPacket::Ptr &pkt, bool key);
+
+    /**
+     * 输出缓存中的消息
+     */
+    void flush();
+private:
+    uint32_t _max_ms;
+    onAggregate _cb;
+    RtmpPacket::Ptr _pending;
+    bool _key = false;
+};
+
+}//namespace mediakit
+#endif //ZLMEDIAKIT_RTMPAGGREGATOR_H
@@ -0,0 +1,184 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "RtmpKeyFrameSource.h"
+#include "Common/config.h"
+#include "Util/logger.h"
+
+namespace mediakit {
+
+unordered_map<string, RtmpKeyFrameSource::Ptr> RtmpKeyFrameSource::s_sources;
+recursive_mutex RtmpKeyFrameSource::s_mtx;
+
+string RtmpKeyFrameSource::getStreamId(const string &origin_id) {
+    GET_CONFIG(string,suffix,General::kKeyFrameStreamSuffix);
+    return origin_id + suffix;
+}
+
+bool RtmpKeyFrameSource::make(const string &vhost, const string &app, const string &id) {
+    GET_CONFIG(string,suffix,General::kKeyFrameStreamSuffix);
+    if (suffix.empty() || id.size() <= suffix.size() || id.compare(id.size() - suffix.size(), suffix.size(), suffix) != 0) {
+        //不是关键帧派生流
+        return false;
+    }
+    auto origin = dynamic_pointer_cast<RtmpMediaSource>(MediaSource::find(RTMP_SCHEMA, vhost, app, id.substr(0, id.size() - suffix.size()), false));
+    if (!origin) {
+        //源流不存在
+        return false;
+    }
+    auto key = origin->getVhost() + "/" + app + "/" + id;
+    lock_guard<recursive_mutex> lck(s_mtx);
+    if (s_sources.find(key) != s_sources.end()) {
+        //已经创建，正在等待注册
+        return true;
+    }
+    auto src = std::make_shared<RtmpKeyFrameSource>(origin, id);
+    src->_key = key;
+    s_sources.emplace(key, src);
+    src->start();
+    return true;
+}
+
+RtmpKeyFrameSource::RtmpKeyFrameSource(const RtmpMediaSource::Ptr &origin, const string &id) {
+    GET_CONFIG(bool,dropAudio,General::kKeyFrameStreamDropAudio);
+    _drop_audio = dropAudio;
+    _origin = origin;
+    //派生流不生成hls与录像
+    _src = std::make_shared<RtmpToRtspMediaSource>(origin->getVhost(), origin->getApp(), id, false, 0);
+    _poller = EventPollerPool::Instance().getPoller();
+}
+
+RtmpKeyFrameSource::~RtmpKeyFrameSource() {
+    InfoL << _key;
+}
+
+void RtmpKeyFrameSource::start() {
+    _src->setListener(shared_from_this());
+    weak_ptr<RtmpKeyFrameSource> weakSelf = shared_from_this();
+    //派生流只在该poller线程写入
+    _poller->async([weakSelf]() {
+        auto strongSelf = weakSelf.lock();
+        if (strongSelf) {
+            strongSelf->onStart();
+        }
+    }, false);
+}
+
+void RtmpKeyFrameSource::onStart() {
+    auto origin = _origin.lock();
+    if (!origin) {
+        release();
+        return;
+    }
+    auto metadata = origin->getMetaData();
+    if (metadata.type() == AMF_OBJECT || metadata.type() == AMF_ECMA_ARRAY) {
+        if (_drop_audio) {
+            //去除音频相关的metadata，否则会等待音频track就绪
+            AMFValue video_only(AMF_OBJECT);
+            metadata.object_for_each([&](const string &key, const AMFValue &val) {
+                if (key.find("audio") != 0 && key != "stereo") {
+                    video_only.set(key, val);
+                }
+            });
+            metadata = video_only;
+        }
+        _src->onGetMetaData(metadata);
+    }
+    origin->getConfigFrame([&](const RtmpPacket::Ptr &pkt) {
+        onRtmp(pkt);
+    });
+
+    weak_ptr<RtmpKeyFrameSource> weakSelf = shared_from_this();
+    _reader = origin->getRing()->attach(_poller);
+    _reader->setReadCB([weakSelf](const RtmpPacket::Ptr &pkt) {
+        auto strongSelf = weakSelf.lock();
+        if (strongSelf) {
+            strongSelf->onRtmp(pkt);
+        }
+    });
+    _reader->setDetachCB([weakSelf]() {
+        auto strongSelf = weakSelf.lock();
+        if (strongSelf) {
+            //源流已经注销
+            strongSelf->release();
+        }
+    });
+    InfoL << "开始生成关键帧流:" << _key;
+}
+
+void RtmpKeyFrameSource::onRtmp(const RtmpPacket::Ptr &pkt) {
+    switch (pkt->typeId) {
+        case MSG_VIDEO:
+            if (!pkt->isCfgFrame() && !pkt->isVideoKeyFrame()) {
+                return;
+            }
+            break;
+        case MSG_AUDIO:
+            if (_drop_audio) {
+                return;
+            }
+            break;
+        default:
+            return;
+    }
+    //RtmpMediaSource会修改包的sourceStamp，源流的包由其观看者共享，所以需要拷贝
+    _src->onWrite(RtmpPacket::create(*pkt), pkt->isVideoKeyFrame());
+}
+
+bool RtmpKeyFrameSource::close(MediaSource &sender, bool force) {
+    if (!force && _src->readerCount() != 0) {
+        return false;
+    }
+    release();
+    return true;
+}
+
+void RtmpKeyFrameSource::onNoneReader(MediaSource &sender) {
+    if (_src->readerCount() != 0) {
+        return;
+    }
+    release();
+}
+
+void RtmpKeyFrameSource::release() {
+    string key = _key;
+    //切换到写线程销毁，防止在写入派生流时销毁对象
+    _poller->async([key]() {
+        Ptr src;
+        {
+            lock_guard<recursive_mutex> lck(s_mtx);
+            auto it = s_sources.find(key);
+            if (it == s_sources.end()) {
+                return;
+            }
+            src = it->second;
+            s_sources.erase(it);
+        }
+        //在锁外销毁，派生流注销时会锁定媒体源表
+    }, false);
+}
+
+}//namespace mediakit
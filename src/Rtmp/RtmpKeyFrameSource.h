@@ -0,0 +1,88 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ZLMEDIAKIT_RTMPKEYFRAMESOURCE_H
+#define ZLMEDIAKIT_RTMPKEYFRAMESOURCE_H
+
+#include <mutex>
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include "RtmpMediaSource.h"
+#include "RtmpToRtspMediaSource.h"
+#include "Poller/EventPoller.h"
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+/**
+ * 只包含关键帧的派生流，用于电视墙、缩略图等只需要低帧率画面的场景
+ * 派生流id为源流id加上general.keyFrameStreamSuffix后缀(默认为stream_key)，
+ * 或者在播放url中添加only_key=1参数；
+ * 派生流在第一个播放器请求时创建，从源流的rtmp环形缓冲中只读取一次，过滤掉非关键帧(以及可选的音频)，
+ * 不转码，所有观看者共享；最后一个观看者离开后销毁
+ */
+class RtmpKeyFrameSource : public MediaSourceEvent, public std::enable_shared_from_this<RtmpKeyFrameSource> {
+public:
+    typedef std::shared_ptr<RtmpKeyFrameSource> Ptr;
+
+    /**
+     * 如果id是关键帧派生流并且源流存在，则创建该派生流(已经存在则忽略)
+     * 创建后派生流异步注册
+     * @return 是否为存在源流的关键帧派生流
+     */
+    static bool make(const string &vhost, const string &app, const string &id);
+
+    /**
+     * 获取源流对应的关键帧派生流id
+     */
+    static string getStreamId(const string &origin_id);
+
+    RtmpKeyFrameSource(const RtmpMediaSource::Ptr &origin, const string &id);
+    ~RtmpKeyFrameSource() override;
+
+    bool close(MediaSource &sender,bool force) override;
+    void onNoneReader(MediaSource &sender) override;
+private:
+    void start();
+    void onStart();
+    void onRtmp(const RtmpPacket::Ptr &pkt);
+    void release();
+private:
+    string _key;
+    bool _drop_audio;
+    EventPoller::Ptr _poller;
+    std::weak_ptr<RtmpMediaSource> _origin;
+    RtmpToRtspMediaSource::Ptr _src;
+    RtmpMediaSource::RingType::RingReader::Ptr _reader;
+
+    static unordered_map<string, Ptr> s_sources;
+    static recursive_mutex s_mtx;
+};
+
+}//namespace mediakit
+#endif //ZLMEDIAKIT_RTMPKEYFRAMESOURCE_H
@@ -28,6 +28,7 @@
 #define SRC_RTMP_RTMPMEDIASOURCE_H_
 
 #include <mutex>
+#include <atomic>
 #include <memory>
 #include <string>
 #include <functional>
@@ -35,8 +36,11 @@
 #include "amf.h"
 #include "Rtmp.h"
 #include "RtmpDemuxer.h"
+#include "RtmpAggregator.h"
 #include "Common/config.h"
 #include "Common/MediaSource.h"
+#include "Common/PollerRingBuffer.h"
+#include "Common/TimeShiftBuffer.h"
 #include "Util/util.h"
 #include "Util/logger.h"
 #include "Util/RingBuffer.h"
@@ -48,10 +52,47 @@ using namespace toolkit;
 
 namespace mediakit {
 
+/**
+ * rtmp包在时移溢出文件中的格式: typeId(1) + timeStamp(4) + streamId(4) + chunkId(4) + sourceStamp(4) + 负载
+ */
+template<>
+class TimeShiftCodec<RtmpPacket> {
+public:
+	static uint32_t size(const RtmpPacket &pkt) {
+		return HEADER_SIZE + pkt.strBuf.size();
+	}
+	static void save(const RtmpPacket &pkt, char *dst) {
+		dst[0] = pkt.typeId;
+		memcpy(dst + 1, &pkt.timeStamp, 4);
+		memcpy(dst + 5, &pkt.streamId, 4);
+		memcpy(dst + 9, &pkt.chunkId, 4);
+		memcpy(dst + 13, &pkt.sourceStamp, 4);
+		memcpy(dst + HEADER_SIZE, pkt.strBuf.data(), pkt.strBuf.size());
+	}
+	static RtmpPacket::Ptr load(const char *src, uint32_t size) {
+		auto pkt = RtmpPacket::create();
+		pkt->typeId = src[0];
+		memcpy(&pkt->timeStamp, src + 1, 4);
+		memcpy(&pkt->streamId, src + 5, 4);
+		memcpy(&pkt->chunkId, src + 9, 4);
+		memcpy(&pkt->sourceStamp, src + 13, 4);
+		pkt->strBuf.assign(src + HEADER_SIZE, size - HEADER_SIZE);
+		pkt->bodySize = pkt->strBuf.size();
+		return pkt;
+	}
+private:
+	static constexpr uint32_t HEADER_SIZE = 17;
+};
+
+/**
+ * rtmp媒体源
+ * onWrite/onGetMetaData只允许推流者所在线程(单写者)调用，写入路径无锁且不分配内存；
+ * 其他线程通过原子快照读取config帧、metadata以及时间戳
+ */
 class RtmpMediaSource: public MediaSource ,public RingDelegate<RtmpPacket::Ptr> {
 public:
 	typedef std::shared_ptr<RtmpMediaSource> Ptr;
-	typedef RingBuffer<RtmpPacket::Ptr> RingType;
+	typedef PollerRingBuffer<RtmpPacket::Ptr> RingType;
 
 	RtmpMediaSource(const string &vhost,
 	                const string &strApp,
@@ -60,72 +101,207 @@ public:
 			MediaSource(RTMP_SCHEMA,vhost,strApp,strId),
 			_ringSize(ringSize) {}
 
-	virtual ~RtmpMediaSource() {}
+	virtual ~RtmpMediaSource() {
+		auto timeShift = std::atomic_load(&_timeShift);
+		if (timeShift) {
+			//回看观看者读完缓存后断开
+			timeShift->close();
+		}
+	}
+
+	/**
+	 * 获取时移缓存
+	 * 时移缓存在该协议第一次有观看者请求回看(或暂停)时才创建，只缓存创建之后的数据，
+	 * 这样只有真正被回看的流、且只有被回看的协议占用内存与溢出文件
+	 * @param create 不存在时是否创建
+	 * @return 未开启直播时移或者尚未创建时返回nullptr
+	 */
+	TimeShiftBuffer<RtmpPacket>::Ptr getTimeShift(bool create = false) {
+		auto ret = std::atomic_load(&_timeShift);
+		if (ret || !create) {
+			return ret;
+		}
+		ret = TimeShiftBuffer<RtmpPacket>::create();
+		if (!ret) {
+			return nullptr;
+		}
+		TimeShiftBuffer<RtmpPacket>::Ptr expected;
+		if (!std::atomic_compare_exchange_strong(&_timeShift, &expected, ret)) {
+			//其他线程已经创建
+			return expected;
+		}
+		InfoL << "创建直播时移缓存:" << getSchema() << "/" << getVhost() << "/" << getApp() << "/" << getId();
+		return ret;
+	}
 
 	const RingType::Ptr &getRing() const {
 		//获取媒体源的rtp环形缓冲
 		return _pRing;
 	}
 
+	/**
+	 * 获取聚合消息(MSG_AGGREGATE)环形缓冲，第一次调用时创建，此后写线程开始生成聚合消息
+	 * 可在任意线程调用
+	 */
+	RingType::Ptr getAggregateRing() {
+		auto ring = std::atomic_load(&_aggregateRing);
+		if (ring) {
+			return ring;
+		}
+		weak_ptr<RtmpMediaSource> weakSelf = dynamic_pointer_cast<RtmpMediaSource>(shared_from_this());
+		GET_CONFIG(bool,ringGroupByPoller,General::kRingGroupByPoller);
+		auto ret = std::make_shared<RingType>(_ringSize,[weakSelf](const EventPoller::Ptr &,int size,bool){
+			auto strongSelf = weakSelf.lock();
+			if(!strongSelf){
+				return;
+			}
+			strongSelf->onReaderChanged(size);
+		},ringGroupByPoller);
+		//多个线程同时创建时以先写入者为准
+		if (std::atomic_compare_exchange_strong(&_aggregateRing, &ring, ret)) {
+			return ret;
+		}
+		return ring;
+	}
+
 	int readerCount() override {
-        return _pRing ? _pRing->readerCount() : 0;
+		auto aggregateRing = std::atomic_load(&_aggregateRing);
+		return (_pRing ? _pRing->readerCount() : 0) + (aggregateRing ? aggregateRing->readerCount() : 0);
 	}
 
-	const AMFValue &getMetaData() const {
-		lock_guard<recursive_mutex> lock(_mtxMap);
-		return _metadata;
+	AMFValue getMetaData() const {
+		auto metadata = std::atomic_load(&_metadata);
+		return metadata ? *metadata : AMFValue();
 	}
+
 	template<typename FUN>
 	void getConfigFrame(const FUN &f) {
-		lock_guard<recursive_mutex> lock(_mtxMap);
-		for (auto &pr : _mapCfgFrame) {
-			f(pr.second);
+		auto cfg = std::atomic_load(&_cfgFrame);
+		if (!cfg) {
+			return;
+		}
+		for (auto &pkt : cfg->frames) {
+			if (pkt) {
+				f(pkt);
+			}
 		}
 	}
 
 	virtual void onGetMetaData(const AMFValue &metadata) {
-		lock_guard<recursive_mutex> lock(_mtxMap);
-		_metadata = metadata;
+		std::atomic_store(&_metadata, std::make_shared<const AMFValue>(metadata));
 	}
 
     void onWrite(const RtmpPacket::Ptr &pkt,bool isKey = true) override {
-		lock_guard<recursive_mutex> lock(_mtxMap);
+		auto index = trackIndex(pkt->typeId);
 		if (pkt->isCfgFrame()) {
-			_mapCfgFrame[pkt->typeId] = pkt;
+			onConfigFrame(index, pkt);
             return;
 		}
 
-        _mapStamp[pkt->typeId] = pkt->timeStamp;
+		if (index >= 0) {
+			_stamp[index].store(pkt->timeStamp, std::memory_order_relaxed);
+		}
+		//flv观看者共享的tag时间戳，在此统一计算，不再由每个观看者各自计算
+		pkt->sourceStamp = sourceStamp(index, pkt->timeStamp);
 
         if(!_pRing){
             weak_ptr<RtmpMediaSource> weakSelf = dynamic_pointer_cast<RtmpMediaSource>(shared_from_this());
+            GET_CONFIG(bool,ringGroupByPoller,General::kRingGroupByPoller);
             _pRing = std::make_shared<RingType>(_ringSize,[weakSelf](const EventPoller::Ptr &,int size,bool){
                 auto strongSelf = weakSelf.lock();
                 if(!strongSelf){
                     return;
                 }
                 strongSelf->onReaderChanged(size);
-            });
+            },ringGroupByPoller);
             onReaderChanged(0);
             regist();
         }
-        _pRing->write(pkt,pkt->isVideoKeyFrame());
+        //纯音频流每个包都可以作为起始位置
+        bool key = pkt->isVideoKeyFrame() || (index == TrackAudio && !_cfgFrameWriter.frames[TrackVideo]);
+        _pRing->write(pkt,key);
+        auto timeShift = std::atomic_load(&_timeShift);
+        if (timeShift && index >= 0) {
+            timeShift->write(pkt, pkt->timeStamp, key);
+        }
+        if (index >= 0) {
+            writeAggregate(pkt, key);
+        }
         checkNoneReader();
     }
 
 	uint32_t getTimeStamp(TrackType trackType) override {
-		lock_guard<recursive_mutex> lock(_mtxMap);
+		auto video = _stamp[TrackVideo].load(std::memory_order_relaxed);
+		auto audio = _stamp[TrackAudio].load(std::memory_order_relaxed);
 		switch (trackType){
 			case TrackVideo:
-				return _mapStamp[MSG_VIDEO];
+				return video;
 			case TrackAudio:
-				return _mapStamp[MSG_AUDIO];
+				return audio;
 			default:
-				return MAX(_mapStamp[MSG_VIDEO],_mapStamp[MSG_AUDIO]);
+				return MAX(video,audio);
 		}
 	}
 
 private:
+	//音视频轨道在定长数组中的下标
+	static int trackIndex(int typeId) {
+		switch (typeId) {
+			case MSG_VIDEO: return TrackVideo;
+			case MSG_AUDIO: return TrackAudio;
+			default: return -1;
+		}
+	}
+
+	//计算相对媒体源起始时间的时间戳，只在写线程调用
+	uint32_t sourceStamp(int index, uint32_t stamp) {
+		//metadata等其他包以视频为基准
+		if (index < 0) {
+			index = TrackVideo;
+		}
+		if (!_firstStampSet[index]) {
+			_firstStampSet[index] = true;
+			_firstStamp[index] = stamp;
+		}
+		if (stamp >= _firstStamp[index]) {
+			return stamp - _firstStamp[index];
+		}
+		//发生回环，重新计算时间戳增量
+		CLEAR_ARR(_firstStampSet);
+		_firstStampSet[index] = true;
+		_firstStamp[index] = stamp;
+		return 0;
+	}
+
+	//有聚合消息观看者时才生成聚合消息，只在写线程调用
+	void writeAggregate(const RtmpPacket::Ptr &pkt, bool key) {
+		auto ring = std::atomic_load(&_aggregateRing);
+		if (!ring) {
+			return;
+		}
+		if (!_aggregator) {
+			GET_CONFIG(uint32_t,aggregateMS,Rtmp::kAggregateMS);
+			weak_ptr<RingType> weakRing = ring;
+			_aggregator = std::make_shared<RtmpAggregator>(aggregateMS,[weakRing](const RtmpPacket::Ptr &pkt, bool key){
+				auto ring = weakRing.lock();
+				if (ring) {
+					ring->write(pkt, key);
+				}
+			});
+		}
+		_aggregator->input(pkt, key);
+	}
+
+	void onConfigFrame(int index, const RtmpPacket::Ptr &pkt) {
+		//推流端一般每个关键帧前都会重发config帧，内容未变化时不必重新发布快照
+		auto &last = _cfgFrameWriter.frames[index];
+		if (last && last->strBuf == pkt->strBuf) {
+			return;
+		}
+		last = pkt;
+		std::atomic_store(&_cfgFrame, std::make_shared<const ConfigFrames>(_cfgFrameWriter));
+	}
+
     void onReaderChanged(int size){
 	    //我们记录最后一次活动时间
         _readerTicker.resetTime();
@@ -145,11 +321,25 @@ private:
         }
     }
 protected:
-	AMFValue _metadata;
-    unordered_map<int, RtmpPacket::Ptr> _mapCfgFrame;
-	unordered_map<int,uint32_t> _mapStamp;
-	mutable recursive_mutex _mtxMap;
-	RingBuffer<RtmpPacket::Ptr>::Ptr _pRing; //rtp环形缓冲
+	struct ConfigFrames {
+		RtmpPacket::Ptr frames[TrackAudio + 1];
+	};
+	//以下快照由写线程整体替换，读线程通过atomic_load获取
+	std::shared_ptr<const AMFValue> _metadata;
+	std::shared_ptr<const ConfigFrames> _cfgFrame;
+	//写线程私有的config帧副本，用于比较是否变化
+	ConfigFrames _cfgFrameWriter;
+	//写线程私有的起始时间戳
+	uint32_t _firstStamp[TrackAudio + 1] = {0};
+	bool _firstStampSet[TrackAudio + 1] = {false};
+	std::atomic<uint32_t> _stamp[TrackAudio + 1] {{0}, {0}};
+	RingType::Ptr _pRing; //rtp环形缓冲
+	//直播时移缓存
+	TimeShiftBuffer<RtmpPacket>::Ptr _timeShift;
+	//聚合消息环形缓冲，由观看者按需创建
+	RingType::Ptr _aggregateRing;
+	//写线程私有的聚合器
+	std::shared_ptr<RtmpAggregator> _aggregator;
 	int _ringSize;
 	Ticker _readerTicker;
     bool _asyncEmitNoneReader = false;
@@ -353,7 +353,7 @@ void RtmpPlayer::onRtmpChunk(RtmpPacket &chunkData) {
             if (_aNowStampTicker[idx].elapsedTime() > 500) {
                 _aiNowStamp[idx] = chunkData.timeStamp;
             }
-			onMediaData_l(std::make_shared<RtmpPacket>(std::move(chunkData)));
+			onMediaData_l(RtmpPacket::create(std::move(chunkData)));
 		}
 			break;
 		default:
@@ -224,7 +224,7 @@ void RtmpProtocol::sendRtmp(uint8_t ui8Type, uint32_t ui32StreamId,
     bool bExtStamp = ui32TimeStamp >= 0xFFFFFF;
 
     //rtmp头
-	BufferRaw::Ptr bufferHeader = obtainBuffer();
+	ArenaBuffer::Ptr bufferHeader = obtainBuffer();
 	bufferHeader->setCapacity(sizeof(RtmpHeader));
 	bufferHeader->setSize(sizeof(RtmpHeader));
 	//对rtmp头赋值，如果使用整形赋值，在arm android上可能由于数据对齐导致总线错误的问题
@@ -238,7 +238,7 @@ void RtmpProtocol::sendRtmp(uint8_t ui8Type, uint32_t ui32StreamId,
     onSendRawData(bufferHeader);
 
     //扩展时间戳字段
-	BufferRaw::Ptr bufferExtStamp;
+	ArenaBuffer::Ptr bufferExtStamp;
     if (bExtStamp) {
         //生成扩展时间戳
 		bufferExtStamp = obtainBuffer();
@@ -248,7 +248,7 @@ void RtmpProtocol::sendRtmp(uint8_t ui8Type, uint32_t ui32StreamId,
 	}
 
 	//生成一个字节的flag，标明是什么chunkId
-	BufferRaw::Ptr bufferFlags = obtainBuffer();
+	ArenaBuffer::Ptr bufferFlags = obtainBuffer();
 	bufferFlags->setCapacity(1);
 	bufferFlags->setSize(1);
 	bufferFlags->data()[0] = (iChunkId & 0x3f) | (3 << 6);
@@ -716,6 +716,9 @@ void RtmpProtocol::handle_rtmpChunk(RtmpPacket& chunkData) {
 		case MSG_AGGREGATE: {
 			auto ptr = (uint8_t*)chunkData.strBuf.data();
 			auto ptr_tail = ptr + chunkData.strBuf.length() ;
+			//子消息时间戳减去第一个子消息时间戳后加上聚合消息的时间戳
+			bool first_sub = true;
+			uint32_t first_ts = 0;
 			while(ptr + 8 + 3 < ptr_tail){
 				auto type = *ptr;
 				ptr += 1;
@@ -750,8 +753,11 @@ void RtmpProtocol::handle_rtmpChunk(RtmpPacket& chunkData) {
 					}
 				 */
 				ptr += 3;
-				//参考FFmpeg多拷贝了4个字节
-				size += 4;
+				if(first_sub){
+					first_sub = false;
+					first_ts = ts;
+				}
+				//子消息后面跟随4个字节的back pointer，不属于消息负载
 				if(ptr + size > ptr_tail){
 //				    ErrorL << ptr + size << " " << ptr_tail << " " << ptr_tail - ptr - size;
 					break;
@@ -762,11 +768,11 @@ void RtmpProtocol::handle_rtmpChunk(RtmpPacket& chunkData) {
 				memcpy((char *)sub_packet.strBuf.data(),ptr,size);
 				sub_packet.typeId = type;
 				sub_packet.bodySize = size;
-				sub_packet.timeStamp = ts;
+				sub_packet.timeStamp = chunkData.timeStamp + (ts - first_ts);
 				sub_packet.streamId = chunkData.streamId;
 				sub_packet.chunkId = chunkData.chunkId;
 				handle_rtmpChunk(sub_packet);
-				ptr += size;
+				ptr += size + 4;
 			}
 //			InfoL << ptr_tail - ptr;
 		}
@@ -777,11 +783,11 @@ void RtmpProtocol::handle_rtmpChunk(RtmpPacket& chunkData) {
 		}
 }
 
-BufferRaw::Ptr RtmpProtocol::obtainBuffer() {
-    return std::make_shared<BufferRaw>() ;//_bufferPool.obtain();
+ArenaBuffer::Ptr RtmpProtocol::obtainBuffer() {
+    return ArenaBuffer::create();
 }
 
-BufferRaw::Ptr RtmpProtocol::obtainBuffer(const void *data, int len) {
+ArenaBuffer::Ptr RtmpProtocol::obtainBuffer(const void *data, int len) {
 	auto buffer = obtainBuffer();
 	buffer->assign((const char *)data,len);
 	return buffer;
@@ -81,9 +81,8 @@ protected:
 	int _iNowStreamID = 0;
 	int _iNowChunkID = 0;
 	bool _bDataStarted = false;
-	inline BufferRaw::Ptr obtainBuffer();
-	inline BufferRaw::Ptr obtainBuffer(const void *data, int len);
-	//ResourcePool<BufferRaw,MAX_SEND_PKT> _bufferPool;
+	inline ArenaBuffer::Ptr obtainBuffer();
+	inline ArenaBuffer::Ptr obtainBuffer(const void *data, int len);
 private:
 	void handle_S0S1S2(const function<void()> &cb);
 	void handle_C0C1();
@@ -284,31 +284,105 @@ void RtmpSession::sendPlayResponse(const string &err,const RtmpMediaSource::Ptr
         onSendMedia(pkt);
     });
 
-    _pRingReader = src->getRing()->attach(getPoller());
-    weak_ptr<RtmpSession> weakSelf = dynamic_pointer_cast<RtmpSession>(shared_from_this());
     SockUtil::setNoDelay(_sock->rawFD(), false);
-    _pRingReader->setReadCB([weakSelf](const RtmpPacket::Ptr &pkt) {
+    attachRing(src);
+    _pPlayerSrc = src;
+    if (src->readerCount() == 1) {
+        src->seekTo(0);
+    }
+
+    //shift参数指定从直播时移缓存中回看若干秒之前的内容
+    auto shift = _mediaInfo._params.find("shift");
+    if (shift != _mediaInfo._params.end() && atoi(shift->second.data()) > 0 && src->getTimeShift(true)) {
+        auto stamp = src->getTimeShift()->liveStamp() - atoi(shift->second.data()) * 1000;
+        if (!startTimeShift(src, stamp)) {
+            WarnP(this) << "直播时移缓存中没有关键帧，从直播位置开始播放";
+        }
+    }
+
+    //提高发送性能
+    (*this) << SocketFlags(kSockFlags);
+    SockUtil::setNoDelay(_sock->rawFD(),false);
+}
+
+void RtmpSession::attachRing(const RtmpMediaSource::Ptr &src) {
+    //聚合消息由媒体源只生成一次，所有使用聚合消息的观看者共享
+    GET_CONFIG(bool,aggregateDefault,Rtmp::kAggregate);
+    bool aggregate = aggregateDefault;
+    auto it = _mediaInfo._params.find("aggregate");
+    if (it != _mediaInfo._params.end()) {
+        aggregate = atoi(it->second.data());
+    }
+    _pRingReader = (aggregate ? src->getAggregateRing() : src->getRing())->attach(getPoller());
+    weak_ptr<RtmpSession> weakSelf = dynamic_pointer_cast<RtmpSession>(shared_from_this());
+    enableRingRead(true);
+    _pRingReader->setDetachCB([weakSelf]() {
         auto strongSelf = weakSelf.lock();
         if (!strongSelf) {
             return;
         }
-        strongSelf->onSendMedia(pkt);
+        strongSelf->shutdown(SockException(Err_shutdown,"rtmp ring buffer detached"));
     });
-    _pRingReader->setDetachCB([weakSelf]() {
+}
+
+void RtmpSession::enableRingRead(bool enable) {
+    if (!enable) {
+        _pRingReader->setReadCB(nullptr);
+        return;
+    }
+    weak_ptr<RtmpSession> weakSelf = dynamic_pointer_cast<RtmpSession>(shared_from_this());
+    _pRingReader->setReadCB([weakSelf](const RtmpPacket::Ptr &pkt) {
         auto strongSelf = weakSelf.lock();
         if (!strongSelf) {
             return;
         }
-        strongSelf->shutdown(SockException(Err_shutdown,"rtmp ring buffer detached"));
+        strongSelf->onSendMedia(pkt);
     });
-    _pPlayerSrc = src;
-    if (src->readerCount() == 1) {
-        src->seekTo(0);
+}
+
+bool RtmpSession::startTimeShift(const RtmpMediaSource::Ptr &src, uint32_t stamp) {
+    auto buffer = src->getTimeShift();
+    if (!buffer || !_pRingReader) {
+        return false;
+    }
+    if (!_pTimeShiftReader) {
+        weak_ptr<RtmpSession> weakSelf = dynamic_pointer_cast<RtmpSession>(shared_from_this());
+        auto reader = std::make_shared<TimeShiftReader<RtmpPacket> >(buffer, getPoller());
+        reader->setReadCB([weakSelf](const RtmpPacket::Ptr &pkt) {
+            auto strongSelf = weakSelf.lock();
+            if (!strongSelf) {
+                return;
+            }
+            strongSelf->onSendMedia(pkt);
+        });
+        reader->setDetachCB([weakSelf]() {
+            auto strongSelf = weakSelf.lock();
+            if (!strongSelf) {
+                return;
+            }
+            strongSelf->shutdown(SockException(Err_shutdown,"rtmp time shift buffer detached"));
+        });
+        if (!reader->seek(stamp)) {
+            return false;
+        }
+        _pTimeShiftReader = reader;
+    } else if (!_pTimeShiftReader->seek(stamp)) {
+        return false;
     }
+    _pTimeShiftReader->pause(false);
+    //环形缓冲读取器保持attach以便统计观看人数
+    enableRingRead(false);
+    InfoP(this) << "直播时移，落后直播:" << _pTimeShiftReader->getDelay() << "ms";
+    return true;
+}
 
-    //提高发送性能
-    (*this) << SocketFlags(kSockFlags);
-    SockUtil::setNoDelay(_sock->rawFD(),false);
+void RtmpSession::stopTimeShift(const RtmpMediaSource::Ptr &src) {
+    if (!_pTimeShiftReader) {
+        return;
+    }
+    _pTimeShiftReader = nullptr;
+    //重新attach以便从gop缓存的关键帧开始播放
+    attachRing(src);
 }
 
 void RtmpSession::doPlayResponse(const string &err,const std::function<void(bool)> &cb){
@@ -384,17 +458,22 @@ void RtmpSession::onCmd_pause(AMFDecoder &dec) {
 	if (!_pRingReader) {
 		throw std::runtime_error("Rtmp not started yet!");
 	}
+	if (_pTimeShiftReader) {
+		//回看中，暂停恢复后从暂停位置继续
+		_pTimeShiftReader->pause(paused);
+		return;
+	}
+	auto src = _pPlayerSrc.lock();
+	//暂停时创建时移缓存，恢复后才能从暂停位置继续
+	auto buffer = src ? src->getTimeShift(paused) : nullptr;
 	if (paused) {
-		_pRingReader->setReadCB(nullptr);
-	} else {
-		weak_ptr<RtmpSession> weakSelf = dynamic_pointer_cast<RtmpSession>(shared_from_this());
-		_pRingReader->setReadCB([weakSelf](const RtmpPacket::Ptr &pkt) {
-			auto strongSelf = weakSelf.lock();
-			if(!strongSelf) {
-				return;
-			}
-            strongSelf->onSendMedia(pkt);
-		});
+		_ui32PauseStamp = buffer ? buffer->liveStamp() : 0;
+		enableRingRead(false);
+		return;
+	}
+	//开启直播时移时，恢复后从暂停位置开始回看
+	if (!buffer || !startTimeShift(src, _ui32PauseStamp)) {
+		enableRingRead(true);
 	}
 }
 
@@ -461,7 +540,7 @@ void RtmpSession::onRtmpChunk(RtmpPacket &chunkData) {
 		if(rtmp_modify_stamp){
 			chunkData.timeStamp = _stampTicker[chunkData.typeId % 2].elapsedTime();
 		}
-		_pPublisherSrc->onWrite(std::make_shared<RtmpPacket>(std::move(chunkData)));
+		_pPublisherSrc->onWrite(RtmpPacket::create(std::move(chunkData)));
 	}
 		break;
 	default:
@@ -475,8 +554,17 @@ void RtmpSession::onCmd_seek(AMFDecoder &dec) {
     auto milliSeconds = dec.load<AMFValue>().as_number();
     InfoP(this) << "rtmp seekTo(ms):" << milliSeconds;
     auto stongSrc = _pPlayerSrc.lock();
-    if (stongSrc) {
-        stongSrc->seekTo(milliSeconds);
+    if (stongSrc && !stongSrc->seekTo(milliSeconds) && stongSrc->getTimeShift(true)) {
+        //直播源不支持seek，在时移缓存中定位，seek位置相对于开始播放时的时间戳
+        //聚合消息播放时使用聚合消息的起始时间戳，回看中数据不再聚合
+        auto first = _aui32FirstStamp[(_aui32FirstStamp[2] && !_pTimeShiftReader) ? 2 : (_aui32FirstStamp[1] ? 1 : 0)];
+        uint32_t stamp = first + (uint32_t) milliSeconds;
+        if ((int32_t) (stongSrc->getTimeShift()->liveStamp() - stamp) <= 0) {
+            //seek到直播位置
+            stopTimeShift(stongSrc);
+        } else {
+            startTimeShift(stongSrc, stamp);
+        }
     }
 	AMFValue status(AMF_OBJECT);
 	AMFEncoder invoke;
@@ -488,7 +576,8 @@ void RtmpSession::onCmd_seek(AMFDecoder &dec) {
 
 void RtmpSession::onSendMedia(const RtmpPacket::Ptr &pkt) {
 	auto modifiedStamp = pkt->timeStamp;
-	auto &firstStamp = _aui32FirstStamp[pkt->typeId % 2];
+	//聚合消息使用独立的起始时间戳，其子消息时间戳由接收端按差值计算
+	auto &firstStamp = _aui32FirstStamp[pkt->typeId == MSG_AGGREGATE ? 2 : pkt->typeId % 2];
 	if(!firstStamp){
 		firstStamp = modifiedStamp;
 	}
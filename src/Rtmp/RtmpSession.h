@@ -67,6 +67,11 @@ private:
 	void onCmd_pause(AMFDecoder &dec);
 	void setMetaData(AMFDecoder &dec);
 
+	void attachRing(const RtmpMediaSource::Ptr &src);
+	void enableRingRead(bool enable);
+	bool startTimeShift(const RtmpMediaSource::Ptr &src, uint32_t stamp);
+	void stopTimeShift(const RtmpMediaSource::Ptr &src);
+
 	void onSendMedia(const RtmpPacket::Ptr &pkt);
 	void onSendRawData(const Buffer::Ptr &buffer) override{
         _ui64TotalBytes += buffer->size();
@@ -89,10 +94,15 @@ private:
 	double _dNowReqID = 0;
 	Ticker _ticker;//数据接收时间
 	SmoothTicker _stampTicker[2];//时间戳生产器
-	RingBuffer<RtmpPacket::Ptr>::RingReader::Ptr _pRingReader;
+	RtmpMediaSource::RingType::RingReader::Ptr _pRingReader;
 	std::shared_ptr<RtmpMediaSource> _pPublisherSrc;
 	std::weak_ptr<RtmpMediaSource> _pPlayerSrc;
-	uint32_t _aui32FirstStamp[2] = {0};
+	//直播时移回看读取器，回看期间环形缓冲读取器保持attach但不再读取数据
+	TimeShiftReader<RtmpPacket>::Ptr _pTimeShiftReader;
+	//直播暂停时的时间戳，恢复后从该位置开始回看
+	uint32_t _ui32PauseStamp = 0;
+	//音频、视频、聚合消息的起始时间戳
+	uint32_t _aui32FirstStamp[3] = {0};
 	//消耗的总流量
 	uint64_t _ui64TotalBytes = 0;
 
@@ -0,0 +1,126 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "MpegFrameWriter.h"
+#if defined(ENABLE_RTPPROXY)
+#include "mpeg-ts-proto.h"
+#include "Util/logger.h"
+#include "Extension/AAC.h"
+#include "Extension/H264.h"
+#include "Extension/H265.h"
+
+namespace mediakit {
+
+MpegFrameWriter::MpegFrameWriter(const string &vhost, const string &app, const string &stream_id) {
+    _stream_id = stream_id;
+    _muxer = std::make_shared<MultiMediaSourceMuxer>(vhost, app, stream_id, 0, true, true, true, 0);
+}
+
+void MpegFrameWriter::inputEs(int codecid, uint32_t pts, uint32_t dts, const char *data, int bytes) {
+    addTrack(codecid);
+    switch (codecid) {
+        case PSI_STREAM_H264:
+        case PSI_STREAM_H265:
+            inputH26x(codecid, data, bytes, dts, pts);
+            break;
+        case PSI_STREAM_AAC:
+            inputAAC(data, bytes, dts);
+            break;
+        default:
+            break;
+    }
+}
+
+void MpegFrameWriter::addTrack(int codecid) {
+    if (_codecs.count(codecid)) {
+        return;
+    }
+    switch (codecid) {
+        case PSI_STREAM_H264:
+            _muxer->addTrack(std::make_shared<H264Track>());
+            break;
+        case PSI_STREAM_H265:
+            _muxer->addTrack(std::make_shared<H265Track>());
+            break;
+        case PSI_STREAM_AAC:
+            _muxer->addTrack(std::make_shared<AACTrack>());
+            break;
+        default:
+            _codecs[codecid] = false;
+            WarnL << _stream_id << " 不支持的负载类型:" << codecid;
+            return;
+    }
+    _codecs[codecid] = true;
+    InfoL << _stream_id << " 添加track:" << codecid;
+}
+
+void MpegFrameWriter::inputH26x(int codecid, const char *data, int bytes, uint32_t dts, uint32_t pts) {
+    //一个pes包可能包含sps、pps、idr等多个nalu
+    splitH264(data, bytes, [&](const char *ptr, int len) {
+        int prefix;
+        if (len > 4 && memcmp(ptr, "\x00\x00\x00\x01", 4) == 0) {
+            prefix = 4;
+        } else if (len > 3 && memcmp(ptr, "\x00\x00\x01", 3) == 0) {
+            prefix = 3;
+        } else {
+            return;
+        }
+        if (codecid == PSI_STREAM_H264) {
+            _muxer->inputFrame(std::make_shared<H264FrameNoCacheAble>((char *) ptr, len, dts, pts, prefix));
+        } else {
+            _muxer->inputFrame(std::make_shared<H265FrameNoCacheAble>((char *) ptr, len, dts, pts, prefix));
+        }
+    });
+}
+
+void MpegFrameWriter::inputAAC(const char *data, int bytes, uint32_t dts) {
+    //一个pes包可能包含多个adts帧，pes时间戳为第一帧的时间戳，后续帧按每帧1024个采样递增
+    auto ptr = (const uint8_t *) data;
+    auto end = ptr + bytes;
+    int index = 0;
+    while (end - ptr > 7) {
+        if (ptr[0] != 0xFF || (ptr[1] & 0xF0) != 0xF0) {
+            WarnL << _stream_id << " 非adts格式的aac数据";
+            break;
+        }
+        int frame_len = ((ptr[3] & 0x03) << 11) | (ptr[4] << 3) | (ptr[5] >> 5);
+        if (frame_len <= 7 || frame_len > end - ptr) {
+            break;
+        }
+        auto sample_rate = samplingFrequencyTable[(ptr[2] & 0x3C) >> 2];
+        auto stamp = sample_rate ? dts + (uint32_t) (index * 1024LL * 1000 / sample_rate) : dts;
+        _muxer->inputFrame(std::make_shared<AACFrameNoCacheAble>((char *) ptr, frame_len, stamp, 7));
+        ptr += frame_len;
+        ++index;
+    }
+}
+
+int MpegFrameWriter::readerCount() const {
+    return _muxer->readerCount();
+}
+
+}//namespace mediakit
+#endif//defined(ENABLE_RTPPROXY)
@@ -0,0 +1,77 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ZLMEDIAKIT_MPEGFRAMEWRITER_H
+#define ZLMEDIAKIT_MPEGFRAMEWRITER_H
+
+#if defined(ENABLE_RTPPROXY)
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include "Common/MultiMediaSourceMuxer.h"
+using namespace std;
+
+namespace mediakit {
+
+/**
+ * 把mpeg-ps/ts解复用出的es数据切分成H264/H265/AAC帧，写入MultiMediaSourceMuxer
+ * 首次遇到某种编码时自动添加对应的Track
+ */
+class MpegFrameWriter {
+public:
+    typedef std::shared_ptr<MpegFrameWriter> Ptr;
+
+    MpegFrameWriter(const string &vhost, const string &app, const string &stream_id);
+    ~MpegFrameWriter() = default;
+
+    /**
+     * 输入一个pes包的es数据
+     * @param codecid PSI_STREAM_XXX
+     * @param pts 显示时间戳，单位毫秒
+     * @param dts 解码时间戳，单位毫秒
+     * @param data es数据
+     * @param bytes es数据长度
+     */
+    void inputEs(int codecid, uint32_t pts, uint32_t dts, const char *data, int bytes);
+
+    /**
+     * 观看者个数
+     */
+    int readerCount() const;
+private:
+    void addTrack(int codecid);
+    void inputH26x(int codecid, const char *data, int bytes, uint32_t dts, uint32_t pts);
+    void inputAAC(const char *data, int bytes, uint32_t dts);
+private:
+    string _stream_id;
+    MultiMediaSourceMuxer::Ptr _muxer;
+    //已经添加到muxer的codecid，false代表不支持的编码
+    unordered_map<int, bool> _codecs;
+};
+
+}//namespace mediakit
+#endif//defined(ENABLE_RTPPROXY)
+#endif //ZLMEDIAKIT_MPEGFRAMEWRITER_H
@@ -0,0 +1,66 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "PSDecoder.h"
+#if defined(ENABLE_RTPPROXY)
+#include "mpeg-ps.h"
+
+namespace mediakit {
+
+PSDecoder::PSDecoder() {
+    _ps_demuxer = ps_demuxer_create([](void *param,
+                                       int stream,
+                                       int codecid,
+                                       int flags,
+                                       int64_t pts,
+                                       int64_t dts,
+                                       const void *data,
+                                       size_t bytes) {
+        PSDecoder *thiz = (PSDecoder *) param;
+        if (thiz->_on_decode) {
+            thiz->_on_decode(stream, codecid, flags, pts, dts, data, bytes);
+        }
+        return 0;
+    }, this);
+}
+
+PSDecoder::~PSDecoder() {
+    if (_ps_demuxer) {
+        ps_demuxer_destroy(_ps_demuxer);
+        _ps_demuxer = nullptr;
+    }
+}
+
+int PSDecoder::input(const uint8_t *data, size_t bytes) {
+    return (int) ps_demuxer_input(_ps_demuxer, data, bytes);
+}
+
+void PSDecoder::setOnDecode(const PSDecoder::onDecode &cb) {
+    _on_decode = cb;
+}
+
+}//namespace mediakit
+#endif//#if defined(ENABLE_RTPPROXY)
@@ -0,0 +1,76 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ZLMEDIAKIT_PSDECODER_H
+#define ZLMEDIAKIT_PSDECODER_H
+
+#if defined(ENABLE_RTPPROXY)
+#include <stdint.h>
+#include <functional>
+using namespace std;
+
+struct ps_demuxer_t;
+
+namespace mediakit {
+
+/**
+ * mpeg-ps解复用器，对libmpeg中ps_demuxer的简单封装
+ */
+class PSDecoder {
+public:
+    /**
+     * 解复用出一帧es数据
+     * @param stream 流id
+     * @param codecid PSI_STREAM_XXX
+     * @param flags 是否为关键帧等标志位
+     * @param pts 显示时间戳，单位90KHz
+     * @param dts 解码时间戳，单位90KHz
+     * @param data es数据
+     * @param bytes es数据长度
+     */
+    typedef function<void(int stream, int codecid, int flags, int64_t pts, int64_t dts, const void *data, size_t bytes)> onDecode;
+
+    PSDecoder();
+    ~PSDecoder();
+
+    /**
+     * 输入完整的ps包(一个或多个pack)
+     * @return 消费的字节数
+     */
+    int input(const uint8_t *data, size_t bytes);
+
+    /**
+     * 设置es帧回调
+     */
+    void setOnDecode(const onDecode &cb);
+private:
+    struct ps_demuxer_t *_ps_demuxer = nullptr;
+    onDecode _on_decode;
+};
+
+}//namespace mediakit
+#endif //defined(ENABLE_RTPPROXY)
+#endif //ZLMEDIAKIT_PSDECODER_H
@@ -0,0 +1,136 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "RtpProcess.h"
+#if defined(ENABLE_RTPPROXY)
+#include "Util/logger.h"
+
+//rtp中ps流的时钟频率固定为90KHz
+#define PS_CLOCK_RATE 90000
+//单个ps帧最大缓存，防止发送端一直不更换时间戳导致内存无限增长
+#define PS_MAX_SIZE (4 * 1024 * 1024)
+
+namespace mediakit {
+
+RtpProcess::RtpProcess(const string &stream_id) {
+    _stream_id = stream_id;
+    _track = std::make_shared<SdpTrack>();
+    _track->_interleaved = 0;
+    _track->_samplerate = PS_CLOCK_RATE;
+    _track->_type = TrackVideo;
+    _track->_ssrc = 0;
+
+    memset(&_addr, 0, sizeof(_addr));
+    GET_CONFIG(string, appName, RtpProxy::kAppName);
+    _writer = std::make_shared<MpegFrameWriter>(DEFAULT_VHOST, appName, _stream_id);
+
+    _decoder.setOnDecode([this](int stream, int codecid, int flags, int64_t pts, int64_t dts, const void *data, size_t bytes) {
+        //90KHz时间戳转换成毫秒
+        _writer->inputEs(codecid, (uint32_t) (pts / (PS_CLOCK_RATE / 1000)), (uint32_t) (dts / (PS_CLOCK_RATE / 1000)), (const char *) data, (int) bytes);
+    });
+    DebugL << _stream_id;
+}
+
+RtpProcess::~RtpProcess() {
+    DebugL << _stream_id << " " << getPeerIp() << ":" << getPeerPort() << " 总计接收:" << _total_bytes;
+}
+
+bool RtpProcess::inputRtp(const char *data, int len, const struct sockaddr *addr) {
+    lock_guard<recursive_mutex> lck(_mtx);
+    if (!_addr_inited) {
+        _addr_inited = true;
+        memcpy(&_addr, addr, sizeof(_addr));
+        InfoL << _stream_id << " 开始接收rtp:" << getPeerIp() << ":" << getPeerPort();
+    } else if (memcmp(&_addr, addr, sizeof(_addr)) != 0) {
+        //发送端可能因为重连而改变了端口，以最新的为准
+        memcpy(&_addr, addr, sizeof(_addr));
+    }
+    _total_bytes += len;
+    _last_rtp_time.resetTime();
+    return handleOneRtp(0, _track, (unsigned char *) data, len);
+}
+
+void RtpProcess::onRtpSorted(const RtpPacket::Ptr &rtp, int track_index) {
+    if (!_ps_cache.empty() && rtp->timeStamp != _ps_stamp) {
+        //时间戳变了，说明上一帧已经接收完毕
+        flushPS();
+    }
+    _ps_stamp = rtp->timeStamp;
+    _ps_cache.append(rtp->data() + rtp->offset, rtp->size() - rtp->offset);
+    if (rtp->mark || _ps_cache.size() > PS_MAX_SIZE) {
+        //mark位代表一帧的最后一个rtp包
+        flushPS();
+    }
+}
+
+void RtpProcess::flushPS() {
+    auto ptr = (const uint8_t *) _ps_cache.data();
+    auto size = _ps_cache.size();
+    while (size > 0) {
+        auto ret = _decoder.input(ptr, size);
+        if (ret <= 0 || (size_t) ret > size) {
+            break;
+        }
+        ptr += ret;
+        size -= ret;
+    }
+    _ps_cache.clear();
+}
+
+bool RtpProcess::alive() {
+    lock_guard<recursive_mutex> lck(_mtx);
+    GET_CONFIG(int, timeoutSec, RtpProxy::kTimeoutSec);
+    return _last_rtp_time.elapsedTime() / 1000 < (uint64_t) timeoutSec;
+}
+
+const string &RtpProcess::getStreamId() const {
+    return _stream_id;
+}
+
+uint32_t RtpProcess::getSSRC() const {
+    return _track->_ssrc;
+}
+
+string RtpProcess::getPeerIp() {
+    lock_guard<recursive_mutex> lck(_mtx);
+    return inet_ntoa(((struct sockaddr_in *) &_addr)->sin_addr);
+}
+
+uint16_t RtpProcess::getPeerPort() {
+    lock_guard<recursive_mutex> lck(_mtx);
+    return ntohs(((struct sockaddr_in *) &_addr)->sin_port);
+}
+
+uint64_t RtpProcess::getTotalBytes() const {
+    return _total_bytes;
+}
+
+int RtpProcess::readerCount() {
+    return _writer->readerCount();
+}
+
+}//namespace mediakit
+#endif//defined(ENABLE_RTPPROXY)
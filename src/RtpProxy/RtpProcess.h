@@ -0,0 +1,99 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ZLMEDIAKIT_RTPPROCESS_H
+#define ZLMEDIAKIT_RTPPROCESS_H
+
+#if defined(ENABLE_RTPPROXY)
+#include <mutex>
+#include <string>
+#include <memory>
+#include "PSDecoder.h"
+#include "MpegFrameWriter.h"
+#include "Rtsp/RtpReceiver.h"
+#include "Util/TimeTicker.h"
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+/**
+ * 一路GB28181 PS over RTP流的处理对象
+ * rtp排序后按时间戳拼接成完整的ps帧，解复用出H264/H265/AAC后直接输入MultiMediaSourceMuxer，
+ * 不经过rtsp/rtmp中转
+ */
+class RtpProcess : public RtpReceiver {
+public:
+    typedef std::shared_ptr<RtpProcess> Ptr;
+
+    /**
+     * @param stream_id 流id，生成的流地址为 rtp_proxy.appName/stream_id
+     */
+    RtpProcess(const string &stream_id);
+    ~RtpProcess() override;
+
+    /**
+     * 输入一个rtp包，线程安全
+     * @param data rtp数据，不含tcp的2字节长度头
+     * @param len rtp数据长度
+     * @param addr 发送端地址
+     * @return 是否解析成功
+     */
+    bool inputRtp(const char *data, int len, const struct sockaddr *addr);
+
+    /**
+     * 是否已经超时未收到数据
+     */
+    bool alive();
+
+    const string &getStreamId() const;
+    uint32_t getSSRC() const;
+    string getPeerIp();
+    uint16_t getPeerPort();
+    uint64_t getTotalBytes() const;
+    int readerCount();
+protected:
+    void onRtpSorted(const RtpPacket::Ptr &rtp, int track_index) override;
+private:
+    void flushPS();
+private:
+    string _stream_id;
+    SdpTrack::Ptr _track;
+    PSDecoder _decoder;
+    MpegFrameWriter::Ptr _writer;
+    //当前正在拼接的ps帧及其rtp时间戳
+    string _ps_cache;
+    uint32_t _ps_stamp = 0;
+    struct sockaddr _addr;
+    bool _addr_inited = false;
+    uint64_t _total_bytes = 0;
+    Ticker _last_rtp_time;
+    recursive_mutex _mtx;
+};
+
+}//namespace mediakit
+#endif//defined(ENABLE_RTPPROXY)
+#endif //ZLMEDIAKIT_RTPPROCESS_H
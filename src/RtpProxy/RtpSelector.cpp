@@ -0,0 +1,188 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "RtpSelector.h"
+#if defined(ENABLE_RTPPROXY)
+#include "Common/config.h"
+#include "Util/logger.h"
+#include "Poller/EventPoller.h"
+
+namespace mediakit {
+
+RtpSelector &RtpSelector::Instance() {
+    static RtpSelector s_instance;
+    return s_instance;
+}
+
+RtpSelector::RtpSelector() {
+    EventPollerPool::Instance().getPoller()->doDelayTask(2000, []() {
+        RtpSelector::Instance().onManager();
+        return 2000;
+    });
+}
+
+string RtpSelector::getStreamId(uint32_t ssrc) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%08X", ssrc);
+    return buf;
+}
+
+bool RtpSelector::inputRtp(const char *data, int len, const struct sockaddr *addr) {
+    if (len < 12) {
+        return false;
+    }
+    uint32_t ssrc;
+    memcpy(&ssrc, data + 8, 4);
+    ssrc = ntohl(ssrc);
+
+    string stream_id;
+    {
+        lock_guard<recursive_mutex> lck(_mtx);
+        auto it = _ssrc_bindings.find(ssrc);
+        stream_id = it != _ssrc_bindings.end() ? it->second : getStreamId(ssrc);
+    }
+    return inputRtp(stream_id, data, len, addr);
+}
+
+bool RtpSelector::inputRtp(const string &stream_id, const char *data, int len, const struct sockaddr *addr) {
+    auto process = getProcess(stream_id);
+    return process->inputRtp(data, len, addr);
+}
+
+RtpProcess::Ptr RtpSelector::getProcess(const string &stream_id) {
+    lock_guard<recursive_mutex> lck(_mtx);
+    auto &ref = _processes[stream_id];
+    if (!ref) {
+        ref = std::make_shared<RtpProcess>(stream_id);
+    }
+    return ref;
+}
+
+void RtpSelector::bindSSRC(uint32_t ssrc, const string &stream_id) {
+    lock_guard<recursive_mutex> lck(_mtx);
+    _ssrc_bindings[ssrc] = stream_id;
+}
+
+bool RtpSelector::unbindSSRC(uint32_t ssrc) {
+    lock_guard<recursive_mutex> lck(_mtx);
+    return _ssrc_bindings.erase(ssrc) != 0;
+}
+
+uint16_t RtpSelector::openRtpServer(const string &stream_id) {
+    lock_guard<recursive_mutex> lck(_mtx);
+    auto it = _servers.find(stream_id);
+    if (it != _servers.end()) {
+        return it->second->getPort();
+    }
+
+    GET_CONFIG(string, portRange, RtpProxy::kPortRange);
+    auto pos = portRange.find('-');
+    uint16_t minPort = atoi(portRange.substr(0, pos).data());
+    uint16_t maxPort = pos == string::npos ? minPort : atoi(portRange.substr(pos + 1).data());
+    if (minPort == 0 || maxPort < minPort) {
+        WarnL << "无效的端口范围:" << portRange;
+        return 0;
+    }
+    if (_next_port < minPort || _next_port > maxPort) {
+        _next_port = minPort;
+    }
+
+    //从上次分配的位置开始轮询，避免刚关闭的端口马上被复用
+    for (int i = 0; i <= maxPort - minPort; ++i) {
+        uint16_t port = _next_port;
+        _next_port = port >= maxPort ? minPort : port + 1;
+        if (_port_streams.count(port)) {
+            continue;
+        }
+        auto server = std::make_shared<RtpServer>(stream_id);
+        if (!server->start(port)) {
+            continue;
+        }
+        _servers[stream_id] = server;
+        _port_streams[port] = stream_id;
+        return port;
+    }
+    WarnL << "没有可用的收流端口:" << portRange;
+    return 0;
+}
+
+bool RtpSelector::closeRtpServer(const string &stream_id) {
+    lock_guard<recursive_mutex> lck(_mtx);
+    auto it = _servers.find(stream_id);
+    if (it == _servers.end()) {
+        return false;
+    }
+    _port_streams.erase(it->second->getPort());
+    _servers.erase(it);
+    _processes.erase(stream_id);
+    return true;
+}
+
+string RtpSelector::getStreamIdByPort(uint16_t port) {
+    lock_guard<recursive_mutex> lck(_mtx);
+    auto it = _port_streams.find(port);
+    return it != _port_streams.end() ? it->second : "";
+}
+
+map<string, uint16_t> RtpSelector::getRtpServers() {
+    map<string, uint16_t> ret;
+    lock_guard<recursive_mutex> lck(_mtx);
+    for (auto &pr : _servers) {
+        ret.emplace(pr.first, pr.second->getPort());
+    }
+    return ret;
+}
+
+unordered_map<string, RtpProcess::Ptr> RtpSelector::getProcesses() {
+    lock_guard<recursive_mutex> lck(_mtx);
+    return _processes;
+}
+
+unordered_map<uint32_t, string> RtpSelector::getSSRCBindings() {
+    lock_guard<recursive_mutex> lck(_mtx);
+    return _ssrc_bindings;
+}
+
+void RtpSelector::onManager() {
+    lock_guard<recursive_mutex> lck(_mtx);
+    for (auto it = _processes.begin(); it != _processes.end();) {
+        if (it->second->alive()) {
+            ++it;
+            continue;
+        }
+        WarnL << "GB28181流接收超时:" << it->first;
+        //独立端口上的流超时后一并回收端口
+        auto server = _servers.find(it->first);
+        if (server != _servers.end()) {
+            _port_streams.erase(server->second->getPort());
+            _servers.erase(server);
+        }
+        it = _processes.erase(it);
+    }
+}
+
+}//namespace mediakit
+#endif//defined(ENABLE_RTPPROXY)
@@ -0,0 +1,133 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ZLMEDIAKIT_RTPSELECTOR_H
+#define ZLMEDIAKIT_RTPSELECTOR_H
+
+#if defined(ENABLE_RTPPROXY)
+#include <map>
+#include <mutex>
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include "RtpProcess.h"
+#include "RtpServer.h"
+using namespace std;
+
+namespace mediakit {
+
+/**
+ * GB28181收流的分发中心
+ * 共享端口上的rtp按ssrc找到对应的流(未绑定的ssrc以8位16进制ssrc为流id)，
+ * 独立端口上的rtp全部属于打开该端口时指定的流；
+ * 同时负责独立收流端口的分配回收以及超时流的清理
+ */
+class RtpSelector {
+public:
+    static RtpSelector &Instance();
+
+    /**
+     * 输入共享端口收到的rtp包，按ssrc分发
+     * @return 是否解析成功
+     */
+    bool inputRtp(const char *data, int len, const struct sockaddr *addr);
+
+    /**
+     * 输入独立端口收到的rtp包
+     * @param stream_id 打开该端口时指定的流id
+     * @return 是否解析成功
+     */
+    bool inputRtp(const string &stream_id, const char *data, int len, const struct sockaddr *addr);
+
+    /**
+     * 把ssrc绑定到指定的流id，共享端口上该ssrc的rtp将生成该流
+     */
+    void bindSSRC(uint32_t ssrc, const string &stream_id);
+
+    /**
+     * 解除ssrc绑定
+     */
+    bool unbindSSRC(uint32_t ssrc);
+
+    /**
+     * 为指定流在端口范围内分配一个独立的udp+tcp收流端口
+     * @param stream_id 流id
+     * @return 端口号，0代表失败；同一个流重复打开返回原来的端口
+     */
+    uint16_t openRtpServer(const string &stream_id);
+
+    /**
+     * 关闭独立收流端口，同时销毁该流
+     * @return 该流是否打开过端口
+     */
+    bool closeRtpServer(const string &stream_id);
+
+    /**
+     * 根据本地端口获取独立收流端口对应的流id，共享端口返回空
+     */
+    string getStreamIdByPort(uint16_t port);
+
+    /**
+     * 获取全部已打开的独立收流端口，key为流id
+     */
+    map<string, uint16_t> getRtpServers();
+
+    /**
+     * 获取全部正在接收的流
+     */
+    unordered_map<string, RtpProcess::Ptr> getProcesses();
+
+    /**
+     * 获取ssrc绑定关系
+     */
+    unordered_map<uint32_t, string> getSSRCBindings();
+
+    /**
+     * 根据ssrc生成默认流id
+     */
+    static string getStreamId(uint32_t ssrc);
+
+private:
+    RtpSelector();
+    ~RtpSelector() = default;
+
+    RtpProcess::Ptr getProcess(const string &stream_id);
+    void onManager();
+private:
+    recursive_mutex _mtx;
+    unordered_map<string, RtpProcess::Ptr> _processes;
+    unordered_map<uint32_t, string> _ssrc_bindings;
+    //独立收流端口，key为流id
+    map<string, RtpServer::Ptr> _servers;
+    //独立收流端口到流id的映射
+    unordered_map<uint16_t, string> _port_streams;
+    //下次开始尝试分配的端口
+    uint16_t _next_port = 0;
+};
+
+}//namespace mediakit
+#endif//defined(ENABLE_RTPPROXY)
+#endif //ZLMEDIAKIT_RTPSELECTOR_H
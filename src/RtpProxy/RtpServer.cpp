@@ -0,0 +1,89 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "RtpServer.h"
+#if defined(ENABLE_RTPPROXY)
+#include "RtpSession.h"
+#include "RtpSelector.h"
+#include "Network/sockutil.h"
+
+namespace mediakit {
+
+RtpServer::RtpServer(const string &stream_id) {
+    _stream_id = stream_id;
+}
+
+RtpServer::~RtpServer() {
+    if (_udp_server) {
+        _udp_server->setOnRead(nullptr);
+    }
+    DebugL << _port << " " << _stream_id;
+}
+
+bool RtpServer::start(uint16_t port, const char *local_ip) {
+    auto poller = EventPollerPool::Instance().getPoller();
+    Socket::Ptr udp_server = std::make_shared<Socket>(poller);
+    if (!udp_server->bindUdpSock(port, local_ip)) {
+        WarnL << "绑定udp端口失败:" << port;
+        return false;
+    }
+    //加大接收缓存，防止高码率下丢包
+    SockUtil::setRecvBuf(udp_server->rawFD(), 4 * 1024 * 1024);
+
+    TcpServer::Ptr tcp_server = std::make_shared<TcpServer>(poller);
+    try {
+        tcp_server->start<RtpSession>(udp_server->get_local_port(), local_ip);
+    } catch (std::exception &ex) {
+        WarnL << "绑定tcp端口失败:" << port << " " << ex.what();
+        return false;
+    }
+
+    string stream_id = _stream_id;
+    udp_server->setOnRead([stream_id](const Buffer::Ptr &buf, struct sockaddr *addr) {
+        if (stream_id.empty()) {
+            RtpSelector::Instance().inputRtp(buf->data(), buf->size(), addr);
+        } else {
+            RtpSelector::Instance().inputRtp(stream_id, buf->data(), buf->size(), addr);
+        }
+    });
+
+    _port = udp_server->get_local_port();
+    _udp_server = udp_server;
+    _tcp_server = tcp_server;
+    InfoL << "GB28181收流端口:" << _port << " " << (_stream_id.empty() ? "共享" : _stream_id);
+    return true;
+}
+
+uint16_t RtpServer::getPort() const {
+    return _port;
+}
+
+const string &RtpServer::getStreamId() const {
+    return _stream_id;
+}
+
+}//namespace mediakit
+#endif//defined(ENABLE_RTPPROXY)
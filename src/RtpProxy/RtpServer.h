@@ -0,0 +1,72 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ZLMEDIAKIT_RTPSERVER_H
+#define ZLMEDIAKIT_RTPSERVER_H
+
+#if defined(ENABLE_RTPPROXY)
+#include <memory>
+#include <string>
+#include "Network/Socket.h"
+#include "Network/TcpServer.h"
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+/**
+ * GB28181收流端口，同一端口同时监听udp与tcp(RFC4571)
+ */
+class RtpServer {
+public:
+    typedef std::shared_ptr<RtpServer> Ptr;
+
+    /**
+     * @param stream_id 该端口对应的流id，为空代表共享端口，按ssrc区分流
+     */
+    RtpServer(const string &stream_id = "");
+    ~RtpServer();
+
+    /**
+     * 开始监听
+     * @param port 端口号
+     * @param local_ip 绑定的网卡ip
+     * @return 是否成功
+     */
+    bool start(uint16_t port, const char *local_ip = "0.0.0.0");
+
+    uint16_t getPort() const;
+    const string &getStreamId() const;
+private:
+    string _stream_id;
+    uint16_t _port = 0;
+    Socket::Ptr _udp_server;
+    TcpServer::Ptr _tcp_server;
+};
+
+}//namespace mediakit
+#endif//defined(ENABLE_RTPPROXY)
+#endif //ZLMEDIAKIT_RTPSERVER_H
@@ -0,0 +1,95 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "RtpSession.h"
+#if defined(ENABLE_RTPPROXY)
+#include "RtpSelector.h"
+#include "Common/config.h"
+
+//rtp over tcp时单个rtp包最大长度
+#define RTP_MAX_SIZE (10 * 1024)
+
+namespace mediakit {
+
+RtpSession::RtpSession(const Socket::Ptr &sock) : TcpSession(sock) {
+    DebugP(this);
+    _stream_id = RtpSelector::Instance().getStreamIdByPort(get_local_port());
+    memset(&_addr, 0, sizeof(_addr));
+    auto addr = (struct sockaddr_in *) &_addr;
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = inet_addr(get_peer_ip().data());
+    addr->sin_port = htons(get_peer_port());
+}
+
+RtpSession::~RtpSession() {
+    DebugP(this);
+}
+
+void RtpSession::onRecv(const Buffer::Ptr &buf) {
+    _ticker.resetTime();
+    input(buf->data(), buf->size());
+}
+
+void RtpSession::onError(const SockException &err) {
+    WarnP(this) << _stream_id << " " << err.what();
+}
+
+void RtpSession::onManager() {
+    GET_CONFIG(int, timeoutSec, RtpProxy::kTimeoutSec);
+    if (_ticker.elapsedTime() > timeoutSec * 1000) {
+        shutdown(SockException(Err_timeout, "rtp over tcp接收超时"));
+    }
+}
+
+const char *RtpSession::onSearchPacketTail(const char *data, int len) {
+    if (len < 2) {
+        //数据不够
+        return nullptr;
+    }
+    uint16_t length = (((uint8_t *) data)[0] << 8) | ((uint8_t *) data)[1];
+    if (len < length + 2) {
+        //数据不够
+        return nullptr;
+    }
+    //返回rtp包末尾
+    return data + 2 + length;
+}
+
+int64_t RtpSession::onRecvHeader(const char *data, uint64_t len) {
+    if (len <= 2 || len - 2 > RTP_MAX_SIZE) {
+        shutdown(SockException(Err_shutdown, "无效的rtp over tcp数据"));
+        return 0;
+    }
+    if (_stream_id.empty()) {
+        RtpSelector::Instance().inputRtp(data + 2, len - 2, &_addr);
+    } else {
+        RtpSelector::Instance().inputRtp(_stream_id, data + 2, len - 2, &_addr);
+    }
+    return 0;
+}
+
+}//namespace mediakit
+#endif//defined(ENABLE_RTPPROXY)
@@ -0,0 +1,61 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ZLMEDIAKIT_RTPSESSION_H
+#define ZLMEDIAKIT_RTPSESSION_H
+
+#if defined(ENABLE_RTPPROXY)
+#include "Network/TcpSession.h"
+#include "Http/HttpRequestSplitter.h"
+#include "Util/TimeTicker.h"
+using namespace toolkit;
+
+namespace mediakit {
+
+/**
+ * GB28181 rtp over tcp会话，rtp包前为2字节大端长度(RFC4571)
+ */
+class RtpSession : public TcpSession , public HttpRequestSplitter {
+public:
+    RtpSession(const Socket::Ptr &sock);
+    ~RtpSession() override;
+
+    void onRecv(const Buffer::Ptr &buf) override;
+    void onError(const SockException &err) override;
+    void onManager() override;
+protected:
+    const char *onSearchPacketTail(const char *data, int len) override;
+    int64_t onRecvHeader(const char *data, uint64_t len) override;
+private:
+    //为空代表共享端口
+    string _stream_id;
+    struct sockaddr _addr;
+    Ticker _ticker;
+};
+
+}//namespace mediakit
+#endif//defined(ENABLE_RTPPROXY)
+#endif //ZLMEDIAKIT_RTPSESSION_H
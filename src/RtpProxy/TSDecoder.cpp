@@ -0,0 +1,67 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "TSDecoder.h"
+#if defined(ENABLE_RTPPROXY)
+#include "mpeg-ts.h"
+
+namespace mediakit {
+
+TSDecoder::TSDecoder() {
+    _ts_demuxer = ts_demuxer_create([](void *param,
+                                       int program,
+                                       int stream,
+                                       int codecid,
+                                       int flags,
+                                       int64_t pts,
+                                       int64_t dts,
+                                       const void *data,
+                                       size_t bytes) {
+        TSDecoder *thiz = (TSDecoder *) param;
+        if (thiz->_on_decode) {
+            thiz->_on_decode(stream, codecid, flags, pts, dts, data, bytes);
+        }
+        return 0;
+    }, this);
+}
+
+TSDecoder::~TSDecoder() {
+    if (_ts_demuxer) {
+        ts_demuxer_destroy(_ts_demuxer);
+        _ts_demuxer = nullptr;
+    }
+}
+
+int TSDecoder::input(const uint8_t *packet) {
+    return (int) ts_demuxer_input(_ts_demuxer, packet, TS_PACKET_SIZE);
+}
+
+void TSDecoder::setOnDecode(const TSDecoder::onDecode &cb) {
+    _on_decode = cb;
+}
+
+}//namespace mediakit
+#endif//#if defined(ENABLE_RTPPROXY)
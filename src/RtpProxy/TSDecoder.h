@@ -0,0 +1,73 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ZLMEDIAKIT_TSDECODER_H
+#define ZLMEDIAKIT_TSDECODER_H
+
+#if defined(ENABLE_RTPPROXY)
+#include <stdint.h>
+#include <functional>
+using namespace std;
+
+struct ts_demuxer_t;
+
+namespace mediakit {
+
+//ts包固定长度
+#define TS_PACKET_SIZE 188
+//ts包同步字节
+#define TS_SYNC_BYTE 0x47
+
+/**
+ * mpeg-ts解复用器，对libmpeg中ts_demuxer的简单封装
+ */
+class TSDecoder {
+public:
+    /**
+     * 解复用出一帧es数据，参数含义同PSDecoder::onDecode
+     */
+    typedef function<void(int stream, int codecid, int flags, int64_t pts, int64_t dts, const void *data, size_t bytes)> onDecode;
+
+    TSDecoder();
+    ~TSDecoder();
+
+    /**
+     * 输入一个188字节的ts包
+     */
+    int input(const uint8_t *packet);
+
+    /**
+     * 设置es帧回调
+     */
+    void setOnDecode(const onDecode &cb);
+private:
+    struct ts_demuxer_t *_ts_demuxer = nullptr;
+    onDecode _on_decode;
+};
+
+}//namespace mediakit
+#endif //defined(ENABLE_RTPPROXY)
+#endif //ZLMEDIAKIT_TSDECODER_H
@@ -0,0 +1,275 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "TsUdpReceiver.h"
+#if defined(ENABLE_RTPPROXY)
+#include "Util/logger.h"
+#include "Network/sockutil.h"
+
+//单次recvmmsg最多读取的udp包数
+#define TS_BATCH_SIZE 32
+//单个udp包最大长度
+#define TS_DATAGRAM_SIZE 2048
+//33位时间戳的回环周期
+#define TS_STAMP_CYCLE (1LL << 33)
+//相邻两个pcr间隔超过该值(单位90KHz)视为不连续，标准规定pcr间隔不超过100ms
+#define PCR_MAX_GAP (90000LL * 2)
+
+namespace mediakit {
+
+void PcrClock::inputPcr(int64_t pcr, bool discontinuity) {
+    if (!_inited) {
+        _inited = true;
+        _last_pcr = pcr;
+        _timeline = pcr;
+        _ticker.resetTime();
+        return;
+    }
+    int64_t delta = pcr - _last_pcr;
+    if (delta < -TS_STAMP_CYCLE / 2) {
+        //33位回环
+        delta += TS_STAMP_CYCLE;
+    }
+    if (discontinuity || delta < 0 || delta > PCR_MAX_GAP) {
+        //时间轴跳变，按实际经过的时间接续
+        delta = _ticker.elapsedTime() * 90;
+        ++_discontinuity_count;
+        WarnL << "pcr不连续:" << _last_pcr << " -> " << pcr;
+    }
+    _ticker.resetTime();
+    _last_pcr = pcr;
+    _timeline += delta;
+}
+
+int64_t PcrClock::toTimeline(int64_t stamp) const {
+    if (!_inited) {
+        return stamp;
+    }
+    int64_t offset = stamp - _last_pcr;
+    //pts/dts与pcr一般相差不超过1秒，相差过大说明其中一个发生了回环
+    if (offset > TS_STAMP_CYCLE / 2) {
+        offset -= TS_STAMP_CYCLE;
+    } else if (offset < -TS_STAMP_CYCLE / 2) {
+        offset += TS_STAMP_CYCLE;
+    }
+    return _timeline + offset;
+}
+
+uint32_t PcrClock::discontinuityCount() const {
+    return _discontinuity_count;
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+
+TsUdpReceiver::TsUdpReceiver(const string &vhost, const string &app, const string &stream_id) {
+    _stream_id = stream_id;
+    _writer = std::make_shared<MpegFrameWriter>(vhost, app, stream_id);
+    _buffer.resize(TS_BATCH_SIZE * TS_DATAGRAM_SIZE);
+    //pid为13位
+    _cc.resize(0x2000, -1);
+    _decoder.setOnDecode([this](int stream, int codecid, int flags, int64_t pts, int64_t dts, const void *data, size_t bytes) {
+        auto timeline_dts = _clock.toTimeline(dts);
+        auto timeline_pts = _clock.toTimeline(pts);
+        if (timeline_dts < 0 || timeline_pts < 0) {
+            return;
+        }
+        //90KHz时间戳转换成毫秒
+        _writer->inputEs(codecid, (uint32_t) (timeline_pts / 90), (uint32_t) (timeline_dts / 90), (const char *) data, (int) bytes);
+    });
+}
+
+TsUdpReceiver::~TsUdpReceiver() {
+    if (_fd != -1) {
+        int fd = _fd;
+        _poller->delEvent(fd, [fd](bool) {
+            close(fd);
+        });
+    }
+    InfoL << _stream_id << " " << _multicast_ip << ":" << _port << " 总计接收:" << _total_bytes;
+}
+
+bool TsUdpReceiver::start(uint16_t port, const string &multicast_ip, const string &local_ip) {
+    //组播需要绑定到0.0.0.0才能收到发往组播地址的包
+    int fd = SockUtil::bindUdpSock(port, multicast_ip.empty() ? local_ip.data() : "0.0.0.0");
+    if (fd == -1) {
+        WarnL << "绑定udp端口失败:" << port;
+        return false;
+    }
+    if (!multicast_ip.empty() && SockUtil::joinMultiAddr(fd, multicast_ip.data(), local_ip.data()) == -1) {
+        WarnL << "加入组播失败:" << multicast_ip << " " << local_ip;
+        close(fd);
+        return false;
+    }
+    SockUtil::setNoBlocked(fd);
+    //加大接收缓存，防止高码率下丢包
+    SockUtil::setRecvBuf(fd, 8 * 1024 * 1024);
+
+    auto poller = EventPollerPool::Instance().getPoller();
+    weak_ptr<TsUdpReceiver> weakSelf = shared_from_this();
+    int ret = poller->addEvent(fd, Event_Read | Event_Error, [weakSelf](int event) {
+        auto strongSelf = weakSelf.lock();
+        if (strongSelf) {
+            strongSelf->onRead();
+        }
+    });
+    if (ret == -1) {
+        WarnL << "监听udp socket失败:" << port;
+        close(fd);
+        return false;
+    }
+    _fd = fd;
+    _poller = poller;
+    _port = port;
+    _multicast_ip = multicast_ip;
+    InfoL << "开始接收ts:" << (multicast_ip.empty() ? local_ip : multicast_ip) << ":" << port << " -> " << _stream_id;
+    return true;
+}
+
+void TsUdpReceiver::onRead() {
+#if defined(__linux__)
+    struct mmsghdr msgs[TS_BATCH_SIZE];
+    struct iovec iovs[TS_BATCH_SIZE];
+    memset(msgs, 0, sizeof(msgs));
+    for (int i = 0; i < TS_BATCH_SIZE; ++i) {
+        iovs[i].iov_base = _buffer.data() + i * TS_DATAGRAM_SIZE;
+        iovs[i].iov_len = TS_DATAGRAM_SIZE;
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    //边沿触发，需要一直读到没有数据为止
+    while (true) {
+        int count = recvmmsg(_fd, msgs, TS_BATCH_SIZE, MSG_DONTWAIT, nullptr);
+        if (count <= 0) {
+            break;
+        }
+        ++_total_syscalls;
+        for (int i = 0; i < count; ++i) {
+            inputDatagram((uint8_t *) iovs[i].iov_base, msgs[i].msg_len);
+        }
+    }
+#else
+    while (true) {
+        auto count = recv(_fd, (char *) _buffer.data(), TS_DATAGRAM_SIZE, 0);
+        if (count <= 0) {
+            break;
+        }
+        ++_total_syscalls;
+        inputDatagram(_buffer.data(), count);
+    }
+#endif //defined(__linux__)
+}
+
+void TsUdpReceiver::inputDatagram(const uint8_t *data, size_t size) {
+    _last_recv.resetTime();
+    _total_bytes += size;
+    ++_total_datagrams;
+    if (size >= 12 && data[0] != TS_SYNC_BYTE && (data[0] >> 6) == 2) {
+        //rtp封装的ts，跳过rtp头
+        size_t offset = 12 + 4 * (data[0] & 0x0F);
+        if ((data[0] & 0x10) && size >= offset + 4) {
+            offset += 4 + 4 * ((data[offset + 2] << 8) | data[offset + 3]);
+        }
+        if (offset >= size) {
+            return;
+        }
+        data += offset;
+        size -= offset;
+    }
+    while (size >= TS_PACKET_SIZE) {
+        if (data[0] != TS_SYNC_BYTE) {
+            //一般一个udp包包含7个完整的ts包，不对齐的数据直接丢弃
+            WarnL << _stream_id << " 无效的ts包";
+            break;
+        }
+        inputTs(data);
+        data += TS_PACKET_SIZE;
+        size -= TS_PACKET_SIZE;
+    }
+}
+
+void TsUdpReceiver::inputTs(const uint8_t *packet) {
+    int pid = ((packet[1] & 0x1F) << 8) | packet[2];
+    int adaptation = (packet[3] >> 4) & 0x03;
+    int cc = packet[3] & 0x0F;
+    bool discontinuity = false;
+    if ((adaptation & 0x02) && packet[4] > 0) {
+        //adaptation_field
+        discontinuity = packet[5] & 0x80;
+        if ((packet[5] & 0x10) && packet[4] >= 7) {
+            //pcr_base为33位
+            int64_t pcr = ((int64_t) packet[6] << 25) |
+                          ((int64_t) packet[7] << 17) |
+                          ((int64_t) packet[8] << 9) |
+                          ((int64_t) packet[9] << 1) |
+                          ((int64_t) packet[10] >> 7);
+            _clock.inputPcr(pcr, discontinuity);
+        }
+    }
+    if (pid != 0x1FFF && (adaptation & 0x01)) {
+        //带负载的包continuity_counter才会递增
+        auto &last = _cc[pid];
+        if (last != -1 && !discontinuity && ((last + 1) & 0x0F) != cc && last != cc) {
+            ++_cc_errors;
+        }
+        last = cc;
+    }
+    _decoder.input(packet);
+}
+
+uint16_t TsUdpReceiver::getPort() const {
+    return _port;
+}
+
+const string &TsUdpReceiver::getMulticastIp() const {
+    return _multicast_ip;
+}
+
+uint64_t TsUdpReceiver::getTotalBytes() const {
+    return _total_bytes;
+}
+
+float TsUdpReceiver::getBatchRatio() const {
+    return _total_syscalls ? (float) _total_datagrams / _total_syscalls : 0;
+}
+
+uint64_t TsUdpReceiver::getIdleTime() const {
+    return _last_recv.elapsedTime();
+}
+
+uint32_t TsUdpReceiver::getDiscontinuityCount() const {
+    return _clock.discontinuityCount();
+}
+
+uint32_t TsUdpReceiver::getCCErrorCount() const {
+    return _cc_errors;
+}
+
+int TsUdpReceiver::readerCount() const {
+    return _writer->readerCount();
+}
+
+}//namespace mediakit
+#endif//defined(ENABLE_RTPPROXY)
@@ -0,0 +1,135 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ZLMEDIAKIT_TSUDPRECEIVER_H
+#define ZLMEDIAKIT_TSUDPRECEIVER_H
+
+#if defined(ENABLE_RTPPROXY)
+#include <string>
+#include <memory>
+#include <vector>
+#include "TSDecoder.h"
+#include "MpegFrameWriter.h"
+#include "Poller/EventPoller.h"
+#include "Util/TimeTicker.h"
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+/**
+ * 根据pcr恢复连续的时间戳
+ * pts/dts只有33位且编码器重启、切换节目时会跳变，这里以pcr为时间轴：
+ * 33位回环时累加而不是回退，pcr跳变(不连续)时按实际经过的时间把新的时间轴接在旧的后面，
+ * pts/dts则换算成相对最近一个pcr的偏移再映射到该时间轴上
+ */
+class PcrClock {
+public:
+    /**
+     * 输入一个pcr
+     * @param pcr 33位pcr基准，单位90KHz
+     * @param discontinuity ts包中的discontinuity_indicator
+     */
+    void inputPcr(int64_t pcr, bool discontinuity);
+
+    /**
+     * 把33位的pts/dts映射到连续的时间轴上
+     * @return 单位90KHz
+     */
+    int64_t toTimeline(int64_t stamp) const;
+
+    /**
+     * 时间轴是否发生过不连续
+     */
+    uint32_t discontinuityCount() const;
+private:
+    bool _inited = false;
+    //最近一个原始pcr
+    int64_t _last_pcr = 0;
+    //最近一个pcr在连续时间轴上的位置
+    int64_t _timeline = 0;
+    uint32_t _discontinuity_count = 0;
+    Ticker _ticker;
+};
+
+/**
+ * mpeg-ts over udp(单播或组播)收流
+ * 在poller线程中通过recvmmsg批量读取udp包，支持裸ts与rtp封装的ts(rfc2250)，
+ * 解复用后直接输入MultiMediaSourceMuxer
+ */
+class TsUdpReceiver : public std::enable_shared_from_this<TsUdpReceiver> {
+public:
+    typedef std::shared_ptr<TsUdpReceiver> Ptr;
+
+    TsUdpReceiver(const string &vhost, const string &app, const string &stream_id);
+    ~TsUdpReceiver();
+
+    /**
+     * 开始接收
+     * @param port udp端口
+     * @param multicast_ip 组播地址，为空则为单播
+     * @param local_ip 绑定的网卡ip，同时用于加入组播
+     * @return 是否成功
+     */
+    bool start(uint16_t port, const string &multicast_ip = "", const string &local_ip = "0.0.0.0");
+
+    uint16_t getPort() const;
+    const string &getMulticastIp() const;
+    uint64_t getTotalBytes() const;
+    //平均每次系统调用读取的udp包数
+    float getBatchRatio() const;
+    //多久没有收到数据，单位毫秒
+    uint64_t getIdleTime() const;
+    uint32_t getDiscontinuityCount() const;
+    uint32_t getCCErrorCount() const;
+    int readerCount() const;
+private:
+    void onRead();
+    void inputDatagram(const uint8_t *data, size_t size);
+    void inputTs(const uint8_t *packet);
+private:
+    string _stream_id;
+    string _multicast_ip;
+    uint16_t _port = 0;
+    int _fd = -1;
+    EventPoller::Ptr _poller;
+    MpegFrameWriter::Ptr _writer;
+    TSDecoder _decoder;
+    PcrClock _clock;
+    //recvmmsg的接收缓存
+    vector<uint8_t> _buffer;
+    //各pid的continuity_counter，用于统计丢包
+    vector<int8_t> _cc;
+    uint32_t _cc_errors = 0;
+    uint64_t _total_bytes = 0;
+    uint64_t _total_datagrams = 0;
+    uint64_t _total_syscalls = 0;
+    Ticker _last_recv;
+};
+
+}//namespace mediakit
+#endif//defined(ENABLE_RTPPROXY)
+#endif //ZLMEDIAKIT_TSUDPRECEIVER_H
@@ -103,7 +103,17 @@ RtpBroadCaster::RtpBroadCaster(const EventPoller::Ptr &poller,const string &strL
 		auto strErr = StrPrinter << "未找到媒体源:" << strVhost << " " << strApp << " " << strStream << endl;
 		throw std::runtime_error(strErr);
 	}
-	_multiAddr = MultiCastAddressMaker::Instance().obtain();
+	GET_CONFIG(bool,groupPerTrack,MultiCast::kGroupPerTrack);
+	_poller = poller;
+	auto videoTrack = SdpParser(src->getSdp()).getTrack(TrackVideo);
+	if(videoTrack){
+		_videoCodec = videoTrack->_codec;
+	}
+	_multiAddr[0] = MultiCastAddressMaker::Instance().obtain();
+	_multiAddr[1] = groupPerTrack ? MultiCastAddressMaker::Instance().obtain() : _multiAddr[0];
+	if(!_multiAddr[0] || !_multiAddr[1]){
+		throw std::runtime_error("分配组播地址失败");
+	}
 	for(auto i = 0; i < 2; i++){
 		_apUdpSock[i].reset(new Socket(poller));
 		if(!_apUdpSock[i]->bindUdpSock(0, strLocalIp.data())){
@@ -120,17 +130,14 @@ RtpBroadCaster::RtpBroadCaster(const EventPoller::Ptr &poller,const string &strL
 		struct sockaddr_in &peerAddr = _aPeerUdpAddr[i];
 		peerAddr.sin_family = AF_INET;
 		peerAddr.sin_port = htons(_apUdpSock[i]->get_local_port());
-		peerAddr.sin_addr.s_addr = htonl(*_multiAddr);
+		peerAddr.sin_addr.s_addr = htonl(*_multiAddr[i]);
 		bzero(&(peerAddr.sin_zero), sizeof peerAddr.sin_zero);
 		_apUdpSock[i]->setSendPeerAddr((struct sockaddr *)&peerAddr);
 	}
+	//每个源只读取一次环形缓存，所有组播观众共享
 	_pReader = src->getRing()->attach(poller);
 	_pReader->setReadCB([this](const RtpPacket::Ptr &pkt){
-		int i = (int)(pkt->type);
-		auto &pSock = _apUdpSock[i];
-		auto &peerAddr = _aPeerUdpAddr[i];
-        BufferRtp::Ptr buffer(new BufferRtp(pkt,4));
-		pSock->send(buffer);
+		onRtp(pkt);
 	});
 	_pReader->setDetachCB([this](){
 		unordered_map<void * , onDetach > _mapDetach_copy;
@@ -142,17 +149,180 @@ RtpBroadCaster::RtpBroadCaster(const EventPoller::Ptr &poller,const string &strL
 			pr.second();
 		}
 	});
-	DebugL << MultiCastAddressMaker::toString(*_multiAddr) << " "
-			<< _apUdpSock[0]->get_local_port() << " "
-			<< _apUdpSock[1]->get_local_port() << " "
-            << strVhost << " "
-			<< strApp << " " << strStream;
+	DebugL << MultiCastAddressMaker::toString(*_multiAddr[0]) << ":" << _apUdpSock[0]->get_local_port() << " "
+		   << MultiCastAddressMaker::toString(*_multiAddr[1]) << ":" << _apUdpSock[1]->get_local_port() << " "
+		   << strVhost << " "
+		   << strApp << " " << strStream;
+}
+
+//一次系统调用最多发送的rtp包个数
+#define MAX_SEND_BATCH 64
+//限速模式下最大突发时长，单位毫秒
+#define MAX_PACING_BURST_MS 20
+//限速模式下补发间隔，单位毫秒
+#define PACING_FLUSH_MS 2
+//限速令牌上限至少能发送一个最大的rtp包，否则低码率下永远发不出去
+#define MAX_PACING_PACKET_BYTES 2048
+//限速模式下待发送队列最大长度，超过后丢弃最老的非关键帧rtp包
+#define MAX_PACING_PENDING 2048
+
+void RtpBroadCaster::onRtp(const RtpPacket::Ptr &pkt) {
+	_pending.emplace_back(pkt);
+	if (_pending.size() > MAX_PACING_PENDING) {
+		dropPending();
+	}
+	//视频按帧批量发送(mark位代表一帧结束)，音频包较小且稀疏，立即发送
+	if (pkt->mark || pkt->type != TrackVideo || _pending.size() >= MAX_SEND_BATCH) {
+		flush();
+	}
 }
+
+void RtpBroadCaster::flush() {
+	GET_CONFIG(uint32_t,pacingKbps,MultiCast::kPacingKbps);
+	if (!pacingKbps) {
+		sendBatch(_pending.size());
+		return;
+	}
+
+	//令牌桶限速，每毫秒补充 pacingKbps / 8 字节
+	uint64_t bytesPerMS = pacingKbps / 8;
+	_pacingTokens += _pacingTicker.elapsedTime() * bytesPerMS;
+	_pacingTicker.resetTime();
+	_pacingTokens = MIN(_pacingTokens, MAX(bytesPerMS * MAX_PACING_BURST_MS, (uint64_t) MAX_PACING_PACKET_BYTES));
+
+	size_t count = 0;
+	for (auto &pkt : _pending) {
+		uint64_t bytes = pkt->size() - 4;
+		if (bytes > _pacingTokens) {
+			if (count == 0 && _pacingTokens >= MAX_PACING_PACKET_BYTES) {
+				//超大包(大于令牌上限)也要能发送出去，否则队列将永远阻塞
+				_pacingTokens = 0;
+				++count;
+			}
+			break;
+		}
+		_pacingTokens -= bytes;
+		++count;
+	}
+	sendBatch(count);
+
+	if (_pending.empty() || _flushScheduled) {
+		return;
+	}
+	//还有数据未发送，稍后继续
+	_flushScheduled = true;
+	weak_ptr<RtpBroadCaster> weakSelf = shared_from_this();
+	_poller->doDelayTask(PACING_FLUSH_MS, [weakSelf]() {
+		auto strongSelf = weakSelf.lock();
+		if (!strongSelf) {
+			return 0;
+		}
+		strongSelf->_flushScheduled = false;
+		strongSelf->flush();
+		return 0;
+	});
+}
+
+bool RtpBroadCaster::isKeyRtp(const RtpPacket::Ptr &pkt) const {
+	if (pkt->type != TrackVideo || pkt->size() < pkt->offset + 5u) {
+		return false;
+	}
+	auto payload = (const uint8_t *) pkt->data() + pkt->offset;
+	if (strcasecmp(_videoCodec.data(), "h264") == 0) {
+		int nal = payload[0] & 0x1F;
+		if (nal == 28) {
+			//FU-A
+			nal = payload[1] & 0x1F;
+		} else if (nal == 24) {
+			//STAP-A,第一个nalu
+			nal = payload[3] & 0x1F;
+		}
+		return nal == 5 || nal == 7 || nal == 8;
+	}
+	if (strcasecmp(_videoCodec.data(), "h265") == 0) {
+		int nal = (payload[0] >> 1) & 0x3F;
+		if (nal == 49) {
+			//FU
+			nal = payload[2] & 0x3F;
+		} else if (nal == 48) {
+			//AP,第一个nalu
+			nal = (payload[4] >> 1) & 0x3F;
+		}
+		return (nal >= 16 && nal <= 23) || (nal >= 32 && nal <= 34);
+	}
+	//无法识别的编码格式，不丢弃视频包
+	return true;
+}
+
+void RtpBroadCaster::dropPending() {
+	size_t dropped = 0;
+	for (auto it = _pending.begin(); it != _pending.end() && _pending.size() > MAX_PACING_PENDING / 2;) {
+		if (isKeyRtp(*it)) {
+			++it;
+			continue;
+		}
+		it = _pending.erase(it);
+		++dropped;
+	}
+	while (_pending.size() > MAX_PACING_PENDING) {
+		//全部是关键帧，只能丢弃最老的包
+		_pending.pop_front();
+		++dropped;
+	}
+	WarnL << "组播发送速率不足，丢弃rtp包:" << dropped << "，剩余:" << _pending.size();
+}
+
+void RtpBroadCaster::sendBatch(size_t count) {
+	while (count) {
+		auto batch = MIN(count, (size_t)MAX_SEND_BATCH);
+#if defined(__linux__)
+		//rtp包本身就是完整的组播数据报(跳过4字节rtp over tcp头)，直接用sendmmsg批量发送，无需额外拷贝或封装
+		struct mmsghdr msgs[2][MAX_SEND_BATCH];
+		struct iovec iovs[2][MAX_SEND_BATCH];
+		int msgCount[2] = {0, 0};
+		for (size_t i = 0; i < batch; ++i) {
+			auto &pkt = _pending[i];
+			int track = pkt->type == TrackVideo ? 0 : 1;
+			auto &msg = msgs[track][msgCount[track]];
+			auto &iov = iovs[track][msgCount[track]];
+			iov.iov_base = pkt->data() + 4;
+			iov.iov_len = pkt->size() - 4;
+			bzero(&msg, sizeof(msg));
+			msg.msg_hdr.msg_name = &_aPeerUdpAddr[track];
+			msg.msg_hdr.msg_namelen = sizeof(_aPeerUdpAddr[track]);
+			msg.msg_hdr.msg_iov = &iov;
+			msg.msg_hdr.msg_iovlen = 1;
+			++msgCount[track];
+		}
+		for (int track = 0; track < 2; ++track) {
+			int sent = 0;
+			while (sent < msgCount[track]) {
+				int ret = sendmmsg(_apUdpSock[track]->rawFD(), msgs[track] + sent, msgCount[track] - sent, 0);
+				if (ret <= 0) {
+					//udp发送缓存满了，组播场景下直接丢弃
+					break;
+				}
+				sent += ret;
+			}
+		}
+#else
+		for (size_t i = 0; i < batch; ++i) {
+			auto &pkt = _pending[i];
+			int track = pkt->type == TrackVideo ? 0 : 1;
+			::sendto(_apUdpSock[track]->rawFD(), pkt->data() + 4, pkt->size() - 4, 0,
+					 (struct sockaddr *) &_aPeerUdpAddr[track], sizeof(_aPeerUdpAddr[track]));
+		}
+#endif//defined(__linux__)
+		_pending.erase(_pending.begin(), _pending.begin() + batch);
+		count -= batch;
+	}
+}
+
 uint16_t RtpBroadCaster::getPort(TrackType trackType){
 	return _apUdpSock[trackType]->get_local_port();
 }
-string RtpBroadCaster::getIP(){
-	return inet_ntoa(_aPeerUdpAddr[0].sin_addr);
+string RtpBroadCaster::getIP(TrackType trackType){
+	return inet_ntoa(_aPeerUdpAddr[trackType == TrackAudio ? 1 : 0].sin_addr);
 }
 RtpBroadCaster::Ptr RtpBroadCaster::make(const EventPoller::Ptr &poller,const string &strLocalIp,const string &strVhost,const string &strApp,const string &strStream){
 	try{
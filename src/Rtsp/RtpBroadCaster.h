@@ -29,12 +29,14 @@
 
 
 #include <mutex>
+#include <deque>
 #include <memory>
 #include <unordered_set>
 #include <unordered_map>
 #include "Common/config.h"
 #include "RtspMediaSource.h"
 #include "Util/mini.h"
+#include "Util/TimeTicker.h"
 #include "Network/Socket.h"
 
 using namespace std;
@@ -65,7 +67,7 @@ private:
 	recursive_mutex _mtx;
 	unordered_set<uint32_t> _setBadAddr;
 };
-class RtpBroadCaster {
+class RtpBroadCaster : public std::enable_shared_from_this<RtpBroadCaster> {
 public:
 	typedef std::shared_ptr<RtpBroadCaster> Ptr;
 	typedef function<void()> onDetach;
@@ -73,21 +75,41 @@ public:
 	static Ptr get(const EventPoller::Ptr &poller,const string &strLocalIp,const string &strVhost,const string &strApp,const string &strStream);
 	void setDetachCB(void *listener,const onDetach &cb);
 	uint16_t getPort(TrackType trackType);
-	string getIP();
+	string getIP(TrackType trackType = TrackVideo);
 private:
 	static recursive_mutex g_mtx;
 	static unordered_map<string , weak_ptr<RtpBroadCaster> > g_mapBroadCaster;
 	static Ptr make(const EventPoller::Ptr &poller,const string &strLocalIp,const string &strVhost,const string &strApp,const string &strStream);
 
-	std::shared_ptr<uint32_t> _multiAddr;
+	RtpBroadCaster(const EventPoller::Ptr &poller,const string &strLocalIp,const string &strVhost,const string &strApp,const string &strStream);
+
+	//环形缓存中读到rtp包
+	void onRtp(const RtpPacket::Ptr &pkt);
+	//批量发送待发送队列，受限于发送速率
+	void flush();
+	//批量发送指定个数的rtp包
+	void sendBatch(size_t count);
+	//待发送队列过长时丢弃最老的非关键帧rtp包
+	void dropPending();
+	//是否为关键帧(或sps/pps等配置帧)的rtp包
+	bool isKeyRtp(const RtpPacket::Ptr &pkt) const;
+private:
+	EventPoller::Ptr _poller;
+	std::shared_ptr<uint32_t> _multiAddr[2];
 	recursive_mutex _mtx;
 	unordered_map<void * , onDetach > _mapDetach;
 	RtspMediaSource::RingType::RingReader::Ptr _pReader;
 	Socket::Ptr _apUdpSock[2];
 	struct sockaddr_in _aPeerUdpAddr[2];
 
-	RtpBroadCaster(const EventPoller::Ptr &poller,const string &strLocalIp,const string &strVhost,const string &strApp,const string &strStream);
-
+	//待发送的rtp包，按帧批量发送
+	deque<RtpPacket::Ptr> _pending;
+	//限速令牌(字节)
+	uint64_t _pacingTokens = 0;
+	Ticker _pacingTicker;
+	bool _flushScheduled = false;
+	//视频编码名称(h264/h265)，用于在丢包时识别关键帧
+	string _videoCodec;
 };
 
 }//namespace mediakit
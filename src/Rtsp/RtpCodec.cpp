@@ -34,7 +34,7 @@ RtpPacket::Ptr RtpInfo::makeRtp(TrackType type, const void* data, unsigned int l
     uint16_t sq = htons(_ui16Sequence);
     uint32_t sc = htonl(_ui32Ssrc);
 
-    auto rtppkt = ResourcePoolHelper<RtpPacket>::obtainObj();
+    auto rtppkt = RtpPacket::create();
     rtppkt->setCapacity(len + 16);
     rtppkt->setSize(len + 16);
 
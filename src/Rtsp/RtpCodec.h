@@ -90,7 +90,7 @@ protected:
 };
 
 
-class RtpInfo : public  ResourcePoolHelper<RtpPacket>{
+class RtpInfo {
 public:
     typedef std::shared_ptr<RtpInfo> Ptr;
 
@@ -44,9 +44,32 @@ RtpReceiver::RtpReceiver() {}
 RtpReceiver::~RtpReceiver() {}
 
 bool RtpReceiver::handleOneRtp(int track_index,SdpTrack::Ptr &track, unsigned char *rtp_raw_ptr, unsigned int rtp_raw_len) {
-    auto rtp_ptr = _rtp_pool.obtain();
-    auto &rtp = *rtp_ptr;
     auto length = rtp_raw_len + 4;
+    if(length > RTP_MAX_SIZE){
+        WarnL << "超大的rtp包:" << length << ">" << RTP_MAX_SIZE;
+        return false;
+    }
+    auto rtp_ptr = RtpPacket::create();
+    rtp_ptr->setCapacity(length);
+    rtp_ptr->setSize(length);
+    //拷贝rtp负载，4字节interleaved头在解析时填写
+    memcpy(rtp_ptr->data() + 4, rtp_raw_ptr, rtp_raw_len);
+    return handleOneRtp(track_index, track, rtp_ptr);
+}
+
+bool RtpReceiver::handleOneRtp(int track_index,SdpTrack::Ptr &track, const RtpPacket::Ptr &rtp_ptr) {
+    auto &rtp = *rtp_ptr;
+    auto length = rtp.size();
+    if(length < 4 + 12){
+        WarnL << "rtp包太小:" << length;
+        return false;
+    }
+    if(length > RTP_MAX_SIZE){
+        WarnL << "超大的rtp包:" << length << ">" << RTP_MAX_SIZE;
+        return false;
+    }
+    unsigned char *rtp_raw_ptr = (unsigned char *)rtp.data() + 4;
+    unsigned int rtp_raw_len = length - 4;
 
     rtp.interleaved = 2 * track->_type;
     rtp.mark = rtp_raw_ptr[1] >> 7;
@@ -104,21 +127,12 @@ bool RtpReceiver::handleOneRtp(int track_index,SdpTrack::Ptr &track, unsigned ch
         return false;
     }
 
-    if(length > RTP_MAX_SIZE){
-        WarnL << "超大的rtp包:" << length << ">" << RTP_MAX_SIZE;
-        return false;
-    }
-
-    //设置rtp负载长度
-    rtp.setCapacity(length);
-    rtp.setSize(length);
+    //重写4字节interleaved头，推流端的通道号可能与转发时不同
     uint8_t *payload_ptr = (uint8_t *)rtp.data();
     payload_ptr[0] = '$';
     payload_ptr[1] = rtp.interleaved;
     payload_ptr[2] = rtp_raw_len >> 8;
     payload_ptr[3] = (rtp_raw_len & 0x00FF);
-    //拷贝rtp负载
-    memcpy(payload_ptr + 4, rtp_raw_ptr, rtp_raw_len);
     //排序rtp
     sortRtp(rtp_ptr,track_index);
     return true;
@@ -176,10 +190,6 @@ void RtpReceiver::clear() {
     _rtp_sort_cache_map[1].clear();
 }
 
-void RtpReceiver::setPoolSize(int size) {
-    _rtp_pool.setSize(size);
-}
-
 int RtpReceiver::getJitterSize(int track_index){
     return _rtp_sort_cache_map[track_index].size();
 }
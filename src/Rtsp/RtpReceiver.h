@@ -55,6 +55,15 @@ protected:
      */
     bool handleOneRtp(int track_index,SdpTrack::Ptr &track, unsigned char *rtp_raw_ptr, unsigned int rtp_raw_len);
 
+    /**
+     * 解析并排序已经在RtpPacket中的rtp包，不再拷贝数据
+     * @param track_index track下标索引
+     * @param track sdp track相关信息
+     * @param rtp 4字节interleaved头加rtp数据
+     * @return 解析成功返回true
+     */
+    bool handleOneRtp(int track_index,SdpTrack::Ptr &track, const RtpPacket::Ptr &rtp);
+
     /**
      * rtp数据包排序后输出
      * @param rtp rtp数据包
@@ -62,7 +71,6 @@ protected:
      */
     virtual void onRtpSorted(const RtpPacket::Ptr &rtp, int track_index){}
     void clear();
-    void setPoolSize(int size);
     int getJitterSize(int track_index);
     int getCycleCount(int track_index);
 private:
@@ -80,8 +88,6 @@ private:
     bool _sort_started[2] = { 0 , 0};
     //rtp排序缓存，根据seq排序
     map<uint16_t , RtpPacket::Ptr> _rtp_sort_cache_map[2];
-    //rtp循环池
-    RtspMediaSource::PoolType _rtp_pool;
 };
 
 }//namespace mediakit
@@ -31,6 +31,7 @@
 #include <memory>
 #include <unordered_map>
 #include "Common/config.h"
+#include "Common/PacketArena.h"
 #include "Util/util.h"
 #include "Extension/Frame.h"
 
@@ -49,9 +50,17 @@ typedef enum {
 } eRtpType;
 };
 
-class RtpPacket : public BufferRaw{
+class RtpPacket : public ArenaBuffer{
 public:
 	typedef std::shared_ptr<RtpPacket> Ptr;
+
+	/**
+	 * 在PacketArena中创建rtp包，对象与负载都不经过malloc
+	 */
+	static Ptr create(){
+		return std::allocate_shared<RtpPacket>(ArenaAllocator<RtpPacket>());
+	}
+
 	uint8_t interleaved;
 	uint8_t PT;
 	bool mark;
@@ -28,12 +28,15 @@
 #define SRC_RTSP_RTSPMEDIASOURCE_H_
 
 #include <mutex>
+#include <atomic>
 #include <string>
 #include <memory>
 #include <functional>
 #include <unordered_map>
 #include "Common/config.h"
 #include "Common/MediaSource.h"
+#include "Common/PollerRingBuffer.h"
+#include "Common/TimeShiftBuffer.h"
 #include "RtpCodec.h"
 
 #include "Util/logger.h"
@@ -48,11 +51,53 @@ using namespace toolkit;
 
 namespace mediakit {
 
+/**
+ * rtp包在时移溢出文件中的格式:
+ * interleaved(1) + PT(1) + mark(1) + offset(1) + type(1) + timeStamp(4) + ssrc(4) + sequence(2) + 数据(含4字节interleaved头)
+ */
+template<>
+class TimeShiftCodec<RtpPacket> {
+public:
+	static uint32_t size(const RtpPacket &pkt) {
+		return HEADER_SIZE + pkt.size();
+	}
+	static void save(const RtpPacket &pkt, char *dst) {
+		dst[0] = pkt.interleaved;
+		dst[1] = pkt.PT;
+		dst[2] = pkt.mark;
+		dst[3] = pkt.offset;
+		dst[4] = pkt.type;
+		memcpy(dst + 5, &pkt.timeStamp, 4);
+		memcpy(dst + 9, &pkt.ssrc, 4);
+		memcpy(dst + 13, &pkt.sequence, 2);
+		memcpy(dst + HEADER_SIZE, pkt.data(), pkt.size());
+	}
+	static RtpPacket::Ptr load(const char *src, uint32_t size) {
+		auto pkt = RtpPacket::create();
+		pkt->interleaved = src[0];
+		pkt->PT = src[1];
+		pkt->mark = src[2];
+		pkt->offset = src[3];
+		pkt->type = (TrackType) (int8_t) src[4];
+		memcpy(&pkt->timeStamp, src + 5, 4);
+		memcpy(&pkt->ssrc, src + 9, 4);
+		memcpy(&pkt->sequence, src + 13, 2);
+		pkt->assign(src + HEADER_SIZE, size - HEADER_SIZE);
+		return pkt;
+	}
+private:
+	static constexpr uint32_t HEADER_SIZE = 15;
+};
+
+/**
+ * rtsp媒体源
+ * onGetSDP/onWrite只允许推流者所在线程(单写者)调用，写入路径无锁且不分配内存；
+ * 各轨道的ssrc/seq/时间戳保存在定长原子数组中，sdp通过原子快照发布给其他线程
+ */
 class RtspMediaSource: public MediaSource , public RingDelegate<RtpPacket::Ptr> {
 public:
-	typedef ResourcePool<RtpPacket> PoolType;
 	typedef std::shared_ptr<RtspMediaSource> Ptr;
-	typedef RingBuffer<RtpPacket::Ptr> RingType;
+	typedef PollerRingBuffer<RtpPacket::Ptr> RingType;
 
 	RtspMediaSource(const string &strVhost,
 	                const string &strApp,
@@ -61,7 +106,38 @@ public:
 			MediaSource(RTSP_SCHEMA,strVhost,strApp,strId),
 			_ringSize(ringSize){}
 
-	virtual ~RtspMediaSource() {}
+	virtual ~RtspMediaSource() {
+		auto timeShift = std::atomic_load(&_timeShift);
+		if (timeShift) {
+			//回看观看者读完缓存后断开
+			timeShift->close();
+		}
+	}
+
+	/**
+	 * 获取时移缓存
+	 * 时移缓存在该协议第一次有观看者请求回看(或暂停)时才创建，只缓存创建之后的数据，
+	 * 这样只有真正被回看的流、且只有被回看的协议占用内存与溢出文件
+	 * @param create 不存在时是否创建
+	 * @return 未开启直播时移或者尚未创建时返回nullptr
+	 */
+	TimeShiftBuffer<RtpPacket>::Ptr getTimeShift(bool create = false) {
+		auto ret = std::atomic_load(&_timeShift);
+		if (ret || !create) {
+			return ret;
+		}
+		ret = TimeShiftBuffer<RtpPacket>::create();
+		if (!ret) {
+			return nullptr;
+		}
+		TimeShiftBuffer<RtpPacket>::Ptr expected;
+		if (!std::atomic_compare_exchange_strong(&_timeShift, &expected, ret)) {
+			//其他线程已经创建
+			return expected;
+		}
+		InfoL << "创建直播时移缓存:" << getSchema() << "/" << getVhost() << "/" << getApp() << "/" << getId();
+		return ret;
+	}
 
 	const RingType::Ptr &getRing() const {
 		//获取媒体源的rtp环形缓冲
@@ -72,80 +148,132 @@ public:
         return _pRing ? _pRing->readerCount() : 0;
 	}
 
-    const string& getSdp() const {
+    string getSdp() const {
 		//获取该源的媒体描述信息
-		return _strSdp;
+		auto sdp = std::atomic_load(&_strSdp);
+		return sdp ? *sdp : string();
 	}
 
 	virtual uint32_t getSsrc(TrackType trackType) {
-		auto track = _sdpParser.getTrack(trackType);
+		auto track = getTrack(trackType);
 		if(!track){
 			return 0;
 		}
-		return track->_ssrc;
+		return track->ssrc.load(std::memory_order_relaxed);
 	}
 	virtual uint16_t getSeqence(TrackType trackType) {
-		auto track = _sdpParser.getTrack(trackType);
+		auto track = getTrack(trackType);
 		if(!track){
 			return 0;
 		}
-		return track->_seq;
+		return track->seq.load(std::memory_order_relaxed);
 	}
 
 	uint32_t getTimeStamp(TrackType trackType) override {
-		auto track = _sdpParser.getTrack(trackType);
+		auto track = getTrack(trackType);
 		if(track) {
-			return track->_time_stamp;
+			return track->time_stamp.load(std::memory_order_relaxed);
 		}
-		auto tracks = _sdpParser.getAvailableTrack();
-		switch (tracks.size()){
-			case 0: return 0;
-			case 1: return tracks[0]->_time_stamp;
-			default:return MAX(tracks[0]->_time_stamp,tracks[1]->_time_stamp);
+		uint32_t ret = 0;
+		for (auto &state : _trackState) {
+			if (state.available.load(std::memory_order_acquire)) {
+				ret = MAX(ret, state.time_stamp.load(std::memory_order_relaxed));
+			}
 		}
+		return ret;
 	}
 
 	virtual void setTimeStamp(uint32_t uiStamp) {
-		auto tracks = _sdpParser.getAvailableTrack();
-		for (auto &track : tracks) {
-			track->_time_stamp  = uiStamp;
+		for (auto &state : _trackState) {
+			if (state.available.load(std::memory_order_acquire)) {
+				state.time_stamp.store(uiStamp, std::memory_order_relaxed);
+			}
 		}
 	}
 
 	virtual void onGetSDP(const string& sdp) {
 		//派生类设置该媒体源媒体描述信息
-		_strSdp = sdp;
-		_sdpParser.load(sdp);
+		SdpParser parser(sdp);
+		for (int i = TrackVideo; i <= TrackAudio; ++i) {
+			_trackState[i].available.store(parser.getTrack((TrackType) i) != nullptr, std::memory_order_release);
+		}
+		std::atomic_store(&_strSdp, std::make_shared<const string>(sdp));
 		if(_pRing){
             regist();
 		}
 	}
 
 	void onWrite(const RtpPacket::Ptr &rtppt, bool keyPos) override {
-		auto track = _sdpParser.getTrack(rtppt->type);
+		auto track = getTrack(rtppt->type);
 		if(track){
-			track->_seq = rtppt->sequence;
-			track->_time_stamp = rtppt->timeStamp;
-			track->_ssrc = rtppt->ssrc;
+			track->seq.store(rtppt->sequence, std::memory_order_relaxed);
+			track->time_stamp.store(rtppt->timeStamp, std::memory_order_relaxed);
+			track->ssrc.store(rtppt->ssrc, std::memory_order_relaxed);
 		}
 		if(!_pRing){
 		    weak_ptr<RtspMediaSource> weakSelf = dynamic_pointer_cast<RtspMediaSource>(shared_from_this());
+            GET_CONFIG(bool,ringGroupByPoller,General::kRingGroupByPoller);
             _pRing = std::make_shared<RingType>(_ringSize,[weakSelf](const EventPoller::Ptr &,int size,bool){
                 auto strongSelf = weakSelf.lock();
                 if(!strongSelf){
                     return;
                 }
                 strongSelf->onReaderChanged(size);
-            });
+            },ringGroupByPoller);
             onReaderChanged(0);
-            if(!_strSdp.empty()){
+            if(std::atomic_load(&_strSdp)){
                 regist();
             }
 		}
+		//纯音频流每个包都可以作为起始位置
+		keyPos = keyPos || !getTrack(TrackVideo);
 		_pRing->write(rtppt,keyPos);
+		//时移时间轴总是计算，时移缓存创建后与之前的时间戳连续
+		auto stamp = shiftStamp(rtppt);
+		auto timeShift = std::atomic_load(&_timeShift);
+		if(timeShift){
+			timeShift->write(rtppt, stamp, keyPos);
+		}
         checkNoneReader();
 	}
 private:
+    struct TrackState {
+        std::atomic<bool> available {false};
+        std::atomic<uint32_t> ssrc {0};
+        std::atomic<uint16_t> seq {0};
+        std::atomic<uint32_t> time_stamp {0};
+    };
+
+    /**
+     * 计算时移缓存使用的时间戳，只在写线程调用
+     * 各轨道的rtp时间戳起始值随机并且按各自采样率回环，无法放在同一时间轴上比较；
+     * 这里按各轨道的时间戳增量累加到同一时间轴，轨道首个包对齐到当前已有轨道的最新时间
+     */
+    uint32_t shiftStamp(const RtpPacket::Ptr &rtp) {
+        auto &state = _shiftState[rtp->type == TrackAudio ? TrackAudio : TrackVideo];
+        if (!state.started) {
+            state.started = true;
+            state.stamp = MAX(_shiftState[TrackVideo].stamp, _shiftState[TrackAudio].stamp);
+        } else {
+            int32_t delta = (int32_t) (rtp->timeStamp - state.last);
+            if (delta > MAX_SHIFT_STAMP_JUMP_MS || delta < -MAX_SHIFT_STAMP_JUMP_MS) {
+                //时间戳回环或者跳变
+                delta = 0;
+            }
+            state.stamp += delta;
+        }
+        state.last = rtp->timeStamp;
+        return state.stamp;
+    }
+
+    TrackState *getTrack(int trackType) {
+        if (trackType < TrackVideo || trackType > TrackAudio) {
+            return nullptr;
+        }
+        auto &state = _trackState[trackType];
+        return state.available.load(std::memory_order_acquire) ? &state : nullptr;
+    }
+
     void onReaderChanged(int size){
 	    //我们记录最后一次活动时间
         _readerTicker.resetTime();
@@ -165,9 +293,20 @@ private:
         }
 	}
 protected:
-	SdpParser _sdpParser;
-    string _strSdp; //媒体描述信息
+    //各轨道状态，按TrackType下标访问
+    TrackState _trackState[TrackAudio + 1];
+    std::shared_ptr<const string> _strSdp; //媒体描述信息
     RingType::Ptr _pRing; //rtp环形缓冲
+    TimeShiftBuffer<RtpPacket>::Ptr _timeShift; //直播时移缓存
+    //时移时间轴的状态，只在写线程访问
+    struct ShiftState {
+        bool started = false;
+        uint32_t last = 0;
+        uint32_t stamp = 0;
+    };
+    //单个包时间戳增量超过该值时视为回环或跳变
+    static constexpr int32_t MAX_SHIFT_STAMP_JUMP_MS = 10 * 1000;
+    ShiftState _shiftState[TrackAudio + 1];
     int _ringSize;
     Ticker _readerTicker;
     bool _asyncEmitNoneReader = false;
@@ -43,7 +43,6 @@ using namespace mediakit::Client;
 namespace mediakit {
 
 RtspPlayer::RtspPlayer(const EventPoller::Ptr &poller) : TcpClient(poller){
-	RtpReceiver::setPoolSize(64);
 }
 RtspPlayer::~RtspPlayer(void) {
     DebugL<<endl;
@@ -492,6 +491,18 @@ void RtspPlayer::onRtpPacket(const char *data, uint64_t len) {
     }
 }
 
+void RtspPlayer::onRtpPacket(const RtpPacket::Ptr &rtp) {
+    uint8_t interleaved = rtp->data()[1];
+    int trackIdx = interleaved % 2 == 0 ? getTrackIndexByInterleaved(interleaved) : -1;
+    if (trackIdx == -1) {
+        //rtcp包或未知通道
+        onRtpPacket(rtp->data(), rtp->size());
+        return;
+    }
+    //rtp包已经在RtpPacket中，无需再次拷贝
+    handleOneRtp(trackIdx, _aTrackInfo[trackIdx], rtp);
+}
+
 void RtspPlayer::onRtcpPacket(int iTrackidx, SdpTrack::Ptr &track, unsigned char *pucData, unsigned int uiLen){
 
 }
@@ -76,6 +76,7 @@ protected:
      * @param len
      */
     void onRtpPacket(const char *data,uint64_t len) override ;
+    void onRtpPacket(const RtpPacket::Ptr &rtp) override;
 
     /**
      * rtp数据包排序后输出
@@ -93,7 +93,11 @@ void RtspSession::onError(const SockException& err) {
 	WarnP(this) << err.what();
 	if (_rtpType == Rtsp::RTP_MULTICAST) {
 		//取消UDP端口监听
-		UDPServer::Instance().stopListenPeer(get_peer_ip().data(), this);
+		for (size_t i = 0; i < _aTrackInfo.size() && i < 2; ++i) {
+			if (_aTrackInfo[i]->_inited) {
+				UDPServer::Instance().stopListenPeer(get_peer_ip().data(), this, _aPeerRtcpPort[i]);
+			}
+		}
 	}
 
 	if (_http_x_sessioncookie.size() != 0) {
@@ -213,6 +217,22 @@ void RtspSession::onRtpPacket(const char *data, uint64_t len) {
 	}
 }
 
+void RtspSession::onRtpPacket(const RtpPacket::Ptr &rtp) {
+    if(!_pushSrc){
+        return;
+    }
+
+    uint8_t interleaved = rtp->data()[1];
+    int trackIdx = interleaved % 2 == 0 ? getTrackIndexByInterleaved(interleaved) : -1;
+    if (trackIdx == -1) {
+        //rtcp包或未知通道
+        onRtpPacket(rtp->data(), rtp->size());
+        return;
+    }
+    //rtp包已经在RtpPacket中，无需再次拷贝
+    handleOneRtp(trackIdx, _aTrackInfo[trackIdx], rtp);
+}
+
 void RtspSession::onRtcpPacket(int iTrackidx, SdpTrack::Ptr &track, unsigned char *pucData, unsigned int uiLen){
 
 }
@@ -278,6 +298,8 @@ void RtspSession::handleReq_RECORD(const Parser &parser){
 			return;
 		}
 
+		//支持时移时Range使用时移缓存的时间轴，之后的seek请求在同一时间轴上定位
+		uint32_t rangeStamp = shiftStamp >= 0 ? (uint32_t) shiftStamp : (timeShift ? timeShift->liveStamp() : pMediaSrc->getTimeStamp(TrackInvalid));
 		_StrPrinter rtp_info;
 		for(auto &track : _aTrackInfo){
 			if (track->_inited == false) {
@@ -712,12 +734,20 @@ void RtspSession::handleReq_Setup(const Parser &parser) {
 			send_NotAcceptable();
             throw SockException(Err_shutdown, "open shared rtcp socket failed");
 		}
+		//播放器在client_port中声明了rtcp端口时按(ip,port)精确监听，
+		//否则无法预知其源端口(例如经过nat)，只能监听该ip的任意端口
+		int iClientRtp = 0, iClientRtcp = 0;
+		auto strClientPort = FindField(parser["Transport"].data(), "client_port=", NULL);
+		if (2 != sscanf(strClientPort.data(), "%d-%d", &iClientRtp, &iClientRtcp) || iClientRtcp <= 0 || iClientRtcp > 0xFFFF) {
+			iClientRtcp = 0;
+		}
+		_aPeerRtcpPort[trackIdx] = iClientRtcp;
 		startListenPeerUdpData(trackIdx);
         GET_CONFIG(uint32_t,udpTTL,MultiCast::kUdpTTL);
 
 		sendRtspResponse("200 OK",
 						 {"Transport",StrPrinter << "RTP/AVP;multicast;"
-												 << "destination=" << _pBrdcaster->getIP() << ";"
+												 << "destination=" << _pBrdcaster->getIP(trackRef->_type) << ";"
 												 << "source=" << get_local_ip() << ";"
 												 << "port=" << iSrvPort << "-" << pSockRtcp->get_local_port() << ";"
 												 << "ttl=" << udpTTL << ";"
@@ -754,8 +784,19 @@ void RtspSession::handleReq_Play(const Parser &parser) {
 
         bool useBuf = true;
 		_enableSendRtp = false;
-
-		if (strRange.size() && !_bFirstPlay) {
+		auto shiftPos = strRange.find("npt=-");
+		//组播不支持直播时移；回看或seek请求时才创建时移缓存
+		bool wantShift = shiftPos != string::npos || (strRange.size() && !_bFirstPlay);
+		auto timeShift = _rtpType != Rtsp::RTP_MULTICAST ? pMediaSrc->getTimeShift(wantShift) : nullptr;
+		//直播时移回看的起始时间戳，-1代表播放直播
+		int64_t shiftStamp = -1;
+		bool resumeShift = false;
+
+		if (shiftPos != string::npos && timeShift) {
+			//npt=-X 代表从直播时移缓存中回看X秒之前的内容
+			auto shiftMS = (uint32_t) (1000 * atof(strRange.data() + shiftPos + 5));
+			shiftStamp = (uint32_t) (timeShift->liveStamp() - shiftMS);
+		} else if (strRange.size() && !_bFirstPlay) {
             //这个是seek操作
 			auto strStart = FindField(strRange.data(), "npt=", "-");
 			if (strStart == "now") {
@@ -764,11 +805,37 @@ void RtspSession::handleReq_Play(const Parser &parser) {
 			auto iStartTime = 1000 * atof(strStart.data());
 			InfoP(this) << "rtsp seekTo(ms):" << iStartTime;
 			useBuf = !pMediaSrc->seekTo(iStartTime);
-		}else if(pMediaSrc->readerCount() == 0){
+			if (useBuf && timeShift) {
+				//直播源在时移缓存中定位，npt与Range回复中的时间戳一致
+				shiftStamp = (uint32_t) iStartTime;
+			}
+		} else if (!_bFirstPlay && _pTimeShiftReader) {
+			//回看中暂停后恢复，从暂停位置继续
+			_pTimeShiftReader->pause(false);
+			shiftStamp = _pTimeShiftReader->getStamp();
+			resumeShift = true;
+		} else if (!_bFirstPlay && _ui32PauseStamp && timeShift) {
+			//直播暂停后恢复，从暂停位置开始回看
+			shiftStamp = _ui32PauseStamp;
+		} else if(pMediaSrc->readerCount() == 0){
 			//第一个消费者
 			pMediaSrc->seekTo(0);
 		}
 		_bFirstPlay = false;
+		_ui32PauseStamp = 0;
+
+		if (shiftStamp >= 0 && (int32_t) (timeShift->liveStamp() - shiftStamp) <= 0) {
+			//定位到直播位置
+			shiftStamp = -1;
+			stopTimeShift();
+		}
+		if (shiftStamp >= 0 && !resumeShift) {
+			if (!startTimeShift(timeShift, shiftStamp)) {
+				WarnP(this) << "直播时移缓存中没有关键帧，从直播位置开始播放";
+				shiftStamp = -1;
+				stopTimeShift();
+			}
+		}
 
 		_StrPrinter rtp_info;
 		for(auto &track : _aTrackInfo){
@@ -780,6 +847,22 @@ void RtspSession::handleReq_Play(const Parser &parser) {
 			track->_ssrc = pMediaSrc->getSsrc(track->_type);
 			track->_seq = pMediaSrc->getSeqence(track->_type);
 			track->_time_stamp = pMediaSrc->getTimeStamp(track->_type);
+			if (_pTimeShiftReader) {
+				//回看时使用该track在回看位置之后的第一个rtp包
+				auto seq = _pTimeShiftReader->getSeq();
+				for (int i = 0; i < 1024; ++i) {
+					uint32_t stamp;
+					auto pkt = timeShift->read(seq + i, stamp);
+					if (!pkt) {
+						break;
+					}
+					if (pkt->type == track->_type) {
+						track->_seq = pkt->sequence;
+						track->_time_stamp = pkt->timeStamp;
+						break;
+					}
+				}
+			}
 
 			rtp_info << "url=" << _strContentBase << "/" << track->_control_surffix << ";"
 					 << "seq=" << track->_seq << ";"
@@ -789,7 +872,7 @@ void RtspSession::handleReq_Play(const Parser &parser) {
 		rtp_info.pop_back();
 
 		sendRtspResponse("200 OK",
-						 {"Range", StrPrinter << "npt=" << setiosflags(ios::fixed) << setprecision(2) <<  pMediaSrc->getTimeStamp(TrackInvalid) / 1000.0,
+						 {"Range", StrPrinter << "npt=" << setiosflags(ios::fixed) << setprecision(2) << rangeStamp / 1000.0,
 						  "RTP-Info",rtp_info
 						 });
 
@@ -814,7 +897,7 @@ void RtspSession::handleReq_Play(const Parser &parser) {
 				if(!strongSelf) {
 					return;
 				}
-				if(strongSelf->_enableSendRtp) {
+				if(strongSelf->_enableSendRtp && !strongSelf->_pTimeShiftReader) {
 					strongSelf->sendRtpPacket(pack);
 				}
 			});
@@ -856,6 +939,58 @@ void RtspSession::handleReq_Pause(const Parser &parser) {
 
 	sendRtspResponse("200 OK");
 	_enableSendRtp = false;
+	if (_pTimeShiftReader) {
+		_pTimeShiftReader->pause(true);
+		return;
+	}
+	auto pMediaSrc = _pMediaSrc.lock();
+	//暂停时创建时移缓存，恢复后才能从暂停位置继续
+	auto timeShift = pMediaSrc && _rtpType != Rtsp::RTP_MULTICAST ? pMediaSrc->getTimeShift(true) : nullptr;
+	if (timeShift) {
+		//记录暂停位置，恢复后从该位置开始回看
+		_ui32PauseStamp = timeShift->liveStamp();
+	}
+}
+
+bool RtspSession::startTimeShift(const TimeShiftBuffer<RtpPacket>::Ptr &buffer, uint32_t stamp) {
+	if (!_pTimeShiftReader) {
+		weak_ptr<RtspSession> weakSelf = dynamic_pointer_cast<RtspSession>(shared_from_this());
+		auto reader = std::make_shared<TimeShiftReader<RtpPacket> >(buffer, getPoller());
+		reader->setReadCB([weakSelf](const RtpPacket::Ptr &pack) {
+			auto strongSelf = weakSelf.lock();
+			if (!strongSelf) {
+				return;
+			}
+			if (strongSelf->_enableSendRtp) {
+				strongSelf->sendRtpPacket(pack);
+			}
+		});
+		reader->setDetachCB([weakSelf]() {
+			auto strongSelf = weakSelf.lock();
+			if (!strongSelf) {
+				return;
+			}
+			strongSelf->shutdown(SockException(Err_shutdown,"rtsp time shift buffer detached"));
+		});
+		if (!reader->seek(stamp)) {
+			return false;
+		}
+		_pTimeShiftReader = reader;
+	} else if (!_pTimeShiftReader->seek(stamp)) {
+		return false;
+	}
+	_pTimeShiftReader->pause(false);
+	InfoP(this) << "直播时移，落后直播:" << _pTimeShiftReader->getDelay() << "ms";
+	return true;
+}
+
+void RtspSession::stopTimeShift() {
+	if (!_pTimeShiftReader) {
+		return;
+	}
+	_pTimeShiftReader = nullptr;
+	//重新attach以便从gop缓存的关键帧开始播放
+	_pRtpReader = nullptr;
 }
 
 void RtspSession::handleReq_Teardown(const Parser &parser) {
@@ -972,6 +1107,12 @@ inline void RtspSession::startListenPeerUdpData(int trackIdx) {
             return true;
         }
 
+		if(strongSelf->getPoller()->isCurrentThread()){
+			//rtp over udp的端口与会话绑定在同一个poller，无需切换线程
+			strongSelf->onRcvPeerUdpData(intervaled,pBuf,*pPeerAddr);
+			return true;
+		}
+
 		struct sockaddr addr=*pPeerAddr;
 		strongSelf->async([weakSelf,pBuf,addr,intervaled]() {
 			auto strongSelf=weakSelf.lock();
@@ -986,10 +1127,11 @@ inline void RtspSession::startListenPeerUdpData(int trackIdx) {
 	switch (_rtpType){
 		case Rtsp::RTP_MULTICAST:{
 			//组播使用的共享rtcp端口
+			//按(ip,rtcp端口)监听，同一主机或nat后的多个会话互不干扰
 			UDPServer::Instance().listenPeer(get_peer_ip().data(), this, [onUdpData](
 					int intervaled, const Buffer::Ptr &pBuf, struct sockaddr *pPeerAddr) {
 				return onUdpData(pBuf,pPeerAddr,intervaled);
-			});
+			}, _aPeerRtcpPort[trackIdx]);
 		}
 			break;
 		case Rtsp::RTP_UDP:{
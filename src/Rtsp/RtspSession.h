@@ -93,6 +93,7 @@ protected:
      * @param len
      */
     void onRtpPacket(const char *data,uint64_t len) override;
+    void onRtpPacket(const RtpPacket::Ptr &rtp) override;
 
     /**
      * 从rtsp头中获取Content长度
@@ -154,6 +155,8 @@ private:
 	bool sendRtspResponse(const string &res_code,const std::initializer_list<string> &header, const string &sdp = "" , const char *protocol = "RTSP/1.0");
 	bool sendRtspResponse(const string &res_code,const StrCaseMap &header = StrCaseMap(), const string &sdp = "",const char *protocol = "RTSP/1.0");
 	void sendSenderReport(bool overTcp,int iTrackIndex);
+	bool startTimeShift(const TimeShiftBuffer<RtpPacket>::Ptr &buffer, uint32_t stamp);
+	void stopTimeShift();
 private:
 	Ticker _ticker;
 	int _iCseq = 0;
@@ -163,7 +166,11 @@ private:
 	bool _bFirstPlay = true;
     MediaInfo _mediaInfo;
 	std::weak_ptr<RtspMediaSource> _pMediaSrc;
-	RingBuffer<RtpPacket::Ptr>::RingReader::Ptr _pRtpReader;
+	RtspMediaSource::RingType::RingReader::Ptr _pRtpReader;
+	//直播时移回看读取器，回看期间环形缓冲读取器保持attach但不再发送数据
+	TimeShiftReader<RtpPacket>::Ptr _pTimeShiftReader;
+	//直播暂停时的时间戳，恢复后从该位置开始回看，0代表未暂停
+	uint32_t _ui32PauseStamp = 0;
 	Rtsp::eRtpType _rtpType = Rtsp::RTP_Invalid;
 	vector<SdpTrack::Ptr> _aTrackInfo;
 
@@ -191,6 +198,8 @@ private:
 
 	RtcpCounter _aRtcpCnt[2]; //rtcp统计,trackid idx 为数组下标
 	Ticker _aRtcpTicker[2]; //rtcp发送时间,trackid idx 为数组下标
+	//组播时播放器发送rtcp的端口,trackid idx 为数组下标，用于共享rtcp端口按(ip,port)区分会话
+	uint16_t _aPeerRtcpPort[2] = {0, 0};
 };
 
 /**
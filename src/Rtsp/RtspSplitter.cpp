@@ -25,6 +25,7 @@
  */
 
 #include <cstdlib>
+#include "Common/config.h"
 #include "RtspSplitter.h"
 
 namespace mediakit{
@@ -78,6 +79,67 @@ void RtspSplitter::enableRecvRtp(bool enable) {
     _enableRecvRtp = enable;
 }
 
+void RtspSplitter::input(const char *data, uint64_t len) {
+    if (_rtpPending) {
+        //补齐上次未接收完整的rtp包，数据只拷贝一次
+        uint32_t size = _rtpPending->size();
+        uint32_t append = MIN(_rtpPendingSize - size, len);
+        memcpy(_rtpPending->data() + size, data, append);
+        _rtpPending->setSize(size + append);
+        data += append;
+        len -= append;
+        if (_rtpPending->size() < _rtpPendingSize) {
+            return;
+        }
+        auto rtp = std::move(_rtpPending);
+        _rtpPending = nullptr;
+        onRtpPacket(rtp);
+    }
+
+    //HttpRequestSplitter没有缓存时，rtp包在调用者内存上直接切割
+    while (len >= 4 && _enableRecvRtp && data[0] == '$' && !isPending()) {
+        uint32_t size = 4 + ((((uint8_t *) data)[2] << 8) | ((uint8_t *) data)[3]);
+        if (len < size) {
+            //不完整的rtp包直接缓存到RtpPacket，避免下次把整段数据拷贝到HttpRequestSplitter的缓存
+            _rtpPending = RtpPacket::create();
+            _rtpPending->setCapacity(size);
+            memcpy(_rtpPending->data(), data, len);
+            _rtpPending->setSize(len);
+            _rtpPendingSize = size;
+            return;
+        }
+        onRtpPacket(data, size);
+        data += size;
+        len -= size;
+    }
+
+    if (!len) {
+        return;
+    }
+    HttpRequestSplitter::input(data, len);
+
+    //rtsp包之后缓存的半个rtp包移到RtpPacket，之后的数据恢复在调用者内存上直接切割
+    auto &remain = remainData();
+    if (_enableRecvRtp && !isRecvContent() && remain.size() >= 4 && remain[0] == '$') {
+        _rtpPendingSize = 4 + ((((uint8_t *) remain.data())[2] << 8) | ((uint8_t *) remain.data())[3]);
+        _rtpPending = RtpPacket::create();
+        _rtpPending->setCapacity(_rtpPendingSize);
+        memcpy(_rtpPending->data(), remain.data(), remain.size());
+        _rtpPending->setSize(remain.size());
+        HttpRequestSplitter::reset();
+    }
+}
+
+void RtspSplitter::reset() {
+    _rtpPending = nullptr;
+    _rtpPendingSize = 0;
+    HttpRequestSplitter::reset();
+}
+
+void RtspSplitter::onRtpPacket(const RtpPacket::Ptr &rtp) {
+    onRtpPacket(rtp->data(), rtp->size());
+}
+
 int64_t RtspSplitter::getContentLength(Parser &parser) {
     return atoi(parser["Content-Length"].data());
 }
@@ -27,6 +27,7 @@
 #ifndef ZLMEDIAKIT_RTSPSPLITTER_H
 #define ZLMEDIAKIT_RTSPSPLITTER_H
 
+#include "Rtsp.h"
 #include "Common/Parser.h"
 #include "Http/HttpRequestSplitter.h"
 
@@ -42,6 +43,18 @@ public:
     * @param enable
     */
     void enableRecvRtp(bool enable);
+
+    /**
+     * 添加数据
+     * 连续的rtp over tcp包直接在调用者内存上切割，
+     * 跨越两次输入的rtp包直接缓存到RtpPacket中，补齐后回调，不经过中间缓存
+     */
+    void input(const char *data,uint64_t len) override;
+
+    /**
+     * 恢复初始设置，同时丢弃缓存的不完整rtp包
+     */
+    void reset() override;
 protected:
     /**
      * 收到完整的rtsp包回调，包括sdp等content数据
@@ -56,6 +69,13 @@ protected:
      */
     virtual void onRtpPacket(const char *data,uint64_t len) = 0;
 
+    /**
+     * 收到跨越多次输入、已经缓存到RtpPacket中的rtp包回调
+     * 数据为4字节interleaved头加rtp包，默认按onRtpPacket(data,len)处理
+     * @param rtp rtp包
+     */
+    virtual void onRtpPacket(const RtpPacket::Ptr &rtp);
+
     /**
      * 从rtsp头中获取Content长度
      * @param parser
@@ -70,6 +90,9 @@ private:
     bool _enableRecvRtp = false;
     bool _isRtpPacket = false;
     Parser _parser;
+    //尚未接收完整的rtp包及其完整长度
+    RtpPacket::Ptr _rtpPending;
+    uint32_t _rtpPendingSize = 0;
 };
 
 }//namespace mediakit
@@ -62,51 +62,71 @@ Socket::Ptr UDPServer::getSock(const EventPoller::Ptr &poller,const char* strLoc
 	return it->second;
 }
 
-void UDPServer::listenPeer(const char* strPeerIp, void* pSelf, const onRecvData& cb) {
+UDPServer::PeerKey UDPServer::makePeerKey(uint32_t ip, uint16_t port) {
+	//ip与port均为网络字节序
+	return ((PeerKey) ip << 16) | port;
+}
+
+void UDPServer::listenPeer(const char* strPeerIp, void* pSelf, const onRecvData& cb, uint16_t iPeerPort) {
+	auto key = makePeerKey(inet_addr(strPeerIp), htons(iPeerPort));
 	lock_guard<mutex> lck(_mtxDataHandler);
-	auto &mapRef = _mapDataHandler[strPeerIp];
-	mapRef.emplace(pSelf, cb);
+	auto mapCopy = _mapDataHandler ? std::make_shared<PeerHandlerMap>(*_mapDataHandler) : std::make_shared<PeerHandlerMap>();
+	(*mapCopy)[key][pSelf] = cb;
+	std::atomic_store(&_mapDataHandler, PeerHandlerMapPtr(mapCopy));
 }
 
-void UDPServer::stopListenPeer(const char* strPeerIp, void* pSelf) {
+void UDPServer::stopListenPeer(const char* strPeerIp, void* pSelf, uint16_t iPeerPort) {
+	removeHandler(makePeerKey(inet_addr(strPeerIp), htons(iPeerPort)), pSelf);
+}
+
+void UDPServer::removeHandler(PeerKey key, void *pSelf) {
 	lock_guard<mutex> lck(_mtxDataHandler);
-	auto it0 = _mapDataHandler.find(strPeerIp);
-	if (it0 == _mapDataHandler.end()) {
+	if (!_mapDataHandler) {
 		return;
 	}
-	auto &mapRef = it0->second;
-	auto it1 = mapRef.find(pSelf);
-	if (it1 != mapRef.end()) {
-		mapRef.erase(it1);
+	auto it0 = _mapDataHandler->find(key);
+	if (it0 == _mapDataHandler->end() || !it0->second.count(pSelf)) {
+		return;
 	}
+	auto mapCopy = std::make_shared<PeerHandlerMap>(*_mapDataHandler);
+	auto &mapRef = (*mapCopy)[key];
+	mapRef.erase(pSelf);
 	if (mapRef.size() == 0) {
-		_mapDataHandler.erase(it0);
+		mapCopy->erase(key);
 	}
-
+	std::atomic_store(&_mapDataHandler, PeerHandlerMapPtr(mapCopy));
 }
+
 void UDPServer::onErr(const string& strKey, const SockException& err) {
 	WarnL << err.what();
 	lock_guard<mutex> lck(_mtxUpdSock);
 	_mapUpdSock.erase(strKey);
 }
+
+bool UDPServer::dispatch(const PeerHandlerMapPtr &handlers, PeerKey key, int intervaled, const Buffer::Ptr &pBuf, struct sockaddr *pPeerAddr) {
+	auto it0 = handlers->find(key);
+	if (it0 == handlers->end()) {
+		return false;
+	}
+	for (auto &pr : it0->second) {
+		if (!pr.second(intervaled, pBuf, pPeerAddr)) {
+			//监听者已经销毁，移除之
+			removeHandler(key, pr.first);
+		}
+	}
+	return true;
+}
+
 void UDPServer::onRcvData(int intervaled, const Buffer::Ptr &pBuf, struct sockaddr* pPeerAddr) {
 	//TraceL << trackIndex;
-	struct sockaddr_in *in = (struct sockaddr_in *) pPeerAddr;
-	string peerIp = inet_ntoa(in->sin_addr);
-	lock_guard<mutex> lck(_mtxDataHandler);
-	auto it0 = _mapDataHandler.find(peerIp);
-	if (it0 == _mapDataHandler.end()) {
+	auto handlers = std::atomic_load(&_mapDataHandler);
+	if (!handlers) {
 		return;
 	}
-	auto &mapRef = it0->second;
-	for (auto it1 = mapRef.begin(); it1 != mapRef.end(); ++it1) {
-		onRecvData &funRef = it1->second;
-		if (!funRef(intervaled, pBuf, pPeerAddr)) {
-			it1 = mapRef.erase(it1);
-		}
-	}
-	if (mapRef.size() == 0) {
-		_mapDataHandler.erase(it0);
+	struct sockaddr_in *in = (struct sockaddr_in *) pPeerAddr;
+	//优先匹配(ip,port)精确监听者，否则交给监听该ip任意端口的监听者
+	if (!dispatch(handlers, makePeerKey(in->sin_addr.s_addr, in->sin_port), intervaled, pBuf, pPeerAddr)) {
+		dispatch(handlers, makePeerKey(in->sin_addr.s_addr, 0), intervaled, pBuf, pPeerAddr);
 	}
 }
 
@@ -47,16 +47,36 @@ public:
 	~UDPServer();
 	static UDPServer &Instance();
 	Socket::Ptr getSock(const EventPoller::Ptr &poller,const char *strLocalIp, int intervaled,uint16_t iLocalPort = 0);
-	void listenPeer(const char *strPeerIp, void *pSelf, const onRecvData &cb);
-	void stopListenPeer(const char *strPeerIp, void *pSelf);
+
+	/**
+	 * 监听某个对端地址发来的udp数据
+	 * @param strPeerIp 对端ip
+	 * @param pSelf 监听者标识
+	 * @param cb 数据回调，返回false时取消监听
+	 * @param iPeerPort 对端端口，为0时匹配该ip的任意端口
+	 */
+	void listenPeer(const char *strPeerIp, void *pSelf, const onRecvData &cb, uint16_t iPeerPort = 0);
+	void stopListenPeer(const char *strPeerIp, void *pSelf, uint16_t iPeerPort = 0);
 private:
+	//(ip,port)组合成的数字key,避免每个udp包都做inet_ntoa和字符串hash
+	typedef uint64_t PeerKey;
+	typedef unordered_map<void *, onRecvData> HandlerMap;
+	typedef unordered_map<PeerKey, HandlerMap> PeerHandlerMap;
+	typedef std::shared_ptr<const PeerHandlerMap> PeerHandlerMapPtr;
+
 	UDPServer();
+	static PeerKey makePeerKey(uint32_t ip, uint16_t port);
 	void onRcvData(int intervaled, const Buffer::Ptr &pBuf,struct sockaddr *pPeerAddr);
 	void onErr(const string &strKey,const SockException &err);
+	bool dispatch(const PeerHandlerMapPtr &handlers, PeerKey key, int intervaled, const Buffer::Ptr &pBuf,struct sockaddr *pPeerAddr);
+	void removeHandler(PeerKey key, void *pSelf);
+
 	unordered_map<string, Socket::Ptr> _mapUpdSock;
 	mutex _mtxUpdSock;
 
-	unordered_map<string, unordered_map<void *, onRecvData> > _mapDataHandler;
+	//写时复制的数据回调表，收包线程只做原子读取，不加锁
+	//注册与注销只在setup/teardown时发生，频率很低
+	PeerHandlerMapPtr _mapDataHandler;
 	mutex _mtxDataHandler;
 };
 
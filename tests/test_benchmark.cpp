@@ -29,6 +29,7 @@
 #include <list>
 #include "Util/logger.h"
 #include "Util/onceToken.h"
+#include "Util/TimeTicker.h"
 #include "Rtsp/UDPServer.h"
 #include "Network/sockutil.h"
 #include "Poller/EventPoller.h"
@@ -51,20 +52,28 @@ int main(int argc, char *argv[]) {
         ErrorL << "\r\n测试方法:./test_benchmark player_count play_interval rtxp_url rtp_type\r\n"
                << "例如你想每隔50毫秒启动共计100个播放器（tcp方式播放rtsp://127.0.0.1/live/0 ）可以输入以下命令:\r\n"
                << "./test_benchmark 100 50 rtsp://127.0.0.1/live/0 0\r\n"
+               << "play_interval为0时进入连接风暴模式，所有播放器同时发起连接，用于测试服务器accept性能:\r\n"
+               << "./test_benchmark 5000 0 rtsp://127.0.0.1/live/0 0\r\n"
+               << "rtmp播放url加上aggregate=1/0参数可以对比服务器使用/不使用聚合消息时的性能:\r\n"
+               << "./test_benchmark 10000 10 rtmp://127.0.0.1/live/0?aggregate=1 0\r\n"
                << endl;
         return 0;
 
     }
     list<MediaPlayer::Ptr> playerList;
     auto playerCnt = atoi(argv[1]);//启动的播放器个数
+    auto playInterval = atoi(argv[2]);
     atomic_int alivePlayerCnt(0);
+    atomic_int failedPlayerCnt(0);
+    Ticker ticker;
 
-    //每隔若干毫秒启动一个播放器（如果一次性全部启动，服务器和客户端可能都承受不了）
-    Timer timer0(atoi(argv[2])/1000.0f,[&]() {
-        MediaPlayer::Ptr player(new MediaPlayer());
+    auto createPlayer = [&](const EventPoller::Ptr &poller) {
+        MediaPlayer::Ptr player(new MediaPlayer(poller));
         player->setOnPlayResult([&](const SockException &ex) {
             if (!ex) {
                 ++alivePlayerCnt;
+            } else {
+                ++failedPlayerCnt;
             }
         });
         player->setOnShutdown([&](const SockException &ex) {
@@ -73,12 +82,42 @@ int main(int argc, char *argv[]) {
         (*player)[kRtpType] = atoi(argv[4]);
         player->play(argv[3]);
         playerList.push_back(player);
-        return playerCnt--;
-    }, nullptr);
+    };
 
+    std::shared_ptr<Timer> timer0;
+    if (playInterval > 0) {
+        //每隔若干毫秒启动一个播放器（如果一次性全部启动，服务器和客户端可能都承受不了）
+        timer0 = std::make_shared<Timer>(playInterval / 1000.0f, [&]() {
+            createPlayer(nullptr);
+            return --playerCnt > 0;
+        }, nullptr);
+    } else {
+        //连接风暴模式，模拟大规模断线重连，所有播放器同时发起连接
+        ticker.resetTime();
+        for (int i = 0; i < playerCnt; ++i) {
+            createPlayer(EventPollerPool::Instance().getPoller());
+        }
+        InfoL << "已同时发起" << playerCnt << "个连接,耗时:" << ticker.elapsedTime() << "ms";
+    }
 
+    int lastDoneCnt = 0;
+    bool stormDone = false;
     Timer timer1(1,[&]() {
-        InfoL << "存活播放器个数:" << alivePlayerCnt.load();
+        if (playInterval > 0) {
+            InfoL << "存活播放器个数:" << alivePlayerCnt.load();
+            return true;
+        }
+        int doneCnt = alivePlayerCnt.load() + failedPlayerCnt.load();
+        InfoL << "存活播放器个数:" << alivePlayerCnt.load()
+              << ",失败个数:" << failedPlayerCnt.load()
+              << ",本秒完成播放握手:" << doneCnt - lastDoneCnt << "个/s";
+        lastDoneCnt = doneCnt;
+        if (!stormDone && doneCnt >= playerCnt) {
+            stormDone = true;
+            auto elapsed = ticker.elapsedTime();
+            InfoL << "连接风暴完成," << playerCnt << "个播放器耗时:" << elapsed << "ms,平均:"
+                  << playerCnt * 1000.0 / (elapsed ? elapsed : 1) << "个/s";
+        }
         return true;
     }, nullptr);
 
@@ -0,0 +1,159 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Util/TimeTicker.h"
+#include "Common/Parser.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+//典型的hls播放请求
+static const char kRequest[] =
+        "GET /live/0/hls.m3u8?vhost=__defaultVhost__&token=7f2c81aa HTTP/1.1\r\n"
+        "Host: 127.0.0.1:8080\r\n"
+        "Connection: keep-alive\r\n"
+        "User-Agent: Mozilla/5.0 (Macintosh; Intel Mac OS X 10_14_5) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/75.0.3770.100 Safari/537.36\r\n"
+        "Accept: */*\r\n"
+        "Origin: http://127.0.0.1\r\n"
+        "Referer: http://127.0.0.1/player.html\r\n"
+        "Accept-Encoding: gzip, deflate, br\r\n"
+        "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+        "Cookie: ZL_COOKIE=5ce5d7c3-3bf1-4dcd-9d1b-b3b1e2a2a3f1\r\n"
+        "\r\n";
+
+//改造前的解析方式，作为对比基准
+static void legacyParse(const char *buf,
+                        string &method,
+                        string &url,
+                        StrCaseMap &headers,
+                        StrCaseMap &args) {
+    const char *start = buf;
+    headers.clear();
+    args.clear();
+    while (true) {
+        auto line = FindField(start, NULL, "\r\n");
+        if (line.size() == 0) {
+            break;
+        }
+        if (start == buf) {
+            method = FindField(line.data(), NULL, " ");
+            auto full_url = FindField(line.data(), " ", " ");
+            auto args_pos = full_url.find('?');
+            if (args_pos != string::npos) {
+                url = full_url.substr(0, args_pos);
+                args = Parser::parseArgs(full_url.substr(args_pos + 1));
+            } else {
+                url = full_url;
+            }
+        } else {
+            auto field = FindField(line.data(), NULL, ": ");
+            auto value = FindField(line.data(), ": ", NULL);
+            if (field.size() != 0) {
+                headers.emplace_force(field, value);
+            }
+        }
+        start = start + line.size() + 2;
+        if (strncmp(start, "\r\n", 2) == 0) {
+            break;
+        }
+    }
+}
+
+static void printResult(const char *name, int count, uint64_t ms) {
+    InfoL << name << ": " << count << "次, 耗时" << ms << "ms, "
+          << (ms ? count * 1000ULL / ms : 0) << " req/s";
+}
+
+int main(int argc, char *argv[]) {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+    Logger::Instance().setWriter(std::make_shared<AsyncLogWriter>());
+
+    int count = argc > 1 ? atoi(argv[1]) : 1000000;
+    if (count <= 0) {
+        count = 1000000;
+    }
+    InfoL << "用法: " << argv[0] << " [解析次数(默认1000000)]";
+
+    //先校验各解析结果一致
+    {
+        Parser parser;
+        parser.Parse(kRequest);
+        ParserView view;
+        auto header_size = view.parse(kRequest, sizeof(kRequest) - 1);
+        if (header_size != sizeof(kRequest) - 1 ||
+            parser.Method() != "GET" ||
+            parser.Url() != "/live/0/hls.m3u8" ||
+            parser.Tail() != "HTTP/1.1" ||
+            parser["connection"] != "keep-alive" ||
+            parser.getUrlArgs()["vhost"] != "__defaultVhost__" ||
+            parser.getValues().size() != 9 ||
+            !(view.url() == "/live/0/hls.m3u8") ||
+            !(view["HOST"] == "127.0.0.1:8080")) {
+            ErrorL << "解析结果不正确";
+            return -1;
+        }
+    }
+
+    //模拟HttpSession处理一次hls请求时的典型访问
+    int check = 0;
+    {
+        string method, url;
+        StrCaseMap headers, args;
+        Ticker ticker;
+        for (int i = 0; i < count; ++i) {
+            legacyParse(kRequest, method, url, headers, args);
+            check += headers["Host"].size() + headers["Connection"].size() + args["vhost"].size();
+        }
+        printResult("FindField+StrCaseMap", count, ticker.elapsedTime());
+    }
+
+    {
+        Parser parser;
+        Ticker ticker;
+        for (int i = 0; i < count; ++i) {
+            parser.Parse(kRequest);
+            check += parser["Host"].size() + parser["Connection"].size() + parser.getUrlArgs()["vhost"].size();
+            parser.Clear();
+        }
+        printResult("Parser", count, ticker.elapsedTime());
+    }
+
+    {
+        ParserView view;
+        Ticker ticker;
+        for (int i = 0; i < count; ++i) {
+            view.parse(kRequest, sizeof(kRequest) - 1);
+            check += view["Host"].size() + view["Connection"].size() + view.params().size();
+        }
+        printResult("ParserView", count, ticker.elapsedTime());
+    }
+
+    InfoL << "校验值:" << check;
+    return 0;
+}
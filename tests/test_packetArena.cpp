@@ -0,0 +1,185 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+#include <iostream>
+#include <stdlib.h>
+#include "Util/logger.h"
+#include "Util/TimeTicker.h"
+#include "Common/PacketArena.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+//常见的媒体包大小：rtcp、音频、rtp(MTU)、rtmp chunk
+static const size_t kSizes[] = {64, 400, 1400, 4096};
+static const int kSizeCount = sizeof(kSizes) / sizeof(kSizes[0]);
+//每个线程同时持有的内存块数，模拟环形缓冲中待发送的包
+static const int kWindow = 256;
+
+static void *allocBlock(bool arena, size_t size) {
+    return arena ? PacketArena::Instance().allocate(size) : malloc(size);
+}
+
+static void freeBlock(bool arena, void *ptr) {
+    if (arena) {
+        PacketArena::Instance().deallocate(ptr);
+    } else {
+        free(ptr);
+    }
+}
+
+/**
+ * 等待所有线程到达同一位置
+ */
+class Barrier {
+public:
+    Barrier(int count) : _count(count) {}
+
+    void wait() {
+        unique_lock<mutex> lck(_mtx);
+        auto generation = _generation;
+        if (++_arrived == _count) {
+            _arrived = 0;
+            ++_generation;
+            _cond.notify_all();
+            return;
+        }
+        _cond.wait(lck, [&]() { return generation != _generation; });
+    }
+
+private:
+    mutex _mtx;
+    condition_variable _cond;
+    int _count;
+    int _arrived = 0;
+    uint64_t _generation = 0;
+};
+
+/**
+ * 多线程同时申请释放内存块，返回耗时
+ * 每个线程每轮申请kWindow个内存块后释放
+ * @param arena 是否使用PacketArena，否则使用malloc
+ * @param thread_count 线程数
+ * @param count 每个线程申请内存块数
+ * @param cross_thread 是否由下一个线程释放(模拟写线程申请、poller线程释放)
+ */
+static uint64_t bench(bool arena, int thread_count, int count, bool cross_thread) {
+    vector<vector<void *> > blocks(thread_count);
+    Barrier barrier(thread_count);
+    Ticker ticker;
+    vector<std::thread> threads;
+    for (int i = 0; i < thread_count; ++i) {
+        threads.emplace_back([&, i]() {
+            auto &mine = blocks[i];
+            auto &other = blocks[cross_thread ? (i + 1) % thread_count : i];
+            mine.reserve(kWindow);
+            for (int j = 0; j < count; j += kWindow) {
+                for (int k = j; k < j + kWindow && k < count; ++k) {
+                    mine.emplace_back(allocBlock(arena, kSizes[k % kSizeCount]));
+                }
+                if (cross_thread) {
+                    barrier.wait();
+                }
+                for (auto ptr : other) {
+                    freeBlock(arena, ptr);
+                }
+                other.clear();
+                if (cross_thread) {
+                    barrier.wait();
+                }
+            }
+        });
+    }
+    for (auto &th : threads) {
+        th.join();
+    }
+    return ticker.elapsedTime();
+}
+
+//汇总所有档位的统计
+static void sumStatistic(uint64_t &alloc_count, uint64_t &in_use) {
+    alloc_count = 0;
+    in_use = 0;
+    for (auto &stat : PacketArena::Instance().getStatistic()) {
+        alloc_count += stat.alloc_count;
+        in_use += stat.in_use;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    //设置日志
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+    Logger::Instance().setWriter(std::make_shared<AsyncLogWriter>());
+
+    int count = argc > 1 ? atoi(argv[1]) : 1000000;
+    if (count <= 0) {
+        ErrorL << "\r\n测试方法:./test_packetArena [count]\r\n"
+               << "分别测试1/4/16个线程各申请释放count个媒体包大小的内存块时PacketArena与malloc的耗时，并校验统计信息\r\n"
+               << endl;
+        return 0;
+    }
+
+    int ret = 0;
+    for (auto thread_count : {1, 4, 16}) {
+        for (auto cross_thread : {false, true}) {
+            uint64_t alloc_before, in_use_before;
+            sumStatistic(alloc_before, in_use_before);
+            auto arena_ms = bench(true, thread_count, count, cross_thread);
+            uint64_t alloc_after, in_use_after;
+            sumStatistic(alloc_after, in_use_after);
+            auto malloc_ms = bench(false, thread_count, count, cross_thread);
+
+            InfoL << "线程数:" << thread_count << (cross_thread ? " 跨线程释放" : " 本线程释放")
+                  << " PacketArena耗时:" << arena_ms << "ms"
+                  << " malloc耗时:" << malloc_ms << "ms";
+
+            //所有线程的计数都要汇总到统计中，内存块全部释放后占用恢复原值
+            uint64_t expect = (uint64_t) thread_count * count;
+            if (alloc_after - alloc_before != expect || in_use_after != in_use_before) {
+                ErrorL << "统计信息错误，申请次数:" << alloc_after - alloc_before << "(应为" << expect << ")"
+                       << " 占用:" << in_use_after << "(应为" << in_use_before << ")";
+                ret = -1;
+            }
+        }
+    }
+
+    for (auto &stat : PacketArena::Instance().getStatistic()) {
+        InfoL << "档位:" << stat.block_size
+              << " 占用:" << stat.in_use
+              << " 峰值:" << stat.high_water
+              << " 缓存:" << stat.cached
+              << " 申请:" << stat.alloc_count
+              << " 未命中:" << stat.miss_count;
+    }
+    //等待日志输出
+    sleep(1);
+    return ret;
+}
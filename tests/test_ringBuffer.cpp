@@ -0,0 +1,141 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <signal.h>
+#include <atomic>
+#include <vector>
+#include <iostream>
+#include "Util/logger.h"
+#include "Util/TimeTicker.h"
+#include "Poller/EventPoller.h"
+#include "Rtsp/Rtsp.h"
+#include "Common/PollerRingBuffer.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+typedef PollerRingBuffer<RtpPacket::Ptr> RingType;
+
+//每批写入的包数，小于积压上限，避免poller线程来不及处理时丢弃积压数据
+static const int kBurstSize = RING_MAX_PENDING_SIZE / 2;
+//读取器长时间没有收到新数据则认为数据已被丢弃，停止等待
+static const uint64_t kIdleTimeoutMS = 5 * 1000;
+
+/**
+ * 等待读取器收到指定个数的包，超时返回false
+ */
+static bool waitReceived(const std::shared_ptr<atomic<uint64_t> > &received, uint64_t expect) {
+    auto last = received->load();
+    Ticker idle;
+    while (last < expect) {
+        usleep(1000);
+        auto now = received->load();
+        if (now != last) {
+            last = now;
+            idle.resetTime();
+        } else if (idle.elapsedTime() > kIdleTimeoutMS) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * 测试一个媒体源在指定观看者个数下的分发耗时与跨线程唤醒次数
+ * @param reader_count 观看者个数，平均分布在所有poller线程
+ * @param packet_count 写入rtp包个数
+ * @param group_by_poller 是否按poller线程分组分发
+ */
+static void bench(int reader_count, int packet_count, bool group_by_poller) {
+    auto ring = std::make_shared<RingType>(0, nullptr, group_by_poller);
+    std::shared_ptr<atomic<uint64_t> > received = std::make_shared<atomic<uint64_t> >(0);
+    vector<RingType::RingReader::Ptr> readers;
+    readers.reserve(reader_count);
+    for (int i = 0; i < reader_count; ++i) {
+        auto reader = ring->attach(EventPollerPool::Instance().getPoller(), false);
+        reader->setReadCB([received](const RtpPacket::Ptr &pkt) {
+            received->fetch_add(1, std::memory_order_relaxed);
+        });
+        readers.emplace_back(reader);
+    }
+    //等待读取器加入完毕
+    while (ring->readerCount() != reader_count) {
+        usleep(1000);
+    }
+    auto wakeups_before = ring->wakeupCount();
+
+    Ticker ticker;
+    uint64_t write_ms = 0;
+    bool timeout = false;
+    for (int i = 0; i < packet_count && !timeout;) {
+        //分批写入，每批分发完成后再写下一批
+        Ticker write_ticker;
+        for (int end = MIN(packet_count, i + kBurstSize); i < end; ++i) {
+            auto pkt = std::make_shared<RtpPacket>();
+            pkt->setCapacity(1400);
+            pkt->setSize(1400);
+            pkt->sequence = i;
+            ring->write(pkt, i % 100 == 0);
+        }
+        write_ms += write_ticker.elapsedTime();
+        timeout = !waitReceived(received, (uint64_t) reader_count * i);
+    }
+    auto total_ms = ticker.elapsedTime();
+    uint64_t total = (uint64_t) reader_count * packet_count;
+    auto dropped = total - MIN(total, received->load());
+
+    InfoL << (group_by_poller ? "按poller分组" : "逐个读取器") << " 观看者:" << reader_count
+          << " 包数:" << packet_count
+          << " 写入耗时:" << write_ms << "ms"
+          << " 分发完成耗时:" << total_ms << "ms"
+          << " 跨线程唤醒:" << ring->wakeupCount() - wakeups_before;
+    if (dropped) {
+        WarnL << "有" << dropped << "个包未送达观看者(积压溢出被丢弃或等待超时)";
+    }
+}
+
+int main(int argc, char *argv[]) {
+    //设置日志
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+    Logger::Instance().setWriter(std::make_shared<AsyncLogWriter>());
+
+    int packet_count = argc > 1 ? atoi(argv[1]) : 2000;
+    if (packet_count <= 0) {
+        ErrorL << "\r\n测试方法:./test_ringBuffer [packet_count]\r\n"
+               << "分别测试每个媒体源1000/5000/10000个观看者时环形缓冲的分发性能\r\n"
+               << endl;
+        return 0;
+    }
+
+    for (auto reader_count : {1000, 5000, 10000}) {
+        bench(reader_count, packet_count, false);
+        bench(reader_count, packet_count, true);
+    }
+    //等待读取器释放完毕
+    sleep(1);
+    return 0;
+}
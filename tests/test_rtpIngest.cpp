@@ -0,0 +1,223 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <signal.h>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <iostream>
+#include "Util/logger.h"
+#include "Util/TimeTicker.h"
+#include "Rtsp/RtspSplitter.h"
+#include "Rtsp/RtpReceiver.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+/**
+ * 模拟一个rtsp推流会话的接收路径：RtspSplitter切割 + RtpReceiver解析排序
+ */
+class IngestSession : public RtspSplitter, public RtpReceiver {
+public:
+    IngestSession(bool legacy) : _legacy(legacy) {
+        enableRecvRtp(true);
+        _track = std::make_shared<SdpTrack>();
+        _track->_type = TrackVideo;
+        _track->_samplerate = 90000;
+    }
+
+    void feed(const char *data, uint64_t len) {
+        if (_legacy) {
+            //旧的接收路径：所有数据经过HttpRequestSplitter的缓存
+            HttpRequestSplitter::input(data, len);
+        } else {
+            input(data, len);
+        }
+    }
+
+    uint64_t packets() const {
+        return _packets;
+    }
+
+    uint64_t parsed() const {
+        return _parsed;
+    }
+
+protected:
+    void onWholeRtspPacket(Parser &parser) override {}
+
+    void onRtpPacket(const char *data, uint64_t len) override {
+        ++_parsed;
+        if (data[1] == 0) {
+            handleOneRtp(0, _track, (unsigned char *) data + 4, len - 4);
+        }
+    }
+
+    void onRtpPacket(const RtpPacket::Ptr &rtp) override {
+        ++_parsed;
+        if (rtp->data()[1] == 0) {
+            handleOneRtp(0, _track, rtp);
+        }
+    }
+
+    void onRtpSorted(const RtpPacket::Ptr &rtp, int track_index) override {
+        ++_packets;
+    }
+
+private:
+    bool _legacy;
+    uint64_t _packets = 0;
+    uint64_t _parsed = 0;
+    SdpTrack::Ptr _track;
+};
+
+/**
+ * 生成指定码率1秒钟的rtp over tcp数据，每个rtp over tcp包长度为4 + 12 + payload_size
+ */
+static string makeStream(int kbps, int payload_size) {
+    string stream;
+    int count = kbps * 1000 / 8 / payload_size;
+    for (int i = 0; i < count; ++i) {
+        int rtp_len = 12 + payload_size;
+        string pkt(4 + rtp_len, '\0');
+        pkt[0] = '$';
+        pkt[1] = 0;
+        pkt[2] = rtp_len >> 8;
+        pkt[3] = rtp_len & 0xFF;
+        pkt[4] = (char) 0x80;
+        pkt[5] = (char) (96 | (i % 10 == 9 ? 0x80 : 0));
+        pkt[6] = (i >> 8) & 0xFF;
+        pkt[7] = i & 0xFF;
+        uint32_t stamp = htonl(i / 10 * 3600);
+        memcpy(&pkt[8], &stamp, 4);
+        uint32_t ssrc = htonl(0x12345678);
+        memcpy(&pkt[12], &ssrc, 4);
+        stream.append(pkt);
+    }
+    return stream;
+}
+
+/**
+ * 测试多个推流者的接收性能
+ * @param publisher_count 推流者个数
+ * @param kbps 每个推流者的码率
+ * @param seconds 每个推流者推流的媒体时长
+ * @param read_size 每次从socket读取的数据量
+ * @param legacy 是否使用旧的接收路径
+ * @return 切割出的rtp包个数是否与输入一致
+ */
+static bool bench(int publisher_count, int kbps, int seconds, int read_size, bool legacy) {
+    const int payload_size = 1400;
+    const size_t packet_size = 4 + 12 + payload_size;
+    auto stream = makeStream(kbps, payload_size);
+    auto stream_packets = stream.size() / packet_size;
+    int thread_count = MAX(1, (int) thread::hardware_concurrency());
+    atomic<uint64_t> total_packets(0);
+    atomic<uint64_t> total_parsed(0);
+    atomic<uint64_t> total_expected(0);
+
+    Ticker ticker;
+    vector<thread> threads;
+    for (int t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&, t]() {
+            vector<std::shared_ptr<IngestSession> > sessions;
+            vector<size_t> offsets;
+            vector<uint64_t> fed_bytes;
+            for (int i = t; i < publisher_count; i += thread_count) {
+                sessions.emplace_back(std::make_shared<IngestSession>(legacy));
+                //每个推流者从不同的rtp包开始推流(tcp连接总是从包边界开始)，之后的读取边界各不相同
+                offsets.emplace_back((i * 977) % stream_packets * packet_size);
+                fed_bytes.emplace_back(0);
+            }
+            //模拟socket接收缓存，末尾保留一个字节
+            string read_buf(read_size + 1, '\0');
+            uint64_t bytes_per_session = (uint64_t) stream.size() * seconds;
+            for (uint64_t done = 0; done < bytes_per_session; done += read_size) {
+                for (size_t i = 0; i < sessions.size(); ++i) {
+                    //从内核拷贝到socket接收缓存
+                    auto &offset = offsets[i];
+                    int size = MIN((size_t) read_size, stream.size() - offset);
+                    memcpy((char *) read_buf.data(), stream.data() + offset, size);
+                    offset = (offset + size) % stream.size();
+                    fed_bytes[i] += size;
+                    sessions[i]->feed(read_buf.data(), size);
+                }
+            }
+            uint64_t packets = 0, parsed = 0, expected = 0;
+            for (size_t i = 0; i < sessions.size(); ++i) {
+                packets += sessions[i]->packets();
+                parsed += sessions[i]->parsed();
+                //数据总是在包尾回绕，每个推流者收到的完整rtp包个数为其输入长度除以包长
+                expected += fed_bytes[i] / packet_size;
+            }
+            total_packets += packets;
+            total_parsed += parsed;
+            total_expected += expected;
+        });
+    }
+    for (auto &th : threads) {
+        th.join();
+    }
+    auto elapsed_ms = MAX(1, ticker.elapsedTime());
+    double mbps = (double) stream.size() * seconds * publisher_count * 8 / 1000 / elapsed_ms;
+    InfoL << (legacy ? "旧接收路径" : "直接切割") << " 推流者:" << publisher_count
+          << " 码率:" << kbps << "kbps"
+          << " 时长:" << seconds << "s"
+          << " 每次读取:" << read_size
+          << " 线程:" << thread_count
+          << " 耗时:" << elapsed_ms << "ms"
+          << " rtp包:" << total_packets.load()
+          << " 吞吐:" << mbps << "Mbps"
+          << " 实时倍数:" << (double) seconds * 1000 / elapsed_ms;
+    if (total_parsed.load() != total_expected.load()) {
+        ErrorL << "切割出的rtp包个数错误:" << total_parsed.load() << " != " << total_expected.load();
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    //设置日志
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+    Logger::Instance().setWriter(std::make_shared<AsyncLogWriter>());
+
+    int publisher_count = argc > 1 ? atoi(argv[1]) : 1000;
+    int seconds = argc > 2 ? atoi(argv[2]) : 10;
+    if (publisher_count <= 0 || seconds <= 0) {
+        ErrorL << "\r\n测试方法:./test_rtpIngest [publisher_count] [seconds]\r\n"
+               << "测试多个8Mbps rtsp推流者(rtp over tcp)的接收切割与解析性能，实时倍数大于1代表能够承载\r\n"
+               << endl;
+        return 0;
+    }
+
+    bool ok = true;
+    for (auto read_size : {4 * 1024, 16 * 1024, 64 * 1024}) {
+        ok = bench(publisher_count, 8 * 1000, seconds, read_size, true) && ok;
+        ok = bench(publisher_count, 8 * 1000, seconds, read_size, false) && ok;
+    }
+    return ok ? 0 : -1;
+}
@@ -0,0 +1,193 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <signal.h>
+#include <thread>
+#include <atomic>
+#include <iostream>
+#include "Util/util.h"
+#include "Util/File.h"
+#include "Util/logger.h"
+#include "Util/TimeTicker.h"
+#include "Network/TcpServer.h"
+#include "Network/sockutil.h"
+#include "Thread/semaphore.h"
+#include "Common/config.h"
+#include "Rtsp/RtspSession.h"
+#include "Rtmp/RtmpSession.h"
+#include "RtpProxy/RtpServer.h"
+#include "RtpProxy/RtpSelector.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+#if defined(ENABLE_RTPPROXY)
+
+#define RTP_PAYLOAD_SIZE 1400
+
+static atomic_bool s_exit(false);
+
+/**
+ * 获取ps pack头中的scr，单位90KHz
+ */
+static uint64_t getSCR(const uint8_t *pack) {
+    return (((uint64_t) pack[4] & 0x38) << 27) |
+           (((uint64_t) pack[4] & 0x03) << 28) |
+           ((uint64_t) pack[5] << 20) |
+           (((uint64_t) pack[6] & 0xF8) << 12) |
+           (((uint64_t) pack[6] & 0x03) << 13) |
+           ((uint64_t) pack[7] << 5) |
+           ((uint64_t) pack[8] >> 3);
+}
+
+/**
+ * 把ps pack切片成rtp并发送，同一个pack的rtp时间戳相同，最后一个rtp置mark位
+ */
+static void sendPack(int fd, const struct sockaddr_in &addr, uint32_t ssrc, uint16_t &seq, uint32_t stamp,
+                     const uint8_t *data, size_t size) {
+    uint8_t rtp[12 + RTP_PAYLOAD_SIZE];
+    while (size > 0) {
+        auto payload = MIN(size, (size_t) RTP_PAYLOAD_SIZE);
+        rtp[0] = 0x80;
+        rtp[1] = (payload == size ? 0x80 : 0) | 96;
+        rtp[2] = seq >> 8;
+        rtp[3] = seq & 0xFF;
+        rtp[4] = stamp >> 24;
+        rtp[5] = (stamp >> 16) & 0xFF;
+        rtp[6] = (stamp >> 8) & 0xFF;
+        rtp[7] = stamp & 0xFF;
+        rtp[8] = ssrc >> 24;
+        rtp[9] = (ssrc >> 16) & 0xFF;
+        rtp[10] = (ssrc >> 8) & 0xFF;
+        rtp[11] = ssrc & 0xFF;
+        memcpy(rtp + 12, data, payload);
+        ::sendto(fd, (char *) rtp, 12 + payload, 0, (struct sockaddr *) &addr, sizeof(addr));
+        ++seq;
+        data += payload;
+        size -= payload;
+    }
+}
+
+/**
+ * 按scr的节奏循环发送ps文件
+ */
+static void sendPSFile(const string &ps, uint16_t port, uint32_t ssrc) {
+    int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+    SockUtil::setSendBuf(fd, 4 * 1024 * 1024);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    auto data = (const uint8_t *) ps.data();
+    auto end = data + ps.size();
+    uint16_t seq = 0;
+    //循环发送时时间戳持续递增
+    uint64_t stamp_offset = 0;
+    while (!s_exit) {
+        Ticker ticker;
+        uint64_t first_scr = 0, last_scr = 0;
+        bool first = true;
+        auto pack = (const uint8_t *) memfind((char *) data, end - data, "\x00\x00\x01\xBA", 4);
+        while (pack && !s_exit) {
+            auto next = (const uint8_t *) memfind((char *) pack + 4, end - pack - 4, "\x00\x00\x01\xBA", 4);
+            auto pack_end = next ? next : end;
+            if (pack_end - pack < 14) {
+                break;
+            }
+            auto scr = getSCR(pack);
+            if (first) {
+                first = false;
+                first_scr = scr;
+            }
+            last_scr = scr;
+            //按scr控制发送速度
+            auto elapsed = (scr - first_scr) / 90;
+            while (!s_exit && ticker.elapsedTime() < elapsed) {
+                usleep(1000);
+            }
+            sendPack(fd, addr, ssrc, seq, (uint32_t) (scr - first_scr + stamp_offset), pack, pack_end - pack);
+            pack = next;
+        }
+        stamp_offset += last_scr - first_scr + 3600;
+        InfoL << "ps文件发送完毕，重新开始";
+    }
+    ::close(fd);
+}
+
+int main(int argc, char *argv[]) {
+    //设置日志
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+    Logger::Instance().setWriter(std::make_shared<AsyncLogWriter>());
+
+    if (argc < 2) {
+        ErrorL << "\r\n测试方法:./test_rtpProxy ps_file [ssrc] [port]\r\n"
+               << "把ps文件打包成rtp(udp)发送到本机GB28181收流端口，\r\n"
+               << "然后可以通过rtsp://127.0.0.1/rtp/ssrc(8位16进制) 或 rtmp://127.0.0.1/rtp/ssrc 播放\r\n"
+               << endl;
+        return 0;
+    }
+    string ps = File::loadFile(argv[1]);
+    if (ps.empty()) {
+        ErrorL << "读取ps文件失败:" << argv[1];
+        return -1;
+    }
+    uint32_t ssrc = argc > 2 ? strtoul(argv[2], nullptr, 10) : 100000001;
+    uint16_t port = argc > 3 ? atoi(argv[3]) : 10000;
+
+    TcpServer::Ptr rtspSrv(new TcpServer());
+    TcpServer::Ptr rtmpSrv(new TcpServer());
+    rtspSrv->start<RtspSession>(554);
+    rtmpSrv->start<RtmpSession>(1935);
+
+    RtpServer::Ptr rtpSrv = std::make_shared<RtpServer>();
+    if (!rtpSrv->start(port)) {
+        ErrorL << "GB28181收流端口启动失败:" << port;
+        return -1;
+    }
+    InfoL << "播放地址: rtsp://127.0.0.1/rtp/" << RtpSelector::getStreamId(ssrc);
+
+    thread sender([&]() {
+        sendPSFile(ps, port, ssrc);
+    });
+
+    //设置退出信号处理函数
+    static semaphore sem;
+    signal(SIGINT, [](int) { sem.post(); });// 设置退出信号
+    sem.wait();
+    s_exit = true;
+    sender.join();
+    return 0;
+}
+
+#else
+int main(int argc, char *argv[]) {
+    cout << "请在开启ENABLE_HLS与ENABLE_RTPPROXY后重新编译" << endl;
+    return 0;
+}
+#endif//defined(ENABLE_RTPPROXY)
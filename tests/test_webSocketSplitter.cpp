@@ -0,0 +1,267 @@
+﻿/*
+ * MIT License
+ *
+ * Copyright (c) 2016-2019 xiongziliang <771730766@qq.com>
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <stdlib.h>
+#include "Util/logger.h"
+#include "Http/WebSocketSplitter.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+//逐字节计算掩码，作为simd实现的参照
+static void maskDataScalar(uint8_t *data, uint64_t len, const uint8_t *mask, uint64_t offset) {
+    for (uint64_t i = 0; i < len; ++i) {
+        data[i] ^= mask[(offset + i) % 4];
+    }
+}
+
+/**
+ * 不同起始地址对齐、长度(覆盖simd批次后的尾部)以及掩码偏移下，maskData与逐字节实现结果一致
+ */
+static bool testMask() {
+    const uint8_t mask[4] = {0x12, 0x34, 0x56, 0x78};
+    vector<uint64_t> lens;
+    for (uint64_t len = 0; len <= 130; ++len) {
+        lens.emplace_back(len);
+    }
+    for (uint64_t len : {255, 256, 257, 1000, 4096, 4099}) {
+        lens.emplace_back(len);
+    }
+
+    vector<uint8_t> src(4099 + 64), simd(src.size()), scalar(src.size());
+    for (size_t i = 0; i < src.size(); ++i) {
+        src[i] = rand() & 0xFF;
+    }
+    for (auto len : lens) {
+        for (int align = 0; align < 32; ++align) {
+            for (uint64_t offset = 0; offset < 8; ++offset) {
+                simd = src;
+                scalar = src;
+                WebSocketSplitter::maskData(simd.data() + align, len, mask, offset);
+                maskDataScalar(scalar.data() + align, len, mask, offset);
+                //数据范围之外的字节也不能被修改
+                if (simd != scalar) {
+                    ErrorL << "maskData结果错误，长度:" << len << " 起始地址偏移:" << align << " 掩码偏移:" << offset;
+                    return false;
+                }
+            }
+        }
+    }
+    InfoL << "maskData测试通过，长度个数:" << lens.size();
+    return true;
+}
+
+class Frame {
+public:
+    bool fin;
+    WebSocketHeader::Type opcode;
+    bool mask_flag;
+    string payload;
+};
+
+/**
+ * 编码器，把编码后的数据追加到字符串
+ */
+class Encoder : public WebSocketSplitter {
+public:
+    string data;
+
+protected:
+    void onWebSocketEncodeData(const Buffer::Ptr &buffer) override {
+        data.append(buffer->data(), buffer->size());
+    }
+};
+
+/**
+ * 解码器，记录解析到的包头与负载
+ */
+class Decoder : public WebSocketSplitter {
+public:
+    vector<Frame> frames;
+    bool error = false;
+
+protected:
+    void onWebSocketDecodeHeader(const WebSocketHeader &header) override {
+        Frame frame;
+        frame.fin = header._fin;
+        frame.opcode = header._opcode;
+        frame.mask_flag = header._mask_flag;
+        frame.payload.reserve(header._playload_len);
+        frames.emplace_back(std::move(frame));
+    }
+
+    void onWebSocketDecodePlayload(const WebSocketHeader &header, const uint8_t *ptr, uint64_t len, uint64_t recved) override {
+        auto &payload = frames.back().payload;
+        payload.append((const char *) ptr, len);
+        if (payload.size() != recved) {
+            error = true;
+        }
+    }
+
+    void onWebSocketDecodeComplete(const WebSocketHeader &header) override {
+        if (frames.back().payload.size() != header._playload_len) {
+            error = true;
+        }
+    }
+};
+
+static Frame makeFrame(uint64_t len, bool mask_flag, WebSocketHeader::Type opcode) {
+    Frame frame;
+    frame.fin = true;
+    frame.opcode = opcode;
+    frame.mask_flag = mask_flag;
+    frame.payload.resize(len);
+    for (auto &ch : frame.payload) {
+        ch = rand() & 0xFF;
+    }
+    return frame;
+}
+
+static string encodeFrames(const vector<Frame> &frames) {
+    Encoder encoder;
+    for (size_t i = 0; i < frames.size(); ++i) {
+        auto &frame = frames[i];
+        WebSocketHeader header;
+        header._fin = frame.fin;
+        header._reserved = 0;
+        header._opcode = frame.opcode;
+        header._mask_flag = frame.mask_flag;
+        header._mask = {(uint8_t) (0xA0 + i), 0x5B, 0xC6, 0x1D};
+        if (i % 2) {
+            //不带掩码的大包不拷贝负载，包头走缓存
+            encoder.encode(header, std::make_shared<BufferString>(frame.payload));
+        } else {
+            encoder.encode(header, (const uint8_t *) frame.payload.data(), frame.payload.size());
+        }
+    }
+    return encoder.data;
+}
+
+/**
+ * 按切分点分多次输入解码器，检查解析结果
+ * @param stream 编码后的数据
+ * @param cuts 切分位置，升序
+ */
+static bool decodeAndCheck(const string &stream, const vector<size_t> &cuts, const vector<Frame> &frames) {
+    //解码时原地解掩码，所以每次都使用拷贝
+    string data = stream;
+    Decoder decoder;
+    size_t pos = 0;
+    for (auto cut : cuts) {
+        decoder.decode((uint8_t *) &data[pos], cut - pos);
+        pos = cut;
+    }
+    decoder.decode((uint8_t *) &data[pos], data.size() - pos);
+
+    if (decoder.error || decoder.frames.size() != frames.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < frames.size(); ++i) {
+        auto &got = decoder.frames[i];
+        auto &expect = frames[i];
+        if (got.fin != expect.fin || got.opcode != expect.opcode || got.mask_flag != expect.mask_flag || got.payload != expect.payload) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * 小包在每个字节处切分，覆盖7位长度、16位长度以及掩码的所有包头切分位置
+ */
+static bool testSplitEveryByte() {
+    vector<Frame> frames;
+    for (uint64_t len : {0, 1, 125, 126, 300}) {
+        frames.emplace_back(makeFrame(len, true, WebSocketHeader::BINARY));
+        frames.emplace_back(makeFrame(len, false, WebSocketHeader::TEXT));
+    }
+    auto stream = encodeFrames(frames);
+    for (size_t cut = 0; cut <= stream.size(); ++cut) {
+        if (!decodeAndCheck(stream, {cut}, frames)) {
+            ErrorL << "在第" << cut << "字节切分时解析错误";
+            return false;
+        }
+    }
+    //相邻两个切分点，覆盖包头被切成三段的情况
+    for (size_t cut = 0; cut + 1 <= stream.size(); ++cut) {
+        for (size_t next = cut + 1; next <= MIN(stream.size(), cut + 14); ++next) {
+            if (!decodeAndCheck(stream, {cut, next}, frames)) {
+                ErrorL << "在第" << cut << "与第" << next << "字节切分时解析错误";
+                return false;
+            }
+        }
+    }
+    InfoL << "逐字节切分测试通过，数据长度:" << stream.size();
+    return true;
+}
+
+/**
+ * 16位与64位长度的大包，按不同的固定长度分块输入，其中逐字节输入覆盖了所有包头切分位置
+ */
+static bool testLargeFrames() {
+    vector<Frame> frames;
+    for (uint64_t len : {0xFFFF, 0x10000, 70000}) {
+        frames.emplace_back(makeFrame(len, true, WebSocketHeader::BINARY));
+        frames.emplace_back(makeFrame(len, false, WebSocketHeader::BINARY));
+    }
+    auto stream = encodeFrames(frames);
+    for (size_t chunk : {1, 2, 3, 5, 7, 13, 14, 15, 4096, 65536}) {
+        vector<size_t> cuts;
+        for (size_t cut = chunk; cut < stream.size(); cut += chunk) {
+            cuts.emplace_back(cut);
+        }
+        if (!decodeAndCheck(stream, cuts, frames)) {
+            ErrorL << "按" << chunk << "字节分块输入时解析错误";
+            return false;
+        }
+    }
+    //一次输入全部数据
+    if (!decodeAndCheck(stream, {}, frames)) {
+        ErrorL << "一次输入全部数据时解析错误";
+        return false;
+    }
+    InfoL << "16/64位长度大包测试通过，数据长度:" << stream.size();
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    //设置日志
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+    Logger::Instance().setWriter(std::make_shared<AsyncLogWriter>());
+
+    srand(0);
+    int ret = 0;
+    if (!testMask() || !testSplitEveryByte() || !testLargeFrames()) {
+        ret = -1;
+    }
+    //等待日志输出
+    sleep(1);
+    return ret;
+}